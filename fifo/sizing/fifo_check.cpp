@@ -0,0 +1,107 @@
+// Compare the models of fifo_model.hpp with the GHDL simulation of the fifo variants (see 'make golden').
+
+#include "fifo_model.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+void print_help(const char* argv0){
+	fprintf(stderr, "usage: %s <variant> <depth> stimulus <n_clocks> <stimulus_file>\n", argv0);
+	fprintf(stderr, "       %s <variant> <depth> check <stimulus_file> <response_file>\n", argv0);
+	fprintf(stderr, " variant is active (fifo_active_out) or passive (fifo_passive_out)\n");
+	fprintf(stderr, " stimulus : write random input (with some resets) for fifo_file_tb\n");
+	fprintf(stderr, " check    : compare the output of fifo_file_tb (GHDL) with the model\n");
+}
+
+int stimulus(int depth, long n_clocks, const char *filename)
+{
+	FILE *f = fopen(filename, "w");
+	if (f == NULL) {
+		perror(filename);
+		return 2;
+	}
+	// stretches that mostly fill, mostly drain, or keep the fill level, so that full and empty are hit
+	int push_percent = 50, pop_percent = 50;
+	unsigned value = 0;
+	for (long t = 0; t < n_clocks; ++t) {
+		if (rand()%(8<<depth) == 0) {
+			push_percent = rand()%101;
+			pop_percent  = rand()%101;
+		}
+		int rst  = (t < 2) || (rand()%(100<<depth) == 0);
+		int push = rand()%100 < push_percent;
+		int pop  = rand()%100 < pop_percent;
+		value = (value + 1) & 0xffff;
+		fprintf(f, "%d %d %d %u\n", rst, push, pop, value);
+	}
+	fclose(f);
+	return 0;
+}
+
+template <typename Fifo>
+int check(int depth, const char *stimulus_file, const char *response_file)
+{
+	FILE *fs = fopen(stimulus_file, "r");
+	if (fs == NULL) {
+		perror(stimulus_file);
+		return 2;
+	}
+	FILE *fr = fopen(response_file, "r");
+	if (fr == NULL) {
+		perror(response_file);
+		return 2;
+	}
+	Fifo fifo(depth);
+	long line = 0, errors = 0;
+	int rst, push, pop;
+	unsigned d;
+	while (fscanf(fs, "%d %d %d %u", &rst, &push, &pop, &d) == 4) {
+		++line;
+		int full, empty;
+		char q[32];
+		if (fscanf(fr, "%d %d %31s", &full, &empty, q) != 3) {
+			fprintf(stderr, "%s ends at line %ld\n", response_file, line);
+			return 1;
+		}
+		if (rst) {
+			fifo.reset();
+		} else {
+			fifo.clock(push, pop, d);
+		}
+		std::string expect = (fifo.q() == fifo_model::undefined) ? "-" : std::to_string(fifo.q());
+		if (full != fifo.full() || empty != fifo.empty() || expect != q) {
+			if (errors++ < 10) {
+				fprintf(stderr, "line %ld: simulation %d %d %s, model %d %d %s\n", line, full, empty, q,
+					fifo.full(), fifo.empty(), expect.c_str());
+			}
+		}
+	}
+	fclose(fs);
+	fclose(fr);
+	printf("%ld clocks, %ld mismatches\n", line, errors);
+	return errors ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+	if (argc < 4) {
+		print_help(argv[0]);
+		return -1;
+	}
+	std::string variant = argv[1];
+	int depth = atoi(argv[2]);
+	if ((variant != "active" && variant != "passive") || depth < 1 || depth > 16) {
+		print_help(argv[0]);
+		return -1;
+	}
+	if (strcmp(argv[3], "stimulus") == 0 && argc == 6) {
+		return stimulus(depth, atol(argv[4]), argv[5]);
+	}
+	if (strcmp(argv[3], "check") == 0 && argc == 6) {
+		return variant == "active" ? check<fifo_model::active_out_fifo>(depth, argv[4], argv[5])
+		                           : check<fifo_model::passive_out_fifo>(depth, argv[4], argv[5]);
+	}
+	print_help(argv[0]);
+	return -1;
+}
@@ -0,0 +1,115 @@
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+use std.textio.all;
+
+-- Drives the guarded_fifo of the variant that was analyzed into the work library (fifo_active_out or
+-- fifo_passive_out) with the inputs from a text file and writes its outputs to another text file,
+-- one line per clock cycle. The input lines are "<rst> <push> <pop> <d>", the output lines are
+-- "<full> <empty> <q>" after the rising edge that sampled the input line with the same number,
+-- where q is "-" if it has undefined bits. fifo_check compares the output with the C++ model.
+entity fifo_file_tb is
+  generic (
+    depth       : integer := 3;
+    input_file  : string  := "fifo_stimulus.txt";
+    output_file : string  := "fifo_response.txt"
+  );
+end entity;
+
+architecture simulation of fifo_file_tb is
+  constant clk_period : time    := 5 ns;
+  constant bit_width  : integer := 16;
+
+  signal d, q        : std_logic_vector(bit_width-1 downto 0) := (others => '0');
+  signal push, pop   : std_logic := '0';
+  signal full, empty : std_logic;
+
+  signal clk  : std_logic := '0';
+  signal rst  : std_logic := '1';
+  signal done : boolean   := false;
+
+begin
+
+  dut : entity work.guarded_fifo
+    generic map (
+      depth     => depth,
+      bit_width => bit_width
+    )
+    port map (
+      clk_i   => clk,
+      rst_i   => rst,
+      push_i  => push,
+      pop_i   => pop,
+      full_o  => full,
+      empty_o => empty,
+      d_i     => d,
+      q_o     => q
+    );
+
+  clk_gen: process
+  begin
+    while not done loop
+      clk <= '0';
+      wait for clk_period/2;
+      clk <= '1';
+      wait for clk_period/2;
+    end loop;
+    wait;
+  end process;
+
+  -- inputs change and outputs are recorded at the falling edge
+  stimulus: process
+    file     f_in     : text open read_mode  is input_file;
+    file     f_out    : text open write_mode is output_file;
+    variable l_in     : line;
+    variable l_out    : line;
+    variable rst_bit  : integer;
+    variable push_bit : integer;
+    variable pop_bit  : integer;
+    variable value    : integer;
+
+    function to_sl(b : integer) return std_logic is
+    begin
+      if b = 0 then
+        return '0';
+      end if;
+      return '1';
+    end function;
+
+    function to_int(b : std_logic) return integer is
+    begin
+      if b = '1' then
+        return 1;
+      end if;
+      return 0;
+    end function;
+  begin
+    wait until falling_edge(clk);
+    while not endfile(f_in) loop
+      readline(f_in, l_in);
+      read(l_in, rst_bit);
+      read(l_in, push_bit);
+      read(l_in, pop_bit);
+      read(l_in, value);
+      rst  <= to_sl(rst_bit);
+      push <= to_sl(push_bit);
+      pop  <= to_sl(pop_bit);
+      d    <= std_logic_vector(to_unsigned(value, bit_width));
+      wait until falling_edge(clk);
+      write(l_out, to_int(full));
+      write(l_out, string'(" "));
+      write(l_out, to_int(empty));
+      write(l_out, string'(" "));
+      if is_x(q) then
+        write(l_out, string'("-"));
+      else
+        write(l_out, to_integer(unsigned(q)));
+      end if;
+      writeline(f_out, l_out);
+    end loop;
+    done <= true;
+    wait;
+  end process;
+
+end architecture;
@@ -0,0 +1,258 @@
+#ifndef FIFO_MODEL_HPP_
+#define FIFO_MODEL_HPP_
+
+// Header-only C++17 cycle-accurate models of the three fifo variants in this directory.
+// Each clock() call is one rising clock edge, the inputs are the values that the signals
+// have during the cycle before the edge, and the outputs (full, empty, q, ...) are the
+// values during the cycle after the edge. The register updates follow the processes in
+// the VHDL, including the order of reads and writes of the storage array, so the models
+// also show what the RTL delivers in corner cases.
+//
+//   fifo_model::active_out_fifo  : fifo_active_out/guarded_fifo.vhd, q is valid in the cycle after a pop
+//   fifo_model::passive_out_fifo : fifo_passive_out/guarded_fifo.vhd, q shows the oldest entry whenever
+//                                  the fifo is not empty, a pop removes it
+//   fifo_model::slow_read_fifo   : slow_read_fifo/guarded_fifo.vhd, push on the fast clock, drdy/dack
+//                                  handshake through two-stage synchronizers on the slow clock
+//
+// All variants are guarded: a push when full and a pop when empty are ignored. Values that are 'U'
+// in the simulation (q when no data is shown, storage that was never written) are undefined.
+
+#include <cstdint>
+#include <vector>
+
+namespace fifo_model {
+
+constexpr uint64_t undefined = ~uint64_t(0);
+
+// which of the requests took effect at a clock edge
+struct edge {
+	bool pushed = false;
+	bool popped = false;
+};
+
+// storage and index logic of fifo.vhd: 2**depth entries, indices with one extra bit
+class fifo_core {
+public:
+	explicit fifo_core(unsigned depth)
+		: depth_(depth), size_(1u << depth), mask_(size_-1), wrap_(2*size_-1), data_(size_, undefined) {}
+
+	unsigned depth() const { return depth_; }
+	uint32_t size()  const { return size_; }
+	uint32_t fill()  const { return (w_ - r_) & wrap_; }
+	// same indices up to the MSB: full if the MSBs differ, empty otherwise
+	bool full()  const { return ((w_ ^ r_) & wrap_) == size_; }
+	bool empty() const { return w_ == r_; }
+
+	// a clock edge with rst_i = '1'
+	void reset() { w_ = r_ = 0; }
+
+protected:
+	uint64_t read(uint32_t idx) const { return data_[idx & mask_]; }
+	void write(uint64_t d)  { data_[w_ & mask_] = d; w_ = (w_ + 1) & wrap_; }
+	void advance_read()     { r_ = (r_ + 1) & wrap_; }
+
+	unsigned depth_;
+	uint32_t size_, mask_, wrap_;
+	uint32_t w_ = 0, r_ = 0;
+	std::vector<uint64_t> data_;
+};
+
+// fifo_active_out: q_o is registered from the storage when popped and 'U' otherwise
+class active_out_fifo : public fifo_core {
+public:
+	explicit active_out_fifo(unsigned depth) : fifo_core(depth) {}
+
+	edge clock(bool push_i, bool pop_i, uint64_t d_i) {
+		edge e;
+		e.pushed = push_i && !full();
+		e.popped = pop_i  && !empty();
+		q_ = undefined;
+		if (e.popped) {
+			q_ = read(r_);
+			advance_read();
+		}
+		if (e.pushed) {
+			write(d_i);
+		}
+		return e;
+	}
+
+	uint64_t q() const { return q_; }
+
+private:
+	uint64_t q_ = undefined;
+};
+
+// fifo_passive_out: a register q follows the oldest entry, q_o is 'U' when empty.
+// Note that q is loaded from the storage before the write of the same edge, so a push together with
+// a pop while the fifo has one entry shows the old content of the written slot instead of the new entry.
+class passive_out_fifo : public fifo_core {
+public:
+	explicit passive_out_fifo(unsigned depth) : fifo_core(depth) {}
+
+	edge clock(bool push_i, bool pop_i, uint64_t d_i) {
+		edge e;
+		e.pushed = push_i && !full();
+		e.popped = pop_i  && !empty();
+		if (e.pushed && empty()) {
+			q_ = d_i;
+		} else if (e.popped) {
+			q_ = read(r_+1);
+		} else {
+			q_ = read(r_);
+		}
+		if (e.popped) {
+			advance_read();
+		}
+		if (e.pushed) {
+			write(d_i);
+		}
+		return e;
+	}
+
+	uint64_t q() const { return empty() ? undefined : q_; }
+
+private:
+	uint64_t q_ = undefined;
+};
+
+// slow_read_fifo: the fifo (active output) runs on the fast clock, a state machine pops one entry
+// into a register and raises data_ready. The slow side synchronizes data_ready, shows drdy_o and q_o,
+// and the reader answers with dack_i, which is synchronized back to the fast side.
+class slow_read_fifo : public fifo_core {
+public:
+	enum fast_state { s_idle, s_getting_data_pop, s_getting_data_nopop, s_getting_data_latch, s_providing_data, s_start_pop };
+
+	explicit slow_read_fifo(unsigned depth) : fifo_core(depth) {}
+
+	// an edge of both clocks with rst_fast_i = rst_i = '1' (pop and the dack synchronizer are not reset)
+	void reset() {
+		fifo_core::reset();
+		state_ = s_idle;
+		fifo_out_data_fast_ = undefined;
+		data_ready_ = false;
+		drdy_ = data_ready_sync_1_ = data_ready_sync_ = data_ready_block_ = block_state_ = false;
+		q_o_ = undefined;
+	}
+
+	// A rising edge of the fast clock, the slow clock, or both at the same time.
+	// push_i and d_i are sampled by the fast edge, dack_i (a slow side signal) by both edges.
+	bool clock(bool fast_edge, bool slow_edge, bool push_i, uint64_t d_i, bool dack_i) {
+		// values of the fast side registers before the edge, seen by the slow side
+		const bool     data_ready         = data_ready_;
+		const uint64_t fifo_out_data_fast = fifo_out_data_fast_;
+		bool pushed = false;
+		if (fast_edge) {
+			pushed = fast_clock(push_i, d_i, dack_i);
+		}
+		if (slow_edge) {
+			slow_clock(dack_i, data_ready, fifo_out_data_fast);
+		}
+		return pushed;
+	}
+
+	// slow side outputs
+	bool       drdy()  const { return drdy_; }
+	uint64_t   q()     const { return q_o_; }
+	fast_state state() const { return state_; }
+
+private:
+	bool fast_clock(bool push_i, uint64_t d_i, bool dack_i) {
+		const bool     empty  = this->empty();
+		const bool     pop    = pop_;
+		const uint64_t q      = q_;
+		const bool     pushed = push_i && !full();
+
+		// fifo.vhd (pop is not guarded, the state machine only pops when not empty)
+		q_ = undefined;
+		if (pop) {
+			q_ = read(r_);
+			advance_read();
+		}
+		if (pushed) {
+			write(d_i);
+		}
+
+		// fast_side process
+		const bool pop_request_sync = pop_request_sync_;
+		pop_request_sync_   = pop_request_sync_1_;
+		pop_request_sync_1_ = dack_i;
+		switch (state_) {
+			case s_idle:
+				if (!empty && !pop_request_sync) {
+					state_ = s_getting_data_pop;
+				}
+				break;
+			case s_getting_data_pop:
+				if (empty) {
+					state_ = s_idle;
+				} else {
+					pop_   = true;
+					state_ = s_getting_data_nopop;
+				}
+				break;
+			case s_getting_data_nopop:
+				pop_        = false;
+				data_ready_ = true;
+				state_      = s_getting_data_latch;
+				break;
+			case s_getting_data_latch:
+				state_ = s_providing_data;
+				// q is valid here because pop was set in the cycle before
+				fifo_out_data_fast_ = q;
+				data_ready_ = true;
+				break;
+			case s_providing_data:
+				if (pop_request_sync) {
+					state_      = s_start_pop;
+					data_ready_ = false;
+				}
+				break;
+			case s_start_pop:
+				if (!pop_request_sync) {
+					state_ = s_idle;
+				}
+				break;
+		}
+		return pushed;
+	}
+
+	void slow_clock(bool dack_i, bool data_ready, uint64_t fifo_out_data_fast) {
+		const bool sync   = data_ready_sync_;
+		const bool sync_1 = data_ready_sync_1_;
+		drdy_ = sync && !data_ready_block_;
+		if (sync) {
+			q_o_ = fifo_out_data_fast;
+		}
+		data_ready_sync_1_ = data_ready;
+		data_ready_sync_   = sync_1;
+		if (!block_state_) {
+			if (dack_i) {
+				block_state_      = true;
+				data_ready_block_ = true;
+			}
+		} else if (sync && !sync_1) {
+			block_state_      = false;
+			data_ready_block_ = false;
+		}
+	}
+
+	// fast side
+	fast_state state_ = s_idle;
+	bool     pop_ = false;
+	uint64_t q_ = undefined;
+	bool     data_ready_ = false;
+	uint64_t fifo_out_data_fast_ = undefined;
+	bool     pop_request_sync_1_ = false, pop_request_sync_ = false;
+
+	// slow side
+	bool     drdy_ = false;
+	uint64_t q_o_ = undefined;
+	bool     data_ready_sync_1_ = false, data_ready_sync_ = false;
+	bool     data_ready_block_ = false;
+	bool     block_state_ = false; // s_block
+};
+
+} // namespace fifo_model
+
+#endif
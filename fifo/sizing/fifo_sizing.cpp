@@ -0,0 +1,404 @@
+// Size the depth generic of a fifo variant: run the cycle-accurate model of fifo_model.hpp with
+// producer and consumer rate models (or recorded traces) for a range of depths, one depth per
+// thread, and show fill level statistics, overflows, and the achieved throughput.
+
+#include "fifo_model.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+void print_help(const char* argv0){
+	fprintf(stderr, "usage: %s [options]\n", argv0);
+	fprintf(stderr, " Simulate a fifo variant for a range of depths and show for each depth the fill level\n");
+	fprintf(stderr, " distribution, the fraction of items that found the fifo full, and the throughput.\n");
+	fprintf(stderr, " Items are offered by the producer in each cycle of the write clock with probability\n");
+	fprintf(stderr, " <rate>, in bursts of mean length <burst> (1 means independent cycles). Items that\n");
+	fprintf(stderr, " find the fifo full are dropped, or with -b wait until they fit.\n");
+	fprintf(stderr, " options are\n");
+	fprintf(stderr, " -V <variant>      : active (fifo_active_out), passive (fifo_passive_out), slow (slow_read_fifo)\n");
+	fprintf(stderr, "                     default is active\n");
+	fprintf(stderr, " -d <min>[:<max>]  : depths to simulate, the fifo has 2**depth entries (default is 1:12)\n");
+	fprintf(stderr, " -n <cycles>       : cycles of the write clock per depth (default is 1000000)\n");
+	fprintf(stderr, " -p <rate>         : producer rate in items per cycle (default is 0.5)\n");
+	fprintf(stderr, " -P <burst>        : mean producer burst length in cycles (default is 1)\n");
+	fprintf(stderr, " -c <rate>         : consumer rate in items per cycle of the read clock (default is 0.6)\n");
+	fprintf(stderr, " -C <burst>        : mean consumer burst length in cycles (default is 1)\n");
+	fprintf(stderr, " -w <file>         : replay a producer trace instead, '1' and '0' for the cycles with and\n");
+	fprintf(stderr, "                     without an item, other characters are ignored, the trace repeats\n");
+	fprintf(stderr, " -r <file>         : replay a consumer trace, '1' for the cycles where the reader is ready\n");
+	fprintf(stderr, " -b                : back pressure, the producer waits while the fifo is full\n");
+	fprintf(stderr, " -f <ps>           : write (fast) clock period of the slow variant (default is 4000)\n");
+	fprintf(stderr, " -s <ps>           : read (slow) clock period of the slow variant (default is 20000)\n");
+	fprintf(stderr, " -j <threads>      : number of threads (default is the number of cores)\n");
+	fprintf(stderr, " -S <seed>         : seed of the random numbers, all depths see the same sequence (default is 1)\n");
+	fprintf(stderr, " -H                : show the fill level histogram of each depth\n");
+}
+
+uint64_t xorshift(uint64_t *state)
+{
+	*state ^= *state >> 12;
+	*state ^= *state << 25;
+	*state ^= *state >> 27;
+	return *state * 2685821657736338717ull;
+}
+
+double uniform(uint64_t *state)
+{
+	return (xorshift(state) >> 11) * (1.0/9007199254740992.0);
+}
+
+// Decides for each cycle if the producer has an item (or the consumer is ready). Either a recorded
+// trace, or an on/off process: 'on' cycles come in bursts with geometric length of mean burst,
+// and the 'off' gaps are long enough to give the mean rate. burst <= 1 are independent cycles.
+struct rate_source {
+	double rate = 0.5, burst = 1;
+	const std::vector<uint8_t> *trace = nullptr;
+
+	uint64_t rng = 1;
+	size_t   pos = 0;
+	bool     on  = false;
+
+	void seed(uint64_t seed) {
+		rng = seed ? seed : 1;
+		pos = 0;
+		on  = false;
+	}
+
+	bool next() {
+		if (trace) {
+			bool result = (*trace)[pos];
+			if (++pos == trace->size()) pos = 0;
+			return result;
+		}
+		if (rate >= 1) return true;
+		if (rate <= 0) return false;
+		if (burst <= 1) {
+			return uniform(&rng) < rate;
+		}
+		double gap = burst*(1-rate)/rate;
+		if (on) {
+			on = uniform(&rng) >= 1/burst;
+		} else {
+			on = uniform(&rng) < 1/gap;
+		}
+		return on;
+	}
+};
+
+struct config {
+	std::string variant = "active";
+	uint64_t cycles = 1000000;
+	rate_source producer, consumer;
+	bool backpressure = false;
+	double fast_ps = 4000, slow_ps = 20000;
+	uint64_t seed = 1;
+};
+
+struct result {
+	unsigned depth = 0;
+	uint64_t cycles = 0, read_cycles = 0;
+	uint64_t offered = 0, dropped = 0, stalled_cycles = 0;
+	uint64_t popped = 0, wrong_data = 0;
+	uint64_t full_cycles = 0;
+	std::vector<uint64_t> histogram; // cycles per fill level
+
+	double mean_fill() const {
+		double sum = 0;
+		for (size_t i = 0; i < histogram.size(); ++i) sum += i*(double)histogram[i];
+		return cycles ? sum/cycles : 0;
+	}
+	// smallest fill level that is not exceeded in fraction q of the cycles
+	size_t quantile(double q) const {
+		uint64_t sum = 0;
+		for (size_t i = 0; i < histogram.size(); ++i) {
+			sum += histogram[i];
+			if (sum >= q*cycles) return i;
+		}
+		return histogram.size()-1;
+	}
+	size_t max_fill() const {
+		for (size_t i = histogram.size(); i > 0; --i) {
+			if (histogram[i-1]) return i-1;
+		}
+		return 0;
+	}
+};
+
+// The producer keeps the item that it could not push (back pressure) or drops it. Items are
+// numbered in the order in which they enter the fifo, the consumer checks that it gets them in order.
+struct producer_state {
+	bool     has_item = false;
+	uint64_t next_item = 0;
+
+	// called once per write clock cycle, before the edge
+	bool want_push(rate_source &source, result &r, bool backpressure) {
+		if (!has_item || !backpressure) {
+			if (has_item) {
+				++r.dropped;
+			}
+			has_item = source.next();
+			r.offered += has_item;
+		} else {
+			++r.stalled_cycles;
+		}
+		return has_item;
+	}
+	void after_edge(bool pushed) {
+		if (pushed) {
+			has_item = false;
+			++next_item;
+		}
+	}
+};
+
+template <typename Fifo>
+void run_single_clock(const config &cfg, result &r)
+{
+	Fifo fifo(r.depth);
+	rate_source producer = cfg.producer, consumer = cfg.consumer;
+	producer.seed(cfg.seed);
+	consumer.seed(cfg.seed*0x9e3779b97f4a7c15ull + 1);
+	producer_state prod;
+	uint64_t expect = 0;
+	for (uint64_t c = 0; c < cfg.cycles; ++c) {
+		++r.histogram[fifo.fill()];
+		r.full_cycles += fifo.full();
+		bool push = prod.want_push(producer, r, cfg.backpressure);
+		bool pop  = consumer.next();
+		uint64_t q = fifo.q();
+		fifo_model::edge e = fifo.clock(push, pop, prod.next_item);
+		prod.after_edge(e.pushed);
+		if (e.popped) {
+			++r.popped;
+			// passive: the value is taken before the edge, active: it arrives after the edge
+			uint64_t value = std::is_same<Fifo, fifo_model::passive_out_fifo>::value ? q : fifo.q();
+			if (value != expect) {
+				++r.wrong_data;
+			}
+			++expect;
+		}
+	}
+	r.cycles = r.read_cycles = cfg.cycles;
+}
+
+void run_slow_read(const config &cfg, result &r)
+{
+	fifo_model::slow_read_fifo fifo(r.depth);
+	rate_source producer = cfg.producer, consumer = cfg.consumer;
+	producer.seed(cfg.seed);
+	consumer.seed(cfg.seed*0x9e3779b97f4a7c15ull + 1);
+	producer_state prod;
+	uint64_t expect = 0;
+	// reader: takes the data when drdy rises and answers with a dack pulse in a cycle where it is ready
+	bool drdy_prev = false, pending = false, dack = false;
+	// odd phase, as in the testbench, so that the edges don't coincide exactly unless the periods do
+	double t_fast = 567, t_slow = 0;
+	for (uint64_t c = 0; c < cfg.cycles; ) {
+		bool fast_edge = t_fast <= t_slow;
+		bool slow_edge = t_slow <= t_fast;
+		bool push = false;
+		if (fast_edge) {
+			++r.histogram[fifo.fill()];
+			r.full_cycles += fifo.full();
+			push = prod.want_push(producer, r, cfg.backpressure);
+		}
+		bool next_dack = dack;
+		if (slow_edge) {
+			bool drdy = fifo.drdy();
+			if (drdy && !drdy_prev) {
+				pending = true;
+			}
+			drdy_prev = drdy;
+			next_dack = false;
+			if (pending && consumer.next()) {
+				pending   = false;
+				next_dack = true;
+				++r.popped;
+				if (fifo.q() != expect) {
+					++r.wrong_data;
+				}
+				++expect;
+			}
+			++r.read_cycles;
+		}
+		bool pushed = fifo.clock(fast_edge, slow_edge, push, prod.next_item, dack);
+		dack = next_dack;
+		if (fast_edge) {
+			prod.after_edge(pushed);
+			t_fast += cfg.fast_ps;
+			++c;
+		}
+		if (slow_edge) {
+			t_slow += cfg.slow_ps;
+		}
+	}
+	r.cycles = cfg.cycles;
+}
+
+void run(const config &cfg, result &r)
+{
+	r.histogram.assign((1u << r.depth)+1, 0);
+	if (cfg.variant == "active") {
+		run_single_clock<fifo_model::active_out_fifo>(cfg, r);
+	} else if (cfg.variant == "passive") {
+		run_single_clock<fifo_model::passive_out_fifo>(cfg, r);
+	} else {
+		run_slow_read(cfg, r);
+	}
+}
+
+bool read_trace(const char *file_name, std::vector<uint8_t> &trace)
+{
+	FILE *f = fopen(file_name, "r");
+	if (f == NULL) {
+		perror(file_name);
+		return false;
+	}
+	int ch;
+	while ((ch = fgetc(f)) != EOF) {
+		if (ch == '0' || ch == '1') {
+			trace.push_back(ch == '1');
+		}
+	}
+	fclose(f);
+	if (trace.empty()) {
+		fprintf(stderr, "%s: no '0' or '1' in the trace\n", file_name);
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char **argv) {
+	config cfg;
+	cfg.consumer.rate = 0.6;
+	int min_depth = 1, max_depth = 12;
+	int threads = std::thread::hardware_concurrency();
+	bool histogram = false;
+	std::vector<uint8_t> producer_trace, consumer_trace;
+
+	for (int i = 1; i < argc; ++i) {
+		double *value = NULL;
+		if      (strcmp(argv[i],"-p") == 0) value = &cfg.producer.rate;
+		else if (strcmp(argv[i],"-P") == 0) value = &cfg.producer.burst;
+		else if (strcmp(argv[i],"-c") == 0) value = &cfg.consumer.rate;
+		else if (strcmp(argv[i],"-C") == 0) value = &cfg.consumer.burst;
+		else if (strcmp(argv[i],"-f") == 0) value = &cfg.fast_ps;
+		else if (strcmp(argv[i],"-s") == 0) value = &cfg.slow_ps;
+		else if (strcmp(argv[i],"-b") == 0) {
+			cfg.backpressure = true;
+			continue;
+		} else if (strcmp(argv[i],"-H") == 0) {
+			histogram = true;
+			continue;
+		} else if (strcmp(argv[i],"--help") == 0) {
+			print_help(argv[0]);
+			return 0;
+		} else if (i+1 >= argc) {
+			fprintf(stderr, "unkown command line option or missing value: %s\n", argv[i]);
+			return -1;
+		} else if (strcmp(argv[i],"-V") == 0) {
+			cfg.variant = argv[++i];
+			if (cfg.variant != "active" && cfg.variant != "passive" && cfg.variant != "slow") {
+				fprintf(stderr, "unknown variant %s\n", argv[i]);
+				return -1;
+			}
+			continue;
+		} else if (strcmp(argv[i],"-d") == 0) {
+			int n = sscanf(argv[++i], "%d:%d", &min_depth, &max_depth);
+			if (n == 1) max_depth = min_depth;
+			if (n < 1 || min_depth < 1 || max_depth > 24 || min_depth > max_depth) {
+				fprintf(stderr, "expect depths <min>[:<max>] in [1,24] after option -d\n");
+				return -1;
+			}
+			continue;
+		} else if (strcmp(argv[i],"-n") == 0) {
+			if (sscanf(argv[++i], "%llu", (unsigned long long*)&cfg.cycles) != 1) {
+				fprintf(stderr, "expect integer value after option -n\n");
+				return -1;
+			}
+			continue;
+		} else if (strcmp(argv[i],"-S") == 0) {
+			if (sscanf(argv[++i], "%llu", (unsigned long long*)&cfg.seed) != 1) {
+				fprintf(stderr, "expect integer value after option -S\n");
+				return -1;
+			}
+			continue;
+		} else if (strcmp(argv[i],"-j") == 0) {
+			if (sscanf(argv[++i], "%d", &threads) != 1) {
+				fprintf(stderr, "expect integer value after option -j\n");
+				return -1;
+			}
+			continue;
+		} else if (strcmp(argv[i],"-w") == 0) {
+			if (!read_trace(argv[++i], producer_trace)) return -1;
+			cfg.producer.trace = &producer_trace;
+			continue;
+		} else if (strcmp(argv[i],"-r") == 0) {
+			if (!read_trace(argv[++i], consumer_trace)) return -1;
+			cfg.consumer.trace = &consumer_trace;
+			continue;
+		} else {
+			fprintf(stderr, "unkown command line option: %s\n", argv[i]);
+			return -1;
+		}
+		if (++i >= argc || sscanf(argv[i], "%lf", value) != 1 || *value < 0) {
+			fprintf(stderr, "expect non-negative number after option %s\n", argv[i-1]);
+			return -1;
+		}
+	}
+	if (cfg.variant == "slow" && (cfg.fast_ps <= 0 || cfg.slow_ps <= 0)) {
+		fprintf(stderr, "clock periods must be positive\n");
+		return -1;
+	}
+
+	// one depth per task, the threads take the next depth when they are done
+	std::vector<result> results(max_depth-min_depth+1);
+	for (size_t k = 0; k < results.size(); ++k) {
+		results[k].depth = min_depth + k;
+	}
+	std::atomic<size_t> next(0);
+	auto worker = [&]() {
+		for (size_t k; (k = next.fetch_add(1)) < results.size(); ) {
+			run(cfg, results[k]);
+		}
+	};
+	threads = std::max(1, std::min(threads, (int)results.size()));
+	std::vector<std::thread> pool;
+	for (int t = 1; t < threads; ++t) {
+		pool.emplace_back(worker);
+	}
+	worker();
+	for (auto &t : pool) {
+		t.join();
+	}
+
+	printf("variant %s, %llu write cycles, %s\n", cfg.variant.c_str(), (unsigned long long)cfg.cycles,
+		cfg.backpressure ? "back pressure" : "dropping items when full");
+	// dropping: the fraction of offered items that were dropped,
+	// back pressure: the fraction of write cycles in which the producer waited
+	printf("depth entries  mean-fill  p99-fill  max-fill   P(full) %14s  offered/cyc   popped/cyc  wrong-data\n",
+		cfg.backpressure ? "P(wait)" : "overflow-prob");
+	for (const result &r : results) {
+		double overflow = cfg.backpressure ? (double)r.stalled_cycles/r.cycles
+		                                   : (r.offered ? (double)r.dropped/r.offered : 0);
+		printf("%5u %7u %10.2f %9zu %9zu %9.2e %14.3e %12.4f %12.4f %11llu\n", r.depth, 1u << r.depth,
+			r.mean_fill(), r.quantile(0.99), r.max_fill(), (double)r.full_cycles/r.cycles, overflow,
+			(double)r.offered/r.cycles, (double)r.popped/r.read_cycles, (unsigned long long)r.wrong_data);
+		if (histogram) {
+			for (size_t f = 0; f < r.histogram.size(); ++f) {
+				if (r.histogram[f]) {
+					printf("      fill %7zu: %12llu cycles %8.4f%%\n", f, (unsigned long long)r.histogram[f], 100.0*r.histogram[f]/r.cycles);
+				}
+			}
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,145 @@
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+-- Moving average over 2^depth samples for many channels that share one delay memory
+-- and one adder. The samples come in as one stream (stb_i = '1'), in the order
+-- channel 0, 1, ..., channels-1, 0, 1, ... and gaps are allowed between them.
+-- Each sample produces one output (stb_o = '1') two clock cycles later.
+--
+-- For each channel the sequence of outputs is the same as the sequence of value_o
+-- of a maw that is clocked once per sample of that channel (and was reset together
+-- with the bank). The registers of that maw (add, sub, sum, and the output register
+-- of its delay) are kept in a memory with one word per channel, the delay memory holds
+-- 2^depth words per channel. Both memories are read and written once per sample, so
+-- they map to block RAM, while the calculation is the same as in maw.vhd.
+entity maw_bank is
+  generic (
+    -- window width is 2^depth
+    depth           : integer;
+    input_bit_width : integer;
+    channels        : integer
+  );
+  port (
+    clk_i , rst_i   : in  std_logic;
+    stb_i           : in  std_logic;
+    value_i         : in  unsigned ( input_bit_width-1 downto 0 );
+    stb_o           : out std_logic;
+    channel_o       : out integer range 0 to channels-1;
+    -- the ouput value's maximum is 2^input_bit_width * 2^depth
+    value_o         : out unsigned ( input_bit_width+depth-1 downto 0 )
+  );
+end entity;
+
+architecture rtl of maw_bank is
+  constant number_of_words : integer := 2**depth;
+
+  subtype t_value is unsigned (input_bit_width-1 downto 0);
+  subtype t_sum   is unsigned (input_bit_width+depth-1 downto 0);
+  type t_delay_data is array (0 to channels*number_of_words-1) of t_value;
+  type t_values     is array (0 to channels-1) of t_value;
+  type t_sums       is array (0 to channels-1) of t_sum;
+
+  -- delay memory, the word of channel c for frame f is at c*2^depth + (f mod 2^depth)
+  signal delay_data : t_delay_data;
+  -- the registers of maw.vhd for each channel
+  signal delayed_regs, add_regs, sub_regs : t_values;
+  signal sum_regs   : t_sums;
+
+  -- input side: channel and frame of the next sample
+  signal channel    : integer range 0 to channels-1 := 0;
+  signal frame_idx  : unsigned (depth-1 downto 0) := (others => '0');
+  signal started    : std_logic := '0'; -- a frame was completed since reset
+  signal filled     : std_logic := '0'; -- 2^depth frames were completed since reset
+
+  -- first pipeline stage: the sample and the old registers of its channel
+  signal stb_1      : std_logic := '0';
+  signal channel_1  : integer range 0 to channels-1 := 0;
+  signal value_1    : t_value;
+  signal started_1  : std_logic;
+  signal filled_1   : std_logic;
+  signal memory_1   : t_value;
+  signal delayed_1, add_1, sub_1 : t_value;
+  signal sum_1      : t_sum;
+
+begin
+
+  assert channels >= 2 report "maw_bank needs at least two channels, use maw for a single channel" severity failure;
+
+  process (clk_i)
+    variable leading_zeros : unsigned (depth-1 downto 0) := (others => '0');
+    variable address       : integer range 0 to channels*number_of_words-1;
+    variable delayed, add, sub : t_value;
+    variable sum           : t_sum;
+  begin
+    if rising_edge(clk_i) then
+      if rst_i = '1' then
+        channel   <= 0;
+        frame_idx <= (others => '0');
+        started   <= '0';
+        filled    <= '0';
+        stb_1     <= '0';
+        stb_o     <= '0';
+        channel_o <= 0;
+        value_o   <= (others => '0');
+      else
+
+        -- read the delay memory and the registers of the channel, write the sample
+        stb_1 <= stb_i;
+        if stb_i = '1' then
+          address := channel*number_of_words + to_integer(frame_idx);
+          memory_1  <= delay_data(address);
+          delay_data(address) <= value_i;
+          delayed_1 <= delayed_regs(channel);
+          add_1     <= add_regs(channel);
+          sub_1     <= sub_regs(channel);
+          sum_1     <= sum_regs(channel);
+          channel_1 <= channel;
+          value_1   <= value_i;
+          started_1 <= started;
+          filled_1  <= filled;
+          if channel = channels-1 then
+            channel   <= 0;
+            frame_idx <= frame_idx + 1;
+            started   <= '1';
+            if frame_idx = number_of_words-1 then
+              filled <= '1';
+            end if;
+          else
+            channel <= channel + 1;
+          end if;
+        end if;
+
+        -- one clock cycle of maw.vhd for the channel
+        stb_o <= stb_1;
+        if stb_1 = '1' then
+          delayed := delayed_1;
+          add     := add_1;
+          sub     := sub_1;
+          sum     := sum_1;
+          if started_1 = '0' then
+            -- the registers of this channel were not written since reset
+            delayed := (others => '0');
+            add     := (others => '0');
+            sub     := (others => '0');
+            sum     := (others => '0');
+          end if;
+          -- as in delay.vhd, nothing comes out before the memory was filled once
+          if filled_1 = '1' then
+            delayed_regs(channel_1) <= memory_1;
+          else
+            delayed_regs(channel_1) <= (others => '0');
+          end if;
+          add_regs(channel_1) <= value_1;
+          sub_regs(channel_1) <= delayed;
+          -- subtraction first, as in maw.vhd
+          sum_regs(channel_1) <= sum - (leading_zeros & sub) + (leading_zeros & add);
+          channel_o <= channel_1;
+          value_o   <= sum;
+        end if;
+
+      end if;
+    end if;
+  end process;
+
+end architecture;
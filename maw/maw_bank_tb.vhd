@@ -0,0 +1,164 @@
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+use ieee.math_real.all;
+
+-- Compares maw_bank with one maw per channel. The maw instances are clocked once per
+-- frame (one sample for each channel), the bank gets the same samples one after another
+-- with random gaps. Each output of the bank must be equal to value_o of the maw of
+-- its channel after the clock edge that sampled the same input.
+entity maw_bank_tb is
+  generic (
+    depth           : integer := 4;
+    input_bit_width : integer := 8;
+    channels        : integer := 5;
+    frames          : integer := 2000;
+    -- probability of a gap before a sample
+    gap_rate        : real    := 0.3
+  );
+end entity;
+
+architecture simulation of maw_bank_tb is
+  constant clk_period : time := 5 ns;
+
+  subtype t_value is unsigned (input_bit_width-1 downto 0);
+  subtype t_sum   is unsigned (input_bit_width+depth-1 downto 0);
+  type t_values is array (0 to channels-1) of t_value;
+  type t_sums   is array (0 to channels-1) of t_sum;
+  -- expected outputs of the last frames
+  constant ring_size : integer := 4;
+  type t_expected is array (0 to ring_size-1) of t_sums;
+
+  signal clk       : std_logic := '0';
+  signal frame_clk : std_logic := '0';
+  signal rst       : std_logic := '1';
+  signal done      : boolean   := false;
+
+  signal ref_inputs  : t_values := (others => (others => '0'));
+  signal ref_outputs : t_sums;
+  signal expected    : t_expected;
+
+  signal stb_in      : std_logic := '0';
+  signal value_in    : t_value   := (others => '0');
+  signal stb_out     : std_logic;
+  signal channel_out : integer range 0 to channels-1;
+  signal value_out   : t_sum;
+
+  signal outputs     : integer := 0;
+  signal mismatches  : integer := 0;
+
+begin
+
+  references: for c in 0 to channels-1 generate
+    ref : entity work.maw
+      generic map (
+        depth           => depth,
+        input_bit_width => input_bit_width
+      )
+      port map (
+        clk_i   => frame_clk,
+        rst_i   => rst,
+        value_i => ref_inputs(c),
+        value_o => ref_outputs(c)
+      );
+  end generate;
+
+  dut : entity work.maw_bank
+    generic map (
+      depth           => depth,
+      input_bit_width => input_bit_width,
+      channels        => channels
+    )
+    port map (
+      clk_i     => clk,
+      rst_i     => rst,
+      stb_i     => stb_in,
+      value_i   => value_in,
+      stb_o     => stb_out,
+      channel_o => channel_out,
+      value_o   => value_out
+    );
+
+  clk_gen: process
+  begin
+    while not done loop
+      clk <= '0';
+      wait for clk_period/2;
+      clk <= '1';
+      wait for clk_period/2;
+    end loop;
+    wait;
+  end process;
+
+  stimulus: process
+    variable seed1, seed2 : positive := 1;
+    variable x            : real;
+    variable values       : t_values;
+  begin
+    -- reset the maw instances with a few edges of their clock
+    for i in 1 to 3 loop
+      frame_clk <= '1';
+      wait for clk_period;
+      frame_clk <= '0';
+      wait for clk_period;
+    end loop;
+    wait until falling_edge(clk);
+    rst <= '0';
+
+    for f in 0 to frames-1 loop
+      for c in 0 to channels-1 loop
+        uniform(seed1, seed2, x);
+        values(c) := to_unsigned(integer(trunc(x*2.0**input_bit_width)), input_bit_width);
+      end loop;
+      -- one clock cycle of the maw instances
+      ref_inputs <= values;
+      wait for 1 ns;
+      frame_clk <= '1';
+      wait for 1 ns;
+      frame_clk <= '0';
+      expected(f mod ring_size) <= ref_outputs;
+      -- the same samples for the bank
+      for c in 0 to channels-1 loop
+        uniform(seed1, seed2, x);
+        while x < gap_rate loop
+          wait until falling_edge(clk);
+          stb_in <= '0';
+          uniform(seed1, seed2, x);
+        end loop;
+        wait until falling_edge(clk);
+        stb_in   <= '1';
+        value_in <= values(c);
+      end loop;
+    end loop;
+    wait until falling_edge(clk);
+    stb_in <= '0';
+    for i in 1 to 4 loop
+      wait until falling_edge(clk);
+    end loop;
+    report integer'image(outputs) & " outputs of " & integer'image(channels) & " channels, " &
+           integer'image(mismatches) & " mismatches";
+    assert outputs = frames*channels report "outputs are missing" severity error;
+    assert mismatches = 0 report "maw_bank differs from maw" severity error;
+    done <= true;
+    wait;
+  end process;
+
+  check: process
+    variable frame : integer := 0;
+  begin
+    wait until rising_edge(clk);
+    if stb_out = '1' then
+      if value_out /= expected(frame mod ring_size)(channel_out) then
+        report "frame " & integer'image(frame) & " channel " & integer'image(channel_out) & ": " &
+               integer'image(to_integer(value_out)) & " instead of " &
+               integer'image(to_integer(expected(frame mod ring_size)(channel_out))) severity error;
+        mismatches <= mismatches + 1;
+      end if;
+      outputs <= outputs + 1;
+      if channel_out = channels-1 then
+        frame := frame + 1;
+      end if;
+    end if;
+  end process;
+
+end architecture;
@@ -0,0 +1,199 @@
+#include "maw_model.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+void print_help(const char* argv0){
+	fprintf(stderr, "usage: %s <depth> <input_bit_width> stimulus <n_clocks> <stimulus_file>\n", argv0);
+	fprintf(stderr, "       %s <depth> <input_bit_width> check <stimulus_file> <response_file>\n", argv0);
+	fprintf(stderr, "       %s <depth> <input_bit_width> selftest\n", argv0);
+	fprintf(stderr, "       %s <depth> <input_bit_width> bench <channels> <n_clocks>\n", argv0);
+	fprintf(stderr, " stimulus : write random input (with some resets) for maw_file_tb\n");
+	fprintf(stderr, " check    : compare the output of maw_file_tb (GHDL) with the model\n");
+	fprintf(stderr, " selftest : compare the vectorized kernel with a direct computation of the window sums\n");
+	fprintf(stderr, " bench    : measure the throughput of the vectorized kernel\n");
+}
+
+double now_s()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + 1e-9*t.tv_nsec;
+}
+
+// random input that has long constant stretches (like maw_tb.vhd), noise, and full scale values
+uint32_t random_input(uint32_t previous, uint32_t input_mask)
+{
+	switch (rand()%8) {
+		case 0:  return rand() & input_mask;
+		case 1:  return input_mask;
+		case 2:  return (previous + rand()%5 - 2) & input_mask;
+		default: return previous;
+	}
+}
+
+int stimulus(int depth, int input_bit_width, long n_clocks, const char *filename)
+{
+	FILE *f = fopen(filename, "w");
+	if (f == NULL) {
+		perror(filename);
+		return 2;
+	}
+	uint32_t input_mask = (1ull<<input_bit_width)-1;
+	uint32_t value = 0;
+	for (long t = 0; t < n_clocks; ++t) {
+		// reset in the beginning and from time to time
+		int rst = (t < 4) || (rand()%(50<<depth) == 0);
+		value = random_input(value, input_mask);
+		fprintf(f, "%d %u\n", rst, value);
+	}
+	fclose(f);
+	return 0;
+}
+
+int check(int depth, int input_bit_width, const char *stimulus_file, const char *response_file)
+{
+	FILE *fs = fopen(stimulus_file, "r");
+	if (fs == NULL) {
+		perror(stimulus_file);
+		return 2;
+	}
+	FILE *fr = fopen(response_file, "r");
+	if (fr == NULL) {
+		perror(response_file);
+		return 2;
+	}
+	maw_model_t *model = maw_model_create(depth, input_bit_width, 1);
+	if (model == NULL) {
+		fprintf(stderr, "cannot create model with depth=%d input_bit_width=%d\n", depth, input_bit_width);
+		return 2;
+	}
+	long line = 0, errors = 0;
+	int rst;
+	uint32_t value_i, value_o, expected;
+	while (fscanf(fs, "%d %u", &rst, &value_i) == 2) {
+		++line;
+		if (fscanf(fr, "%u", &value_o) != 1) {
+			fprintf(stderr, "%s ends at line %ld\n", response_file, line);
+			++errors;
+			break;
+		}
+		maw_model_clock(model, rst, &value_i, &expected);
+		if (value_o != expected && errors++ < 10) {
+			fprintf(stderr, "line %ld: rst=%d value_i=%u: GHDL value_o=%u, model value_o=%u\n", line, rst, value_i, value_o, expected);
+		}
+	}
+	printf("%ld clock cycles, %ld mismatches\n", line, errors);
+	maw_model_destroy(model);
+	fclose(fs);
+	fclose(fr);
+	return errors ? 1 : 0;
+}
+
+int selftest(int depth, int input_bit_width)
+{
+	const int  channels = 19; // vector lanes and scalar tail
+	const long n_clocks = 20<<depth;
+	const long window   = (1<<depth)+1;
+	maw_model_t *model = maw_model_create(depth, input_bit_width, channels);
+	if (model == NULL) {
+		fprintf(stderr, "cannot create model with depth=%d input_bit_width=%d\n", depth, input_bit_width);
+		return 2;
+	}
+	uint32_t *value_i = (uint32_t*)malloc(n_clocks*channels*sizeof(uint32_t));
+	uint32_t *value_o = (uint32_t*)malloc(n_clocks*channels*sizeof(uint32_t));
+	for (int ch = 0; ch < channels; ++ch) {
+		uint32_t value = 0;
+		for (long t = 0; t < n_clocks; ++t) {
+			// inputs have bits above input_bit_width set, they must be ignored
+			value = random_input(value, 0xffffffff);
+			value_i[t*channels+ch] = value;
+		}
+	}
+	// process in pieces of different length
+	for (long t = 0; t < n_clocks; ) {
+		long n = 1 + rand()%(3<<depth);
+		if (t+n > n_clocks) {
+			n = n_clocks-t;
+		}
+		maw_model_process(model, &value_i[t*channels], &value_o[t*channels], n);
+		t += n;
+	}
+	long errors = 0;
+	uint32_t input_mask = (1ull<<input_bit_width)-1;
+	uint32_t sum_mask   = (1ull<<(input_bit_width+depth))-1;
+	for (int ch = 0; ch < channels; ++ch) {
+		for (long t = 0; t < n_clocks; ++t) {
+			// window of 2^depth+1 inputs, the newest one is two clock cycles old
+			uint32_t expected = 0;
+			for (long k = t-2; k > t-2-window && k >= 0; --k) {
+				expected += value_i[k*channels+ch] & input_mask;
+			}
+			expected &= sum_mask;
+			if (value_o[t*channels+ch] != expected && errors++ < 10) {
+				fprintf(stderr, "channel %d clock %ld: model value_o=%u, expected %u\n", ch, t, value_o[t*channels+ch], expected);
+			}
+		}
+	}
+	printf("selftest (%s kernel): %ld mismatches\n", maw_model_kernel_name(), errors);
+	free(value_i);
+	free(value_o);
+	maw_model_destroy(model);
+	return errors ? 1 : 0;
+}
+
+int bench(int depth, int input_bit_width, int channels, long n_clocks)
+{
+	maw_model_t *model = maw_model_create(depth, input_bit_width, channels);
+	if (model == NULL) {
+		fprintf(stderr, "cannot create model with depth=%d input_bit_width=%d\n", depth, input_bit_width);
+		return 2;
+	}
+	uint32_t *value_i = (uint32_t*)malloc(n_clocks*channels*sizeof(uint32_t));
+	uint32_t *value_o = (uint32_t*)malloc(n_clocks*channels*sizeof(uint32_t));
+	if (value_i == NULL || value_o == NULL) {
+		fprintf(stderr, "cannot allocate %ld samples\n", n_clocks*channels);
+		return 2;
+	}
+	for (long i = 0; i < n_clocks*channels; ++i) {
+		value_i[i] = rand();
+	}
+	// the first pass brings the pages in
+	maw_model_process(model, value_i, value_o, n_clocks);
+	double t0 = now_s();
+	maw_model_process(model, value_i, value_o, n_clocks);
+	double dt = now_s() - t0;
+	double samples = (double)n_clocks*channels;
+	printf("%s kernel, %d channels: %.1f Msamples/s, %.2f GB/s input\n", maw_model_kernel_name(), channels,
+		1e-6*samples/dt, 1e-9*samples*sizeof(uint32_t)/dt);
+	free(value_i);
+	free(value_o);
+	maw_model_destroy(model);
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	if (argc < 4) {
+		print_help(argv[0]);
+		return -1;
+	}
+	int depth           = atoi(argv[1]);
+	int input_bit_width = atoi(argv[2]);
+	if (depth < 1 || input_bit_width < 1 || depth+input_bit_width > 32) {
+		fprintf(stderr, "depth+input_bit_width must not exceed 32\n");
+		return -1;
+	}
+	if (strcmp(argv[3], "stimulus") == 0 && argc == 6) {
+		return stimulus(depth, input_bit_width, atol(argv[4]), argv[5]);
+	} else if (strcmp(argv[3], "check") == 0 && argc == 6) {
+		return check(depth, input_bit_width, argv[4], argv[5]);
+	} else if (strcmp(argv[3], "selftest") == 0) {
+		return selftest(depth, input_bit_width);
+	} else if (strcmp(argv[3], "bench") == 0 && argc == 6) {
+		return bench(depth, input_bit_width, atoi(argv[4]), atol(argv[5]));
+	}
+	print_help(argv[0]);
+	return -1;
+}
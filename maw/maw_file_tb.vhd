@@ -0,0 +1,83 @@
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+use std.textio.all;
+
+-- Drives the maw with the inputs from a text file and writes its outputs to another text file,
+-- one line per clock cycle. The input lines are "<rst> <value_i>", the output lines are
+-- "<value_o>" after the rising edge that sampled the input line with the same number.
+-- The simulation stops at the end of the input file. maw_check compares the output with the C model.
+entity maw_file_tb is
+  generic (
+    depth           : integer := 6;
+    input_bit_width : integer := 8;
+    input_file      : string  := "maw_stimulus.txt";
+    output_file     : string  := "maw_response.txt"
+  );
+end entity;
+
+architecture simulation of maw_file_tb is
+  constant clk_period : time := 5 ns;
+
+  signal input_value  : unsigned (input_bit_width-1 downto 0) := (others => '0');
+  signal output_value : unsigned (input_bit_width+depth-1 downto 0);
+
+  signal clk  : std_logic := '0';
+  signal rst  : std_logic := '1';
+  signal done : boolean   := false;
+
+begin
+
+  dut : entity work.maw
+    generic map (
+      depth           => depth,
+      input_bit_width => input_bit_width
+    )
+    port map (
+      clk_i   => clk,
+      rst_i   => rst,
+      value_i => input_value,
+      value_o => output_value
+    );
+
+  clk_gen: process
+  begin
+    while not done loop
+      clk <= '0';
+      wait for clk_period/2;
+      clk <= '1';
+      wait for clk_period/2;
+    end loop;
+    wait;
+  end process;
+
+  -- inputs change and outputs are recorded at the falling edge
+  stimulus: process
+    file     f_in     : text open read_mode  is input_file;
+    file     f_out    : text open write_mode is output_file;
+    variable l_in     : line;
+    variable l_out    : line;
+    variable rst_bit  : integer;
+    variable value    : integer;
+  begin
+    wait until falling_edge(clk);
+    while not endfile(f_in) loop
+      readline(f_in, l_in);
+      read(l_in, rst_bit);
+      read(l_in, value);
+      if rst_bit = 0 then
+        rst <= '0';
+      else
+        rst <= '1';
+      end if;
+      input_value <= to_unsigned(value, input_bit_width);
+      wait until falling_edge(clk);
+      write(l_out, to_integer(output_value));
+      writeline(f_out, l_out);
+    end loop;
+    done <= true;
+    wait;
+  end process;
+
+end architecture;
@@ -0,0 +1,214 @@
+#include "maw_model.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+maw_model_t* maw_model_create(int depth, int input_bit_width, int channels)
+{
+	if (depth < 1 || input_bit_width < 1 || depth+input_bit_width > 32 || channels < 1) {
+		return NULL;
+	}
+	maw_model_t *model = (maw_model_t*)calloc(1, sizeof(maw_model_t));
+	if (model == NULL) {
+		return NULL;
+	}
+	model->depth           = depth;
+	model->input_bit_width = input_bit_width;
+	model->channels        = channels;
+	model->input_mask      = (input_bit_width       == 32) ? 0xffffffff : ((1u<<input_bit_width)-1);
+	model->sum_mask        = (input_bit_width+depth == 32) ? 0xffffffff : ((1u<<(input_bit_width+depth))-1);
+	model->sum       = (uint32_t*)calloc(channels, sizeof(uint32_t));
+	model->add       = (uint32_t*)calloc(channels, sizeof(uint32_t));
+	model->sub       = (uint32_t*)calloc(channels, sizeof(uint32_t));
+	model->delayed   = (uint32_t*)calloc(channels, sizeof(uint32_t));
+	model->fifo_data = (uint32_t*)calloc((size_t)channels<<depth, sizeof(uint32_t));
+	if (!model->sum || !model->add || !model->sub || !model->delayed || !model->fifo_data) {
+		maw_model_destroy(model);
+		return NULL;
+	}
+	return model;
+}
+
+void maw_model_destroy(maw_model_t *model)
+{
+	free(model->sum);
+	free(model->add);
+	free(model->sub);
+	free(model->delayed);
+	free(model->fifo_data);
+	free(model);
+}
+
+void maw_model_reset(maw_model_t *model)
+{
+	// the fifo memory is not reset, but it is not read before it was written again
+	size_t size = model->channels*sizeof(uint32_t);
+	memset(model->sum,     0, size);
+	memset(model->add,     0, size);
+	memset(model->sub,     0, size);
+	memset(model->delayed, 0, size);
+	model->idx    = 0;
+	model->filled = 0;
+}
+
+void maw_model_clock(maw_model_t *model, int rst, const uint32_t *value_i, uint32_t *value_o)
+{
+	if (rst) {
+		maw_model_reset(model);
+		memset(value_o, 0, model->channels*sizeof(uint32_t));
+	} else {
+		maw_model_process(model, value_i, value_o, 1);
+	}
+}
+
+// All channels see the same clock, so the channels are independent lanes.
+// Each kernel handles a group of channels for all clock cycles, keeping the registers of
+// these channels in (vector) registers. Per clock cycle and channel this is:
+//   value_o = sum;  sum = sum - sub + add;  sub = delayed;  add = value_i;
+//   delayed = fifo_data[idx] (or 0 while the fifo is not filled);  fifo_data[idx] = value_i;
+static void maw_model_scalar(maw_model_t *model, int first, int last, const uint32_t *value_i, uint32_t *value_o, size_t n_clocks)
+{
+	const size_t   channels = model->channels;
+	const uint32_t n_words  = 1u << model->depth;
+	for (int ch = first; ch < last; ++ch) {
+		uint32_t sum     = model->sum[ch];
+		uint32_t add     = model->add[ch];
+		uint32_t sub     = model->sub[ch];
+		uint32_t delayed = model->delayed[ch];
+		uint32_t idx     = model->idx;
+		uint32_t filled  = model->filled;
+		for (size_t t = 0; t < n_clocks; ++t) {
+			uint32_t x = value_i[t*channels+ch] & model->input_mask;
+			uint32_t *mem = &model->fifo_data[idx*channels+ch];
+			value_o[t*channels+ch] = sum;
+			sum     = (sum - sub + add) & model->sum_mask;
+			sub     = delayed;
+			add     = x;
+			delayed = (filled == n_words) ? *mem : 0;
+			*mem    = x;
+			idx     = (idx+1) & (n_words-1);
+			filled += (filled != n_words);
+		}
+		model->sum[ch]     = sum;
+		model->add[ch]     = add;
+		model->sub[ch]     = sub;
+		model->delayed[ch] = delayed;
+	}
+}
+
+#if defined(__AVX2__)
+static int maw_model_vector(maw_model_t *model, const uint32_t *value_i, uint32_t *value_o, size_t n_clocks)
+{
+	const size_t   channels = model->channels;
+	const uint32_t n_words  = 1u << model->depth;
+	const __m256i input_mask = _mm256_set1_epi32(model->input_mask);
+	const __m256i sum_mask   = _mm256_set1_epi32(model->sum_mask);
+	int ch = 0;
+	for (; ch+8 <= model->channels; ch += 8) {
+		__m256i sum     = _mm256_loadu_si256((const __m256i*)&model->sum[ch]);
+		__m256i add     = _mm256_loadu_si256((const __m256i*)&model->add[ch]);
+		__m256i sub     = _mm256_loadu_si256((const __m256i*)&model->sub[ch]);
+		__m256i delayed = _mm256_loadu_si256((const __m256i*)&model->delayed[ch]);
+		uint32_t idx    = model->idx;
+		uint32_t filled = model->filled;
+		for (size_t t = 0; t < n_clocks; ++t) {
+			__m256i x = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)&value_i[t*channels+ch]), input_mask);
+			__m256i *mem = (__m256i*)&model->fifo_data[idx*channels+ch];
+			_mm256_storeu_si256((__m256i*)&value_o[t*channels+ch], sum);
+			sum     = _mm256_and_si256(_mm256_add_epi32(_mm256_sub_epi32(sum, sub), add), sum_mask);
+			sub     = delayed;
+			add     = x;
+			delayed = (filled == n_words) ? _mm256_loadu_si256(mem) : _mm256_setzero_si256();
+			_mm256_storeu_si256(mem, x);
+			idx     = (idx+1) & (n_words-1);
+			filled += (filled != n_words);
+		}
+		_mm256_storeu_si256((__m256i*)&model->sum[ch],     sum);
+		_mm256_storeu_si256((__m256i*)&model->add[ch],     add);
+		_mm256_storeu_si256((__m256i*)&model->sub[ch],     sub);
+		_mm256_storeu_si256((__m256i*)&model->delayed[ch], delayed);
+	}
+	return ch;
+}
+#elif defined(__ARM_NEON)
+static int maw_model_vector(maw_model_t *model, const uint32_t *value_i, uint32_t *value_o, size_t n_clocks)
+{
+	const size_t   channels = model->channels;
+	const uint32_t n_words  = 1u << model->depth;
+	const uint32x4_t input_mask = vdupq_n_u32(model->input_mask);
+	const uint32x4_t sum_mask   = vdupq_n_u32(model->sum_mask);
+	int ch = 0;
+	for (; ch+4 <= model->channels; ch += 4) {
+		uint32x4_t sum     = vld1q_u32(&model->sum[ch]);
+		uint32x4_t add     = vld1q_u32(&model->add[ch]);
+		uint32x4_t sub     = vld1q_u32(&model->sub[ch]);
+		uint32x4_t delayed = vld1q_u32(&model->delayed[ch]);
+		uint32_t idx    = model->idx;
+		uint32_t filled = model->filled;
+		for (size_t t = 0; t < n_clocks; ++t) {
+			uint32x4_t x = vandq_u32(vld1q_u32(&value_i[t*channels+ch]), input_mask);
+			uint32_t *mem = &model->fifo_data[idx*channels+ch];
+			vst1q_u32(&value_o[t*channels+ch], sum);
+			sum     = vandq_u32(vaddq_u32(vsubq_u32(sum, sub), add), sum_mask);
+			sub     = delayed;
+			add     = x;
+			delayed = (filled == n_words) ? vld1q_u32(mem) : vdupq_n_u32(0);
+			vst1q_u32(mem, x);
+			idx     = (idx+1) & (n_words-1);
+			filled += (filled != n_words);
+		}
+		vst1q_u32(&model->sum[ch],     sum);
+		vst1q_u32(&model->add[ch],     add);
+		vst1q_u32(&model->sub[ch],     sub);
+		vst1q_u32(&model->delayed[ch], delayed);
+	}
+	return ch;
+}
+#else
+static int maw_model_vector(maw_model_t *model, const uint32_t *value_i, uint32_t *value_o, size_t n_clocks)
+{
+	(void)model; (void)value_i; (void)value_o; (void)n_clocks;
+	return 0;
+}
+#endif
+
+// The clock cycles are processed in tiles, so that the inputs, outputs, and fifo memory
+// of one tile stay in the cache while the kernels walk over the groups of channels.
+#define MAW_MODEL_TILE_BYTES (64*1024)
+
+void maw_model_process(maw_model_t *model, const uint32_t *value_i, uint32_t *value_o, size_t n_clocks)
+{
+	const uint32_t n_words = 1u << model->depth;
+	size_t tile = MAW_MODEL_TILE_BYTES / (model->channels*sizeof(uint32_t));
+	if (tile < 16) {
+		tile = 16;
+	}
+	for (size_t t = 0; t < n_clocks; t += tile) {
+		size_t n = (n_clocks-t < tile) ? n_clocks-t : tile;
+		const uint32_t *in  = &value_i[t*model->channels];
+		uint32_t       *out = &value_o[t*model->channels];
+		int ch = maw_model_vector(model, in, out, n);
+		maw_model_scalar(model, ch, model->channels, in, out, n);
+
+		// the fifo pointers are common to all channels
+		model->idx = (model->idx + n) & (n_words-1);
+		model->filled = ((size_t)model->filled + n >= n_words) ? n_words : model->filled + n;
+	}
+}
+
+const char* maw_model_kernel_name(void)
+{
+#if defined(__AVX2__)
+	return "avx2";
+#elif defined(__ARM_NEON)
+	return "neon";
+#else
+	return "scalar";
+#endif
+}
@@ -0,0 +1,61 @@
+#ifndef MAW_MODEL_H_
+#define MAW_MODEL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Bit accurate model of maw.vhd (including delay.vhd) for many channels that share one clock.
+//
+// One call of maw_model_clock corresponds to one rising edge of clk_i: value_i is the input
+// that is sampled at this edge, value_o is the output after the edge. As in the RTL,
+//  - value_o is the sum of the last 2^depth+1 inputs, with the newest input being the one
+//    that was sampled two clock cycles earlier (the subtraction path is one register longer
+//    than the window),
+//  - the sum wraps around at 2^(input_bit_width+depth),
+//  - inputs are truncated to input_bit_width bits.
+// input_bit_width+depth must not exceed 32.
+typedef struct maw_model
+{
+	int depth;
+	int input_bit_width;
+	int channels;
+	uint32_t input_mask;
+	uint32_t sum_mask;
+
+	// registers of maw.vhd and the output register of delay.vhd, [channels] each
+	uint32_t *sum;
+	uint32_t *add;
+	uint32_t *sub;
+	uint32_t *delayed;
+
+	// memory of delay.vhd, [2^depth][channels]
+	uint32_t *fifo_data;
+	uint32_t idx;    // write and read index (they are equal once the fifo is filled)
+	uint32_t filled; // number of words written since reset, saturates at 2^depth
+} maw_model_t;
+
+maw_model_t* maw_model_create(int depth, int input_bit_width, int channels);
+void         maw_model_destroy(maw_model_t *model);
+
+// one clock cycle with rst_i = '1'
+void maw_model_reset(maw_model_t *model);
+
+// one clock cycle with rst_i = rst, value_i and value_o have one entry per channel.
+void maw_model_clock(maw_model_t *model, int rst, const uint32_t *value_i, uint32_t *value_o);
+
+// n_clocks clock cycles with rst_i = '0'. value_i and value_o are [n_clocks][channels].
+// This is the vectorized kernel (see maw_model_kernel_name).
+void maw_model_process(maw_model_t *model, const uint32_t *value_i, uint32_t *value_o, size_t n_clocks);
+
+// "avx2", "neon", or "scalar"
+const char* maw_model_kernel_name(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,203 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+// Runs a simulation and appends one line to a results file:
+//   tag  testbench  simulated_ns  cycles  wall_s  startup_s  cycles_per_s  peak_kB  exit_status  unix_time
+// Compares two tags in a results file (e.g. two GHDL backends, or a baseline and a new commit).
+//
+// The simulation runs twice, with --stop-time=0ns and with the stop time of the given number of cycles.
+// The first run measures the start-up (elaboration, and code generation with the mcode backend),
+// which is subtracted, so that cycles_per_s is the speed of the simulation itself.
+
+void print_help(const char* argv0){
+	fprintf(stderr, "usage: %s run <results_file> <tag> <testbench> <clk_period_ns> <cycles> <command> [<args>...]\n", argv0);
+	fprintf(stderr, "       %s compare <results_file> <tag_a> <tag_b> [<tolerance_percent>]\n", argv0);
+	fprintf(stderr, " run     : run the command (the simulation) with --stop-time=0ns and with --stop-time=<cycles*clk_period_ns>ns\n");
+	fprintf(stderr, "           appended, and record the wall clock time without the start-up and the peak memory.\n");
+	fprintf(stderr, "           The simulation must run until the stop time.\n");
+	fprintf(stderr, " compare : compare the last result of each testbench for tag_a with the one for tag_b.\n");
+	fprintf(stderr, "           Returns 1 if a testbench is more than tolerance_percent (default 10) slower with tag_b.\n");
+}
+
+double now_s()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + 1e-9*t.tv_nsec;
+}
+
+// run the command with stop_time appended, returns the exit status (-1 if it cannot be started)
+int run_once(char **command, int n_args, const char *stop_time, double *wall_s, long *peak_kB)
+{
+	char **argv = (char**)malloc((n_args+2)*sizeof(char*));
+	memcpy(argv, command, n_args*sizeof(char*));
+	argv[n_args]   = (char*)stop_time;
+	argv[n_args+1] = NULL;
+	double t_start = now_s();
+	pid_t pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		free(argv);
+		return -1;
+	}
+	if (pid == 0) {
+		// the simulation output is not needed, only how long it takes
+		if (freopen("/dev/null", "w", stdout) == NULL) {
+			_exit(127);
+		}
+		execvp(argv[0], argv);
+		perror(argv[0]);
+		_exit(127);
+	}
+	free(argv);
+	int status;
+	struct rusage usage;
+	if (wait4(pid, &status, 0, &usage) < 0) {
+		perror("wait4");
+		return -1;
+	}
+	*wall_s  = now_s() - t_start;
+	*peak_kB = usage.ru_maxrss; // kilobytes on Linux
+	return WIFEXITED(status) ? WEXITSTATUS(status) : 128+WTERMSIG(status);
+}
+
+int run(const char *results_file, const char *tag, const char *testbench, double clk_period_ns, double cycles, char **command, int n_args)
+{
+	double stop_time_ns = ceil(cycles * clk_period_ns);
+	char stop_time[64];
+	double startup_s, wall_s;
+	long startup_kB, peak_kB;
+	int exit_status = run_once(command, n_args, "--stop-time=0ns", &startup_s, &startup_kB);
+	if (exit_status == 0) {
+		snprintf(stop_time, sizeof(stop_time), "--stop-time=%.0fns", stop_time_ns);
+		exit_status = run_once(command, n_args, stop_time, &wall_s, &peak_kB);
+	} else {
+		wall_s  = startup_s;
+		peak_kB = startup_kB;
+	}
+	if (exit_status < 0) {
+		return 2;
+	}
+
+	// the start-up is measured with noise, it is only subtracted if the simulation takes longer
+	double sim_s = (wall_s > startup_s) ? wall_s - startup_s : wall_s;
+	double cycles_per_s = cycles / sim_s;
+	printf("%-24s %-20s %12.0f cycles %8.3f s (%.3f s start-up) %12.0f cycles/s %8ld kB", tag, testbench, cycles, wall_s, startup_s, cycles_per_s, peak_kB);
+	if (exit_status != 0) {
+		printf(" (exit status %d)", exit_status);
+	}
+	printf("\n");
+
+	FILE *f = fopen(results_file, "a");
+	if (f == NULL) {
+		perror(results_file);
+		return 2;
+	}
+	fprintf(f, "%s\t%s\t%.0f\t%.0f\t%.6f\t%.6f\t%.0f\t%ld\t%d\t%ld\n", tag, testbench, stop_time_ns, cycles, wall_s, startup_s, cycles_per_s, peak_kB, exit_status, (long)time(NULL));
+	fclose(f);
+	return exit_status != 0;
+}
+
+#define MAX_RESULTS 256
+typedef struct result
+{
+	char   testbench[64];
+	double cycles_per_s;
+	long   peak_kB;
+	int    exit_status;
+} result_t;
+
+// the last result for each testbench with the given tag
+int read_results(const char *results_file, const char *tag, result_t *results)
+{
+	FILE *f = fopen(results_file, "r");
+	if (f == NULL) {
+		perror(results_file);
+		return -1;
+	}
+	int n = 0;
+	char line[512];
+	while (fgets(line, sizeof(line), f) != NULL) {
+		char line_tag[128];
+		result_t r;
+		double stop_time_ns, cycles, wall_s, startup_s;
+		if (sscanf(line, "%127s %63s %lf %lf %lf %lf %lf %ld %d", line_tag, r.testbench, &stop_time_ns, &cycles, &wall_s, &startup_s, &r.cycles_per_s, &r.peak_kB, &r.exit_status) != 9) {
+			continue;
+		}
+		if (strcmp(line_tag, tag) != 0) {
+			continue;
+		}
+		int i = 0;
+		while (i < n && strcmp(results[i].testbench, r.testbench) != 0) {
+			++i;
+		}
+		if (i == MAX_RESULTS) {
+			continue;
+		}
+		results[i] = r;
+		if (i == n) {
+			++n;
+		}
+	}
+	fclose(f);
+	return n;
+}
+
+int compare(const char *results_file, const char *tag_a, const char *tag_b, double tolerance_percent)
+{
+	static result_t a[MAX_RESULTS], b[MAX_RESULTS];
+	int n_a = read_results(results_file, tag_a, a);
+	int n_b = read_results(results_file, tag_b, b);
+	if (n_a < 0 || n_b < 0) {
+		return 2;
+	}
+	printf("%-20s %14s %14s %7s %10s %10s\n", "testbench", tag_a, tag_b, "speed", "peak kB a", "peak kB b");
+	int slower = 0;
+	for (int i = 0; i < n_a; ++i) {
+		for (int j = 0; j < n_b; ++j) {
+			if (strcmp(a[i].testbench, b[j].testbench) != 0) {
+				continue;
+			}
+			if (a[i].exit_status != 0 || b[j].exit_status != 0) {
+				printf("%-20s failed (exit status %d and %d)\n", a[i].testbench, a[i].exit_status, b[j].exit_status);
+				slower = 1;
+				continue;
+			}
+			double ratio = b[j].cycles_per_s / a[i].cycles_per_s;
+			const char *mark = "";
+			if (ratio < 1.0 - tolerance_percent/100.0) {
+				mark = "  slower";
+				slower = 1;
+			}
+			printf("%-20s %14.0f %14.0f %6.2fx %10ld %10ld%s\n", a[i].testbench, a[i].cycles_per_s, b[j].cycles_per_s, ratio, a[i].peak_kB, b[j].peak_kB, mark);
+		}
+	}
+	return slower;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc >= 8 && strcmp(argv[1], "run") == 0) {
+		double clk_period_ns = atof(argv[5]);
+		double cycles        = atof(argv[6]);
+		if (clk_period_ns <= 0 || cycles <= 0) {
+			print_help(argv[0]);
+			return 2;
+		}
+		return run(argv[2], argv[3], argv[4], clk_period_ns, cycles, argv+7, argc-7);
+	}
+	if ((argc == 5 || argc == 6) && strcmp(argv[1], "compare") == 0) {
+		double tolerance_percent = (argc == 6) ? atof(argv[5]) : 10.0;
+		return compare(argv[2], argv[3], argv[4], tolerance_percent);
+	}
+	print_help(argv[0]);
+	return 2;
+}
@@ -0,0 +1,177 @@
+#include "tdc_calibration.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void tdc_calibration_nominal_lut(tdc_calibration_t *calibration, int channel)
+{
+	const int length = calibration->config.line_length;
+	float *lut = &calibration->lut[channel*length];
+	// fine = 1 is the first bin (the edge has not passed any delay element yet)
+	lut[0] = 0;
+	for (int fine = 1; fine < length; ++fine) {
+		lut[fine] = (fine-0.5)*calibration->config.nominal_tap_ps;
+	}
+}
+
+tdc_calibration_t* tdc_calibration_create(const tdc_calibration_config_t *config)
+{
+	if (config->line_length < 2 || config->line_length > TDC_MAX_LINE_LENGTH) {
+		fprintf(stderr, "tdc_calibration_create: line_length must be in [2,%d]\n", TDC_MAX_LINE_LENGTH);
+		return NULL;
+	}
+	if (config->channels < 1 || config->channels > 256) {
+		fprintf(stderr, "tdc_calibration_create: channels must be in [1,256]\n");
+		return NULL;
+	}
+	if (!(config->clock_period_ps > 0) || config->update_entries == 0) {
+		fprintf(stderr, "tdc_calibration_create: clock_period_ps and update_entries must be positive\n");
+		return NULL;
+	}
+	tdc_calibration_t *calibration = (tdc_calibration_t*)calloc(1, sizeof(tdc_calibration_t));
+	if (calibration == NULL) {
+		return NULL;
+	}
+	calibration->config = *config;
+	if (calibration->config.nominal_tap_ps <= 0) {
+		calibration->config.nominal_tap_ps = config->clock_period_ps/(config->line_length-1);
+	}
+	const size_t bins = (size_t)config->channels*config->line_length;
+	calibration->histogram    = (uint32_t*)calloc(bins, sizeof(uint32_t));
+	calibration->lut          = (float*)calloc(bins, sizeof(float));
+	calibration->entries      = (uint64_t*)calloc(config->channels, sizeof(uint64_t));
+	calibration->since_update = (uint64_t*)calloc(config->channels, sizeof(uint64_t));
+	calibration->quality      = (tdc_calibration_quality_t*)calloc(config->channels, sizeof(tdc_calibration_quality_t));
+	if (calibration->histogram == NULL || calibration->lut == NULL || calibration->entries == NULL ||
+	    calibration->since_update == NULL || calibration->quality == NULL) {
+		tdc_calibration_destroy(calibration);
+		return NULL;
+	}
+	for (int ch = 0; ch < config->channels; ++ch) {
+		tdc_calibration_nominal_lut(calibration, ch);
+	}
+	return calibration;
+}
+
+void tdc_calibration_destroy(tdc_calibration_t *calibration)
+{
+	if (calibration == NULL) {
+		return;
+	}
+	free(calibration->histogram);
+	free(calibration->lut);
+	free(calibration->entries);
+	free(calibration->since_update);
+	free(calibration->quality);
+	free(calibration);
+}
+
+// old hits count half from now on
+static void tdc_calibration_halve(tdc_calibration_t *calibration, int channel)
+{
+	const int length = calibration->config.line_length;
+	uint32_t *histogram = &calibration->histogram[channel*length];
+	uint64_t entries = 0;
+	for (int fine = 0; fine < length; ++fine) {
+		histogram[fine] >>= 1;
+		entries += histogram[fine];
+	}
+	calibration->entries[channel] = entries;
+}
+
+int tdc_calibration_update(tdc_calibration_t *calibration, int channel)
+{
+	const int    length  = calibration->config.line_length;
+	const double period  = calibration->config.clock_period_ps;
+	const uint64_t total = calibration->entries[channel];
+	if (total == 0 || total < calibration->config.min_entries) {
+		return 0;
+	}
+	const uint32_t *histogram = &calibration->histogram[channel*length];
+	float *lut = &calibration->lut[channel*length];
+	tdc_calibration_quality_t *q = &calibration->quality[channel];
+
+	int used_bins = 0, first = -1, last = -1;
+	for (int fine = 0; fine < length; ++fine) {
+		if (histogram[fine]) {
+			++used_bins;
+			if (first < 0) {
+				first = fine;
+			}
+			last = fine;
+		}
+	}
+	q->entries       = total;
+	q->used_bins     = used_bins;
+	q->missing_codes = (last-first+1) - used_bins;
+	q->lsb_ps        = period/used_bins;
+	q->max_dnl = q->max_inl = q->max_shift_ps = 0;
+
+	// the bins cover one clock period, lut is the center of each bin
+	double scale = period/total;
+	double start = 0, sum_cubes = 0;
+	int used = 0;
+	for (int fine = 0; fine < length; ++fine) {
+		double width  = scale*histogram[fine];
+		double center = start + 0.5*width;
+		if (fine >= first && fine <= last && fabs(center - lut[fine]) > q->max_shift_ps) {
+			q->max_shift_ps = fabs(center - lut[fine]);
+		}
+		lut[fine] = center;
+		if (histogram[fine]) {
+			double dnl = fabs(width/q->lsb_ps - 1);
+			double inl = fabs(center/q->lsb_ps - (used+0.5));
+			if (dnl > q->max_dnl) q->max_dnl = dnl;
+			if (inl > q->max_inl) q->max_inl = inl;
+			sum_cubes += width*width*width;
+			++used;
+		}
+		start += width;
+	}
+	q->rms_ps = sqrt(sum_cubes/(12*period));
+	++q->updates;
+	calibration->since_update[channel] = 0;
+	return 1;
+}
+
+int tdc_calibration_fill(tdc_calibration_t *calibration, const tdc_hit_t *hits, size_t n_hits)
+{
+	const int      length   = calibration->config.line_length;
+	const int      channels = calibration->config.channels;
+	const uint64_t window   = calibration->config.window_entries;
+	const uint64_t update   = calibration->config.update_entries;
+	int updates = 0;
+	for (size_t h = 0; h < n_hits; ++h) {
+		const int ch   = hits[h].channel;
+		const int fine = hits[h].fine;
+		if (ch >= channels || fine >= length) {
+			++calibration->ignored_hits;
+			continue;
+		}
+		++calibration->histogram[ch*length + fine];
+		if (++calibration->entries[ch] == window) {
+			tdc_calibration_halve(calibration, ch);
+		}
+		if (++calibration->since_update[ch] >= update) {
+			updates += tdc_calibration_update(calibration, ch);
+		}
+	}
+	return updates;
+}
+
+void tdc_calibration_apply(const tdc_calibration_t *calibration, const tdc_hit_t *hits, size_t n_hits, double *time_ps)
+{
+	const int    length   = calibration->config.line_length;
+	const int    channels = calibration->config.channels;
+	const double period   = calibration->config.clock_period_ps;
+	const float *lut      = calibration->lut;
+	for (size_t h = 0; h < n_hits; ++h) {
+		if (hits[h].channel >= channels) {
+			time_ps[h] = NAN;
+			continue;
+		}
+		time_ps[h] = hits[h].coarse*period - lut[hits[h].channel*length + hits[h].fine];
+	}
+}
@@ -0,0 +1,92 @@
+#ifndef TDC_CALIBRATION_H_
+#define TDC_CALIBRATION_H_
+
+#include "tdc_decoder.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Code-density calibration of the delay line taps.
+//
+// The delay elements of delayline.vhd have different delays, so the fine value of a hit is not
+// proportional to time. If the edges are not correlated with the clock, the probability of a fine
+// value is proportional to the width (in ps) of its bin. The calibration keeps a histogram of the
+// fine values of each channel and regularly turns it into a lookup table with the time at the
+// center of each bin: lut[fine] = (width of all bins below fine) + width[fine]/2, where the widths
+// of all bins add up to one clock period.
+//
+// Each edge must be counted only once, i.e. the hits should be decoded with max_fine set to the
+// number of taps that the edge passes within one clock period. Otherwise the bins above that are
+// counted twice and all widths come out too small.
+//
+// The histogram is filled in the decode loop (one increment per hit). After update_entries new hits
+// of a channel, the lookup table of that channel is regenerated. This costs O(line_length) and is
+// spread over the channels, so acquisition does not stop. To follow temperature drift, all bins of
+// a channel are halved whenever the channel has window_entries hits, so that old hits fade out.
+//
+// Until a channel has min_entries hits, its lookup table assumes that every tap has nominal_tap_ps.
+
+typedef struct tdc_calibration_config {
+	int    line_length;     // length generic of delayline.vhd
+	int    channels;        // hits with channel >= channels are ignored
+	double clock_period_ps; // period of the clock that takes the snapshots
+	double nominal_tap_ps;  // tap delay until the first calibration, 0 means clock_period_ps/(line_length-1)
+	uint64_t min_entries;     // hits per channel before the first calibration
+	uint64_t update_entries;  // regenerate the lookup table of a channel after this many new hits
+	uint64_t window_entries;  // halve the histogram of a channel when it has this many hits, 0 never forgets
+} tdc_calibration_config_t;
+
+typedef struct tdc_calibration_quality {
+	uint64_t entries;       // hits in the histogram at the last calibration
+	uint64_t updates;       // number of calibrations so far
+	int      used_bins;     // bins with at least one hit
+	int      missing_codes; // empty bins between used bins
+	double   lsb_ps;        // mean bin width (clock_period_ps/used_bins)
+	double   max_dnl;       // largest |width/lsb - 1| of the used bins
+	double   max_inl;       // largest |lut - uniform lut| in units of lsb
+	double   rms_ps;        // rms quantization error for uniformly distributed edges: sqrt(sum(width^3)/(12*period))
+	double   max_shift_ps;  // largest change of a lut entry by the last calibration (drift indicator)
+} tdc_calibration_quality_t;
+
+typedef struct tdc_calibration {
+	tdc_calibration_config_t config;
+
+	// [channel][fine], lut is float to keep it small: a 64 tap line needs 256 bytes per channel
+	uint32_t *histogram;
+	float    *lut;
+
+	uint64_t *entries;      // per channel
+	uint64_t *since_update; // per channel
+	tdc_calibration_quality_t *quality;
+
+	uint64_t ignored_hits;  // hits with channel >= channels or fine >= line_length
+} tdc_calibration_t;
+
+// returns NULL if the configuration is not supported
+tdc_calibration_t* tdc_calibration_create(const tdc_calibration_config_t *config);
+void               tdc_calibration_destroy(tdc_calibration_t *calibration);
+
+// Add hits to the histograms and regenerate the lookup tables of channels that have enough new hits.
+// Returns the number of lookup tables that were regenerated.
+int tdc_calibration_fill(tdc_calibration_t *calibration, const tdc_hit_t *hits, size_t n_hits);
+
+// Regenerate the lookup table of a channel now (e.g. at the end of a run), if it has min_entries hits.
+// Returns 1 if the table was regenerated.
+int tdc_calibration_update(tdc_calibration_t *calibration, int channel);
+
+// Times of the edges in ps: coarse*clock_period_ps - lut[channel][fine].
+// Hits with channel >= channels get NAN.
+void tdc_calibration_apply(const tdc_calibration_t *calibration, const tdc_hit_t *hits, size_t n_hits, double *time_ps);
+
+// Time of the edge before the snapshot in ps
+static inline float tdc_calibration_fine_ps(const tdc_calibration_t *calibration, int channel, int fine)
+{
+	return calibration->lut[channel*calibration->config.line_length + fine];
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,394 @@
+#include "tdc_decoder.h"
+#include "tdc_calibration.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+void print_help(const char* argv0){
+	fprintf(stderr, "usage: %s [options] <capture_file>\n", argv0);
+	fprintf(stderr, "       %s [options] -s <records>\n", argv0);
+	fprintf(stderr, " Decode a capture of the serializer output (each word stored in (word_width+7)/8 bytes,\n");
+	fprintf(stderr, " most significant byte first) and print one line \"<coarse> <fine> <rising>\" per hit,\n");
+	fprintf(stderr, " or \"<time_ps> <rising>\" per hit with code-density calibration (option -p).\n");
+	fprintf(stderr, " options are\n");
+	fprintf(stderr, " -l <taps>         : line length (default is 64)\n");
+	fprintf(stderr, " -c <bits>         : coarse counter bits per record (default is 64)\n");
+	fprintf(stderr, " -w <bits>         : serializer word width (default is 8)\n");
+	fprintf(stderr, " -o <clocks>       : coarse counter offset (default is 2)\n");
+	fprintf(stderr, " -b <taps>         : bubble width (default is 2)\n");
+	fprintf(stderr, " -m <taps>         : drop hits with fine >= taps (default is 0, keep all)\n");
+	fprintf(stderr, " -p <ps>           : clock period, enables the calibration (use -m to count each edge once)\n");
+	fprintf(stderr, " -u <hits>         : recalibrate after this many hits (default is 100000)\n");
+	fprintf(stderr, " -q                : don't print hits, only the summary\n");
+	fprintf(stderr, " -s <records>      : decode random records and compare with the expected hits,\n");
+	fprintf(stderr, "                     with -p also calibrate a random delay line and let it drift\n");
+	fprintf(stderr, "                     (with at least 2000000 hits)\n");
+}
+
+double now_s()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + 1e-9*t.tv_nsec;
+}
+
+void print_summary(const tdc_decoder_t *decoder, double dt)
+{
+	fprintf(stderr, "%llu records, %llu hits, %llu empty records, %llu dropped clusters, %llu late hits",
+		(unsigned long long)decoder->records, (unsigned long long)decoder->hits, (unsigned long long)decoder->empty_records,
+		(unsigned long long)decoder->dropped_clusters, (unsigned long long)decoder->dropped_late);
+	if (dt > 0) {
+		fprintf(stderr, ", %.1f Mhits/s", 1e-6*decoder->hits/dt);
+	}
+	fprintf(stderr, "\n");
+}
+
+void print_quality(const tdc_calibration_t *calibration)
+{
+	for (int ch = 0; ch < calibration->config.channels; ++ch) {
+		const tdc_calibration_quality_t *q = &calibration->quality[ch];
+		if (q->updates == 0) {
+			continue;
+		}
+		fprintf(stderr, "channel %d: %llu entries, %llu updates, %d bins, %d missing codes, lsb %.1f ps, "
+			"max |dnl| %.2f, max |inl| %.2f lsb, rms %.1f ps, last shift %.2f ps\n",
+			ch, (unsigned long long)q->entries, (unsigned long long)q->updates, q->used_bins, q->missing_codes,
+			q->lsb_ps, q->max_dnl, q->max_inl, q->rms_ps, q->max_shift_ps);
+	}
+}
+
+// Random records with one or two edges and bubbles next to the transitions, serialized like
+// serializer.vhd does it. expected[] gets the edges of each record (fine = -1 for no second edge).
+int selftest(tdc_decoder_config_t *config, long n_records, int quiet)
+{
+	const int length = config->line_length;
+	const int record_bytes = (length + config->coarse_bits)/8;
+	if (config->word_width != 8 || (length + config->coarse_bits)%8 != 0) {
+		fprintf(stderr, "selftest needs word_width 8\n");
+		return -1;
+	}
+	uint8_t *bytes = (uint8_t*)calloc(n_records, record_bytes);
+	int *expected = (int*)malloc(n_records*4*sizeof(int)); // fine and level of up to two edges
+	int gap = 2*config->bubble_width+4;
+	if (bytes == NULL || expected == NULL || length < 2*gap) {
+		fprintf(stderr, "selftest: cannot allocate buffers or line too short\n");
+		return -1;
+	}
+	int level = 0;
+	for (long r = 0; r < n_records; ++r) {
+		// edges are at least gap taps away from each other and from the ends of the line
+		int f1 = 1 + rand()%(length-2*gap);
+		int f2 = (rand()%2) ? f1 + gap + rand()%(length-gap-f1) : -1;
+		if (f2 >= length-1) {
+			f2 = -1;
+		}
+		int level_before = (f2 < 0) ? level : !level;
+		int *e = &expected[4*r];
+		e[0] = f1; e[1] = !level_before ^ (f2 >= 0); e[2] = f2; e[3] = !level_before;
+		level = e[1];
+		uint64_t line[TDC_MAX_LINE_LENGTH/64] = {0};
+		for (int j = 0; j < length; ++j) {
+			int d = length-1-j;
+			int bit = (d < f1) ? e[1] : (f2 >= 0 && d < f2) ? e[3] : level_before;
+			// a bubble next to the transition of the first edge
+			if (config->bubble_width > 0 && (r%3) == 0 && d == f1+1) {
+				bit = !bit;
+			}
+			bit ^= ((length-1-j) & 1);
+			line[j/64] |= (uint64_t)bit << (j%64);
+		}
+		// record = coarse & line, most significant byte first
+		uint8_t *rec = &bytes[r*record_bytes];
+		uint64_t coarse = r + config->coarse_offset;
+		for (int b = 0; b < record_bytes; ++b) {
+			int lsb = 8*(record_bytes-1-b);
+			uint8_t byte = 0;
+			for (int i = 0; i < 8; ++i) {
+				int idx = lsb+i;
+				int bit = (idx < length) ? (line[idx/64] >> (idx%64)) & 1
+				        : (idx-length < 64) ? (coarse >> (idx-length)) & 1 : 0;
+				byte |= bit << i;
+			}
+			rec[b] = byte;
+		}
+	}
+
+	tdc_decoder_t *decoder = tdc_decoder_create(config);
+	if (decoder == NULL) {
+		return -1;
+	}
+	size_t max_hits = 2*n_records + length;
+	tdc_hit_t *hits = (tdc_hit_t*)malloc(max_hits*sizeof(tdc_hit_t));
+	size_t n_hits;
+	double t0 = now_s();
+	tdc_decoder_decode_bytes(decoder, bytes, (size_t)n_records*record_bytes, hits, max_hits, &n_hits);
+	double dt = now_s() - t0;
+
+	long errors = 0;
+	size_t h = 0;
+	for (long r = 0; r < n_records; ++r) {
+		int *e = &expected[4*r];
+		for (int k = 0; k < 2; ++k) {
+			if (e[2*k] < 0) {
+				continue;
+			}
+			uint64_t coarse = config->coarse_bits ? (uint64_t)r : 0;
+			int ok = h < n_hits && hits[h].coarse == coarse && hits[h].rising == e[2*k+1]
+			      && abs((int)hits[h].fine - e[2*k]) <= config->bubble_width;
+			if (!ok && errors++ < 10) {
+				fprintf(stderr, "record %ld: expected fine=%d rising=%d, got ", r, e[2*k], e[2*k+1]);
+				if (h < n_hits) {
+					fprintf(stderr, "coarse=%llu fine=%d rising=%d\n", (unsigned long long)hits[h].coarse, hits[h].fine, hits[h].rising);
+				} else {
+					fprintf(stderr, "nothing\n");
+				}
+			}
+			++h;
+		}
+	}
+	if (!quiet || errors) {
+		print_summary(decoder, dt);
+	}
+	printf("selftest: %ld errors\n", errors);
+	free(bytes);
+	free(expected);
+	free(hits);
+	tdc_decoder_destroy(decoder);
+	return errors ? 1 : 0;
+}
+
+// Hits from a delay line with random tap delays and edges uniformly distributed within the clock period.
+// After the first half of the hits all delays grow by 10% (temperature drift), and the calibration has
+// to follow. The lookup table is compared with the true bin centers after each half, and every entry
+// has to lie within its own bin.
+int calibration_selftest(tdc_calibration_config_t *config, long n_hits)
+{
+	const int    length = config->line_length;
+	const double period = config->clock_period_ps;
+	tdc_calibration_t *calibration = tdc_calibration_create(config);
+	if (calibration == NULL) {
+		return -1;
+	}
+	// the line covers about 1.4 clock periods
+	double delay[TDC_MAX_LINE_LENGTH];
+	for (int k = 0; k < length-1; ++k) {
+		delay[k] = 1.4*period/(length-1) * (0.4 + 1.2*rand()/RAND_MAX);
+	}
+	enum { chunk = 4096 };
+	tdc_hit_t hits[chunk];
+	double times[chunk];
+	long errors = 0;
+	double t_fill = 0, t_apply = 0;
+	for (int half = 0; half < 2; ++half) {
+		if (half == 1) {
+			for (int k = 0; k < length-1; ++k) {
+				delay[k] *= 1.1;
+			}
+		}
+		for (long n = 0; n < n_hits/2; n += chunk) {
+			for (int h = 0; h < chunk; ++h) {
+				// fine-1 is the number of delay elements that the edge has passed
+				double t = period*rand()/((double)RAND_MAX+1);
+				int fine = 1;
+				for (double passed = delay[0]; passed <= t && fine < length-1; passed += delay[fine-1]) {
+					++fine;
+				}
+				hits[h].coarse  = n+h;
+				hits[h].fine    = fine;
+				hits[h].rising  = h&1;
+				hits[h].channel = h%config->channels;
+			}
+			double t0 = now_s();
+			tdc_calibration_fill(calibration, hits, chunk);
+			double t1 = now_s();
+			tdc_calibration_apply(calibration, hits, chunk, times);
+			t_fill  += t1-t0;
+			t_apply += now_s()-t1;
+		}
+		// true bin centers, the last bin that an edge can reach is cut by the clock period
+		double max_error = 0;
+		long outside = 0;
+		int bins = 0;
+		for (int ch = 0; ch < config->channels; ++ch) {
+			double start = 0;
+			for (int fine = 1; fine < length && start < period; ++fine) {
+				double end = fmin(start + delay[fine-1], period);
+				double lut = tdc_calibration_fine_ps(calibration, ch, fine);
+				double error = fabs(lut - 0.5*(start+end));
+				if (error > max_error) {
+					max_error = error;
+				}
+				if (lut < start || lut > end) {
+					++outside;
+				}
+				if (ch == 0) {
+					++bins;
+				}
+				start = end;
+			}
+		}
+		// statistical error of the bin boundaries is below period/(2*sqrt(window)), but a lut error
+		// of more than half a bin would put a hit closer to the neighbouring bin's center
+		double tolerance = fmin(4*period/(2*sqrt((double)config->window_entries/2)), 0.5*period/bins);
+		fprintf(stderr, "%s drift: max lut error %.2f ps (tolerance %.2f ps), %ld entries outside their bin\n",
+			half ? "after" : "before", max_error, tolerance, outside);
+		if (max_error > tolerance || outside) {
+			++errors;
+		}
+	}
+	print_quality(calibration);
+	fprintf(stderr, "fill %.1f Mhits/s, apply %.1f Mhits/s\n", 1e-6*n_hits/t_fill, 1e-6*n_hits/t_apply);
+	printf("calibration selftest: %ld errors\n", errors);
+	tdc_calibration_destroy(calibration);
+	return errors ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+	tdc_decoder_config_t config = {
+		.line_length   = 64,
+		.coarse_bits   = 64,
+		.word_width    = 8,
+		.coarse_offset = 2,
+		.bubble_width  = 2,
+		.max_fine      = 0,
+		.channel       = 0,
+	};
+	tdc_calibration_config_t calibration_config = {
+		.line_length     = 64,
+		.channels        = 1,
+		.clock_period_ps = 0,
+		.nominal_tap_ps  = 0,
+		.min_entries     = 10000,
+		.update_entries  = 100000,
+		.window_entries  = 4000000,
+	};
+	const char *filename = NULL;
+	long selftest_records = 0;
+	int quiet = 0;
+	for (int i = 1; i < argc; ++i) {
+		int *value = NULL;
+		if      (strcmp(argv[i],"-l") == 0) value = &config.line_length;
+		else if (strcmp(argv[i],"-c") == 0) value = &config.coarse_bits;
+		else if (strcmp(argv[i],"-w") == 0) value = &config.word_width;
+		else if (strcmp(argv[i],"-o") == 0) value = &config.coarse_offset;
+		else if (strcmp(argv[i],"-b") == 0) value = &config.bubble_width;
+		else if (strcmp(argv[i],"-m") == 0) value = &config.max_fine;
+		else if (strcmp(argv[i],"-p") == 0) {
+			if (++i >= argc || sscanf(argv[i], "%lf", &calibration_config.clock_period_ps) != 1) {
+				fprintf(stderr, "expect number after option -p\n");
+				return -1;
+			}
+			continue;
+		} else if (strcmp(argv[i],"-u") == 0) {
+			long update;
+			if (++i >= argc || sscanf(argv[i], "%ld", &update) != 1 || update < 1) {
+				fprintf(stderr, "expect positive integer value after option -u\n");
+				return -1;
+			}
+			calibration_config.update_entries = update;
+			continue;
+		} else if (strcmp(argv[i],"-q") == 0) {
+			quiet = 1;
+			continue;
+		} else if (strcmp(argv[i],"-s") == 0) {
+			if (++i >= argc || sscanf(argv[i], "%ld", &selftest_records) != 1) {
+				fprintf(stderr, "expect integer value after option -s\n");
+				return -1;
+			}
+			continue;
+		} else if (strcmp(argv[i],"--help") == 0) {
+			print_help(argv[0]);
+			return 0;
+		} else if (argv[i][0] != '-' && filename == NULL) {
+			filename = argv[i];
+			continue;
+		} else {
+			fprintf(stderr, "unkown command line option: %s\n", argv[i]);
+			return -1;
+		}
+		if (++i >= argc || sscanf(argv[i], "%d", value) != 1) {
+			fprintf(stderr, "expect integer value after option %s\n", argv[i-1]);
+			return -1;
+		}
+	}
+
+	const int calibrate = calibration_config.clock_period_ps > 0;
+	calibration_config.line_length = config.line_length;
+	calibration_config.channels    = config.channel+1;
+	if (selftest_records > 0) {
+		int result = selftest(&config, selftest_records, quiet);
+		if (result == 0 && calibrate) {
+			// the hits after the drift fill the window many times, and the window is large enough
+			// that the statistical error of the bin boundaries stays well below half a bin
+			long n_hits = 2*selftest_records > 2000000 ? 2*selftest_records : 2000000;
+			calibration_config.window_entries = n_hits/16;
+			if (calibration_config.update_entries > calibration_config.window_entries/4) {
+				calibration_config.update_entries = calibration_config.window_entries/4;
+			}
+			result = calibration_selftest(&calibration_config, n_hits);
+		}
+		return result;
+	}
+	if (filename == NULL) {
+		print_help(argv[0]);
+		return -1;
+	}
+
+	FILE *f = fopen(filename, "rb");
+	if (f == NULL) {
+		perror(filename);
+		return 2;
+	}
+	tdc_decoder_t *decoder = tdc_decoder_create(&config);
+	if (decoder == NULL) {
+		return 2;
+	}
+	tdc_calibration_t *calibration = NULL;
+	if (calibrate && (calibration = tdc_calibration_create(&calibration_config)) == NULL) {
+		return 2;
+	}
+	enum { chunk = 1<<20, max_hits = 1<<18 };
+	static uint8_t bytes[chunk];
+	static tdc_hit_t hits[max_hits];
+	static double times[max_hits];
+	size_t n_bytes = 0;
+	double t0 = now_s();
+	for (;;) {
+		size_t n_read = fread(&bytes[n_bytes], 1, chunk-n_bytes, f);
+		n_bytes += n_read;
+		if (n_bytes == 0) {
+			break;
+		}
+		size_t n_hits;
+		size_t consumed = tdc_decoder_decode_bytes(decoder, bytes, n_bytes, hits, max_hits, &n_hits);
+		if (calibrate) {
+			tdc_calibration_fill(calibration, hits, n_hits);
+			tdc_calibration_apply(calibration, hits, n_hits, times);
+			for (size_t h = 0; !quiet && h < n_hits; ++h) {
+				printf("%.1f %d\n", times[h], hits[h].rising);
+			}
+		} else if (!quiet) {
+			for (size_t h = 0; h < n_hits; ++h) {
+				printf("%llu %d %d\n", (unsigned long long)hits[h].coarse, hits[h].fine, hits[h].rising);
+			}
+		}
+		memmove(bytes, &bytes[consumed], n_bytes-consumed);
+		n_bytes -= consumed;
+		if (n_read == 0 && consumed == 0) {
+			// less than one word left
+			break;
+		}
+	}
+	print_summary(decoder, now_s()-t0);
+	if (calibrate) {
+		tdc_calibration_update(calibration, config.channel);
+		print_quality(calibration);
+		tdc_calibration_destroy(calibration);
+	}
+	tdc_decoder_destroy(decoder);
+	fclose(f);
+	return 0;
+}
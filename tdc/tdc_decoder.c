@@ -0,0 +1,262 @@
+#include "tdc_decoder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+tdc_decoder_t* tdc_decoder_create(const tdc_decoder_config_t *config)
+{
+	if (config->line_length < 2 || config->line_length > TDC_MAX_LINE_LENGTH) {
+		fprintf(stderr, "tdc_decoder_create: line_length must be in [2,%d]\n", TDC_MAX_LINE_LENGTH);
+		return NULL;
+	}
+	if (config->coarse_bits < 0 || config->coarse_bits > TDC_MAX_COARSE_BITS) {
+		fprintf(stderr, "tdc_decoder_create: coarse_bits must be in [0,%d]\n", TDC_MAX_COARSE_BITS);
+		return NULL;
+	}
+	int record_width = config->line_length + config->coarse_bits;
+	if (config->word_width < 1 || config->word_width > 64 || record_width % config->word_width != 0) {
+		fprintf(stderr, "tdc_decoder_create: word_width must be in [1,64] and divide line_length+coarse_bits\n");
+		return NULL;
+	}
+	tdc_decoder_t *decoder = (tdc_decoder_t*)calloc(1, sizeof(tdc_decoder_t));
+	if (decoder == NULL) {
+		return NULL;
+	}
+	decoder->config       = *config;
+	decoder->record_width = record_width;
+	decoder->line_limbs   = (config->line_length+63)/64;
+	// tap line_o(length-1) is async_i itself, every other tap below is inverted
+	for (int j = 0; j < config->line_length; ++j) {
+		if ((config->line_length-1-j) & 1) {
+			decoder->parity[j/64] |= 1ull << (j%64);
+		}
+	}
+	return decoder;
+}
+
+void tdc_decoder_destroy(tdc_decoder_t *decoder)
+{
+	free(decoder);
+}
+
+void tdc_decoder_reset(tdc_decoder_t *decoder)
+{
+	memset(decoder->record, 0, sizeof(decoder->record));
+	decoder->fill = 0;
+}
+
+int tdc_decoder_max_hits_per_record(const tdc_decoder_t *decoder)
+{
+	return decoder->config.line_length-1;
+}
+
+static int tdc_bit(const uint64_t *limbs, int idx)
+{
+	return (limbs[idx/64] >> (idx%64)) & 1;
+}
+
+int tdc_decode_snapshot(tdc_decoder_t *decoder, const uint64_t *line, uint64_t coarse, tdc_hit_t *hits)
+{
+	const int length = decoder->config.line_length;
+	const int limbs  = decoder->line_limbs;
+	++decoder->records;
+
+	// thermometer code
+	uint64_t code[TDC_MAX_LINE_LENGTH/64];
+	for (int l = 0; l < limbs; ++l) {
+		code[l] = line[l] ^ decoder->parity[l];
+	}
+	if (length%64) {
+		code[limbs-1] &= (1ull << (length%64)) - 1;
+	}
+
+	// transition j is between tap j and tap j+1, collected from the input side of the line
+	int pos[TDC_MAX_LINE_LENGTH];
+	int n_pos = 0;
+	for (int l = limbs-1; l >= 0; --l) {
+		uint64_t next = (l+1 < limbs) ? code[l+1] : 0;
+		uint64_t transitions = code[l] ^ ((code[l] >> 1) | (next << 63));
+		if (l == (length-1)/64) {
+			// there is no transition above the last tap
+			transitions &= ~(~0ull << ((length-1)%64));
+		}
+		while (transitions) {
+			int b = 63 - __builtin_clzll(transitions);
+			pos[n_pos++] = 64*l + b;
+			transitions &= ~(1ull << b);
+		}
+	}
+
+	int n_hits = 0;
+	for (int i = 0; i < n_pos; ) {
+		int j = i;
+		while (j+1 < n_pos && pos[j]-pos[j+1] <= decoder->config.bubble_width) {
+			++j;
+		}
+		if ((j-i)%2 == 1) {
+			++decoder->dropped_clusters;
+		} else {
+			int p = pos[(i+j)/2];
+			int fine = length-1-p;
+			if (decoder->config.max_fine > 0 && fine >= decoder->config.max_fine) {
+				++decoder->dropped_late;
+			} else {
+				hits[n_hits].coarse  = coarse;
+				hits[n_hits].fine    = fine;
+				// the level above the cluster is the level after the edge
+				hits[n_hits].rising  = tdc_bit(code, pos[i]+1);
+				hits[n_hits].channel = decoder->config.channel;
+				++n_hits;
+			}
+		}
+		i = j+1;
+	}
+	if (n_hits == 0) {
+		++decoder->empty_records;
+	}
+	decoder->hits += n_hits;
+	return n_hits;
+}
+
+// the bits of value go to the record bits [lsb, lsb+n_bits-1]
+static void tdc_put_bits(uint64_t *record, int lsb, uint64_t value, int n_bits)
+{
+	int limb = lsb/64;
+	int shift = lsb%64;
+	record[limb] |= value << shift;
+	if (shift && shift+n_bits > 64) {
+		record[limb+1] |= value >> (64-shift);
+	}
+}
+
+static uint64_t tdc_get_bits(const uint64_t *record, int lsb, int n_bits)
+{
+	if (n_bits == 0) {
+		return 0;
+	}
+	int limb = lsb/64;
+	int shift = lsb%64;
+	uint64_t value = record[limb] >> shift;
+	if (shift && shift+n_bits > 64) {
+		value |= record[limb+1] << (64-shift);
+	}
+	if (n_bits < 64) {
+		value &= (1ull << n_bits) - 1;
+	}
+	return value;
+}
+
+static int tdc_decode_record(tdc_decoder_t *decoder, tdc_hit_t *hits)
+{
+	const int coarse_bits = decoder->config.coarse_bits;
+	uint64_t coarse = tdc_get_bits(decoder->record, decoder->config.line_length, coarse_bits) - decoder->config.coarse_offset;
+	if (coarse_bits < 64) {
+		coarse &= (1ull << coarse_bits) - 1;
+	}
+	int n_hits = tdc_decode_snapshot(decoder, decoder->record, coarse, hits);
+	tdc_decoder_reset(decoder);
+	return n_hits;
+}
+
+// returns the number of hits, or -1 if the record would be complete but the hits might not fit
+static int tdc_push_word(tdc_decoder_t *decoder, uint64_t word, tdc_hit_t *hits, size_t space)
+{
+	const int ww = decoder->config.word_width;
+	if (decoder->fill + ww == decoder->record_width && space < (size_t)tdc_decoder_max_hits_per_record(decoder)) {
+		return -1;
+	}
+	if (ww < 64) {
+		word &= (1ull << ww) - 1;
+	}
+	decoder->fill += ww;
+	tdc_put_bits(decoder->record, decoder->record_width - decoder->fill, word, ww);
+	if (decoder->fill < decoder->record_width) {
+		return 0;
+	}
+	return tdc_decode_record(decoder, hits);
+}
+
+size_t tdc_decoder_decode(tdc_decoder_t *decoder, const uint64_t *words, size_t n_words, tdc_hit_t *hits, size_t max_hits, size_t *n_hits)
+{
+	size_t h = 0, w = 0;
+	for (; w < n_words; ++w) {
+		int n = tdc_push_word(decoder, words[w], &hits[h], max_hits-h);
+		if (n < 0) {
+			break;
+		}
+		h += n;
+	}
+	*n_hits = h;
+	return w;
+}
+
+size_t tdc_decoder_decode32(tdc_decoder_t *decoder, const uint32_t *words, size_t n_words, tdc_hit_t *hits, size_t max_hits, size_t *n_hits)
+{
+	size_t h = 0, w = 0;
+	for (; w < n_words; ++w) {
+		int n = tdc_push_word(decoder, words[w], &hits[h], max_hits-h);
+		if (n < 0) {
+			break;
+		}
+		h += n;
+	}
+	*n_hits = h;
+	return w;
+}
+
+size_t tdc_decoder_decode_bytes(tdc_decoder_t *decoder, const uint8_t *bytes, size_t n_bytes, tdc_hit_t *hits, size_t max_hits, size_t *n_hits)
+{
+	const int bytes_per_word = (decoder->config.word_width+7)/8;
+	const int max_hits_per_record = tdc_decoder_max_hits_per_record(decoder);
+	size_t h = 0, b = 0;
+	if (decoder->config.word_width%8 == 0) {
+		// whole records can be taken directly from the byte stream
+		const int record_bytes = decoder->record_width/8;
+		for (;;) {
+			if (decoder->fill == 0 && b+record_bytes <= n_bytes) {
+				if (max_hits-h < (size_t)max_hits_per_record) {
+					break;
+				}
+				// limb l holds the bytes [record_bytes-8*(l+1), record_bytes-8*l), most significant first
+				const uint8_t *rec = &bytes[b];
+				for (int l = 0, end = record_bytes; end > 0; ++l, end -= 8) {
+					uint64_t limb = 0;
+					for (int i = (end > 8) ? end-8 : 0; i < end; ++i) {
+						limb = (limb << 8) | rec[i];
+					}
+					decoder->record[l] = limb;
+				}
+				h += tdc_decode_record(decoder, &hits[h]);
+				b += record_bytes;
+			} else if (decoder->fill != 0 && b+bytes_per_word <= n_bytes) {
+				// complete the record of the previous call word by word
+				uint64_t word = 0;
+				for (int i = 0; i < bytes_per_word; ++i) {
+					word = (word << 8) | bytes[b+i];
+				}
+				int n = tdc_push_word(decoder, word, &hits[h], max_hits-h);
+				if (n < 0) {
+					break;
+				}
+				h += n;
+				b += bytes_per_word;
+			} else {
+				break;
+			}
+		}
+	}
+	for (; b+bytes_per_word <= n_bytes; b += bytes_per_word) {
+		uint64_t word = 0;
+		for (int i = 0; i < bytes_per_word; ++i) {
+			word = (word << 8) | bytes[b+i];
+		}
+		int n = tdc_push_word(decoder, word, &hits[h], max_hits-h);
+		if (n < 0) {
+			break;
+		}
+		h += n;
+	}
+	*n_hits = h;
+	return b;
+}
@@ -0,0 +1,98 @@
+#ifndef TDC_DECODER_H_
+#define TDC_DECODER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Decoder for the snapshots of delayline.vhd as they come out of serializer.vhd.
+//
+// Each record that is pushed into the serializer has coarse_bits + line_length bits: a coarse
+// counter in the upper bits and the line_o snapshot in the lower bits (in delayline_tb.vhd this is
+// counter & line_result). The serializer sends each record as word_width bit words, most significant
+// word first.
+//
+// Every other tap of the delay line is inverted, so the snapshot is first turned into a thermometer
+// code where all taps that the edge has passed have the new level of async_i. Each transition in the
+// thermometer code is a hit: fine is the number of taps that the edge has passed, i.e. the edge
+// entered the line fine tap delays before the snapshot was taken.
+//
+// Bubbles (single taps with the wrong level near a transition) produce additional transitions
+// close to the real one. Transitions that are at most bubble_width taps apart form a cluster:
+// a cluster with an odd number of transitions is one edge (at the middle transition), a cluster with
+// an even number of transitions is dropped (bubbles only, or two edges that are too close to be resolved).
+
+#define TDC_MAX_LINE_LENGTH 256
+#define TDC_MAX_COARSE_BITS 64
+
+typedef struct tdc_decoder_config {
+	int line_length;   // length generic of delayline.vhd
+	int coarse_bits;   // number of coarse counter bits above the snapshot in each record
+	int word_width;    // out_width generic of serializer.vhd (at most 64)
+	int coarse_offset; // clock cycles between the snapshot and the coarse counter value in the record (2 in delayline_tb.vhd)
+	int bubble_width;  // transitions at most this many taps apart form a cluster, 0 disables bubble handling
+	int max_fine;      // drop hits with fine >= max_fine (the edge was already seen in the previous snapshot), 0 keeps all
+	int channel;       // copied into the hits
+} tdc_decoder_config_t;
+
+typedef struct tdc_hit {
+	uint64_t coarse;  // clock cycle of the snapshot
+	uint16_t fine;    // taps passed by the edge at the time of the snapshot
+	uint8_t  rising;  // 1 for a rising edge of async_i, 0 for a falling edge
+	uint8_t  channel;
+} tdc_hit_t;
+
+#define TDC_LIMBS ((TDC_MAX_LINE_LENGTH+TDC_MAX_COARSE_BITS)/64)
+typedef struct tdc_decoder {
+	tdc_decoder_config_t config;
+	int record_width;
+	int line_limbs;
+
+	// thermometer code = snapshot xor parity
+	uint64_t parity[TDC_MAX_LINE_LENGTH/64];
+
+	// the record that is currently received, fill is the number of bits received so far
+	uint64_t record[TDC_LIMBS];
+	int fill;
+
+	// statistics
+	uint64_t records;
+	uint64_t hits;
+	uint64_t empty_records;    // records without any hit
+	uint64_t dropped_clusters; // clusters with an even number of transitions
+	uint64_t dropped_late;     // hits dropped because of max_fine
+} tdc_decoder_t;
+
+// returns NULL if the configuration is not supported
+tdc_decoder_t* tdc_decoder_create(const tdc_decoder_config_t *config);
+void           tdc_decoder_destroy(tdc_decoder_t *decoder);
+
+// Forget a partially received record, e.g. after the serializer was reset
+void tdc_decoder_reset(tdc_decoder_t *decoder);
+
+// A record can produce at most this many hits
+int tdc_decoder_max_hits_per_record(const tdc_decoder_t *decoder);
+
+// Decode serializer words (each word in the lower word_width bits). Records can span calls.
+// Hits are written to hits[], decoding stops before a record whose hits might not fit into max_hits.
+// Returns the number of words that were consumed, the number of hits is stored in *n_hits.
+size_t tdc_decoder_decode(tdc_decoder_t *decoder, const uint64_t *words, size_t n_words, tdc_hit_t *hits, size_t max_hits, size_t *n_hits);
+
+// Same for words in uint32_t, e.g. from uart_wbp_readout_peek (word_width at most 32)
+size_t tdc_decoder_decode32(tdc_decoder_t *decoder, const uint32_t *words, size_t n_words, tdc_hit_t *hits, size_t max_hits, size_t *n_hits);
+
+// Same for a byte stream where each word is stored in (word_width+7)/8 bytes, most significant byte first.
+// Returns the number of bytes that were consumed (always whole words).
+size_t tdc_decoder_decode_bytes(tdc_decoder_t *decoder, const uint8_t *bytes, size_t n_bytes, tdc_hit_t *hits, size_t max_hits, size_t *n_hits);
+
+// Decode a single snapshot of line_length bits (line[0] bit 0 is line_o(0)) without serializer framing
+int tdc_decode_snapshot(tdc_decoder_t *decoder, const uint64_t *line, uint64_t coarse, tdc_hit_t *hits);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,244 @@
+#include "tdc_event_builder.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+tdc_event_builder_t* tdc_event_builder_create(const tdc_event_builder_config_t *config, tdc_event_callback_t callback, void *user)
+{
+	if (config->inputs < 1 || config->reorder_capacity < 1 || config->reorder_ps < 0 ||
+	    config->window_ps < 0 || config->max_event_hits < 1) {
+		fprintf(stderr, "tdc_event_builder_create: inputs, reorder_capacity and max_event_hits must be positive\n");
+		return NULL;
+	}
+	tdc_event_builder_t *builder = (tdc_event_builder_t*)calloc(1, sizeof(tdc_event_builder_t));
+	if (builder == NULL) {
+		return NULL;
+	}
+	builder->config   = *config;
+	builder->callback = callback;
+	builder->user     = user;
+	uint32_t capacity = 1;
+	while (capacity < (uint32_t)config->reorder_capacity) {
+		capacity *= 2;
+	}
+	builder->mask = capacity-1;
+	builder->leaves = 1;
+	while (builder->leaves < config->inputs) {
+		builder->leaves *= 2;
+	}
+	builder->input      = (tdc_event_input_t*)calloc(config->inputs, sizeof(tdc_event_input_t));
+	builder->winner     = (int*)calloc(2*builder->leaves, sizeof(int));
+	builder->bound      = (double*)calloc(builder->leaves, sizeof(double));
+	builder->event_hits = (tdc_timed_hit_t*)calloc(config->max_event_hits, sizeof(tdc_timed_hit_t));
+	if (builder->input == NULL || builder->winner == NULL || builder->bound == NULL || builder->event_hits == NULL) {
+		tdc_event_builder_destroy(builder);
+		return NULL;
+	}
+	for (int i = 0; i < config->inputs; ++i) {
+		builder->input[i].buffer = (tdc_timed_hit_t*)calloc(capacity, sizeof(tdc_timed_hit_t));
+		if (builder->input[i].buffer == NULL) {
+			tdc_event_builder_destroy(builder);
+			return NULL;
+		}
+		builder->input[i].newest    = -INFINITY;
+		builder->input[i].watermark = -INFINITY;
+	}
+	// unused leaves never win
+	for (int i = 0; i < builder->leaves; ++i) {
+		builder->bound[i] = (i < config->inputs) ? -INFINITY : INFINITY;
+		builder->winner[builder->leaves+i] = i;
+	}
+	for (int n = builder->leaves-1; n >= 1; --n) {
+		int l = builder->winner[2*n], r = builder->winner[2*n+1];
+		builder->winner[n] = (builder->bound[l] <= builder->bound[r]) ? l : r;
+	}
+	builder->last_time = -INFINITY;
+	builder->event.hits = builder->event_hits;
+	return builder;
+}
+
+void tdc_event_builder_destroy(tdc_event_builder_t *builder)
+{
+	if (builder == NULL) {
+		return;
+	}
+	if (builder->input != NULL) {
+		for (int i = 0; i < builder->config.inputs; ++i) {
+			free(builder->input[i].buffer);
+		}
+	}
+	free(builder->input);
+	free(builder->winner);
+	free(builder->bound);
+	free(builder->event_hits);
+	free(builder);
+}
+
+static int tdc_event_input_ready(const tdc_event_input_t *in, uint32_t mask)
+{
+	return in->count && in->buffer[in->head & mask].time_ps <= in->watermark;
+}
+
+// the bound of an input changed, replay its path to the root
+static void tdc_event_builder_update(tdc_event_builder_t *builder, int i)
+{
+	const tdc_event_input_t *in = &builder->input[i];
+	double bound = in->watermark;
+	if (in->count && in->buffer[in->head & builder->mask].time_ps < bound) {
+		bound = in->buffer[in->head & builder->mask].time_ps;
+	}
+	builder->bound[i] = bound;
+	for (int n = (builder->leaves+i)/2; n >= 1; n /= 2) {
+		int l = builder->winner[2*n], r = builder->winner[2*n+1];
+		builder->winner[n] = (builder->bound[l] <= builder->bound[r]) ? l : r;
+	}
+}
+
+double tdc_event_builder_lower_bound(const tdc_event_builder_t *builder)
+{
+	double bound = builder->bound[builder->winner[1]];
+	return (bound > builder->last_time) ? bound : builder->last_time;
+}
+
+static void tdc_event_builder_close(tdc_event_builder_t *builder)
+{
+	tdc_event_t *event = &builder->event;
+	if (event->n_hits == 0) {
+		return;
+	}
+	if (event->multiplicity >= builder->config.min_channels) {
+		++builder->events;
+		if (event->truncated) {
+			++builder->truncated_events;
+		}
+		builder->callback(builder->user, event);
+	} else {
+		++builder->dropped_events;
+	}
+	event->n_hits = event->multiplicity = event->truncated = 0;
+	memset(builder->channel_mask, 0, sizeof(builder->channel_mask));
+}
+
+static void tdc_event_builder_add(tdc_event_builder_t *builder, const tdc_timed_hit_t *hit)
+{
+	tdc_event_t *event = &builder->event;
+	if (event->n_hits && !(hit->time_ps - event->time_ps < builder->config.window_ps)) {
+		tdc_event_builder_close(builder);
+	}
+	if (event->n_hits == 0) {
+		event->time_ps = hit->time_ps;
+	}
+	if (event->n_hits < builder->config.max_event_hits) {
+		builder->event_hits[event->n_hits++] = *hit;
+	} else {
+		++event->truncated;
+	}
+	uint64_t bit = 1ull << (hit->channel%64);
+	if (!(builder->channel_mask[hit->channel/64] & bit)) {
+		builder->channel_mask[hit->channel/64] |= bit;
+		++event->multiplicity;
+	}
+	if (builder->config.window_ps == 0) {
+		tdc_event_builder_close(builder);
+	}
+}
+
+static void tdc_event_builder_merge(tdc_event_builder_t *builder)
+{
+	for (;;) {
+		int i = builder->winner[1];
+		tdc_event_input_t *in = &builder->input[i];
+		if (i >= builder->config.inputs || !tdc_event_input_ready(in, builder->mask)) {
+			break;
+		}
+		const tdc_timed_hit_t *hit = &in->buffer[in->head & builder->mask];
+		builder->last_time = hit->time_ps;
+		++builder->hits_out;
+		tdc_event_builder_add(builder, hit);
+		++in->head;
+		--in->count;
+		tdc_event_builder_update(builder, i);
+	}
+	// nothing can join the open event any more
+	if (builder->event.n_hits && tdc_event_builder_lower_bound(builder) - builder->event.time_ps >= builder->config.window_ps) {
+		tdc_event_builder_close(builder);
+	}
+}
+
+size_t tdc_event_builder_push(tdc_event_builder_t *builder, int input, const tdc_timed_hit_t *hits, size_t n_hits)
+{
+	tdc_event_input_t *in = &builder->input[input];
+	const uint32_t mask = builder->mask;
+	size_t h = 0;
+	for (; h < n_hits; ++h) {
+		const tdc_timed_hit_t *hit = &hits[h];
+		if (hit->time_ps < builder->last_time) {
+			++builder->late_hits;
+			continue;
+		}
+		if (in->count == mask+1) {
+			// release the oldest hit now, merge and try again
+			if (in->watermark < in->buffer[in->head & mask].time_ps) {
+				in->watermark = in->buffer[in->head & mask].time_ps;
+				++builder->forced_hits;
+			}
+			tdc_event_builder_update(builder, input);
+			tdc_event_builder_merge(builder);
+			if (in->count == mask+1) {
+				break;
+			}
+			--h;
+			continue;
+		}
+		// insertion sort from the newest end, hits are almost in order
+		uint32_t pos = in->head + in->count;
+		while (pos != in->head && in->buffer[(pos-1) & mask].time_ps > hit->time_ps) {
+			in->buffer[pos & mask] = in->buffer[(pos-1) & mask];
+			--pos;
+		}
+		in->buffer[pos & mask] = *hit;
+		++in->count;
+		++builder->hits_in;
+		if (hit->time_ps > in->newest) {
+			in->newest = hit->time_ps;
+			if (in->newest - builder->config.reorder_ps > in->watermark) {
+				in->watermark = in->newest - builder->config.reorder_ps;
+			}
+		}
+		// only merge if this input could be the one that the tree waits for
+		if (builder->winner[1] == input || pos == in->head) {
+			tdc_event_builder_update(builder, input);
+			tdc_event_builder_merge(builder);
+		}
+	}
+	tdc_event_builder_update(builder, input);
+	tdc_event_builder_merge(builder);
+	return h;
+}
+
+void tdc_event_builder_advance(tdc_event_builder_t *builder, int input, double time_ps)
+{
+	tdc_event_input_t *in = &builder->input[input];
+	if (time_ps > in->watermark) {
+		in->watermark = time_ps;
+		tdc_event_builder_update(builder, input);
+		tdc_event_builder_merge(builder);
+	}
+}
+
+void tdc_event_builder_finish(tdc_event_builder_t *builder, int input)
+{
+	tdc_event_builder_advance(builder, input, INFINITY);
+}
+
+void tdc_event_builder_flush(tdc_event_builder_t *builder)
+{
+	for (int i = 0; i < builder->config.inputs; ++i) {
+		builder->input[i].watermark = INFINITY;
+		tdc_event_builder_update(builder, i);
+	}
+	tdc_event_builder_merge(builder);
+	tdc_event_builder_close(builder);
+}
@@ -0,0 +1,115 @@
+#ifndef TDC_EVENT_BUILDER_H_
+#define TDC_EVENT_BUILDER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Time-ordered merge of several hit streams and grouping into coincidence events.
+//
+// Each input is one hit stream (e.g. one delay line channel after tdc_decoder and tdc_calibration).
+// The hits of an input are almost time ordered: the hits of one snapshot come out latest first, and
+// the calibration can swap neighbouring hits. Each input therefore has a small sorted reorder buffer,
+// and a hit is only released when the input has seen a hit that is reorder_ps later (or when
+// tdc_event_builder_advance() says that no earlier hit will come). The inputs are merged with a
+// tournament tree: every input has a lower bound for the time of the next hit it can release, the
+// tree finds the input with the smallest bound in O(log(inputs)), and that hit is released if the input
+// is ready. If an input is not ready the merge waits for more hits of that input, so an idle input
+// must be advanced (e.g. with the coarse counter of empty records) or finished.
+//
+// Hits that arrive after a later hit was already merged are dropped and counted as late. If the reorder
+// buffer of an input is full, its oldest hit is released without waiting for reorder_ps.
+//
+// The merged hits are grouped into events: an event starts with a hit and collects all hits within
+// window_ps after it. Events with less than min_channels different channels are dropped. With
+// window_ps = 0 every hit is an event of its own, which makes the output a merged hit stream that can
+// be the input of another event builder (see tdc_events.c, where channel groups are merged in parallel).
+// Memory use is bounded by the reorder buffers and one event.
+
+typedef struct tdc_timed_hit {
+	double  time_ps;
+	uint8_t channel;
+	uint8_t rising;
+} tdc_timed_hit_t;
+
+typedef struct tdc_event {
+	double time_ps;      // time of the first hit
+	int    n_hits;
+	int    multiplicity; // number of different channels
+	int    truncated;    // hits that did not fit into max_event_hits
+	const tdc_timed_hit_t *hits;
+} tdc_event_t;
+
+typedef void (*tdc_event_callback_t)(void *user, const tdc_event_t *event);
+
+typedef struct tdc_event_builder_config {
+	int    inputs;
+	int    reorder_capacity; // hits per input reorder buffer (rounded up to a power of two)
+	double reorder_ps;       // how much later than a merged hit an earlier hit of the same input may arrive
+	double window_ps;        // coincidence window, 0 makes every hit an event
+	int    min_channels;     // events with fewer channels are dropped
+	int    max_event_hits;
+} tdc_event_builder_config_t;
+
+typedef struct tdc_event_input {
+	tdc_timed_hit_t *buffer; // sorted ring buffer
+	uint32_t head, count;
+	double newest;
+	double watermark;        // no hit before this will be released any more
+} tdc_event_input_t;
+
+typedef struct tdc_event_builder {
+	tdc_event_builder_config_t config;
+	tdc_event_callback_t callback;
+	void *user;
+
+	tdc_event_input_t *input;
+	uint32_t mask;           // reorder_capacity-1
+	int leaves;              // inputs rounded up to a power of two
+	int *winner;             // tournament tree: winner[1] is the input with the smallest bound, leaves at winner[leaves+i]
+	double *bound;           // per leaf
+
+	double last_time;        // time of the last merged hit
+	tdc_timed_hit_t *event_hits;
+	tdc_event_t event;       // the open event
+	uint64_t channel_mask[4];
+
+	// statistics
+	uint64_t hits_in;
+	uint64_t hits_out;
+	uint64_t late_hits;
+	uint64_t forced_hits;    // released because the reorder buffer was full
+	uint64_t events;
+	uint64_t dropped_events; // fewer than min_channels
+	uint64_t truncated_events;
+} tdc_event_builder_t;
+
+// returns NULL if the configuration is not supported
+tdc_event_builder_t* tdc_event_builder_create(const tdc_event_builder_config_t *config, tdc_event_callback_t callback, void *user);
+void                 tdc_event_builder_destroy(tdc_event_builder_t *builder);
+
+// Add hits of one input and merge as far as possible (events are passed to the callback).
+// Returns the number of hits that were taken, which is less than n_hits if the reorder buffer of the
+// input is full and other inputs have to deliver hits (or be advanced) before the merge can go on.
+size_t tdc_event_builder_push(tdc_event_builder_t *builder, int input, const tdc_timed_hit_t *hits, size_t n_hits);
+
+// No hit before time_ps will come from this input
+void tdc_event_builder_advance(tdc_event_builder_t *builder, int input, double time_ps);
+
+// The input has ended
+void tdc_event_builder_finish(tdc_event_builder_t *builder, int input);
+
+// All inputs have ended: merge the remaining hits and close the open event
+void tdc_event_builder_flush(tdc_event_builder_t *builder);
+
+// All hits that are merged from now on have a time >= this bound
+double tdc_event_builder_lower_bound(const tdc_event_builder_t *builder);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,502 @@
+#include "tdc_event_builder.h"
+#include "../uart/uart_wbp_queue.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+void print_help(const char* argv0){
+	fprintf(stderr, "usage: %s [options] <channel0_file> <channel1_file> ...\n", argv0);
+	fprintf(stderr, "       %s [options] -s <events>\n", argv0);
+	fprintf(stderr, " Merge the hits of several channels (files with \"<time_ps> <rising>\" lines as written\n");
+	fprintf(stderr, " by tdc_decode -p) and print the coincidence events: one line \"<time_ps> <n_hits> <channels>\"\n");
+	fprintf(stderr, " per event followed by one line \"  <channel> <time_ps-event_time_ps> <rising>\" per hit.\n");
+	fprintf(stderr, " options are\n");
+	fprintf(stderr, " -w <ps>           : coincidence window (default is 1000)\n");
+	fprintf(stderr, " -r <ps>           : reorder window of each channel (default is 10000)\n");
+	fprintf(stderr, " -m <channels>     : minimum number of channels in an event (default is 2)\n");
+	fprintf(stderr, " -q                : don't print events, only the summary\n");
+	fprintf(stderr, " -s <events>       : merge generated coincidences and noise and check the result\n");
+	fprintf(stderr, " -n <channels>     : number of generated channels (default is 16)\n");
+	fprintf(stderr, " -g <groups>       : merge the generated channels in this many threads (default is 4)\n");
+}
+
+double now_s()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + 1e-9*t.tv_nsec;
+}
+
+void print_summary(const tdc_event_builder_t *builder, double dt)
+{
+	fprintf(stderr, "%llu hits, %llu merged, %llu late, %llu forced, %llu events, %llu dropped events, %llu truncated",
+		(unsigned long long)builder->hits_in, (unsigned long long)builder->hits_out, (unsigned long long)builder->late_hits,
+		(unsigned long long)builder->forced_hits, (unsigned long long)builder->events, (unsigned long long)builder->dropped_events,
+		(unsigned long long)builder->truncated_events);
+	if (dt > 0) {
+		fprintf(stderr, ", %.1f Mhits/s", 1e-6*builder->hits_out/dt);
+	}
+	fprintf(stderr, "\n");
+}
+
+void print_event(void *user, const tdc_event_t *event)
+{
+	(void)user;
+	printf("%.1f %d %d\n", event->time_ps, event->n_hits, event->multiplicity);
+	for (int h = 0; h < event->n_hits; ++h) {
+		printf("  %d %.1f %d\n", event->hits[h].channel, event->hits[h].time_ps - event->time_ps, event->hits[h].rising);
+	}
+}
+
+void count_event(void *user, const tdc_event_t *event)
+{
+	(void)user;
+	(void)event;
+}
+
+int merge_files(tdc_event_builder_config_t *config, char **filenames, int quiet)
+{
+	FILE **f = (FILE**)calloc(config->inputs, sizeof(FILE*));
+	for (int i = 0; i < config->inputs; ++i) {
+		if ((f[i] = fopen(filenames[i], "r")) == NULL) {
+			perror(filenames[i]);
+			return 2;
+		}
+	}
+	tdc_event_builder_t *builder = tdc_event_builder_create(config, quiet ? count_event : print_event, NULL);
+	if (builder == NULL) {
+		return 2;
+	}
+	// read the files in turns, a hit that doesn't fit is kept for the next turn
+	enum { chunk = 4096 };
+	tdc_timed_hit_t *hits = (tdc_timed_hit_t*)calloc((size_t)config->inputs*chunk, sizeof(tdc_timed_hit_t));
+	int *n_hits = (int*)calloc(config->inputs, sizeof(int));
+	long *lines = (long*)calloc(config->inputs, sizeof(long));
+	int open = config->inputs;
+	int result = 0;
+	double t0 = now_s();
+	while (open && result == 0) {
+		for (int i = 0; i < config->inputs; ++i) {
+			if (f[i] == NULL) {
+				continue;
+			}
+			tdc_timed_hit_t *h = &hits[i*chunk];
+			char line[256];
+			while (n_hits[i] < chunk && fgets(line, sizeof(line), f[i]) != NULL) {
+				++lines[i];
+				int rising;
+				int n = sscanf(line, "%lf %d", &h[n_hits[i]].time_ps, &rising);
+				if (n == EOF) {
+					continue; // empty line
+				}
+				if (n != 2) {
+					fprintf(stderr, "%s:%ld: expect \"<time_ps> <rising>\"\n", filenames[i], lines[i]);
+					result = 3;
+					break;
+				}
+				h[n_hits[i]].channel = i;
+				h[n_hits[i]].rising  = rising;
+				++n_hits[i];
+			}
+			if (result) {
+				break;
+			}
+			size_t taken = tdc_event_builder_push(builder, i, h, n_hits[i]);
+			memmove(h, &h[taken], (n_hits[i]-taken)*sizeof(tdc_timed_hit_t));
+			n_hits[i] -= taken;
+			if (n_hits[i] == 0 && feof(f[i])) {
+				tdc_event_builder_finish(builder, i);
+				fclose(f[i]);
+				f[i] = NULL;
+				--open;
+			}
+		}
+	}
+	if (result == 0) {
+		tdc_event_builder_flush(builder);
+		print_summary(builder, now_s()-t0);
+	}
+	for (int i = 0; i < config->inputs; ++i) {
+		if (f[i] != NULL) {
+			fclose(f[i]);
+		}
+	}
+	tdc_event_builder_destroy(builder);
+	free(hits);
+	free(n_hits);
+	free(lines);
+	free(f);
+	return result;
+}
+
+// Selftest: every channel has a hit for each generated event (with jitter), plus noise hits. Channel
+// groups are merged by their own threads into merged hit streams (window 0), which are passed through
+// single producer single consumer rings to the main thread, where the group streams are merged again and
+// grouped into events.
+
+uint64_t xorshift(uint64_t *state)
+{
+	*state ^= *state >> 12;
+	*state ^= *state << 25;
+	*state ^= *state >> 27;
+	return *state * 2685821657736338717ull;
+}
+
+double uniform(uint64_t *state)
+{
+	return (xorshift(state) >> 11) * (1.0/9007199254740992.0);
+}
+
+typedef struct selftest_config {
+	long   events;
+	int    channels;
+	int    groups;
+	double event_gap_ps; // mean time between events
+	double noise_gap_ps; // mean time between noise hits of a channel
+	double jitter_ps;
+} selftest_config_t;
+
+// the hits of one channel in time order, except that hits in the same clock cycle come out latest first
+typedef struct channel_generator {
+	uint64_t event_state, noise_state;
+	long     event;
+	double   next_event, next_noise;
+	int      channel;
+	tdc_timed_hit_t pending;
+	int      has_pending;
+} channel_generator_t;
+
+void generator_init(channel_generator_t *gen, const selftest_config_t *st, int channel)
+{
+	memset(gen, 0, sizeof(*gen));
+	gen->event_state = 0x1234567; // the same events for all channels
+	gen->noise_state = 0x9876543 + 7919*channel;
+	gen->channel     = channel;
+	gen->next_event  = -st->event_gap_ps*log(1-uniform(&gen->event_state));
+	gen->next_noise  = -st->noise_gap_ps*log(1-uniform(&gen->noise_state));
+}
+
+// returns 0 at the end
+int generator_next_in_order(channel_generator_t *gen, const selftest_config_t *st, tdc_timed_hit_t *hit)
+{
+	hit->channel = gen->channel;
+	hit->rising  = 1;
+	if (gen->event < st->events && gen->next_event < gen->next_noise) {
+		hit->time_ps = gen->next_event + st->jitter_ps*(2*uniform(&gen->noise_state)-1);
+		gen->next_event += -st->event_gap_ps*log(1-uniform(&gen->event_state));
+		++gen->event;
+		return 1;
+	}
+	if (gen->event < st->events) {
+		hit->time_ps = gen->next_noise;
+		hit->rising  = 0;
+		gen->next_noise += -st->noise_gap_ps*log(1-uniform(&gen->noise_state));
+		return 1;
+	}
+	return 0;
+}
+
+int generator_next(channel_generator_t *gen, const selftest_config_t *st, tdc_timed_hit_t *hit)
+{
+	if (!gen->has_pending && !generator_next_in_order(gen, st, &gen->pending)) {
+		return 0;
+	}
+	gen->has_pending = 1;
+	tdc_timed_hit_t next;
+	int more = generator_next_in_order(gen, st, &next);
+	if (more && floor(next.time_ps/5000) == floor(gen->pending.time_ps/5000)) {
+		// same snapshot, the later hit comes first
+		*hit = next;
+		return 1;
+	}
+	*hit = gen->pending;
+	gen->pending = next;
+	gen->has_pending = more;
+	return 1;
+}
+
+typedef struct ring_entry {
+	tdc_timed_hit_t hit;
+	int type;      // 0: hit, 1: hit.time_ps is a watermark, 2: end of the stream
+} ring_entry_t;
+
+enum { ring_depth = 14, ring_batch = 64 };
+typedef struct ring {
+	uart_wbp_queue_t queue;
+	ring_entry_t entry[1<<ring_depth];
+	ring_entry_t pending[ring_batch]; // producer only
+	int n_pending;
+} ring_t;
+
+void ring_put(ring_t *ring, const ring_entry_t *entry)
+{
+	ring->pending[ring->n_pending++] = *entry;
+	// publish in batches
+	if (ring->n_pending < ring_batch && entry->type == 0) {
+		return;
+	}
+	size_t pushed = 0;
+	while ((pushed += uart_wbp_queue_push(&ring->queue, &ring->pending[pushed], ring->n_pending-pushed)) < (size_t)ring->n_pending) {
+		sched_yield();
+	}
+	ring->n_pending = 0;
+}
+
+typedef struct group {
+	const selftest_config_t *st;
+	int first_channel, n_channels;
+	ring_t *ring;
+	tdc_event_builder_config_t config;
+	tdc_event_builder_t *builder;
+} group_t;
+
+void group_hit(void *user, const tdc_event_t *event)
+{
+	group_t *group = (group_t*)user;
+	ring_entry_t entry = { event->hits[0], 0 };
+	ring_put(group->ring, &entry);
+}
+
+void* group_thread(void *arg)
+{
+	group_t *group = (group_t*)arg;
+	const selftest_config_t *st = group->st;
+	channel_generator_t *gen = (channel_generator_t*)calloc(group->n_channels, sizeof(channel_generator_t));
+	for (int i = 0; i < group->n_channels; ++i) {
+		generator_init(&gen[i], st, group->first_channel+i);
+	}
+	// generate all channels in time slices, and tell the main thread how far the group is
+	enum { chunk = 256 };
+	tdc_timed_hit_t hits[chunk];
+	tdc_timed_hit_t carry[64];
+	int has_carry[64] = {0};
+	const double slice = 50*st->event_gap_ps;
+	int running = group->n_channels;
+	for (double end = slice; running; end += slice) {
+		running = 0;
+		for (int i = 0; i < group->n_channels; ++i) {
+			int n = 0, more = 1;
+			if (has_carry[i]) {
+				if (carry[i].time_ps >= end) {
+					// nothing in this slice
+					more = 0;
+				} else {
+					hits[n++] = carry[i];
+					has_carry[i] = 0;
+				}
+			}
+			while (more) {
+				while (n < chunk && (more = generator_next(&gen[i], st, &hits[n]))) {
+					if (hits[n].time_ps >= end) {
+						carry[i] = hits[n];
+						has_carry[i] = 1;
+						more = 0;
+						break;
+					}
+					++n;
+				}
+				size_t taken = 0;
+				while (taken < (size_t)n) {
+					taken += tdc_event_builder_push(group->builder, i, &hits[taken], n-taken);
+				}
+				n = 0;
+			}
+			running += has_carry[i];
+			// later hits can be earlier than end by the jitter and by the order within a snapshot
+			tdc_event_builder_advance(group->builder, i, has_carry[i] ? end - 5000 - 2*st->jitter_ps : INFINITY);
+		}
+		ring_entry_t entry = { { tdc_event_builder_lower_bound(group->builder), 0, 0 }, 1 };
+		ring_put(group->ring, &entry);
+	}
+	tdc_event_builder_flush(group->builder);
+	ring_entry_t entry = { { INFINITY, 0, 0 }, 2 };
+	ring_put(group->ring, &entry);
+	free(gen);
+	return NULL;
+}
+
+typedef struct selftest_result {
+	uint64_t events, complete_events, hits, errors;
+	double last_time;
+} selftest_result_t;
+
+void check_event(void *user, const tdc_event_t *event)
+{
+	selftest_result_t *result = (selftest_result_t*)user;
+	++result->events;
+	result->hits += event->n_hits + event->truncated;
+	if (event->multiplicity == 0 || event->time_ps < result->last_time) {
+		if (result->errors++ < 10) {
+			fprintf(stderr, "event at %.1f ps comes after %.1f ps\n", event->time_ps, result->last_time);
+		}
+	}
+	for (int h = 1; h < event->n_hits; ++h) {
+		if (event->hits[h].time_ps < event->hits[h-1].time_ps && result->errors++ < 10) {
+			fprintf(stderr, "hits of event at %.1f ps not in order\n", event->time_ps);
+		}
+	}
+	result->last_time = event->hits[event->n_hits-1].time_ps;
+}
+
+int selftest(tdc_event_builder_config_t *config, const selftest_config_t *st, int quiet)
+{
+	if (st->channels < 1 || st->channels > 256 || st->groups < 1 || st->channels%st->groups != 0 || st->channels/st->groups > 64) {
+		fprintf(stderr, "selftest needs at most 256 channels, divided into groups of at most 64 channels\n");
+		return -1;
+	}
+	// the top level gets merged streams, no reordering needed
+	tdc_event_builder_config_t top_config = *config;
+	top_config.inputs     = st->groups;
+	top_config.reorder_ps = 0;
+	selftest_result_t result;
+	memset(&result, 0, sizeof(result));
+	result.last_time = -INFINITY;
+	// count complete events: multiplicity equal to all channels
+	tdc_event_builder_t *top = tdc_event_builder_create(&top_config, check_event, &result);
+	if (top == NULL) {
+		return -1;
+	}
+	group_t *groups = (group_t*)calloc(st->groups, sizeof(group_t));
+	pthread_t *threads = (pthread_t*)calloc(st->groups, sizeof(pthread_t));
+	for (int g = 0; g < st->groups; ++g) {
+		group_t *group = &groups[g];
+		group->st            = st;
+		group->n_channels    = st->channels/st->groups;
+		group->first_channel = g*group->n_channels;
+		group->ring          = (ring_t*)aligned_alloc(_Alignof(ring_t), sizeof(ring_t));
+		group->config        = *config;
+		group->config.inputs       = group->n_channels;
+		group->config.window_ps    = 0;
+		group->config.min_channels = 1;
+		group->builder = tdc_event_builder_create(&group->config, group_hit, group);
+		if (group->ring == NULL || group->builder == NULL) {
+			return -1;
+		}
+		uart_wbp_queue_init(&group->ring->queue, group->ring->entry, ring_depth, sizeof(ring_entry_t));
+		group->ring->n_pending = 0;
+	}
+	double t0 = now_s();
+	for (int g = 0; g < st->groups; ++g) {
+		pthread_create(&threads[g], NULL, group_thread, &groups[g]);
+	}
+	// take what is there from each ring, keep a hit that doesn't fit for the next turn
+	int running = st->groups;
+	while (running) {
+		int idle = 1;
+		for (int g = 0; g < st->groups; ++g) {
+			uart_wbp_queue_t *queue = &groups[g].ring->queue;
+			size_t n, taken = 0;
+			const ring_entry_t *entries = (const ring_entry_t*)uart_wbp_queue_read_ptr(queue, &n);
+			idle &= (n == 0);
+			for (; taken < n; ++taken) {
+				const ring_entry_t *entry = &entries[taken];
+				if (entry->type == 1) {
+					tdc_event_builder_advance(top, g, entry->hit.time_ps);
+				} else if (entry->type == 2) {
+					tdc_event_builder_finish(top, g);
+					--running;
+				} else if (tdc_event_builder_push(top, g, &entry->hit, 1) == 0) {
+					break;
+				}
+			}
+			uart_wbp_queue_release(queue, taken);
+		}
+		if (idle) {
+			sched_yield();
+		}
+	}
+	tdc_event_builder_flush(top);
+	double dt = now_s() - t0;
+
+	uint64_t hits_in = 0, late = 0;
+	for (int g = 0; g < st->groups; ++g) {
+		pthread_join(threads[g], NULL);
+		hits_in += groups[g].builder->hits_in;
+		late    += groups[g].builder->late_hits;
+		tdc_event_builder_destroy(groups[g].builder);
+		free(groups[g].ring);
+	}
+	late += top->late_hits;
+	if (late || top->hits_out != hits_in) {
+		fprintf(stderr, "%llu hits generated, %llu merged, %llu late\n", (unsigned long long)hits_in,
+			(unsigned long long)top->hits_out, (unsigned long long)late);
+		++result.errors;
+	}
+	if (!quiet || result.errors) {
+		print_summary(top, dt);
+	}
+	// noise hits can start an event early and cut it, but most events must be found
+	if (top->events < 0.95*st->events) {
+		fprintf(stderr, "found %llu of %ld events\n", (unsigned long long)top->events, st->events);
+		++result.errors;
+	}
+	printf("selftest: %llu events, %llu errors\n", (unsigned long long)top->events, (unsigned long long)result.errors);
+	tdc_event_builder_destroy(top);
+	free(groups);
+	free(threads);
+	return result.errors ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+	tdc_event_builder_config_t config = {
+		.inputs           = 0,
+		.reorder_capacity = 1024,
+		.reorder_ps       = 10000,
+		.window_ps        = 1000,
+		.min_channels     = 2,
+		.max_event_hits   = 1024,
+	};
+	selftest_config_t st = {
+		.events       = 0,
+		.channels     = 16,
+		.groups       = 4,
+		.event_gap_ps = 100000,
+		.noise_gap_ps = 1000000,
+		.jitter_ps    = 100,
+	};
+	int quiet = 0;
+	int first_file = argc;
+	for (int i = 1; i < argc; ++i) {
+		double value;
+		if (strcmp(argv[i],"-q") == 0) {
+			quiet = 1;
+			continue;
+		} else if (strcmp(argv[i],"--help") == 0) {
+			print_help(argv[0]);
+			return 0;
+		} else if (argv[i][0] != '-') {
+			first_file = i;
+			break;
+		} else if (strlen(argv[i]) != 2 || strchr("wrmsng", argv[i][1]) == NULL) {
+			fprintf(stderr, "unkown command line option: %s\n", argv[i]);
+			return -1;
+		}
+		if (++i >= argc || sscanf(argv[i], "%lf", &value) != 1) {
+			fprintf(stderr, "expect number after option %s\n", argv[i-1]);
+			return -1;
+		}
+		switch (argv[i-1][1]) {
+			case 'w': config.window_ps    = value; break;
+			case 'r': config.reorder_ps   = value; break;
+			case 'm': config.min_channels = value; break;
+			case 's': st.events           = value; break;
+			case 'n': st.channels         = value; break;
+			case 'g': st.groups           = value; break;
+		}
+	}
+
+	if (st.events > 0) {
+		return selftest(&config, &st, quiet);
+	}
+	config.inputs = argc - first_file;
+	if (config.inputs < 1) {
+		print_help(argv[0]);
+		return -1;
+	}
+	return merge_files(&config, &argv[first_file], quiet);
+}
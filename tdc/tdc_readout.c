@@ -0,0 +1,201 @@
+#include "../uart/uart_wbp_readout.h"
+#include "tdc_decoder.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+void print_help(const char* argv0){
+	fprintf(stderr, "usage: %s [options] <devicename> <adr>\n", argv0);
+	fprintf(stderr, " Read a tdc_wbp_readout at wishbone address <adr> continuously, decode the words, and show\n");
+	fprintf(stderr, " rates and FIFO overflows once per second. Stops after -t seconds or with Ctrl-C.\n");
+	fprintf(stderr, " options are\n");
+	fprintf(stderr, " -w <bits>         : word_width generic of tdc_wbp_readout (default is 16)\n");
+	fprintf(stderr, " -l <taps>         : line length (default is 64)\n");
+	fprintf(stderr, " -c <bits>         : coarse counter bits per record (default is 64)\n");
+	fprintf(stderr, " -m <taps>         : drop hits with fine >= taps (default is 0, keep all)\n");
+	fprintf(stderr, " -o <file>         : write the words to a capture file for tdc_decode\n");
+	fprintf(stderr, " -t <seconds>      : stop after this time (default is 0, run until Ctrl-C)\n");
+	fprintf(stderr, " -D <words>        : maximum number of words per poll (default is %d)\n", UART_WBP_READOUT_MAX_DEPTH);
+	fprintf(stderr, " -T <milliseconds> : give up if the device does not respond in time (default is 2000)\n");
+	fprintf(stderr, " -r                : enable RTS/CTS hardware flow control\n");
+	fprintf(stderr, " -q                : don't show rates\n");
+	fprintf(stderr, " -v                : verbose output\n");
+}
+
+double now_s()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + 1e-9*t.tv_nsec;
+}
+
+volatile sig_atomic_t stop = 0;
+void handle_sigint(int signum)
+{
+	(void)signum;
+	stop = 1;
+}
+
+void show_rates(const uart_wbp_readout_t *readout, const tdc_decoder_t *decoder, uint64_t words, uint64_t hits, double dt, int final)
+{
+	fprintf(stderr, "\r%8.0f words/s %8.0f hits/s, %llu lost records, %llu lost words, %llu full polls, depth %4d, max fill %5d",
+		words/dt, hits/dt, (unsigned long long)readout->lost_records, (unsigned long long)readout->lost_words, (unsigned long long)readout->full_polls,
+		readout->depth, readout->max_fill);
+	if (final) {
+		fprintf(stderr, "\n%llu polls, %llu words (%llu invalid), %llu records, %llu hits, %.0f words/s\n",
+			(unsigned long long)readout->polls, (unsigned long long)readout->words, (unsigned long long)readout->invalid_words,
+			(unsigned long long)decoder->records, (unsigned long long)decoder->hits, uart_wbp_readout_rate(readout));
+	}
+}
+
+int main(int argc, char **argv) {
+	tdc_decoder_config_t config = {
+		.line_length   = 64,
+		.coarse_bits   = 64,
+		.word_width    = 16,
+		.coarse_offset = 2,
+		.bubble_width  = 2,
+		.max_fine      = 0,
+		.channel       = 0,
+	};
+	const char *device_name = NULL;
+	const char *capture_name = NULL;
+	uint32_t adr = 0;
+	int adr_set = 0;
+	double duration = 0;
+	int max_depth = UART_WBP_READOUT_MAX_DEPTH;
+	int timeout_ms = 2000;
+	int rtscts = 0;
+	int quiet = 0;
+	int verbose = 0;
+
+	for (int i = 1; i < argc; ++i) {
+		int *value = NULL;
+		if      (strcmp(argv[i],"-w") == 0) value = &config.word_width;
+		else if (strcmp(argv[i],"-l") == 0) value = &config.line_length;
+		else if (strcmp(argv[i],"-c") == 0) value = &config.coarse_bits;
+		else if (strcmp(argv[i],"-m") == 0) value = &config.max_fine;
+		else if (strcmp(argv[i],"-D") == 0) value = &max_depth;
+		else if (strcmp(argv[i],"-T") == 0) value = &timeout_ms;
+		else if (strcmp(argv[i],"-o") == 0) {
+			if (++i >= argc) {
+				fprintf(stderr, "expect file name after option -o\n");
+				return -1;
+			}
+			capture_name = argv[i];
+			continue;
+		} else if (strcmp(argv[i],"-t") == 0) {
+			if (++i >= argc || sscanf(argv[i], "%lf", &duration) != 1) {
+				fprintf(stderr, "expect number after option -t\n");
+				return -1;
+			}
+			continue;
+		} else if (strcmp(argv[i],"-r") == 0) {
+			rtscts = 1;
+			continue;
+		} else if (strcmp(argv[i],"-q") == 0) {
+			quiet = 1;
+			continue;
+		} else if (strcmp(argv[i],"-v") == 0) {
+			verbose = 1;
+			continue;
+		} else if (strcmp(argv[i],"--help") == 0) {
+			print_help(argv[0]);
+			return 0;
+		} else if (argv[i][0] != '-' && device_name == NULL) {
+			device_name = argv[i];
+			continue;
+		} else if (argv[i][0] != '-' && !adr_set) {
+			sscanf(argv[i], "%x", &adr);
+			adr_set = 1;
+			continue;
+		} else {
+			fprintf(stderr, "unkown command line option: %s\n", argv[i]);
+			return -1;
+		}
+		if (++i >= argc || sscanf(argv[i], "%d", value) != 1) {
+			fprintf(stderr, "expect integer value after option %s\n", argv[i-1]);
+			return -1;
+		}
+	}
+	if (device_name == NULL || !adr_set) {
+		print_help(argv[0]);
+		return -1;
+	}
+
+	tdc_decoder_t *decoder = tdc_decoder_create(&config);
+	if (decoder == NULL) {
+		return 2;
+	}
+	FILE *capture = NULL;
+	if (capture_name != NULL && (capture = fopen(capture_name, "wb")) == NULL) {
+		perror(capture_name);
+		return 2;
+	}
+	uart_wbp_device_t *device = uart_wbp_open(device_name, B2000000, verbose);
+	if (!device) {
+		fprintf(stderr,"cannot open device \"%s\"\n", device_name);
+		return 2;
+	}
+	if (rtscts && uart_wbp_set_flow_control(device, 1) < 0) {
+		fprintf(stderr,"cannot enable flow control on device \"%s\"\n", device_name);
+		return 2;
+	}
+	uart_wbp_set_timeout(device, timeout_ms);
+	uart_wbp_readout_t *readout = uart_wbp_readout_create(device, adr, config.word_width, 1<<16);
+	if (readout == NULL) {
+		return 2;
+	}
+	uart_wbp_readout_set_depth(readout, 8, max_depth);
+	signal(SIGINT, handle_sigint);
+
+	enum { max_hits = 1<<16 };
+	static tdc_hit_t hits[max_hits];
+	static uint8_t bytes[4<<16];
+	const int bytes_per_word = (config.word_width+7)/8;
+	double t_start = now_s(), t_show = t_start;
+	uint64_t words_shown = 0, hits_shown = 0;
+	int result = 0;
+	while (!stop && (duration <= 0 || now_s()-t_start < duration)) {
+		uart_wbp_response_t response = uart_wbp_readout_poll(readout);
+		if (response != ack) {
+			fprintf(stderr, "\npoll failed: %s\n", uart_wbp_response_str(response));
+			result = 1;
+			break;
+		}
+		// decode directly from the buffer of the readout
+		size_t n_words, n_hits;
+		const uint32_t *words = uart_wbp_readout_peek(readout, &n_words);
+		size_t consumed = tdc_decoder_decode32(decoder, words, n_words, hits, max_hits, &n_hits);
+		if (capture != NULL) {
+			size_t n = 0;
+			for (size_t w = 0; w < consumed; ++w) {
+				for (int b = bytes_per_word-1; b >= 0; --b) {
+					bytes[n++] = words[w] >> (8*b);
+				}
+			}
+			fwrite(bytes, 1, n, capture);
+		}
+		uart_wbp_readout_consume(readout, consumed);
+
+		double now = now_s();
+		if (!quiet && now - t_show >= 1) {
+			show_rates(readout, decoder, readout->words-words_shown, decoder->hits-hits_shown, now-t_show, 0);
+			words_shown = readout->words;
+			hits_shown  = decoder->hits;
+			t_show = now;
+		}
+	}
+	double now = now_s();
+	show_rates(readout, decoder, readout->words-words_shown, decoder->hits-hits_shown, now > t_show ? now-t_show : 1, 1);
+	if (capture != NULL) {
+		fclose(capture);
+	}
+	uart_wbp_readout_destroy(readout);
+	uart_wbp_close(device);
+	tdc_decoder_destroy(decoder);
+	return result;
+}
@@ -0,0 +1,129 @@
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+use work.wbp_pkg.all;
+
+-- Wishbone (pipelined) access to the serializer output of a tdc channel.
+-- The registers are selected by adr(11 downto 2):
+--   0    : status, bits 15..0 fill level in words (saturating), bit 30 full, bit 31 empty
+--   1    : bits 15..0 number of records that were lost because the serializer was full (wrapping),
+--          a write clears it
+--   2..  : data window, each read pops one word if the serializer is not empty.
+--          bit 31 is '1' if the word is valid, bits word_width-1..0 are the word.
+-- Reading past the end of the data is harmless (the words have bit 31 = '0'), so the host
+-- can read the status, the lost counter, and a guess of the fill level in one burst from adr 0.
+-- All information is in bytes 0, 1 and 3, so a host with word_width <= 16 can read with sel "1011".
+-- Strobes are acked in the clock cycle after the strobe and never stall.
+entity tdc_wbp_readout is
+  generic (
+    record_width : integer;      -- width of d_i, e.g. coarse counter & delay line snapshot
+    word_width   : integer := 16; -- at most 31, must divide record_width
+    depth        : integer := 6   -- the serializer holds 2**depth records
+  );
+  port (
+    clk_i, rst_i : in  std_logic;
+    push_i       : in  std_logic;
+    d_i          : in  std_logic_vector(record_width-1 downto 0);
+    full_o       : out std_logic;
+
+    slave_i      : in  t_wbp_slave_in;
+    slave_o      : out t_wbp_slave_out
+  );
+end entity;
+
+architecture rtl of tdc_wbp_readout is
+  constant words_per_record : integer := record_width/word_width;
+  constant max_fill         : integer := 2**depth*words_per_record;
+
+  signal push, pop     : std_logic;
+  signal full, empty   : std_logic;
+  signal q             : std_logic_vector(word_width-1 downto 0);
+  signal fill          : integer range 0 to max_fill := 0;
+  signal lost          : unsigned(15 downto 0) := (others => '0');
+  signal read_data     : boolean;
+  signal ack           : std_logic := '0';
+  signal dat           : t_wbp_dat := (others => '0');
+begin
+
+  serializer: entity work.serializer
+    generic map (
+      in_width  => record_width,
+      out_width => word_width,
+      depth     => depth
+    )
+    port map (
+      clk_i   => clk_i,
+      rst_i   => rst_i,
+      push_i  => push,
+      pop_i   => pop,
+      full_o  => full,
+      empty_o => empty,
+      d_i     => d_i,
+      q_o     => q
+    );
+
+  -- the fifo must not be pushed when it is full
+  push   <= push_i and not full;
+  full_o <= full;
+
+  read_data <= slave_i.cyc = '1' and slave_i.stb = '1' and slave_i.we = '0'
+               and unsigned(slave_i.adr(11 downto 2)) >= 2;
+  pop <= '1' when read_data and empty = '0' else '0';
+
+  main: process (clk_i)
+    variable next_fill : integer range -1 to max_fill+words_per_record;
+  begin
+    if rising_edge(clk_i) then
+      if rst_i = '1' then
+        fill <= 0;
+        lost <= (others => '0');
+        ack  <= '0';
+      else
+        next_fill := fill;
+        if push = '1' then
+          next_fill := next_fill + words_per_record;
+        end if;
+        if pop = '1' then
+          next_fill := next_fill - 1;
+        end if;
+        fill <= next_fill;
+
+        ack <= slave_i.cyc and slave_i.stb;
+        if slave_i.cyc = '1' and slave_i.stb = '1' then
+          dat <= (others => '0');
+          case to_integer(unsigned(slave_i.adr(11 downto 2))) is
+            when 0 =>
+              if fill > 65535 then
+                dat(15 downto 0) <= (others => '1');
+              else
+                dat(15 downto 0) <= std_logic_vector(to_unsigned(fill, 16));
+              end if;
+              dat(30)          <= full;
+              dat(31)          <= empty;
+            when 1 =>
+              dat(15 downto 0) <= std_logic_vector(lost);
+            when others =>
+              if empty = '0' then
+                dat(31)                    <= '1';
+                dat(word_width-1 downto 0) <= q;
+              end if;
+          end case;
+        end if;
+
+        if slave_i.cyc = '1' and slave_i.stb = '1' and slave_i.we = '1' and unsigned(slave_i.adr(11 downto 2)) = 1 then
+          lost <= (others => '0');
+        elsif push_i = '1' and full = '1' then
+          lost <= lost + 1;
+        end if;
+      end if;
+    end if;
+  end process;
+
+  slave_o.ack   <= ack;
+  slave_o.err   <= '0';
+  slave_o.rty   <= '0';
+  slave_o.stall <= '0';
+  slave_o.dat   <= dat;
+
+end architecture;
@@ -0,0 +1,170 @@
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+use ieee.math_real.all;
+
+use work.wbp_pkg.all;
+
+-- Records are pushed into a tdc_wbp_readout at random, faster than they are read, so that the
+-- serializer runs full and records are lost. Record k is the k-th record that was accepted
+-- (k & not k, 64 bits in 16 bit words). A wishbone master polls like uart_wbp_readout_poll:
+-- a burst from adr 0 with the status, the lost counter and g_depth data words, and checks that
+-- the valid words arrive in order. At the end the serializer must be empty, the lost counter
+-- must match the rejected pushes, and a write must clear it.
+entity tdc_wbp_readout_tb is
+  generic (
+    g_records : integer := 500;
+    g_rate    : real    := 0.3;  -- push probability per clock cycle
+    g_depth   : integer := 8     -- data words per poll
+  );
+end entity;
+
+architecture simulation of tdc_wbp_readout_tb is
+  constant clk_period   : time    := 10 ns;
+  constant record_width : integer := 64;
+  constant word_width   : integer := 16;
+  constant words        : integer := record_width/word_width;
+
+  signal clk   : std_logic := '1';
+  signal rst   : std_logic := '1';
+  signal done  : boolean   := false;
+
+  signal push  : std_logic := '0';
+  signal d     : std_logic_vector(record_width-1 downto 0) := (others => '0');
+  signal full  : std_logic;
+  signal wbp   : t_wbp := c_wbp_init;
+
+  signal rejected : natural := 0; -- pushes while the readout was full
+
+  function record_word(k, w : natural) return std_logic_vector is
+    variable r : std_logic_vector(record_width-1 downto 0);
+  begin
+    r := std_logic_vector(to_unsigned(k, 32)) & not std_logic_vector(to_unsigned(k, 32));
+    return r(record_width-1-w*word_width downto record_width-(w+1)*word_width);
+  end function;
+begin
+
+  clk <= not clk after clk_period/2 when not done;
+  rst <= '0' after clk_period*5;
+
+  dut: entity work.tdc_wbp_readout
+    generic map (
+      record_width => record_width,
+      word_width   => word_width,
+      depth        => 3
+    )
+    port map (
+      clk_i   => clk,
+      rst_i   => rst,
+      push_i  => push,
+      d_i     => d,
+      full_o  => full,
+      slave_i => wbp.mosi,
+      slave_o => wbp.miso
+    );
+
+  producer: process
+    variable seed1 : positive := 1;
+    variable seed2 : positive := 2;
+    variable x     : real;
+    variable k     : natural := 0;
+  begin
+    wait until rising_edge(clk);
+    if rst = '0' then
+      -- the readout sees the same push and full as this process
+      if push = '1' then
+        if full = '0' then
+          k := k+1;
+        else
+          rejected <= rejected + 1;
+        end if;
+      end if;
+      push <= '0';
+      uniform(seed1, seed2, x);
+      if k < g_records and x < g_rate then
+        push <= '1';
+        d    <= std_logic_vector(to_unsigned(k, 32)) & not std_logic_vector(to_unsigned(k, 32));
+      end if;
+    end if;
+  end process;
+
+  poller: process
+    type t_dat_array is array(0 to g_depth+1) of t_wbp_dat;
+    variable seed1    : positive := 3;
+    variable seed2    : positive := 4;
+    variable x        : real;
+    variable dat      : t_dat_array;
+    variable word_idx : natural := 0; -- valid words so far
+    variable invalid  : natural := 0;
+    variable polls    : natural := 0;
+    variable mosi     : t_wbp_master_out := c_wbp_master_out_init;
+
+    -- n pipelined strobes from adr (one per clock cycle), the responses go to dat
+    procedure burst(adr : natural; n : natural; we : std_logic) is
+      variable stbs, acks : natural := 0;
+    begin
+      while acks < n loop
+        wait until rising_edge(clk);
+        if wbp.miso.ack = '1' then
+          dat(acks) := wbp.miso.dat;
+          acks := acks+1;
+        end if;
+        assert wbp.miso.err = '0' and wbp.miso.rty = '0' and wbp.miso.stall = '0'
+          report "unexpected err, rty or stall" severity failure;
+        mosi.cyc := '1';
+        mosi.stb := '0';
+        if stbs < n then
+          mosi.stb := '1';
+          mosi.we  := we;
+          mosi.sel := "1011";
+          mosi.adr := std_logic_vector(to_unsigned(adr+4*stbs, 32));
+          mosi.dat := (others => '0');
+          stbs := stbs+1;
+        end if;
+        wbp.mosi <= mosi;
+      end loop;
+      mosi.cyc := '0';
+      wbp.mosi <= mosi;
+    end procedure;
+  begin
+    wait until rst = '0';
+    while word_idx < words*g_records loop
+      burst(0, g_depth+2, '0');
+      polls := polls+1;
+      for i in 2 to g_depth+1 loop
+        if dat(i)(31) = '1' then
+          assert dat(i)(word_width-1 downto 0) = record_word(word_idx/words, word_idx mod words)
+            report "word " & integer'image(word_idx) & " is wrong" severity failure;
+          word_idx := word_idx+1;
+        else
+          invalid := invalid+1;
+        end if;
+      end loop;
+      -- wait a random time before the next poll
+      uniform(seed1, seed2, x);
+      for i in 1 to integer(trunc(x*real(4*g_depth))) loop
+        wait until rising_edge(clk);
+      end loop;
+    end loop;
+
+    -- the producer has stopped, nothing is left and the lost counter is complete
+    burst(0, 2, '0');
+    assert dat(0)(31) = '1' and unsigned(dat(0)(15 downto 0)) = 0
+      report "serializer not empty at the end" severity failure;
+    assert to_integer(unsigned(dat(1)(15 downto 0))) = rejected mod 2**16
+      report "lost counter " & integer'image(to_integer(unsigned(dat(1)(15 downto 0)))) &
+             ", expect " & integer'image(rejected) severity failure;
+    assert rejected > 0
+      report "no record was lost, increase g_rate" severity failure;
+    -- a write clears the lost counter
+    burst(4, 1, '1');
+    burst(4, 1, '0');
+    assert unsigned(dat(0)(15 downto 0)) = 0
+      report "lost counter not cleared" severity failure;
+
+    report integer'image(polls) & " polls, " & integer'image(word_idx) & " words, " &
+           integer'image(invalid) & " invalid, " & integer'image(rejected) & " lost records";
+    done <= true;
+    wait;
+  end process;
+end architecture;
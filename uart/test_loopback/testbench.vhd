@@ -5,6 +5,16 @@ use ieee.numeric_std.all;
 use work.wbp_pkg.all;
 
 entity testbench is
+	generic (
+		-- false: run without a host on the pseudo terminal (e.g. to measure the simulation speed)
+		g_wait_until_connected : boolean := true;
+		-- > 0: the bridge uses wbta_wbp_master_pipelined with up to 2**g_master_depth open strobes
+		g_master_depth         : integer := 0;
+		-- true: the simulated host honors the RTS output of the bridge (RTS/CTS flow control), 
+		-- false: bytes that do not fit into the receive FIFO of the bridge are lost, like with a 
+		-- host that has flow control disabled
+		g_honor_cts            : boolean := false
+	);
 end entity;
 
 architecture simulation of testbench is
@@ -21,6 +31,8 @@ architecture simulation of testbench is
 	-- serial data
 	signal chip_tx_to_fpga_rx : std_logic := '1';
 	signal fpga_tx_to_chip_rx : std_logic := '1';
+	signal fpga_rts_to_chip_cts : std_logic := '1';
+	signal chip_cts             : std_logic := '1';
 
 	-- wishbone
 	signal wbp : t_wbp := c_wbp_init;
@@ -36,19 +48,24 @@ begin
 	clk <= not clk after c_clk_period/2;
 	rst <=     '0' after c_clk_period*5;
 
+	chip_cts <= fpga_rts_to_chip_cts when g_honor_cts else '1';
+
 	uart_chip: entity work.uart_chipsim
 	generic map(
-		g_baud_rate => c_baud_rate
+		g_wait_until_connected => g_wait_until_connected,
+		g_baud_rate            => c_baud_rate
 	)
 	port map (
-		tx_o => chip_tx_to_fpga_rx,
-		rx_i => fpga_tx_to_chip_rx
+		tx_o  => chip_tx_to_fpga_rx,
+		rx_i  => fpga_tx_to_chip_rx,
+		cts_i => chip_cts
 	);
 
 	master: entity work.uart_wbp
 	generic map (
-		g_clk_freq  => c_clk_freq,
-		g_baud_rate => c_baud_rate
+		g_clk_freq     => c_clk_freq,
+		g_baud_rate    => c_baud_rate,
+		g_master_depth => g_master_depth
 	)
 	port map (
 		clk_i    => clk,
@@ -57,6 +74,7 @@ begin
 		-- serial lines 
 		rx_i     => chip_tx_to_fpga_rx,
 		tx_o     => fpga_tx_to_chip_rx,
+		rts_o    => fpga_rts_to_chip_cts,
 
 		-- wishbone master
 		master_o => wbp.mosi,
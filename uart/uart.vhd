@@ -220,13 +220,18 @@ use ieee.std_logic_1164.all;
 use ieee.numeric_std.all;
 
 -- a wrapper for uart_rx that has a stall input
--- and buffers the last received value as long as
--- this stall input is asserted
+-- and buffers up to g_depth received values as long as
+-- this stall input is asserted.
+-- rts_o is '1' as long as more than g_rts_margin values 
+-- can be buffered. It can drive the (inverted) RTS line
+-- for hardware flow control.
 entity uart_rx_buffer is
 	generic (
-		g_clk_freq  : integer := 12000000;
-		g_baud_rate : integer := 9600;
-		g_bits      : integer := 8
+		g_clk_freq   : integer := 12000000;
+		g_baud_rate  : integer := 9600;
+		g_bits       : integer := 8;
+		g_depth      : integer := 1;
+		g_rts_margin : integer := 0
 	);
 	port (
 		clk_i   :  in std_logic;
@@ -234,6 +239,8 @@ entity uart_rx_buffer is
 		dat_o   : out std_logic_vector(g_bits-1 downto 0);
 		stb_o   : out std_logic;
 		stall_i :  in std_logic;
+		-- flow control
+		rts_o   : out std_logic;
 		-- serial 
 		rx_i    :  in std_logic
 	);	
@@ -241,9 +248,13 @@ end entity;
 
 architecture rtl of uart_rx_buffer is
 	signal dat       : std_logic_vector(g_bits-1 downto 0) := (others => '0');
-	signal buf       : std_logic_vector(g_bits-1 downto 0) := (others => '0');
-	signal buf_valid : std_logic := '0';
 	signal stb       : std_logic := '0';
+
+	type t_buf is array(0 to g_depth-1) of std_logic_vector(g_bits-1 downto 0);
+	signal buf       : t_buf := (others => (others => '0'));
+	signal rd_idx    : integer range 0 to g_depth-1 := 0;
+	signal wr_idx    : integer range 0 to g_depth-1 := 0;
+	signal fill      : integer range 0 to g_depth := 0;
 begin
 
 	wrapped_rx: entity work.uart_rx 
@@ -253,25 +264,37 @@ begin
 			     stb_o => stb,
 			     rx_i  => rx_i);
 
-	dat_o <= buf;
-	stb_o <= buf_valid;
+	dat_o <= buf(rd_idx);
+	stb_o <= '1' when fill > 0 else '0';
+	rts_o <= '1' when fill < g_depth-g_rts_margin else '0';
 
 	process
+		variable pop  : boolean;
+		variable push : boolean;
 	begin
 		wait until rising_edge(clk_i);
-		if stb = '1' then
-			if buf_valid = '1' and stall_i = '1' then
-				assert false report "UART receiver overflow" severity failure; 
-				               -- In this case one uart value is dropped
-				               -- This condition should be prevented by the host
-				               -- by not sending the serial bytes too fast
-			end if;
-			buf       <= dat;
-			buf_valid <= '1';
-		elsif buf_valid = '1' and stall_i = '0' then
-			buf_valid <= '0';
+		pop  := fill > 0 and stall_i = '0';
+		push := stb = '1';
+		if push and fill = g_depth and not pop then
+			assert false report "UART receiver overflow" severity failure; 
+			               -- In this case one uart value is dropped
+			               -- This condition should be prevented by the host
+			               -- by not sending the serial bytes too fast 
+			               -- (or by hardware flow control, see rts_o)
+			push := false;
+		end if;
+		if push then
+			buf(wr_idx) <= dat;
+			wr_idx      <= (wr_idx + 1) mod g_depth;
+		end if;
+		if pop then
+			rd_idx      <= (rd_idx + 1) mod g_depth;
+		end if;
+		if push and not pop then
+			fill <= fill + 1;
+		elsif pop and not push then
+			fill <= fill - 1;
 		end if;
-
 	end process;
 
 end architecture;
@@ -64,7 +64,9 @@ entity uart_chipsim is
     );
   port (
     tx_o : out std_logic;
-    rx_i :  in std_logic
+    rx_i :  in std_logic;
+    -- hardware flow control: no bytes are sent while cts_i is '0'
+    cts_i :  in std_logic := '1'
   );
 end entity;
 
@@ -147,7 +149,7 @@ begin
 
         -- provide value to simulation
         tx_stb <= '0';
-        if value_from_file >= 0 and tx_stall = '0' then 
+        if value_from_file >= 0 and tx_stall = '0' and cts_i = '1' then 
           tx_dat <= std_logic_vector(to_signed(value_from_file,8));
           tx_stb <= '1';
           value_from_file <= -1;
@@ -7,6 +7,7 @@ void print_help(const char* argv0){
 	fprintf(stderr, " options are\n");
 	fprintf(stderr, " -h                : enable host response message to writes\n");
 	fprintf(stderr, " -d                : disable device response message to writes\n");
+	fprintf(stderr, " -D                : enable delta write frames for slave writes\n");
 	fprintf(stderr, " -s <sel>          : set select bits (default is 0xf) \n");
 	fprintf(stderr, " -g <gpo>          : set general purpose output bits \n");
 	fprintf(stderr, " -w <milliseconds> : wait after device access\n");
@@ -14,6 +15,8 @@ void print_help(const char* argv0){
 	fprintf(stderr, " -a                : show write access data in ASCII while listening\n");
 	fprintf(stderr, " -t <timeout>      : set stall timeout value in clock cycles\n");
 	fprintf(stderr, "                     set to 0 to disable, default is 1000\n");
+	fprintf(stderr, " -T <milliseconds> : give up if the device does not respond in time\n");
+	fprintf(stderr, " -r                : enable RTS/CTS hardware flow control\n");
 	fprintf(stderr, " -x                : don\'t prepend hex output with 0x verbose output\n");
 	fprintf(stderr, " -v                : verbose output\n");
 
@@ -38,6 +41,8 @@ int main(int argc, char **argv) {
 	uint32_t dat, dat_set = 0;
 	uint8_t  sel = 0xf;
 	int timeout = 1000;
+	int timeout_ms = -1;
+	int rtscts = 0;
 	int wait_ms = -1;
 	int verbose = 0;
 	int listen = 0;
@@ -62,6 +67,11 @@ int main(int argc, char **argv) {
 			if (verbose) {
 				printf("disable device write response\n");
 			}
+		} else if (strcmp(argv[i],"-D") == 0) {
+			bridge_config |= (delta_slave_writes);
+			if (verbose) {
+				printf("enable delta slave writes\n");
+			}
 		} else if (strcmp(argv[i],"-t") == 0) {
 			if (++i < argc) {
 				sscanf(argv[i], "%d", &timeout);
@@ -72,6 +82,21 @@ int main(int argc, char **argv) {
 				fprintf(stderr, "expect integer value after option -t\n");
 				return -1;
 			}
+		} else if (strcmp(argv[i],"-T") == 0) {
+			if (++i < argc) {
+				sscanf(argv[i], "%d", &timeout_ms);
+				if (verbose) {
+					printf("set response timeout to %d ms\n", timeout_ms);
+				}
+			} else {
+				fprintf(stderr, "expect integer value after option -T\n");
+				return -1;
+			}
+		} else if (strcmp(argv[i],"-r") == 0) {
+			rtscts = 1;
+			if (verbose) {
+				printf("enable hardware flow control\n");
+			}
 		} else if (strcmp(argv[i],"-s") == 0) {
 			if (++i < argc) {
 				sscanf(argv[i], "%hhx", &sel);
@@ -150,14 +175,22 @@ int main(int argc, char **argv) {
 		return 2;
 	}
 
-	if (timeout >= 0) {
-		uart_wbp_set_stall_timeout(device, timeout);
-	} 
-	uart_wbp_configure(device, bridge_config);
+	if (rtscts && uart_wbp_set_flow_control(device, 1) < 0) {
+		fprintf(stderr,"cannot enable flow control on device \"%s\"\n", device_name);
+		return 2;
+	}
+
+	uart_wbp_set_timeout(device, timeout_ms);
+	if ((timeout >= 0 && uart_wbp_set_stall_timeout(device, timeout) < 0) ||
+	    uart_wbp_configure(device, bridge_config) < 0) {
+		fprintf(stderr,"cannot configure the bridge\n");
+		return 2;
+	}
 	device->write_handler = &my_uart_wbp_slave_write_handler;
 
-	if (set_gpo) {
-		uart_wbp_set_gpo_bits(device, gpo);
+	if (set_gpo && uart_wbp_set_gpo_bits(device, gpo) < 0) {
+		fprintf(stderr,"cannot set the gpo bits\n");
+		return 2;
 	}
 
 
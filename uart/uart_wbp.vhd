@@ -9,13 +9,22 @@ use work.uart_pkg.all;
 entity uart_wbp is 
 generic (
 	g_clk_freq  : integer := 12000000;
-	g_baud_rate : integer := 9600);
+	g_baud_rate : integer := 9600;
+	-- number of received bytes that can be buffered before rts_o is deasserted 
+	g_rx_fifo_depth : integer := 16;
+	-- number of words that the host can put into the cache for reads through the slave interface
+	g_slave_cache_entries : integer := 4;
+	-- the wishbone master keeps up to 2**g_master_depth strobes open (wbta_wbp_master_pipelined),
+	-- 0 waits for the response of each strobe before the next one (wbta_wbp_master)
+	g_master_depth : integer := 0);
 port (
 	clk_i :  in std_logic;
 	rst_i :  in std_logic;
 	-- serial 
 	rx_i  :  in std_logic;
 	tx_o  : out std_logic;
+	-- hardware flow control: '1' if the host may send (the RTS pin is usually active low)
+	rts_o : out std_logic;
 	-- wishbone master
 	master_o : out t_wbp_master_out;
 	master_i :  in t_wbp_master_in;
@@ -37,6 +46,7 @@ architecture rtl of uart_wbp is
 	signal wbta_rsp    : t_wbta_response := c_wbta_response_init;
 	signal wbta_config : t_configuration := c_configuration_init;
 	signal wbta_stb_resp: t_wbp_response := c_wbp_response_init; 
+	signal slave_cache  : t_slave_cache_update := c_slave_cache_update_none;
 
 	signal rst : std_logic := '0';
 	signal bridge_reset : std_logic := '0';
@@ -46,14 +56,19 @@ begin
 	
 	rx: entity work.uart_rx_buffer
 	generic map (
-		g_clk_freq  => g_clk_freq,
-		g_baud_rate => g_baud_rate,
-		g_bits      => 8
+		g_clk_freq   => g_clk_freq,
+		g_baud_rate  => g_baud_rate,
+		g_bits       => 8,
+		g_depth      => g_rx_fifo_depth,
+		-- USB serial adapters can send a few more bytes after RTS is deasserted
+		g_rts_margin => g_rx_fifo_depth/4
 	)
 	port map (
 		clk_i   => clk_i,
 		-- uart serial interface
 		rx_i    => rx_i,
+		-- flow control
+		rts_o   => rts_o,
 		-- parallel interface
 		dat_o   => rx_parallel.dat,
 		stb_o   => rx_parallel.stb,
@@ -113,6 +128,10 @@ begin
 	--);
 
 	uart_rx_to_wbta_req: entity work.uart_wbta
+	generic map (
+		-- an incomplete command is abandoned after 5 ms without a byte
+		g_command_timeout => g_clk_freq/200
+	)
 	port map (
 		clk_i    => clk_i,
 		rst_i    => rst,
@@ -128,6 +147,8 @@ begin
     	config_o     => wbta_config,
     	-- host response
     	stb_resp_o   => wbta_stb_resp,
+    	-- host commands for the slave cache
+    	slave_cache_o => slave_cache,
     	-- general purpose output bits
     	gpo_bits_o   => gpo_bits_o,
     	-- bridge reset initiated by host
@@ -148,35 +169,73 @@ begin
 		wbta_stall_o => wbta_rsp.stall
 	);
 
-	master: entity work.wbta_wbp_master
-	port map(
-		clk_i   => clk_i,
-		rst_i   => rst, 
-		-- this interface takes a strobe request
-		tract_i => wbta_req.dat,
-		stb_i   => wbta_req.stb,
-		stall_o => wbta_req.stall,
-		-- this interface delivers the strobe response
-		tract_o => wbta_rsp.dat,
-		stb_o   => wbta_rsp.stb,
-		stall_i => wbta_rsp.stall,
-		-- configuration of write behavior
-		config_write_response_i => wbta_config.fpga_sends_write_response,
-		-- a normal wishbone master
-		wb_cyc_o    => master_o.cyc,
-		wb_stb_o    => master_o.stb,
-		wb_we_o     => master_o.we,
-		wb_adr_o    => master_o.adr,
-		wb_dat_o    => master_o.dat,
-		wb_sel_o    => master_o.sel,
-		wb_stall_i  => master_i.stall,
-		wb_ack_i    => master_i.ack,
-		wb_err_i    => master_i.err,
-		wb_rty_i    => master_i.rty,
-		wb_dat_i    => master_i.dat
-	);
+	single_strobe_master: if g_master_depth = 0 generate
+		master: entity work.wbta_wbp_master
+		port map(
+			clk_i   => clk_i,
+			rst_i   => rst, 
+			-- this interface takes a strobe request
+			tract_i => wbta_req.dat,
+			stb_i   => wbta_req.stb,
+			stall_o => wbta_req.stall,
+			-- this interface delivers the strobe response
+			tract_o => wbta_rsp.dat,
+			stb_o   => wbta_rsp.stb,
+			stall_i => wbta_rsp.stall,
+			-- configuration of write behavior
+			config_write_response_i => wbta_config.fpga_sends_write_response,
+			-- a normal wishbone master
+			wb_cyc_o    => master_o.cyc,
+			wb_stb_o    => master_o.stb,
+			wb_we_o     => master_o.we,
+			wb_adr_o    => master_o.adr,
+			wb_dat_o    => master_o.dat,
+			wb_sel_o    => master_o.sel,
+			wb_stall_i  => master_i.stall,
+			wb_ack_i    => master_i.ack,
+			wb_err_i    => master_i.err,
+			wb_rty_i    => master_i.rty,
+			wb_dat_i    => master_i.dat
+		);
+	end generate;
+
+	pipelined_master: if g_master_depth > 0 generate
+		master: entity work.wbta_wbp_master_pipelined
+		generic map(
+			g_depth => g_master_depth
+		)
+		port map(
+			clk_i   => clk_i,
+			rst_i   => rst, 
+			-- this interface takes a strobe request
+			tract_i => wbta_req.dat,
+			stb_i   => wbta_req.stb,
+			stall_o => wbta_req.stall,
+			-- this interface delivers the strobe response
+			tract_o => wbta_rsp.dat,
+			stb_o   => wbta_rsp.stb,
+			stall_i => wbta_rsp.stall,
+			-- configuration of write behavior
+			config_write_response_i => wbta_config.fpga_sends_write_response,
+			-- a normal wishbone master
+			wb_cyc_o    => master_o.cyc,
+			wb_stb_o    => master_o.stb,
+			wb_we_o     => master_o.we,
+			wb_adr_o    => master_o.adr,
+			wb_dat_o    => master_o.dat,
+			wb_sel_o    => master_o.sel,
+			wb_stall_i  => master_i.stall,
+			wb_ack_i    => master_i.ack,
+			wb_err_i    => master_i.err,
+			wb_rty_i    => master_i.rty,
+			wb_dat_i    => master_i.dat
+		);
+	end generate;
 
 	slave: entity work.wb_uart
+	generic map (
+		g_cache_entries => g_slave_cache_entries
+	)
 	port map (
 		clk_i    => clk_i,
 		rst_i    => rst_i,
@@ -184,8 +243,11 @@ begin
     	bridge_reset_i => bridge_reset,
     	-- configuration
     	config_write_response_i => wbta_config.host_sends_write_response,
+    	config_delta_writes_i   => wbta_config.delta_slave_writes,
     	-- host response
     	stb_resp_i   => wbta_stb_resp,
+    	-- cache commands from host
+    	cache_i      => slave_cache,
 		-- uart transmitter interface
 		tx_dat_o   => tx_parallel_from_slave.dat,
 		tx_stb_o   => tx_parallel_from_slave.stb,
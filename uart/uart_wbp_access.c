@@ -89,20 +89,282 @@ enum uart_wbp_master_commands {
 	uart_wbp_master_response_rty        = 9,	
 	uart_wbp_master_command_set_gpo_bits=10,
 	uart_wbp_master_command_reset       =11,
+	uart_wbp_master_command_burst_write =12,
+	uart_wbp_master_command_burst_read  =13,
+	uart_wbp_master_command_slave_cache =14,
 };
 
-int reset_bridge_state(uart_wbp_device_t *device) {
-	uint8_t cmd_rst = uart_wbp_master_command_reset;
-	uint8_t reset_msg[] = {cmd_rst, cmd_rst, cmd_rst, cmd_rst, cmd_rst };
-	if (write(device->fd, reset_msg, sizeof(reset_msg)) != sizeof(reset_msg)) {
+// payload bits of the slave cache command
+#define UART_WBP_SLAVE_CACHE_FILL           0x10
+#define UART_WBP_SLAVE_CACHE_INVALIDATE     0x20
+#define UART_WBP_SLAVE_CACHE_INVALIDATE_ALL 0x40
+
+// header of the aggregated response to a burst read (a write response header with payload 5)
+#define UART_WBP_BURST_READ_HEADER 0x85
+
+// returned by uart_wbp_buffered_read and uart_wbp_write_all if the deadline passed
+#define UART_WBP_TIMEOUT -2
+
+int64_t uart_wbp_monotonic_ns() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec*1000000000 + now.tv_nsec;
+}
+
+// Set the deadline for the access that is about to start. Each public call does this once at 
+// its beginning, all phases of the call (writing the request, waiting for the responses, 
+// answering slave requests in between) share it.
+void uart_wbp_start_deadline(uart_wbp_device_t *device) {
+	device->deadline_ns = device->batch_deadline_ns;
+	if (device->timeout_ms >= 0) {
+		int64_t deadline_ns = uart_wbp_monotonic_ns() + (int64_t)device->timeout_ms*1000000;
+		if (device->deadline_ns == 0 || deadline_ns < device->deadline_ns) {
+			device->deadline_ns = deadline_ns;
+		}
+	}
+}
+
+// milliseconds until the deadline (rounded up), or -1 if there is no deadline
+int uart_wbp_remaining_ms(uart_wbp_device_t *device) {
+	if (device->deadline_ns == 0) {
+		return -1;
+	}
+	int64_t remaining_ns = device->deadline_ns - uart_wbp_monotonic_ns();
+	if (remaining_ns <= 0) {
+		return 0;
+	}
+	return (remaining_ns+999999)/1000000;
+}
+
+// Write all bytes to the device. With hardware flow control the device may not 
+// take them all at once, then wait until it does or until the deadline of the call passes.
+// The slave handlers use this directly, their responses are not part of a traced transaction.
+int uart_wbp_write_all_untraced(uart_wbp_device_t *device, const uint8_t *msg, int len) {
+	int written = 0;
+	while (written < len) {
+		int result = write(device->fd, msg+written, len-written);
+		if (result > 0) {
+			written += result;
+			continue;
+		}
+		if (result < 0 && errno != EAGAIN && errno != EINTR) {
+			break;
+		}
+		struct pollfd pfd[1];
+		pfd[0].fd = device->fd;
+		pfd[0].events = POLLOUT;
+		result = poll(pfd, 1, uart_wbp_remaining_ms(device));
+		if (result == 0) {
+			device->resync = 1;
+			if (written > 0) {
+				// the bridge waits for the rest of a command
+				device->partial_write = 1;
+			}
+			return UART_WBP_TIMEOUT;
+		}
+	}
+	return written;
+}
+
+// write a request of the master, the time is recorded for tracing
+int uart_wbp_write_all(uart_wbp_device_t *device, const uint8_t *msg, int len) {
+	int written = uart_wbp_write_all_untraced(device, msg, len);
+	if (device->trace_begin_ns) {
+		device->trace_written_ns = uart_wbp_monotonic_ns();
+	}
+	return written;
+}
+
+// Transaction tracing: each thread records into its own buffer, which is allocated on the first 
+// record and linked into a global list with an atomic push. Records are published by incrementing 
+// the record count of the buffer (release), so uart_wbp_trace_export can run in any thread.
+typedef struct uart_wbp_trace_record {
+	const char *name;
+	uint32_t adr;
+	int      response;
+	int64_t  t_begin_ns;
+	int64_t  t_written_ns;    // write() of the request completed (0 if nothing was written)
+	int64_t  t_first_byte_ns; // first response byte taken from the device (0 if none)
+	int64_t  t_end_ns;
+} uart_wbp_trace_record_t;
+
+typedef struct uart_wbp_trace_buffer {
+	struct uart_wbp_trace_buffer *next;
+	int tid;
+	int capacity;
+	int n_records;
+	uart_wbp_trace_record_t records[];
+} uart_wbp_trace_buffer_t;
+
+// records per thread, 0 means tracing is off. It is read by all threads, always access it atomically.
+int uart_wbp_trace_capacity = 0;
+uart_wbp_trace_buffer_t *uart_wbp_trace_buffers = NULL;
+_Thread_local uart_wbp_trace_buffer_t *uart_wbp_trace_local = NULL;
+// The buffers are freed by uart_wbp_trace_free. A thread whose buffer generation 
+// is not the current one has a dangling uart_wbp_trace_local and allocates a new buffer.
+int uart_wbp_trace_generation = 0;
+_Thread_local int uart_wbp_trace_local_generation = 0;
+
+static inline int uart_wbp_tracing() {
+	return __atomic_load_n(&uart_wbp_trace_capacity, __ATOMIC_RELAXED);
+}
+
+int uart_wbp_trace_enable(int records_per_thread) {
+	__atomic_store_n(&uart_wbp_trace_capacity, records_per_thread, __ATOMIC_RELAXED);
+	return 0;
+}
+
+// a slot for the next record of this thread, or NULL if tracing is off or the buffer is full
+uart_wbp_trace_record_t *uart_wbp_trace_slot() {
+	int capacity = uart_wbp_tracing();
+	if (capacity <= 0) {
+		return NULL;
+	}
+	uart_wbp_trace_buffer_t *buffer = uart_wbp_trace_local;
+	int generation = __atomic_load_n(&uart_wbp_trace_generation, __ATOMIC_ACQUIRE);
+	if (uart_wbp_trace_local_generation != generation) {
+		buffer = NULL;
+	}
+	if (buffer == NULL) {
+		static int next_tid = 1;
+		buffer = (uart_wbp_trace_buffer_t*)malloc(sizeof(uart_wbp_trace_buffer_t) + capacity*sizeof(uart_wbp_trace_record_t));
+		if (buffer == NULL) {
+			return NULL;
+		}
+		buffer->tid       = __atomic_fetch_add(&next_tid, 1, __ATOMIC_RELAXED);
+		buffer->capacity  = capacity;
+		buffer->n_records = 0;
+		buffer->next = __atomic_load_n(&uart_wbp_trace_buffers, __ATOMIC_RELAXED);
+		while (!__atomic_compare_exchange_n(&uart_wbp_trace_buffers, &buffer->next, buffer, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+		uart_wbp_trace_local = buffer;
+		uart_wbp_trace_local_generation = generation;
+	}
+	if (buffer->n_records >= buffer->capacity) {
+		return NULL;
+	}
+	return &buffer->records[buffer->n_records];
+}
+
+void uart_wbp_trace_free() {
+	__atomic_store_n(&uart_wbp_trace_capacity, 0, __ATOMIC_RELAXED);
+	uart_wbp_trace_buffer_t *buffer = __atomic_exchange_n(&uart_wbp_trace_buffers, NULL, __ATOMIC_ACQ_REL);
+	__atomic_fetch_add(&uart_wbp_trace_generation, 1, __ATOMIC_RELEASE);
+	while (buffer) {
+		uart_wbp_trace_buffer_t *next = buffer->next;
+		free(buffer);
+		buffer = next;
+	}
+}
+
+void uart_wbp_trace_publish() {
+	__atomic_store_n(&uart_wbp_trace_local->n_records, uart_wbp_trace_local->n_records+1, __ATOMIC_RELEASE);
+}
+
+void uart_wbp_trace_begin(uart_wbp_device_t *device) {
+	if (uart_wbp_tracing() > 0) {
+		device->trace_begin_ns      = uart_wbp_monotonic_ns();
+		device->trace_written_ns    = 0;
+		device->trace_first_byte_ns = 0;
+	}
+}
+
+void uart_wbp_trace_end(uart_wbp_device_t *device, const char *name, uint32_t adr, uart_wbp_response_t response) {
+	uart_wbp_trace_record_t *record = uart_wbp_trace_slot();
+	if (record == NULL) {
+		return;
+	}
+	record->name            = name;
+	record->adr             = adr;
+	record->response        = response;
+	record->t_begin_ns      = device->trace_begin_ns;
+	record->t_written_ns    = device->trace_written_ns;
+	record->t_first_byte_ns = device->trace_first_byte_ns;
+	record->t_end_ns        = uart_wbp_monotonic_ns();
+	uart_wbp_trace_publish();
+}
+
+void uart_wbp_trace_handler(const char *name, uint32_t adr, int response, int64_t t_begin_ns) {
+	uart_wbp_trace_record_t *record = uart_wbp_trace_slot();
+	if (record == NULL) {
+		return;
+	}
+	record->name            = name;
+	record->adr             = adr;
+	record->response        = response;
+	record->t_begin_ns      = t_begin_ns;
+	record->t_written_ns    = 0;
+	record->t_first_byte_ns = 0;
+	record->t_end_ns        = uart_wbp_monotonic_ns();
+	uart_wbp_trace_publish();
+}
+
+void uart_wbp_trace_write_event(FILE *f, int *first, const char *name, int tid, int64_t t_begin_ns, int64_t t_end_ns, const uart_wbp_trace_record_t *record) {
+	fprintf(f, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f", 
+		*first ? "" : ",", name, tid, t_begin_ns/1000.0, (t_end_ns-t_begin_ns)/1000.0);
+	if (record) {
+		fprintf(f, ",\"args\":{\"adr\":\"0x%08x\",\"response\":\"%s\"}", record->adr, uart_wbp_response_str(record->response));
+	}
+	fprintf(f, "}");
+	*first = 0;
+}
+
+int uart_wbp_trace_export(const char *filename) {
+	FILE *f = fopen(filename, "w");
+	if (f == NULL) {
+		return -1;
+	}
+	fprintf(f, "{\"traceEvents\":[");
+	int first = 1;
+	for (uart_wbp_trace_buffer_t *buffer = __atomic_load_n(&uart_wbp_trace_buffers, __ATOMIC_ACQUIRE); buffer; buffer = buffer->next) {
+		int n_records = __atomic_load_n(&buffer->n_records, __ATOMIC_ACQUIRE);
+		for (int i = 0; i < n_records; ++i) {
+			const uart_wbp_trace_record_t *record = &buffer->records[i];
+			uart_wbp_trace_write_event(f, &first, record->name, buffer->tid, record->t_begin_ns, record->t_end_ns, record);
+			// phases of the transaction
+			if (record->t_written_ns) {
+				uart_wbp_trace_write_event(f, &first, "encode and write", buffer->tid, record->t_begin_ns, record->t_written_ns, NULL);
+				if (record->t_first_byte_ns >= record->t_written_ns) {
+					uart_wbp_trace_write_event(f, &first, "wait for response", buffer->tid, record->t_written_ns, record->t_first_byte_ns, NULL);
+					uart_wbp_trace_write_event(f, &first, "decode", buffer->tid, record->t_first_byte_ns, record->t_end_ns, NULL);
+				}
+			}
+		}
+	}
+	fprintf(f, "\n]}\n");
+	fclose(f);
+	return 0;
+}
+
+// number of reset commands if no write to the bridge was interrupted: 
+// the payload bytes of one command, and one that is taken as command
+#define UART_WBP_SHORT_RESET 6
+
+int reset_bridge_state(uart_wbp_device_t *device, int full) {
+	// The bridge abandons an incomplete command after 5 ms without a byte (g_command_timeout in uart_wbp.vhd).
+	// Wait for that, then the reset commands are not taken as payload of a burst write.
+	struct timespec quiet = {0, 10000000};
+	nanosleep(&quiet, NULL);
+	// If the bridge did not see the pause (e.g. in a simulation that runs slower than real time), it could 
+	// be in the middle of a burst write and expect the count byte and up to 4*UART_WBP_BURST_MAX_WORDS 
+	// data bytes before it takes the next command. If a write to the bridge was interrupted or its 
+	// state is unknown (full=1), enough reset commands are sent to fill any of these and still have 
+	// one left that is taken as command. Otherwise the library wrote only complete commands.
+	uint8_t reset_msg[2+4*UART_WBP_BURST_MAX_WORDS];
+	int len = full ? (int)sizeof(reset_msg) : UART_WBP_SHORT_RESET;
+	memset(reset_msg, uart_wbp_master_command_reset, len);
+	if (uart_wbp_write_all(device, reset_msg, len) != len) {
 		return -1;
 	};
+	device->partial_write = 0;
 
 	// reset the variables that represent the hardware state
 	device->wb_dat    = 0x0;
 	device->wb_adr    = 0x0;
 	device->wb_sel    = 0x0;
 	device->hw_config = /*host_sends_write_response |*/ fpga_sends_write_response;
+	device->slave_write_next = 0;
+	device->stall_timeout = 0;
+	device->gpo_bits  = 0;
 
 	return 0;
 }
@@ -156,7 +418,8 @@ uart_wbp_device_t* uart_wbp_open(const char* device_name, speed_t speed, int ver
 	}
 
 
-	uart_wbp_device_t *device = (uart_wbp_device_t*)malloc(sizeof(uart_wbp_device_t));
+	// the rx queue has cache line aligned members
+	uart_wbp_device_t *device = (uart_wbp_device_t*)aligned_alloc(_Alignof(uart_wbp_device_t), sizeof(uart_wbp_device_t));
 	if (device == NULL) {
 		close(fd);
 		return NULL;
@@ -164,6 +427,14 @@ uart_wbp_device_t* uart_wbp_open(const char* device_name, speed_t speed, int ver
 
 	device->fd = fd;
 
+	device->timeout_ms        = -1;
+	device->batch_deadline_ns = 0;
+	device->deadline_ns       = 0;
+	device->resync            = 0;
+	device->partial_write     = 0;
+	device->trace_begin_ns    = 0;
+	device->flow_control      = 0;
+
 	// // read all incoming bytes util empty
 	// for (;;) {
 	// 	struct pollfd pfd[1];
@@ -175,21 +446,21 @@ uart_wbp_device_t* uart_wbp_open(const char* device_name, speed_t speed, int ver
 	// }
 
 
-	// put hardware side of the bridge into a known state
-	if (reset_bridge_state(device) < 0) {
+	// put hardware side of the bridge into a known state, 
+	// it may still wait for the rest of a command from an earlier process
+	if (reset_bridge_state(device, 1) < 0) {
 		fprintf(stderr, "cannot write to device\n");
 		close(fd);
 		return NULL;
 	}
 
 	// initialize the readbuffer;
-	device->buffer_top_idx  = 0;
-	device->buffer_read_idx = 0;
+	uart_wbp_queue_init(&device->rx, device->rx_storage, UART_WBP_BUFFER_DEPTH, 1);
+	device->rx_pos = device->rx_len = 0;
 
 	device->write_handler = uart_wbp_slave_default_write_handler;
 	device->read_handler  = uart_wbp_slave_default_read_handler;
 
-
 	return device;
 }
 
@@ -203,17 +474,46 @@ void uart_wbp_close(uart_wbp_device_t *device)
 }
 
 int uart_wbp_buffered_read(uart_wbp_device_t *device, uint8_t *dat) {
-	if (device->buffer_read_idx >= device->buffer_top_idx) {
-		device->buffer_read_idx = 0; //reset the buffer read index and read as much data as is available
-		int result = read(device->fd, &device->buffer[0], UART_WBP_BUFFER_SIZE);
-		// printf("read returned %d\n", device->buffer_top_idx);
-		if (result <= 0) {
-			return -1;
+	if (device->rx_pos == device->rx_len) {
+		// take the next block from the ringbuffer, one atomic update per block instead of per byte
+		device->rx_pos = 0;
+		device->rx_len = uart_wbp_queue_pop(&device->rx, device->rx_block, sizeof(device->rx_block));
+		if (device->rx_len == 0) {
+			// read as much data as is available
+			if (device->deadline_ns || device->flow_control) {
+				// don't block in read() longer than the deadline allows, 
+				// with flow control the file descriptor is non-blocking
+				struct pollfd pfd[1];
+				pfd[0].fd = device->fd;
+				pfd[0].events = POLLIN;
+				int result;
+				do {
+					result = poll(pfd, 1, uart_wbp_remaining_ms(device));
+				} while (result < 0 && errno == EINTR);
+				if (result == 0) {
+					device->resync = 1;
+					return UART_WBP_TIMEOUT;
+				}
+			}
+			size_t space;
+			uint8_t *free_slots = (uint8_t*)uart_wbp_queue_write_ptr(&device->rx, &space);
+			int result = read(device->fd, free_slots, space);
+			// printf("read returned %d\n", result);
+			if (result < 0 && (errno == EAGAIN || errno == EINTR)) {
+				return uart_wbp_buffered_read(device, dat);
+			}
+			if (result <= 0) {
+				return -1;
+			}
+			uart_wbp_queue_commit(&device->rx, result);
+			device->rx_len = uart_wbp_queue_pop(&device->rx, device->rx_block, sizeof(device->rx_block));
 		}
-		device->buffer_top_idx = result;
 	}
-	// printf("buffered_read idx = %d dat = %x\n", device->buffer_read_idx, (unsigned)dat);
-	*dat = device->buffer[device->buffer_read_idx++];
+	*dat = device->rx_block[device->rx_pos++];
+	// printf("buffered_read dat = %x\n", (unsigned)*dat);
+	if (device->trace_begin_ns && device->trace_first_byte_ns == 0) {
+		device->trace_first_byte_ns = uart_wbp_monotonic_ns();
+	}
 	return 0;
 }
 
@@ -241,6 +541,7 @@ int uart_wbp_handle_slave_write(uart_wbp_device_t *device, uint8_t header) {
 		adr |= (header2 & 0x3f)<<shift;
 		shift += 6;
 	}
+	device->slave_write_next = (device->hw_config & delta_slave_writes) ? adr+4 : 0;
 	// printf("adr = %08x\n", adr);
 	// build data
 	uint32_t dat = 0;
@@ -258,7 +559,11 @@ int uart_wbp_handle_slave_write(uart_wbp_device_t *device, uint8_t header) {
 		}
 	}
 	// printf("dat = %08x\n", dat);
+	int64_t t_handler_ns = uart_wbp_tracing() ? uart_wbp_monotonic_ns() : 0;
 	int response = device->write_handler(sel, adr, dat);
+	if (t_handler_ns) {
+		uart_wbp_trace_handler("slave write handler", adr, response, t_handler_ns);
+	}
 	// if (device->hw_config & host_sends_write_response) {
 	if (send_write_response) {
 		// printf("host_sends_write_response is true, send response %d\n", response);
@@ -270,22 +575,22 @@ int uart_wbp_handle_slave_write(uart_wbp_device_t *device, uint8_t header) {
 			case ack:
 				msg = uart_wbp_master_response_ack;
 				// printf("write response is ack\n");
-				result = write(device->fd, &msg, 1);
+				result = uart_wbp_write_all_untraced(device, &msg, 1);
 			break;
 			case err:
 				msg = uart_wbp_master_response_err;
 				// printf("write response is err\n");
-				result = write(device->fd, &msg, 1);
+				result = uart_wbp_write_all_untraced(device, &msg, 1);
 				break;
 			case rty:
 				msg = uart_wbp_master_response_rty;
 				// printf("write response is rty\n");
-				result = write(device->fd, &msg, 1);
+				result = uart_wbp_write_all_untraced(device, &msg, 1);
 				break;
 			default:
 				msg = uart_wbp_master_response_err;
 				// printf("write response is unknonw -> send err\n");
-				result = write(device->fd, &msg, 1);
+				result = uart_wbp_write_all_untraced(device, &msg, 1);
 				break;
 		}
 		if (result != 1) {
@@ -296,6 +601,55 @@ int uart_wbp_handle_slave_write(uart_wbp_device_t *device, uint8_t header) {
 	return 0;
 }
 
+// A delta write frame (header 1000_1nnn) carries n+1 words that were written with sel=0xf to consecutive addresses.
+// The first address is the zigzag encoded word distance to the address after the previous slave write,
+// followed by each word as one byte with the MSBs of the data bytes and four data bytes.
+// The bridge sends these only for writes that need no response from the host.
+int uart_wbp_handle_slave_delta_write(uart_wbp_device_t *device, uint8_t header) {
+	int n = (header&0x07)+1;
+
+	// zigzag encoded word distance in blocks of 6 bits (0naaaaaa)
+	uint32_t zigzag = 0;
+	uint8_t adr_byte;
+	int shift = 0;
+	do {
+		if (uart_wbp_buffered_read(device, &adr_byte) < 0) {
+			fprintf(stderr, "Error reading from device\n");
+			return -1;
+		}
+		zigzag |= (uint32_t)(adr_byte & 0x3f)<<shift;
+		shift += 6;
+	} while (adr_byte & 0x40);
+	uint32_t delta = (zigzag>>1) ^ (0-(zigzag&1));
+	uint32_t adr = ((device->slave_write_next>>2) + delta)<<2;
+
+	for (int w = 0; w < n; ++w) {
+		uint8_t bytes[5];
+		for (int i = 0; i < 5; ++i) {
+			if (uart_wbp_buffered_read(device, &bytes[i]) < 0) {
+				fprintf(stderr, "Error reading from device\n");
+				return -1;
+			}
+		}
+		uint32_t dat = 0;
+		for (int i = 0; i < 4; ++i) {
+			uint32_t data_byte = bytes[1+i];
+			if (bytes[0]&(1<<i)) {
+				data_byte |= 0x80;
+			}
+			dat |= data_byte<<(8*i);
+		}
+		int64_t t_handler_ns = uart_wbp_tracing() ? uart_wbp_monotonic_ns() : 0;
+		int response = device->write_handler(0xf, adr, dat);
+		if (t_handler_ns) {
+			uart_wbp_trace_handler("slave write handler", adr, response, t_handler_ns);
+		}
+		adr += 4;
+	}
+	device->slave_write_next = adr;
+	return 0;
+}
+
 
 int uart_wbp_handle_slave_read(uart_wbp_device_t *device, uint8_t header) {
 	uint8_t sel = header&0x0f;
@@ -320,7 +674,11 @@ int uart_wbp_handle_slave_read(uart_wbp_device_t *device, uint8_t header) {
 	// printf("adr = %08x\n", adr);
 
 	uint32_t dat;
+	int64_t t_handler_ns = uart_wbp_tracing() ? uart_wbp_monotonic_ns() : 0;
 	int response = device->read_handler(sel, adr, &dat);
+	if (t_handler_ns) {
+		uart_wbp_trace_handler("slave read handler", adr, response, t_handler_ns);
+	}
 	// printf("host sends read response %d\n", response);
 	// send repsone 
 	// first set wb_dat in hardware
@@ -352,7 +710,7 @@ int uart_wbp_handle_slave_read(uart_wbp_device_t *device, uint8_t header) {
 		break;
 	}
 	// printf("writing the message (%d bytes) to bridge\n", read_response_msg_len);
-	if (write(device->fd, read_response_msg, read_response_msg_len) != read_response_msg_len) {
+	if (uart_wbp_write_all_untraced(device, read_response_msg, read_response_msg_len) != read_response_msg_len) {
 		return -1;
 	};
 	// update hardware representation
@@ -371,7 +729,11 @@ int uart_wbp_read_header(uart_wbp_device_t *device, uint8_t *header, int expect_
 	for (;;) {
 		
 		for (;;) {
-			if (uart_wbp_buffered_read(device, header) < 0) {
+			int result = uart_wbp_buffered_read(device, header);
+			if (result == UART_WBP_TIMEOUT) {
+				return result;
+			}
+			if (result < 0) {
 				fprintf(stderr, "Error reading from device\n");
 				return -1;
 			}
@@ -384,6 +746,17 @@ int uart_wbp_read_header(uart_wbp_device_t *device, uint8_t *header, int expect_
 		uart_wbp_response_t write_response_type = ((*header)&0x7); // write response header encodes response type in 3 LSB
 		switch(response_type) {
 			case write_response: 
+				if (*header & 0x08) {
+					// printf("the slave interface was written to (delta write)\n");
+					if (uart_wbp_handle_slave_delta_write(device, *header) < 0) {
+						device->resync = 1;
+						return -1;
+					}
+					if (expect_rw) {
+						return 0;
+					}
+					break;
+				}
 				switch (write_response_type) {
 					case ack:
 						// printf("got write response ack\n");
@@ -397,6 +770,9 @@ int uart_wbp_read_header(uart_wbp_device_t *device, uint8_t *header, int expect_
 					case stall_timeout:
 						// printf("got write response stall_timeout\n");
 						return 0;
+					case (UART_WBP_BURST_READ_HEADER&0x7):
+						// printf("got burst read response\n");
+						return 0;
 					default:
 						return -1;				
 				}     
@@ -415,14 +791,20 @@ int uart_wbp_read_header(uart_wbp_device_t *device, uint8_t *header, int expect_
 				return 0;
 			case write_request: case write_req_norsp:
 				// printf("the slave intefcace was written to\n");
-				uart_wbp_handle_slave_write(device, *header);
+				if (uart_wbp_handle_slave_write(device, *header) < 0) {
+					device->resync = 1;
+					return -1;
+				}
 				if (expect_rw) {
 					return 0;
 				}
 				break;
 			case read_request:
 				// printf("the slave inteface was read from\n");
-				uart_wbp_handle_slave_read(device, *header);
+				if (uart_wbp_handle_slave_read(device, *header) < 0) {
+					device->resync = 1;
+					return -1;
+				}
 				if (expect_rw) {
 					return 0;
 				}
@@ -448,97 +830,184 @@ const char* uart_wbp_response_str(uart_wbp_response_t response)
 		case write_req_norsp: return "write_request_no_response";
 		case read_request: return "read_request";
 		case unknown: return "unknown (response deactivated)";
+		case timeout: return "timeout (no response before deadline)";
 		default: return "unkonwn (something went wrong)";
 	}
 	return "";
 }
 
-void uart_wbp_set_stall_timeout(uart_wbp_device_t *device, int timeout)
+static int uart_wbp_resync_bridge(uart_wbp_device_t *device);
+
+// Send the bytes of a setting, the device is resynced first if needed. On failure (e.g. a timeout, 
+// then the device is marked for resync) -1 is returned and the setting is not recorded.
+static int uart_wbp_send_setting(uart_wbp_device_t *device, const uint8_t *msg, int len)
+{
+	uart_wbp_start_deadline(device);
+	if (device->resync && uart_wbp_resync_bridge(device) < 0) {
+		return -1;
+	}
+	if (uart_wbp_write_all(device, msg, len) != len) {
+		return -1;
+	}
+	return 0;
+}
+
+int uart_wbp_set_stall_timeout(uart_wbp_device_t *device, int timeout)
 {
 	uint8_t msg[5] = {uart_wbp_master_command_set_timeout | 0xf0,
 	                  (timeout>>0), (timeout>>8), (timeout>>16), (timeout>>24)};
-	int len = 5;
 	//printf("set stall timeout to %d\n", timeout);
-	int result = write(device->fd, msg, len);
-	assert(result == len);
+	if (uart_wbp_send_setting(device, msg, sizeof(msg)) < 0) {
+		return -1;
+	}
+	device->stall_timeout = timeout;
+	return 0;
 }
 
-void uart_wbp_configure(uart_wbp_device_t *device, uart_wbp_config_t flags)
+int uart_wbp_configure(uart_wbp_device_t *device, uart_wbp_config_t flags)
 {
 	uint8_t msg = uart_wbp_master_command_config | (flags << 4);
-	int result = write(device->fd, &msg, 1);
-	assert(result == 1);
+	if (uart_wbp_send_setting(device, &msg, 1) < 0) {
+		return -1;
+	}
 	device->hw_config = flags;
+	if (!(flags & delta_slave_writes)) {
+		// the bridge starts from zero when delta writes are enabled again
+		device->slave_write_next = 0;
+	}
+	return 0;
 }
 
-void uart_wbp_set_gpo_bits(uart_wbp_device_t *device, uint32_t bits)
+int uart_wbp_set_gpo_bits(uart_wbp_device_t *device, uint32_t bits)
 {
 	uint8_t msg[5] = {uart_wbp_master_command_set_gpo_bits | 0xf0,
 	                  (bits>>0), (bits>>8), (bits>>16), (bits>>24)};
-	int len = 5;
-	int result = write(device->fd, msg, len);
-	assert(result == len);	
+	if (uart_wbp_send_setting(device, msg, sizeof(msg)) < 0) {
+		return -1;
+	}
+	device->gpo_bits = bits;
+	return 0;
 }
 
-
-uart_wbp_response_t uart_wbp_write(uart_wbp_device_t *device, uint8_t sel, uint32_t adr, uint32_t dat, int delta_adr, int keep_cyc) 
+int uart_wbp_set_flow_control(uart_wbp_device_t *device, int rtscts)
 {
-	delta_adr /= 4;
-	if (delta_adr > 3  || delta_adr < -4) {
-		printf("delta_adr is out of bounds [-16,12]");
+	struct termios tio;
+	if (tcgetattr(device->fd, &tio) < 0) {
+		return -1;
+	}
+	if (rtscts) {
+		tio.c_cflag |= CRTSCTS;
+	} else {
+		tio.c_cflag &= ~CRTSCTS;
+	}
+	if (tcsetattr(device->fd, TCSANOW, &tio) < 0) {
+		int err = errno;
+		fprintf(stderr, "Error, cant set flow control: %s\n", strerror(err));
+		return -1;
+	}
+	// writes can block for a long time when the bridge deasserts RTS, 
+	// uart_wbp_write_all waits for it with poll() to respect the deadlines 
+	int flags = fcntl(device->fd, F_GETFL);
+	if (rtscts) {
+		flags |= O_NONBLOCK;
+	} else {
+		flags &= ~O_NONBLOCK;
+	}
+	if (fcntl(device->fd, F_SETFL, flags) < 0) {
 		return -1;
 	}
-	delta_adr &= 0x00000007;
+	device->flow_control = rtscts?1:0;
+	return 0;
+}
 
-	// any nonzero value of keep_cyc will do
-	if (keep_cyc) {
-		keep_cyc = 0x8;
+void uart_wbp_set_timeout(uart_wbp_device_t *device, int timeout_ms)
+{
+	device->timeout_ms = timeout_ms;
+}
+
+void uart_wbp_set_deadline(uart_wbp_device_t *device, int timeout_ms)
+{
+	if (timeout_ms < 0) {
+		device->batch_deadline_ns = 0;
+	} else {
+		device->batch_deadline_ns = uart_wbp_monotonic_ns() + (int64_t)timeout_ms*1000000;
 	}
+}
 
-	uint8_t write_stb_msg[12];
-	int write_stb_msg_len = 0;
-	// change the sel bits of the hardware only if they are different than what is requested
-	if (device->wb_sel != sel) {
-		write_stb_msg[write_stb_msg_len++] = uart_wbp_master_command_set_sel | (sel<<4); 
+// Bring the bridge back into a known state after a timeout.
+// Responses that are still in flight are discarded, the bridge is reset
+// and the configuration, stall timeout, and gpo bits are restored.
+// Note that the gpo bits are zero for a short time during the reset.
+// The accesses call this with their own deadline, which covers the resync.
+static int uart_wbp_resync_bridge(uart_wbp_device_t *device)
+{
+	uart_wbp_config_t hw_config = device->hw_config;
+	uint32_t stall_timeout = device->stall_timeout;
+	uint32_t gpo_bits = device->gpo_bits;
+
+	tcflush(device->fd, TCIOFLUSH);
+	uart_wbp_queue_pop(&device->rx, NULL, UART_WBP_BUFFER_SIZE);
+	device->rx_pos = device->rx_len = 0;
+	if (reset_bridge_state(device, device->partial_write) < 0) {
+		return -1;
 	}
-	// write only those bytes of the data that are different from the buffered data bytes and covered by the sel bits
-	int dat_sel_idx = write_stb_msg_len;
-	write_stb_msg[dat_sel_idx] = uart_wbp_master_command_set_dat ; 
-	int i;
-	for (i = 0; i < 4; ++i) {
-		if ((device->wb_dat&(0x000000ff<<(8*i))) != (dat&(0x000000ff)<<(8*i)) && (sel&(0x1<<(i)))) {
-			write_stb_msg[dat_sel_idx] |= (0x10<<i);
-			write_stb_msg[++write_stb_msg_len] = (dat>>(8*i))&0x000000ff;
+	// drop bytes that the bridge sent before the reset arrived, 
+	// i.e. until the line is quiet for 10 ms (but not longer than 100 ms)
+	int64_t drain_end_ns = uart_wbp_monotonic_ns() + 100000000;
+	for (;;) {
+		struct pollfd pfd[1];
+		pfd[0].fd = device->fd;
+		pfd[0].events = POLLIN;
+		if (poll(pfd, 1, 10) <= 0 || uart_wbp_monotonic_ns() > drain_end_ns) {
+			break;
 		}
-	}
-	// put the write-stb command into the buffer, if there was no dat byte set, the set dat sel-bits command can be overwriitten
-	if (write_stb_msg_len > dat_sel_idx) {
-		++write_stb_msg_len; 
-	} 
-	// write only those bytes of the address that are different from the buffered address bytes
-	int adr_sel_idx = write_stb_msg_len;
-	//printf("buffer adr=%08x  requested adr=%08x \n", device->wb_adr, adr);
-	write_stb_msg[adr_sel_idx] = uart_wbp_master_command_set_adr ; 
-	for (i = 0; i < 4; ++i) {
-		if ((device->wb_adr&(0x000000ff<<(8*i))) != (adr&(0x000000ff)<<(8*i))) {
-			write_stb_msg[adr_sel_idx] |= (0x10<<i);
-			write_stb_msg[++write_stb_msg_len] = (adr>>(8*i))&0x000000ff;
+		uint8_t drain[UART_WBP_BUFFER_SIZE];
+		if (read(device->fd, drain, UART_WBP_BUFFER_SIZE) <= 0) {
+			break;
 		}
 	}
-	// put the write-stb command into the buffer, if there was no adr byte set, the set adr sel-bits command can be overwriitten
-	if (write_stb_msg_len > adr_sel_idx) {
-		++write_stb_msg_len; 
-	} 
-	write_stb_msg[write_stb_msg_len++] = uart_wbp_master_command_write_stb | ((keep_cyc | delta_adr)<<4);
-	//printf("writing the message (%d bytes) to bridge\n", write_stb_msg_len);
-	if (write(device->fd, write_stb_msg, write_stb_msg_len) != write_stb_msg_len) {
+
+	// restore the configuration, stall timeout, and gpo bits with one write 
+	// that is covered by the deadline of this call
+	uint8_t msg[11] = {uart_wbp_master_command_config | (hw_config << 4),
+	                   uart_wbp_master_command_set_timeout | 0xf0,
+	                   (stall_timeout>>0), (stall_timeout>>8), (stall_timeout>>16), (stall_timeout>>24),
+	                   uart_wbp_master_command_set_gpo_bits | 0xf0,
+	                   (gpo_bits>>0), (gpo_bits>>8), (gpo_bits>>16), (gpo_bits>>24)};
+	if (uart_wbp_write_all(device, msg, sizeof(msg)) != sizeof(msg)) {
+		// resync stays set, the next access tries again
+		return -1;
+	}
+	device->hw_config     = hw_config;
+	device->stall_timeout = stall_timeout;
+	device->gpo_bits      = gpo_bits;
+	device->resync = 0;
+	return 0;
+}
+
+int uart_wbp_resync(uart_wbp_device_t *device)
+{
+	uart_wbp_start_deadline(device);
+	return uart_wbp_resync_bridge(device);
+}
+
+
+// Send the command bytes of a write strobe, update our representation of the hardware 
+// state (sel, adr after the strobe, and dat), and wait for the response
+uart_wbp_response_t uart_wbp_send_write(uart_wbp_device_t *device, const uint8_t *msg, int len, uint8_t sel, uint32_t adr, uint32_t dat)
+{
+	int written = uart_wbp_write_all(device, msg, len);
+	if (written == UART_WBP_TIMEOUT) {
+		return timeout;
+	}
+	if (written != len) {
 		return -1;
 	};
 
 	// now that the data is written to the hardware, update 
 	// our representation of the hardware state
 	device->wb_sel = sel;
-	device->wb_adr = adr+4*delta_adr;
+	device->wb_adr = adr;
 	for (int i = 0; i < 4; ++i) {
 		if (sel & (1<<i)) {
 			device->wb_dat &= ~(0xff<<(i*8));
@@ -550,10 +1019,16 @@ uart_wbp_response_t uart_wbp_write(uart_wbp_device_t *device, uint8_t sel, uint3
 		uint8_t header;
 		//printf("read the response header\n");
 		for (;;) {
-			if (uart_wbp_read_header(device, &header, 0) < 0) {
+			int result = uart_wbp_read_header(device, &header, 0);
+			if (result == UART_WBP_TIMEOUT) {
+				device->deadline_ns = 0;
+				return timeout;
+			}
+			if (result < 0) {
 				fprintf(stderr, "Error reading reponse\n");
 			}
 			if (((header & 0x70)>>4) == write_response) {
+				device->deadline_ns = 0;
 				uart_wbp_response_t response_type = (header & 0x7);
 				if (response_type == ack) {
 					// printf("write: ack received\n");
@@ -576,93 +1051,911 @@ uart_wbp_response_t uart_wbp_write(uart_wbp_device_t *device, uint8_t sel, uint3
 	return err;
 }
 
-
-
-uart_wbp_response_t uart_wbp_read(uart_wbp_device_t *device, uint8_t sel, uint32_t adr, uint32_t *dat, int delta_adr, int keep_cyc) {
-
+uart_wbp_response_t uart_wbp_write_untraced(uart_wbp_device_t *device, uint8_t sel, uint32_t adr, uint32_t dat, int delta_adr, int keep_cyc) 
+{
 	delta_adr /= 4;
 	if (delta_adr > 3  || delta_adr < -4) {
-		printf("uart_wbp_read:delta_adr is out of bounds [-16,12]");
+		printf("delta_adr is out of bounds [-16,12]");
 		return -1;
 	}
-	delta_adr &= 0x00000007;
 
-	// any nonzero value of keep_cyc will cause that cyc will stay high after stb response
+	uart_wbp_start_deadline(device);
+	if (device->resync && uart_wbp_resync_bridge(device) < 0) {
+		return -1;
+	}
+
+	// any nonzero value of keep_cyc will do
 	if (keep_cyc) {
 		keep_cyc = 0x8;
 	}
 
-	// the more complicated but possibly more efficient way of making a wishbone write in the hardware
-	uint8_t read_stb_msg[12];
-	int read_stb_msg_len = 0;
+	uint8_t write_stb_msg[12];
+	int write_stb_msg_len = 0;
 	// change the sel bits of the hardware only if they are different than what is requested
 	if (device->wb_sel != sel) {
-		read_stb_msg[read_stb_msg_len++] = uart_wbp_master_command_set_sel | (sel<<4); 
-		device->wb_sel = sel;
+		write_stb_msg[write_stb_msg_len++] = uart_wbp_master_command_set_sel | (sel<<4); 
 	}
-
-	// write only those bytes of the address that are different from the buffered address bytes
-	int adr_sel_idx = read_stb_msg_len;
-	// printf("uart_wbp_read:  requested adr=%08x \n", device->wb_adr, adr);
-	read_stb_msg[adr_sel_idx] = uart_wbp_master_command_set_adr ; 
+	// write only those bytes of the data that are different from the buffered data bytes and covered by the sel bits
+	int dat_sel_idx = write_stb_msg_len;
+	write_stb_msg[dat_sel_idx] = uart_wbp_master_command_set_dat ; 
 	int i;
+	for (i = 0; i < 4; ++i) {
+		if ((device->wb_dat&(0x000000ff<<(8*i))) != (dat&(0x000000ff)<<(8*i)) && (sel&(0x1<<(i)))) {
+			write_stb_msg[dat_sel_idx] |= (0x10<<i);
+			write_stb_msg[++write_stb_msg_len] = (dat>>(8*i))&0x000000ff;
+		}
+	}
+	// put the write-stb command into the buffer, if there was no dat byte set, the set dat sel-bits command can be overwriitten
+	if (write_stb_msg_len > dat_sel_idx) {
+		++write_stb_msg_len; 
+	} 
+	// write only those bytes of the address that are different from the buffered address bytes
+	int adr_sel_idx = write_stb_msg_len;
+	//printf("buffer adr=%08x  requested adr=%08x \n", device->wb_adr, adr);
+	write_stb_msg[adr_sel_idx] = uart_wbp_master_command_set_adr ; 
 	for (i = 0; i < 4; ++i) {
 		if ((device->wb_adr&(0x000000ff<<(8*i))) != (adr&(0x000000ff)<<(8*i))) {
-			read_stb_msg[adr_sel_idx] |= (0x10<<i);
-			read_stb_msg[++read_stb_msg_len] = (adr>>(8*i))&0x000000ff;
+			write_stb_msg[adr_sel_idx] |= (0x10<<i);
+			write_stb_msg[++write_stb_msg_len] = (adr>>(8*i))&0x000000ff;
 		}
 	}
 	// put the write-stb command into the buffer, if there was no adr byte set, the set adr sel-bits command can be overwriitten
-	if (read_stb_msg_len > adr_sel_idx) {
-		++read_stb_msg_len; 
+	if (write_stb_msg_len > adr_sel_idx) {
+		++write_stb_msg_len; 
 	} 
-	read_stb_msg[read_stb_msg_len++] = uart_wbp_master_command_read_stb | ((keep_cyc | delta_adr)<<4);
-	// printf("uart_wbp_read: writing the message (%d bytes) to bridge\n", read_stb_msg_len);
-	if (write(device->fd, read_stb_msg, read_stb_msg_len) != read_stb_msg_len) {
-		fprintf(stderr, "uart_wbp_read: Error writing data to hardware\n");
-		return -1;
-	};
-
+	write_stb_msg[write_stb_msg_len++] = uart_wbp_master_command_write_stb | ((keep_cyc | (delta_adr & 0x7))<<4);
+	//printf("writing the message (%d bytes) to bridge\n", write_stb_msg_len);
+	return uart_wbp_send_write(device, write_stb_msg, write_stb_msg_len, sel, adr+4*delta_adr, dat);
+}
+
+uart_wbp_response_t uart_wbp_write(uart_wbp_device_t *device, uint8_t sel, uint32_t adr, uint32_t dat, int delta_adr, int keep_cyc)
+{
+	if (uart_wbp_tracing() == 0) {
+		return uart_wbp_write_untraced(device, sel, adr, dat, delta_adr, keep_cyc);
+	}
+	uart_wbp_trace_begin(device);
+	uart_wbp_response_t response = uart_wbp_write_untraced(device, sel, adr, dat, delta_adr, keep_cyc);
+	uart_wbp_trace_end(device, "write", adr, response);
+	device->trace_begin_ns = 0;
+	return response;
+}
+
+
+
+// wait for the response to a read strobe (the deadline must be started by the caller)
+uart_wbp_response_t uart_wbp_read_response(uart_wbp_device_t *device, uint8_t sel, uint32_t *dat) {
+	uint8_t header;
+	int result = uart_wbp_read_header(device, &header, 0);
+	if (result == UART_WBP_TIMEOUT) {
+		return timeout;
+	}
+	if (result < 0) {
+		fprintf(stderr, "uart_wbp_read: Error reading reponse\n");
+	}
+	// printf("uart_wbp_read: got header %02x\n", header);
+	uart_wbp_response_t response_type = ((header & 0x70)>>4);
+	if (response_type == write_response) {
+		fprintf(stderr, "uart_wbp_read: Error: expect read response, got write response\n");
+	} else if (response_type == ack || response_type == err || response_type == rty || response_type == stall_timeout) {
+		// build the data word
+		// printf("uart_wbp_read: got read response %d\n", response_type);
+		*dat = 0;
+		if (header&1) *dat |= (1<< 7); 
+		if (header&2) *dat |= (1<<15); 
+		if (header&4) *dat |= (1<<23); 
+		if (header&8) *dat |= (1<<31); 
+		for (int i = 0; i < 4; ++i) {
+			if (sel&(1<<i)) {
+				uint8_t data_byte;
+				int result = uart_wbp_buffered_read(device, &data_byte);
+				if (result == UART_WBP_TIMEOUT) {
+					return timeout;
+				} else if (result < 0) {
+					fprintf(stderr, "Error reading from device\n");
+					return -1;
+				} else {
+					*dat |= (((uint32_t)data_byte)<<(8*i));				
+				}
+			}
+		}
+	}
+	return response_type;
+}
+
+// Send the command bytes of a read strobe, update our representation of the hardware 
+// state (sel and adr after the strobe), and wait for the response
+uart_wbp_response_t uart_wbp_send_read(uart_wbp_device_t *device, const uint8_t *msg, int len, uint8_t sel, uint32_t adr, uint32_t *dat)
+{
+	int written = uart_wbp_write_all(device, msg, len);
+	if (written == UART_WBP_TIMEOUT) {
+		return timeout;
+	}
+	if (written != len) {
+		fprintf(stderr, "uart_wbp_read: Error writing data to hardware\n");
+		return -1;
+	};
+
 	// now that the data is written to the hardware, update 
 	// our representation of the hardware state
 	device->wb_sel = sel;
-	device->wb_adr = adr+4*delta_adr;
+	device->wb_adr = adr;
 
 
-	uint8_t header;
 	// printf("uart_wbp_read: read the response header\n");
-	for (;;) {
-		if (uart_wbp_read_header(device, &header, 0) < 0) {
-			fprintf(stderr, "uart_wbp_read: Error reading reponse\n");
-		}
-		// printf("uart_wbp_read: got header %02x\n", header);
-		uart_wbp_response_t response_type = ((header & 0x70)>>4);
-		if (response_type == write_response) {
-			fprintf(stderr, "uart_wbp_read: Error: expect read response, got write response\n");
-		} else if (response_type == ack || response_type == err || response_type == rty || response_type == stall_timeout) {
-			// build the data word
-			// printf("uart_wbp_read: got read response %d\n", response_type);
-			*dat = 0;
-			if (header&1) *dat |= (1<< 7); 
-			if (header&2) *dat |= (1<<15); 
-			if (header&4) *dat |= (1<<23); 
-			if (header&8) *dat |= (1<<31); 
+	uart_wbp_response_t response_type = uart_wbp_read_response(device, sel, dat);
+	device->deadline_ns = 0;
+	return response_type;
+}
+
+uart_wbp_response_t uart_wbp_read_untraced(uart_wbp_device_t *device, uint8_t sel, uint32_t adr, uint32_t *dat, int delta_adr, int keep_cyc) {
+
+	delta_adr /= 4;
+	if (delta_adr > 3  || delta_adr < -4) {
+		printf("uart_wbp_read:delta_adr is out of bounds [-16,12]");
+		return -1;
+	}
+
+	uart_wbp_start_deadline(device);
+	if (device->resync && uart_wbp_resync_bridge(device) < 0) {
+		return -1;
+	}
+
+	// any nonzero value of keep_cyc will cause that cyc will stay high after stb response
+	if (keep_cyc) {
+		keep_cyc = 0x8;
+	}
+
+	// the more complicated but possibly more efficient way of making a wishbone write in the hardware
+	uint8_t read_stb_msg[12];
+	int read_stb_msg_len = 0;
+	// change the sel bits of the hardware only if they are different than what is requested
+	if (device->wb_sel != sel) {
+		read_stb_msg[read_stb_msg_len++] = uart_wbp_master_command_set_sel | (sel<<4); 
+		device->wb_sel = sel;
+	}
+
+	// write only those bytes of the address that are different from the buffered address bytes
+	int adr_sel_idx = read_stb_msg_len;
+	// printf("uart_wbp_read:  requested adr=%08x \n", device->wb_adr, adr);
+	read_stb_msg[adr_sel_idx] = uart_wbp_master_command_set_adr ; 
+	int i;
+	for (i = 0; i < 4; ++i) {
+		if ((device->wb_adr&(0x000000ff<<(8*i))) != (adr&(0x000000ff)<<(8*i))) {
+			read_stb_msg[adr_sel_idx] |= (0x10<<i);
+			read_stb_msg[++read_stb_msg_len] = (adr>>(8*i))&0x000000ff;
+		}
+	}
+	// put the write-stb command into the buffer, if there was no adr byte set, the set adr sel-bits command can be overwriitten
+	if (read_stb_msg_len > adr_sel_idx) {
+		++read_stb_msg_len; 
+	} 
+	read_stb_msg[read_stb_msg_len++] = uart_wbp_master_command_read_stb | ((keep_cyc | (delta_adr & 0x7))<<4);
+	// printf("uart_wbp_read: writing the message (%d bytes) to bridge\n", read_stb_msg_len);
+	return uart_wbp_send_read(device, read_stb_msg, read_stb_msg_len, sel, adr+4*delta_adr, dat);
+}
+
+uart_wbp_response_t uart_wbp_read(uart_wbp_device_t *device, uint8_t sel, uint32_t adr, uint32_t *dat, int delta_adr, int keep_cyc)
+{
+	if (uart_wbp_tracing() == 0) {
+		return uart_wbp_read_untraced(device, sel, adr, dat, delta_adr, keep_cyc);
+	}
+	uart_wbp_trace_begin(device);
+	uart_wbp_response_t response = uart_wbp_read_untraced(device, sel, adr, dat, delta_adr, keep_cyc);
+	uart_wbp_trace_end(device, "read", adr, response);
+	device->trace_begin_ns = 0;
+	return response;
+}
+
+uart_wbp_response_t uart_wbp_write_prepared(uart_wbp_device_t *device, const uint8_t *msg, int len, uint8_t sel, uint32_t adr, uint32_t dat)
+{
+	if (device->resync) {
+		// msg was prepared for a hardware state that is not known anymore
+		fprintf(stderr, "uart_wbp_write_prepared: Error: the device needs a resync\n");
+		return -1;
+	}
+	uart_wbp_start_deadline(device);
+	if (uart_wbp_tracing() == 0) {
+		return uart_wbp_send_write(device, msg, len, sel, adr, dat);
+	}
+	uart_wbp_trace_begin(device);
+	uart_wbp_response_t response = uart_wbp_send_write(device, msg, len, sel, adr, dat);
+	uart_wbp_trace_end(device, "write", adr, response);
+	device->trace_begin_ns = 0;
+	return response;
+}
+
+uart_wbp_response_t uart_wbp_read_prepared(uart_wbp_device_t *device, const uint8_t *msg, int len, uint8_t sel, uint32_t adr, uint32_t *dat)
+{
+	if (device->resync) {
+		// msg was prepared for a hardware state that is not known anymore
+		fprintf(stderr, "uart_wbp_read_prepared: Error: the device needs a resync\n");
+		return -1;
+	}
+	uart_wbp_start_deadline(device);
+	if (uart_wbp_tracing() == 0) {
+		return uart_wbp_send_read(device, msg, len, sel, adr, dat);
+	}
+	uart_wbp_trace_begin(device);
+	uart_wbp_response_t response = uart_wbp_send_read(device, msg, len, sel, adr, dat);
+	uart_wbp_trace_end(device, "read", adr, response);
+	device->trace_begin_ns = 0;
+	return response;
+}
+
+// collect one response per burst, the result is the first response that is not ack
+static int uart_wbp_collect_write_responses(uart_wbp_device_t *device, int n_bursts, uart_wbp_response_t *result_response)
+{
+	while (n_bursts > 0) {
+		uint8_t header;
+		int result = uart_wbp_read_header(device, &header, 0);
+		if (result == UART_WBP_TIMEOUT) {
+			return UART_WBP_TIMEOUT;
+		}
+		if (result < 0) {
+			fprintf(stderr, "uart_wbp_write_burst: Error reading reponse\n");
+			continue;
+		}
+		if (((header & 0x70)>>4) == write_response) {
+			uart_wbp_response_t response_type = (header & 0x7);
+			if (*result_response == ack) {
+				*result_response = response_type;
+			}
+			--n_bursts;
+		}
+	}
+	return 0;
+}
+
+uart_wbp_response_t uart_wbp_write_burst_untraced(uart_wbp_device_t *device, uint8_t sel, uint32_t adr, const uint32_t *dat, int n, int keep_cyc)
+{
+	if (n <= 0) {
+		return unknown;
+	}
+
+	uart_wbp_start_deadline(device);
+	if (device->resync && uart_wbp_resync_bridge(device) < 0) {
+		return -1;
+	}
+
+	// any nonzero value of keep_cyc will do
+	if (keep_cyc) {
+		keep_cyc = 0x8;
+	}
+
+	// set sel and adr only if they are different from what the hardware has
+	uint8_t burst_msg[6+2+UART_WBP_BURST_MAX_WORDS*4];
+	int burst_msg_len = 0;
+	if (device->wb_sel != sel) {
+		burst_msg[burst_msg_len++] = uart_wbp_master_command_set_sel | (sel<<4); 
+	}
+	int adr_sel_idx = burst_msg_len;
+	burst_msg[adr_sel_idx] = uart_wbp_master_command_set_adr ; 
+	for (int i = 0; i < 4; ++i) {
+		if ((device->wb_adr&(0x000000ff<<(8*i))) != (adr&(0x000000ff)<<(8*i))) {
+			burst_msg[adr_sel_idx] |= (0x10<<i);
+			burst_msg[++burst_msg_len] = (adr>>(8*i))&0x000000ff;
+		}
+	}
+	if (burst_msg_len > adr_sel_idx) {
+		++burst_msg_len; 
+	} 
+
+	// split into bursts of at most UART_WBP_BURST_MAX_WORDS words, each of them gets one response. 
+	// The cycle is kept high between the bursts.
+	// If the host answers slave writes, the burst may target the own slave interface. The bridge
+	// does not read our slave response while it waits with the payload of a burst, so in that case
+	// each burst carries only one word and its response is collected before the next one is sent.
+	int max_words = UART_WBP_BURST_MAX_WORDS;
+	int wait_each = 0;
+	if (device->hw_config & host_sends_write_response) {
+		max_words = 1;
+		wait_each = (device->hw_config & fpga_sends_write_response) != 0;
+	}
+	uart_wbp_response_t result_response = ack;
+	int n_bursts = 0;
+	for (int word = 0; word < n; ) {
+		int count = n-word;
+		if (count > max_words) {
+			count = max_words;
+		}
+		int last = (word+count == n);
+		burst_msg[burst_msg_len++] = uart_wbp_master_command_burst_write | ((last?keep_cyc:0x8)<<4);
+		burst_msg[burst_msg_len++] = count-1;
+		for (int w = word; w < word+count; ++w) {
 			for (int i = 0; i < 4; ++i) {
 				if (sel&(1<<i)) {
-					uint8_t data_byte;
-					if (uart_wbp_buffered_read(device, &data_byte) < 0) {
-						fprintf(stderr, "Error reading from device\n");
-						return -1;
-					} else {
-						*dat |= (((uint32_t)data_byte)<<(8*i));				
+					burst_msg[burst_msg_len++] = (dat[w]>>(8*i))&0x000000ff;
+				}
+			}
+		}
+		int written = uart_wbp_write_all(device, burst_msg, burst_msg_len);
+		if (written == UART_WBP_TIMEOUT) {
+			return timeout;
+		}
+		if (written != burst_msg_len) {
+			fprintf(stderr, "uart_wbp_write_burst: Error writing data to hardware\n");
+			return -1;
+		}
+		burst_msg_len = 0;
+		word += count;
+		++n_bursts;
+		if (wait_each) {
+			if (uart_wbp_collect_write_responses(device, n_bursts, &result_response) == UART_WBP_TIMEOUT) {
+				return timeout;
+			}
+			n_bursts = 0;
+		}
+	}
+
+	// now that the data is written to the hardware, update 
+	// our representation of the hardware state
+	device->wb_sel = sel;
+	device->wb_adr = adr+4*n;
+	for (int i = 0; i < 4; ++i) {
+		if (sel & (1<<i)) {
+			device->wb_dat &= ~(0xff<<(i*8));
+			device->wb_dat |=  (0xff<<(i*8)) & dat[n-1];
+		}
+	}
+
+	if (!(device->hw_config & fpga_sends_write_response)) {
+		return unknown;
+	}
+
+	if (uart_wbp_collect_write_responses(device, n_bursts, &result_response) == UART_WBP_TIMEOUT) {
+		return timeout;
+	}
+	return result_response;
+}
+
+uart_wbp_response_t uart_wbp_write_burst(uart_wbp_device_t *device, uint8_t sel, uint32_t adr, const uint32_t *dat, int n, int keep_cyc)
+{
+	if (uart_wbp_tracing() == 0) {
+		return uart_wbp_write_burst_untraced(device, sel, adr, dat, n, keep_cyc);
+	}
+	uart_wbp_trace_begin(device);
+	uart_wbp_response_t response = uart_wbp_write_burst_untraced(device, sel, adr, dat, n, keep_cyc);
+	uart_wbp_trace_end(device, "write burst", adr, response);
+	device->trace_begin_ns = 0;
+	return response;
+}
+
+// the count byte of the burst read response has 7 bits, the bridge cannot answer longer bursts
+#if UART_WBP_BURST_READ_MAX_WORDS > 128
+#error "UART_WBP_BURST_READ_MAX_WORDS must not exceed 128 (count byte 127)"
+#endif
+
+// Append the requests of the next n_more bursts of a burst read of n words to msg (which has already 
+// msg_len bytes) and write them, *n_requested is the number of bursts that were requested so far
+static int uart_wbp_request_read_bursts(uart_wbp_device_t *device, uint8_t *msg, int msg_len, int msg_size, int *n_requested, int n_more, int n, int keep_cyc)
+{
+	int n_bursts_total = (n+UART_WBP_BURST_READ_MAX_WORDS-1)/UART_WBP_BURST_READ_MAX_WORDS;
+	for (int b = *n_requested; b < n_bursts_total && b < *n_requested+n_more; ++b) {
+		int count = n-b*UART_WBP_BURST_READ_MAX_WORDS;
+		if (count > UART_WBP_BURST_READ_MAX_WORDS) {
+			count = UART_WBP_BURST_READ_MAX_WORDS;
+		}
+		if (count-1 > 0x7f) {
+			fprintf(stderr, "uart_wbp_read_burst: Error: count byte %d exceeds the bridge limit of 127\n", count-1);
+			return -1;
+		}
+		int last = (b == n_bursts_total-1);
+		msg[msg_len++] = uart_wbp_master_command_burst_read | ((last?keep_cyc:0x8)<<4);
+		msg[msg_len++] = count-1;
+		if (msg_len+2 > msg_size || last || b+1 == *n_requested+n_more) {
+			int written = uart_wbp_write_all(device, msg, msg_len);
+			if (written == UART_WBP_TIMEOUT) {
+				return UART_WBP_TIMEOUT;
+			}
+			if (written != msg_len) {
+				fprintf(stderr, "uart_wbp_read_burst: Error writing data to hardware\n");
+				return -1;
+			}
+			msg_len = 0;
+		}
+	}
+	*n_requested += n_more;
+	if (*n_requested > n_bursts_total) {
+		*n_requested = n_bursts_total;
+	}
+	return 0;
+}
+
+uart_wbp_response_t uart_wbp_read_burst_untraced(uart_wbp_device_t *device, uint8_t sel, uint32_t adr, uint32_t *dat, int n, int keep_cyc)
+{
+	if (n <= 0) {
+		return unknown;
+	}
+
+	uart_wbp_start_deadline(device);
+	if (device->resync && uart_wbp_resync_bridge(device) < 0) {
+		return -1;
+	}
+
+	// any nonzero value of keep_cyc will do
+	if (keep_cyc) {
+		keep_cyc = 0x8;
+	}
+
+	// set sel and adr only if they are different from what the hardware has, 
+	// then request the bursts
+	uint8_t burst_msg[6+2*32];
+	int n_bursts_total = (n+UART_WBP_BURST_READ_MAX_WORDS-1)/UART_WBP_BURST_READ_MAX_WORDS;
+	int burst_msg_len = 0;
+	if (device->wb_sel != sel) {
+		burst_msg[burst_msg_len++] = uart_wbp_master_command_set_sel | (sel<<4); 
+	}
+	int adr_sel_idx = burst_msg_len;
+	burst_msg[adr_sel_idx] = uart_wbp_master_command_set_adr ; 
+	for (int i = 0; i < 4; ++i) {
+		if ((device->wb_adr&(0x000000ff<<(8*i))) != (adr&(0x000000ff)<<(8*i))) {
+			burst_msg[adr_sel_idx] |= (0x10<<i);
+			burst_msg[++burst_msg_len] = (adr>>(8*i))&0x000000ff;
+		}
+	}
+	if (burst_msg_len > adr_sel_idx) {
+		++burst_msg_len; 
+	} 
+	// While a burst is in progress, the bridge takes only the commands that serve its own slave interface.
+	// Without flow control the other requests wait in its receive FIFO (UART_WBP_RX_FIFO_DEPTH bytes) and 
+	// further bytes are lost, so only one burst is requested ahead, and the next one each time a response 
+	// is complete. If the host answers slave writes, the bursts may read the own slave interface. The bridge 
+	// takes the slave responses only from the head of its FIFO, so then each burst is requested after the 
+	// previous one was answered (like uart_wbp_write_burst).
+	int window = n_bursts_total;
+	if (device->hw_config & host_sends_write_response) {
+		window = 1;
+	} else if (!device->flow_control) {
+		window = 2;
+	}
+	int n_requested = 0;
+	int result = uart_wbp_request_read_bursts(device, burst_msg, burst_msg_len, sizeof(burst_msg), &n_requested, window, n, keep_cyc);
+	if (result < 0) {
+		return (result == UART_WBP_TIMEOUT) ? timeout : -1;
+	}
+
+	// now that the request is written to the hardware, update 
+	// our representation of the hardware state
+	device->wb_sel = sel;
+	device->wb_adr = adr+4*n;
+
+	// Each burst is answered with a header, the word count (minus one), the selected
+	// bytes of all words as a stream of 7-bit payload bytes (least significant bits first), 
+	// and a status byte. The result is the first status that is not ack.
+	int n_selected = 0;
+	for (int i = 0; i < 4; ++i) {
+		if (sel&(1<<i)) ++n_selected;
+	}
+	uart_wbp_response_t result_response = ack;
+	for (int b = 0; b < n_bursts_total; ) {
+		uint8_t header;
+		result = uart_wbp_read_header(device, &header, 0);
+		if (result == UART_WBP_TIMEOUT) {
+			device->deadline_ns = 0;
+			return timeout;
+		}
+		if (result < 0) {
+			fprintf(stderr, "uart_wbp_read_burst: Error reading reponse\n");
+			continue;
+		}
+		if (header != UART_WBP_BURST_READ_HEADER) {
+			fprintf(stderr, "uart_wbp_read_burst: Error: expect burst read response, got header %02x\n", header);
+			continue;
+		}
+		int count = n-b*UART_WBP_BURST_READ_MAX_WORDS;
+		if (count > UART_WBP_BURST_READ_MAX_WORDS) {
+			count = UART_WBP_BURST_READ_MAX_WORDS;
+		}
+		uint32_t *words = dat+b*UART_WBP_BURST_READ_MAX_WORDS;
+		int n_payload = (count*n_selected*8+6)/7;
+		uint8_t bytes[2+(UART_WBP_BURST_READ_MAX_WORDS*32+6)/7];
+		for (int i = 0; i < n_payload+2; ++i) {
+			result = uart_wbp_buffered_read(device, &bytes[i]);
+			if (result >= 0 && (bytes[i] & 0x80)) {
+				// the bridge may send slave requests between the words of a burst
+				uart_wbp_response_t request_type = ((bytes[i] >> 4)&0x7);
+				int handled;
+				if (request_type == write_request || request_type == write_req_norsp) {
+					handled = uart_wbp_handle_slave_write(device, bytes[i]);
+				} else if (request_type == write_response && (bytes[i] & 0x08)) {
+					handled = uart_wbp_handle_slave_delta_write(device, bytes[i]);
+				} else if (request_type == read_request) {
+					handled = uart_wbp_handle_slave_read(device, bytes[i]);
+				} else {
+					fprintf(stderr, "uart_wbp_read_burst: Error: unexpected header %02x in burst read response\n", bytes[i]);
+					handled = -1;
+				}
+				if (handled < 0) {
+					device->resync = 1;
+					device->deadline_ns = 0;
+					return -1;
+				}
+				--i;
+				continue;
+			}
+			if (result == UART_WBP_TIMEOUT) {
+				device->deadline_ns = 0;
+				return timeout;
+			} else if (result < 0) {
+				fprintf(stderr, "Error reading from device\n");
+				device->deadline_ns = 0;
+				return -1;
+			}
+		}
+		if (bytes[0] != count-1) {
+			fprintf(stderr, "uart_wbp_read_burst: Error: expect %d words, got %d\n", count, bytes[0]+1);
+			device->resync = 1;
+			device->deadline_ns = 0;
+			return -1;
+		}
+		// unpack the payload bits into the selected bytes of the words
+		uint32_t bits = 0;
+		int n_bits = 0;
+		int payload_idx = 1;
+		for (int w = 0; w < count; ++w) {
+			words[w] = 0;
+			for (int i = 0; i < 4; ++i) {
+				if (sel&(1<<i)) {
+					while (n_bits < 8) {
+						bits |= (uint32_t)(bytes[payload_idx++]&0x7f)<<n_bits;
+						n_bits += 7;
 					}
+					words[w] |= (bits&0xff)<<(8*i);
+					bits >>= 8;
+					n_bits -= 8;
 				}
 			}
 		}
-		return response_type;
+		uart_wbp_response_t response_type = (bytes[n_payload+1] & 0x7);
+		if (result_response == ack) {
+			result_response = response_type;
+		}
+		++b;
+		if (n_requested < n_bursts_total) {
+			result = uart_wbp_request_read_bursts(device, burst_msg, 0, sizeof(burst_msg), &n_requested, 1, n, keep_cyc);
+			if (result < 0) {
+				device->resync = 1; // some responses are still on their way
+				device->deadline_ns = 0;
+				return (result == UART_WBP_TIMEOUT) ? timeout : -1;
+			}
+		}
 	}
+	device->deadline_ns = 0;
+	return result_response;
+}
 
-	return err;
+uart_wbp_response_t uart_wbp_read_burst(uart_wbp_device_t *device, uint8_t sel, uint32_t adr, uint32_t *dat, int n, int keep_cyc)
+{
+	if (uart_wbp_tracing() == 0) {
+		return uart_wbp_read_burst_untraced(device, sel, adr, dat, n, keep_cyc);
+	}
+	uart_wbp_trace_begin(device);
+	uart_wbp_response_t response = uart_wbp_read_burst_untraced(device, sel, adr, dat, n, keep_cyc);
+	uart_wbp_trace_end(device, "read burst", adr, response);
+	device->trace_begin_ns = 0;
+	return response;
+}
+
+uart_wbp_response_t uart_wbp_modify(uart_wbp_device_t *device, uint32_t adr, uint32_t mask, uint32_t value, uint32_t *old)
+{
+	uint32_t dat;
+	// keep cyc high after the read, the write follows as soon as the response is there
+	uart_wbp_response_t response = uart_wbp_read(device, 0xf, adr, &dat, 0, 1);
+	if (response != ack) {
+		// release the bus
+		if (response != timeout) {
+			uart_wbp_read(device, 0xf, adr, &dat, 0, 0);
+		}
+		return response;
+	}
+	if (old) {
+		*old = dat;
+	}
+	return uart_wbp_write(device, 0xf, adr, (dat & ~mask) | (value & mask), 0, 0);
+}
+
+uart_wbp_response_t uart_wbp_set_bits(uart_wbp_device_t *device, uint32_t adr, uint32_t bits)
+{
+	return uart_wbp_modify(device, adr, bits, bits, NULL);
+}
+
+uart_wbp_response_t uart_wbp_clear_bits(uart_wbp_device_t *device, uint32_t adr, uint32_t bits)
+{
+	return uart_wbp_modify(device, adr, bits, 0, NULL);
+}
+
+uart_wbp_response_t uart_wbp_write_field(uart_wbp_device_t *device, uint32_t adr, int lsb, int width, uint32_t value)
+{
+	uint32_t mask = (width >= 32) ? 0xffffffff : ((1u<<width)-1);
+	return uart_wbp_modify(device, adr, mask<<lsb, value<<lsb, NULL);
+}
+
+uart_wbp_response_t uart_wbp_compare_and_swap(uart_wbp_device_t *device, uint32_t adr, uint32_t mask, uint32_t expected, uint32_t desired, uint32_t *old)
+{
+	uint32_t dat;
+	uart_wbp_response_t response = uart_wbp_read(device, 0xf, adr, &dat, 0, 1);
+	if (response == timeout) {
+		return response;
+	}
+	if (old && response == ack) {
+		*old = dat;
+	}
+	if (response != ack || (dat & mask) != (expected & mask)) {
+		// no swap, release the bus with a second read of the same register
+		uart_wbp_read(device, 0xf, adr, &dat, 0, 0);
+		return response;
+	}
+	return uart_wbp_write(device, 0xf, adr, (dat & ~mask) | (desired & mask), 0, 0);
+}
+
+// append the commands that set the adr-buffer register of the bridge to adr
+int uart_wbp_append_set_adr(uart_wbp_device_t *device, uint8_t *msg, int len, uint32_t adr) 
+{
+	int adr_sel_idx = len;
+	msg[adr_sel_idx] = uart_wbp_master_command_set_adr ; 
+	for (int i = 0; i < 4; ++i) {
+		if ((device->wb_adr&(0x000000ff<<(8*i))) != (adr&(0x000000ff)<<(8*i))) {
+			msg[adr_sel_idx] |= (0x10<<i);
+			msg[++len] = (adr>>(8*i))&0x000000ff;
+		}
+	}
+	if (len > adr_sel_idx) {
+		++len; 
+	} 
+	device->wb_adr = adr;
+	return len;
+}
+
+int uart_wbp_append_set_dat(uart_wbp_device_t *device, uint8_t *msg, int len, uint32_t dat) 
+{
+	int dat_sel_idx = len;
+	msg[dat_sel_idx] = uart_wbp_master_command_set_dat ; 
+	for (int i = 0; i < 4; ++i) {
+		if ((device->wb_dat&(0x000000ff<<(8*i))) != (dat&(0x000000ff)<<(8*i))) {
+			msg[dat_sel_idx] |= (0x10<<i);
+			msg[++len] = (dat>>(8*i))&0x000000ff;
+		}
+	}
+	if (len > dat_sel_idx) {
+		++len; 
+	} 
+	device->wb_dat = dat;
+	return len;
+}
+
+// One chunk of uart_wbp_modify_batch: the read strobes of the chunk are pipelined, then all write strobes 
+// are sent at once. Cyc stays high after the last write unless this is the last chunk. If a read is not 
+// acked, nothing is written, the bus is released, and *reads_acked is set to 0.
+static uart_wbp_response_t uart_wbp_modify_chunk(uart_wbp_device_t *device, const uint32_t *adr, int n, uint32_t mask, uint32_t value, int last, int *reads_acked)
+{
+	// read i is msg[read_end[i-1], read_end[i])
+	uint8_t msg[UART_WBP_MODIFY_BATCH_CHUNK*11+1];
+	int read_end[UART_WBP_MODIFY_BATCH_CHUNK];
+	int msg_len = 0;
+	if (device->wb_sel != 0xf) {
+		msg[msg_len++] = uart_wbp_master_command_set_sel | 0xf0; 
+		device->wb_sel = 0xf;
+	}
+	for (int i = 0; i < n; ++i) {
+		msg_len = uart_wbp_append_set_adr(device, msg, msg_len, adr[i]);
+		msg[msg_len++] = uart_wbp_master_command_read_stb | (0x8<<4);
+		read_end[i] = msg_len;
+	}
+
+	// The bridge takes the next read only when it can send the response of the previous one, the reads 
+	// wait in its receive FIFO meanwhile. Without flow control they must fit into it, so the reads are 
+	// sent as far as the responses come back. Collect the responses and compute the new values.
+	int credit = device->flow_control ? msg_len : UART_WBP_RX_FIFO_DEPTH;
+	int n_sent = 0;
+	uart_wbp_response_t result_response = ack;
+	uint32_t dat[UART_WBP_MODIFY_BATCH_CHUNK];
+	for (int i = 0; i < n; ++i) {
+		int answered_end = i ? read_end[i-1] : 0;
+		int end = n_sent;
+		while (end < n && (end == i || read_end[end]-answered_end <= credit)) {
+			++end;
+		}
+		if (end > n_sent) {
+			int begin = n_sent ? read_end[n_sent-1] : 0;
+			int written = uart_wbp_write_all(device, msg+begin, read_end[end-1]-begin);
+			if (written == UART_WBP_TIMEOUT) {
+				return timeout;
+			} else if (written != read_end[end-1]-begin) {
+				return -1;
+			}
+			n_sent = end;
+		}
+		uart_wbp_response_t response = uart_wbp_read_response(device, 0xf, &dat[i]);
+		if (response == timeout || (int)response < 0) {
+			return response;
+		}
+		if (result_response == ack) {
+			result_response = response;
+		}
+		dat[i] = (dat[i] & ~mask) | (value & mask);
+	}
+	if (result_response != ack) {
+		// release the bus without writing anything
+		*reads_acked = 0;
+		msg_len = uart_wbp_append_set_adr(device, msg, 0, adr[n-1]);
+		msg[msg_len++] = uart_wbp_master_command_read_stb;
+		uint32_t dummy;
+		if (uart_wbp_write_all(device, msg, msg_len) == msg_len) {
+			uart_wbp_read_response(device, 0xf, &dummy);
+		}
+		return result_response;
+	}
+
+	// all write strobes at once, the last one of the last chunk releases the bus
+	msg_len = 0;
+	for (int i = 0; i < n; ++i) {
+		msg_len = uart_wbp_append_set_dat(device, msg, msg_len, dat[i]);
+		msg_len = uart_wbp_append_set_adr(device, msg, msg_len, adr[i]);
+		msg[msg_len++] = uart_wbp_master_command_write_stb | ((last && i==n-1?0:0x8)<<4);
+	}
+	int written = uart_wbp_write_all(device, msg, msg_len);
+	if (written == UART_WBP_TIMEOUT) {
+		return timeout;
+	} else if (written != msg_len) {
+		return -1;
+	}
+
+	// collect the write responses
+	if (device->hw_config & fpga_sends_write_response) {
+		for (int i = 0; i < n; ++i) {
+			uint8_t header;
+			int result = uart_wbp_read_header(device, &header, 0);
+			if (result == UART_WBP_TIMEOUT) {
+				return timeout;
+			}
+			if (result < 0 || ((header & 0x70)>>4) != write_response) {
+				fprintf(stderr, "uart_wbp_modify_batch: Error: expect write response, got header %02x\n", header);
+				continue;
+			}
+			if (result_response == ack) {
+				result_response = (header & 0x7);
+			}
+		}
+	}
+	return result_response;
+}
+
+uart_wbp_response_t uart_wbp_modify_batch(uart_wbp_device_t *device, const uint32_t *adr, int n, uint32_t mask, uint32_t value)
+{
+	if (n <= 0) {
+		return unknown;
+	}
+	uart_wbp_start_deadline(device);
+	if (device->resync && uart_wbp_resync_bridge(device) < 0) {
+		return -1;
+	}
+
+	// If the host answers slave writes, the batch may address the own slave interface. 
+	// The bridge serves it only when one strobe at a time is in flight, so each chunk has one register.
+	int chunk = UART_WBP_MODIFY_BATCH_CHUNK;
+	if (device->hw_config & host_sends_write_response) {
+		chunk = 1;
+	}
+	uart_wbp_response_t result_response = ack;
+	int reads_acked = 1;
+	for (int i = 0; i < n; i += chunk) {
+		int count = (n-i < chunk) ? n-i : chunk;
+		uart_wbp_response_t response = uart_wbp_modify_chunk(device, adr+i, count, mask, value, i+count == n, &reads_acked);
+		if (response == timeout || (int)response < 0) {
+			device->deadline_ns = 0;
+			return response;
+		}
+		if (result_response == ack) {
+			result_response = response;
+		}
+		if (!reads_acked) {
+			break;
+		}
+	}
+	device->deadline_ns = 0;
+	return result_response;
+}
+
+// number of read strobes that uart_wbp_poll_until keeps in flight, and the limits of its backoff
+#define UART_WBP_POLL_WINDOW          4
+#define UART_WBP_POLL_BACKOFF_MIN_US  50
+#define UART_WBP_POLL_BACKOFF_MAX_US  10000
+
+uart_wbp_response_t uart_wbp_poll_until(uart_wbp_device_t *device, uint8_t sel, uint32_t adr, uint32_t mask, uint32_t value, int timeout_ms, uint32_t *dat)
+{
+	uart_wbp_start_deadline(device);
+	if (timeout_ms >= 0) {
+		int64_t deadline_ns = uart_wbp_monotonic_ns() + (int64_t)timeout_ms*1000000;
+		if (device->deadline_ns == 0 || deadline_ns < device->deadline_ns) {
+			device->deadline_ns = deadline_ns;
+		}
+	}
+	if (device->resync && uart_wbp_resync_bridge(device) < 0) {
+		return -1;
+	}
+
+	// the first read sets sel and adr if needed, all others are a single read-stb byte
+	uint8_t msg[7+UART_WBP_POLL_WINDOW];
+	int msg_len = 0;
+	if (device->wb_sel != sel) {
+		msg[msg_len++] = uart_wbp_master_command_set_sel | (sel<<4); 
+		device->wb_sel = sel;
+	}
+	msg_len = uart_wbp_append_set_adr(device, msg, msg_len, adr);
+	// If the host answers slave writes, the register may be on the own slave interface,
+	// which is served only when one read at a time is in flight (see uart_wbp_modify_batch).
+	int window = UART_WBP_POLL_WINDOW;
+	if (device->hw_config & host_sends_write_response) {
+		window = 1;
+	}
+	for (int i = 0; i < window; ++i) {
+		msg[msg_len++] = uart_wbp_master_command_read_stb;
+	}
+
+	int written = uart_wbp_write_all(device, msg, msg_len);
+	if (written != msg_len) {
+		device->deadline_ns = 0;
+		return (written == UART_WBP_TIMEOUT) ? timeout : -1;
+	}
+
+	int in_flight = window;
+	int misses = 0;
+	int backoff_us = 0;
+	uart_wbp_response_t result_response = -1;
+	uint32_t data;
+	while (in_flight > 0) {
+		uart_wbp_response_t response = uart_wbp_read_response(device, sel, &data);
+		if (response == timeout || (int)response < 0) {
+			device->resync = 1; // some responses are still on their way
+			device->deadline_ns = 0;
+			return response;
+		}
+		--in_flight;
+		if (result_response != (uart_wbp_response_t)-1) {
+			// done, only drain the reads that are still in flight
+			continue;
+		}
+		if (response != ack || (data & mask) == (value & mask)) {
+			result_response = response;
+			if (dat) {
+				*dat = data;
+			}
+			continue;
+		}
+		// no match: wait a bit longer each time before the next read, but never past the deadline
+		if (backoff_us > 0) {
+			int remaining_ms = uart_wbp_remaining_ms(device);
+			if (remaining_ms == 0) {
+				device->resync = 1;
+				device->deadline_ns = 0;
+				return timeout;
+			}
+			struct timespec delay;
+			int delay_us = backoff_us;
+			if (remaining_ms > 0 && delay_us > remaining_ms*1000) {
+				delay_us = remaining_ms*1000;
+			}
+			delay.tv_sec  = 0;
+			delay.tv_nsec = delay_us*1000;
+			nanosleep(&delay, NULL);
+		}
+		if (++misses % window == 0) {
+			// a whole window of misses, back off (more)
+			backoff_us = backoff_us ? 2*backoff_us : UART_WBP_POLL_BACKOFF_MIN_US;
+			if (backoff_us > UART_WBP_POLL_BACKOFF_MAX_US) {
+				backoff_us = UART_WBP_POLL_BACKOFF_MAX_US;
+			}
+		}
+		msg[0] = uart_wbp_master_command_read_stb;
+		written = uart_wbp_write_all(device, msg, 1);
+		if (written != 1) {
+			device->deadline_ns = 0;
+			return (written == UART_WBP_TIMEOUT) ? timeout : -1;
+		}
+		++in_flight;
+	}
+	device->deadline_ns = 0;
+	return result_response;
 }
 
 int uart_wbp_wait_single(uart_wbp_device_t *device, int timeout)
@@ -677,7 +1970,9 @@ int uart_wbp_wait_single(uart_wbp_device_t *device, int timeout)
 			return -1; // error
 		}
 		if (pfd[0].revents & POLLIN) {
+			// the request and the response of the handler share one deadline
 			uint8_t header;
+			uart_wbp_start_deadline(device);
 			if (uart_wbp_read_header(device, &header, 1) < 0) {
 				fprintf(stderr, "Error: cannot read header\n");
 				return -1; // error
@@ -707,3 +2002,58 @@ int uart_wbp_wait(uart_wbp_device_t *device, int timeout)
 	return result;
 }
 
+
+int uart_wbp_slave_cache_command(uart_wbp_device_t *device, uint8_t *msg, int msg_len)
+{
+	int written = uart_wbp_write_all(device, msg, msg_len);
+	if (written != msg_len) {
+		fprintf(stderr, "uart_wbp_slave_cache: Error writing data to hardware\n");
+		return -1;
+	}
+	return 0;
+}
+
+#define UART_WBP_SLAVE_CACHE_CHUNK 64
+int uart_wbp_slave_cache_fill(uart_wbp_device_t *device, uint32_t adr, const uint32_t *dat, int n)
+{
+	uart_wbp_start_deadline(device);
+	if (device->resync && uart_wbp_resync_bridge(device) < 0) {
+		return -1;
+	}
+	// set dat, set adr, and fill for each word
+	uint8_t msg[UART_WBP_SLAVE_CACHE_CHUNK*11];
+	for (int word = 0; word < n; word += UART_WBP_SLAVE_CACHE_CHUNK) {
+		int msg_len = 0;
+		for (int i = word; i < n && i < word+UART_WBP_SLAVE_CACHE_CHUNK; ++i) {
+			msg_len = uart_wbp_append_set_dat(device, msg, msg_len, dat[i]);
+			msg_len = uart_wbp_append_set_adr(device, msg, msg_len, adr+4*i);
+			msg[msg_len++] = uart_wbp_master_command_slave_cache | UART_WBP_SLAVE_CACHE_FILL;
+		}
+		if (uart_wbp_slave_cache_command(device, msg, msg_len) < 0) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int uart_wbp_slave_cache_invalidate(uart_wbp_device_t *device, uint32_t adr)
+{
+	uart_wbp_start_deadline(device);
+	if (device->resync && uart_wbp_resync_bridge(device) < 0) {
+		return -1;
+	}
+	uint8_t msg[6];
+	int msg_len = uart_wbp_append_set_adr(device, msg, 0, adr);
+	msg[msg_len++] = uart_wbp_master_command_slave_cache | UART_WBP_SLAVE_CACHE_INVALIDATE;
+	return uart_wbp_slave_cache_command(device, msg, msg_len);
+}
+
+int uart_wbp_slave_cache_invalidate_all(uart_wbp_device_t *device)
+{
+	uart_wbp_start_deadline(device);
+	if (device->resync && uart_wbp_resync_bridge(device) < 0) {
+		return -1;
+	}
+	uint8_t msg = uart_wbp_master_command_slave_cache | UART_WBP_SLAVE_CACHE_INVALIDATE_ALL;
+	return uart_wbp_slave_cache_command(device, &msg, 1);
+}
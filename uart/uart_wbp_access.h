@@ -5,6 +5,12 @@
 #include <unistd.h>
 #include <stdint.h>
 
+#include "uart_wbp_queue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 typedef enum uart_wbp_response {
 	write_response  = 0,
 	ack             = 1,
@@ -16,6 +22,9 @@ typedef enum uart_wbp_response {
 	read_request    = 7, // 111
 	// if write response is disabled, unknown is returned
 	unknown        = 8, 
+	// if no response arrived before the deadline, timeout is returned
+	// and the device is marked for resync (see uart_wbp_resync)
+	timeout        = 9,
 } uart_wbp_response_t;
 
 const char* uart_wbp_response_str(uart_wbp_response_t response);
@@ -24,14 +33,16 @@ const char* uart_wbp_response_str(uart_wbp_response_t response);
 typedef enum uart_wbp_config {
 	host_sends_write_response = 1,
 	fpga_sends_write_response = 2,
-	// ..                     = 4,
+	// posted slave writes with sel=0xf are sent as delta write frames (see uart_wbp_handle_slave_delta_write)
+	delta_slave_writes        = 4,
 	// ..                     = 8,
 } uart_wbp_config_t;
 
 typedef uart_wbp_response_t (*uart_wbp_slave_write_handler_f)(uint8_t sel, uint32_t adr, uint32_t dat);
 typedef uart_wbp_response_t (*uart_wbp_slave_read_handler_f)(uint8_t sel, uint32_t adr, uint32_t *dat);
 
-#define UART_WBP_BUFFER_SIZE 256
+#define UART_WBP_BUFFER_DEPTH 8
+#define UART_WBP_BUFFER_SIZE  (1<<UART_WBP_BUFFER_DEPTH)
 typedef struct uart_wbp_device
 {
 	// the file descriptor to read/write the device
@@ -42,29 +53,160 @@ typedef struct uart_wbp_device
 	uint32_t wb_adr;
 	uint8_t  wb_sel;
 	uart_wbp_config_t  hw_config;
+	// the address after the last slave write, delta write frames are relative to it
+	uint32_t slave_write_next;
 	
-	// a ringbuffer for incoming data
-	uint8_t  buffer[UART_WBP_BUFFER_SIZE];
-	uint32_t buffer_top_idx;    // buffer contains valid data until this index
-	uint32_t buffer_read_idx;   // read index into the buffer
+	// a ringbuffer for incoming data, read() writes directly into the free slots
+	uart_wbp_queue_t rx;
+	uint8_t  rx_storage[UART_WBP_BUFFER_SIZE];
+	// bytes are taken from the ringbuffer in blocks, rx_block[rx_pos, rx_len) are not read yet
+	uint8_t  rx_block[UART_WBP_BUFFER_SIZE/4];
+	int      rx_pos, rx_len;
 
 	// callbacks for when the slave is accessed
 	uart_wbp_slave_write_handler_f write_handler;
 	uart_wbp_slave_read_handler_f  read_handler;
 
+	// deadlines for device access, all times are on CLOCK_MONOTONIC
+	int      timeout_ms;        // per-call timeout, -1 means wait forever
+	int64_t  batch_deadline_ns; // deadline for all calls until it is cleared, 0 means none
+	int64_t  deadline_ns;       // deadline of the call in progress, 0 means none
+
+	// after a timeout the hardware state is unknown and the bridge is
+	// reset with the next access (see uart_wbp_resync). These values are restored afterwards.
+	int      resync;
+	// a write was interrupted in the middle of a command, the resync needs the full reset 
+	int      partial_write;
+	uint32_t stall_timeout;
+	uint32_t gpo_bits;
+
+	// RTS/CTS hardware flow control is enabled, the file descriptor is non-blocking
+	int      flow_control;
+
+	// timestamps of the transaction in progress for tracing (see uart_wbp_trace_enable)
+	int64_t  trace_begin_ns;
+	int64_t  trace_written_ns;
+	int64_t  trace_first_byte_ns;
+
 } uart_wbp_device_t;
 
 uart_wbp_device_t* uart_wbp_open(const char* device_name, speed_t speed, int verbose);
 void               uart_wbp_close(uart_wbp_device_t *device);
 
-void uart_wbp_set_stall_timeout(uart_wbp_device_t *device, int timeout);
-void uart_wbp_configure(uart_wbp_device_t *device, uart_wbp_config_t flags);
-void uart_wbp_set_gpo_bits(uart_wbp_device_t *device, uint32_t bits);
+// These return 0, or -1 if the setting could not be sent (e.g. a timeout, 
+// then the device is marked for resync and the setting is not applied).
+int  uart_wbp_set_stall_timeout(uart_wbp_device_t *device, int timeout);
+int  uart_wbp_configure(uart_wbp_device_t *device, uart_wbp_config_t flags);
+int  uart_wbp_set_gpo_bits(uart_wbp_device_t *device, uint32_t bits);
+
+// Enable (rtscts=1) or disable (rtscts=0) RTS/CTS hardware flow control. The bridge deasserts RTS 
+// when its receive buffer is almost full, the host then stops sending until it is asserted again. 
+// Required to send long pipelined sequences of commands at full baud rate.
+int  uart_wbp_set_flow_control(uart_wbp_device_t *device, int rtscts);
+// Bytes that the bridge buffers while it cannot take commands (g_rx_fifo_depth of uart_wbp.vhd). 
+// Without flow control, the accesses never have more request bytes waiting in this buffer.
+#define UART_WBP_RX_FIFO_DEPTH 16
 
 uart_wbp_response_t uart_wbp_write(uart_wbp_device_t *device, uint8_t sel, uint32_t adr, uint32_t dat, int delta_adr, int keep_cyc);
 uart_wbp_response_t uart_wbp_read(uart_wbp_device_t *device, uint8_t sel, uint32_t adr, uint32_t *dat, int delta_adr, int keep_cyc);
 
+// Send the command bytes of a single write/read strobe that were prepared by the caller (e.g. at compile time,
+// see uart_wbp_access.hpp) and wait for the response. sel, adr, and dat are the values that msg leaves in the 
+// sel, adr (after the strobe), and dat registers of the bridge. Fails if the device needs a resync (see uart_wbp_resync).
+uart_wbp_response_t uart_wbp_write_prepared(uart_wbp_device_t *device, const uint8_t *msg, int len, uint8_t sel, uint32_t adr, uint32_t dat);
+uart_wbp_response_t uart_wbp_read_prepared(uart_wbp_device_t *device, const uint8_t *msg, int len, uint8_t sel, uint32_t adr, uint32_t *dat);
+
+// Write n words to consecutive addresses starting at adr, using the burst write command.
+// The bridge answers each burst of up to UART_WBP_BURST_MAX_WORDS words with one response,
+// the returned value is ack if all strobes were acked, otherwise the first other response.
+// If the host sends slave write responses (the burst may go to the own slave interface),
+// each word is sent as a burst of its own and its response is awaited before the next one.
+#define UART_WBP_BURST_MAX_WORDS 256
+uart_wbp_response_t uart_wbp_write_burst(uart_wbp_device_t *device, uint8_t sel, uint32_t adr, const uint32_t *dat, int n, int keep_cyc);
+
+// Read n words from consecutive addresses starting at adr, using the burst read command.
+// Each burst of up to UART_WBP_BURST_READ_MAX_WORDS words is answered with one packed response,
+// the returned value is ack if all strobes were acked, otherwise the first other response.
+// The bridge keeps the following requests in its receive FIFO while a burst is in progress. Without flow control 
+// only one burst is requested ahead, so that the FIFO does not overflow. If the host sends slave write responses 
+// (the bursts may read the own slave interface), each burst is requested after the previous one was answered.
+#define UART_WBP_BURST_READ_MAX_WORDS 128
+uart_wbp_response_t uart_wbp_read_burst(uart_wbp_device_t *device, uint8_t sel, uint32_t adr, uint32_t *dat, int n, int keep_cyc);
+
+// Atomic read-modify-write of a full 32-bit register: the read strobe keeps cyc high and the write
+// strobe is sent as soon as the read response arrived, so no other master can access the register in between.
+// uart_wbp_modify writes (old & ~mask) | (value & mask) and stores the old value in *old (if old is not NULL).
+// If the read is not acked, nothing is written and the bus is released with another read of the register.
+// This takes two round trips: the written value depends on the read response, and the write is not posted 
+// because its response is part of the result (use uart_wbp_modify_batch to modify many registers).
+uart_wbp_response_t uart_wbp_modify(uart_wbp_device_t *device, uint32_t adr, uint32_t mask, uint32_t value, uint32_t *old);
+uart_wbp_response_t uart_wbp_set_bits(uart_wbp_device_t *device, uint32_t adr, uint32_t bits);
+uart_wbp_response_t uart_wbp_clear_bits(uart_wbp_device_t *device, uint32_t adr, uint32_t bits);
+uart_wbp_response_t uart_wbp_write_field(uart_wbp_device_t *device, uint32_t adr, int lsb, int width, uint32_t value);
+// The bits in mask are replaced by desired only if they are equal to expected. 
+// The swap happened if the response is ack and (*old & mask) == (expected & mask).
+// *old is only written if the read was acked.
+uart_wbp_response_t uart_wbp_compare_and_swap(uart_wbp_device_t *device, uint32_t adr, uint32_t mask, uint32_t expected, uint32_t desired, uint32_t *old);
+// Apply the same modification to n registers in chunks of UART_WBP_MODIFY_BATCH_CHUNK registers. 
+// The reads of a chunk are pipelined (without flow control only as many as fit into the receive FIFO 
+// of the bridge, see UART_WBP_RX_FIFO_DEPTH), then all its writes are sent at once, and cyc stays high 
+// for the whole batch. 
+// If a read is not acked, nothing is written from that chunk on (earlier chunks stay modified).
+// If the host sends slave write responses, each chunk has one register, so the batch can address 
+// the slave interface of the bridge (this needs fpga_sends_write_response as well). 
+// Otherwise the addressed slaves must respond without the host.
+#define UART_WBP_MODIFY_BATCH_CHUNK 64
+uart_wbp_response_t uart_wbp_modify_batch(uart_wbp_device_t *device, const uint32_t *adr, int n, uint32_t mask, uint32_t value);
+
+// Read the register at adr until (dat & mask) == (value & mask), at most timeout_ms milliseconds 
+// (-1 waits forever, the deadlines set with uart_wbp_set_timeout/uart_wbp_set_deadline apply as well).
+// A few reads are kept in flight, each re-read is a single byte. The time between re-reads grows while 
+// the condition is not met. Returns ack when the condition is met (the last value is stored in *dat
+// if dat is not NULL), timeout if the deadline passed, or the response of a read that was not acked.
+// Like uart_wbp_modify_batch, this can be used for the slave interface of the bridge only if the host 
+// sends slave write responses, then only one read is kept in flight.
+uart_wbp_response_t uart_wbp_poll_until(uart_wbp_device_t *device, uint8_t sel, uint32_t adr, uint32_t mask, uint32_t value, int timeout_ms, uint32_t *dat);
+
+// Put n words into the cache of the slave interface of the bridge, for the addresses adr, adr+4, ...
+// Reads of FPGA logic from these addresses are then answered by the bridge without calling the read handler.
+// The cache has g_slave_cache_entries words (see uart_wbp.vhd), older entries are replaced round robin.
+// A bridge reset (see uart_wbp_resync) clears the cache.
+int uart_wbp_slave_cache_fill(uart_wbp_device_t *device, uint32_t adr, const uint32_t *dat, int n);
+int uart_wbp_slave_cache_invalidate(uart_wbp_device_t *device, uint32_t adr);
+int uart_wbp_slave_cache_invalidate_all(uart_wbp_device_t *device);
+
+// Limit the time that uart_wbp_write and uart_wbp_read wait for a response.
+// uart_wbp_set_timeout applies to each call separately (writing the request, waiting for
+// the response, and a resync if needed share one deadline), uart_wbp_set_deadline 
+// applies to all calls from now on until it is cleared by passing -1.
+// If both are set, the earlier one is effective.
+void uart_wbp_set_timeout(uart_wbp_device_t *device, int timeout_ms);
+void uart_wbp_set_deadline(uart_wbp_device_t *device, int timeout_ms);
+// Reset the bridge and restore configuration, stall timeout, and gpo bits (the accesses do this 
+// automatically after a timeout). The bridge abandons an incomplete command after 5 ms without a byte, 
+// so the resync waits 10 ms and sends a few reset commands. uart_wbp_open, and a resync after a write 
+// that was interrupted in the middle, send 1026 reset commands instead (about 90 ms at 115200 baud). 
+// If the bridge did not abandon an interrupted burst write, these are written as data (up to 256 words 0x0b0b0b0b).
+int  uart_wbp_resync(uart_wbp_device_t *device);
+
+// Record a timeline of each transaction (uart_wbp_write/read/write_burst/read_burst): begin, 
+// completion of the write() of the request, arrival of the first response byte, and end. 
+// Calls of the slave write/read handlers are recorded as well. Each thread records into its own 
+// buffer of records_per_thread entries, recording stops when it is full. 0 disables tracing.
+// Call it before the threads start to access devices.
+int uart_wbp_trace_enable(int records_per_thread);
+// Write all records in Chrome trace event format (JSON), which can be viewed with chrome://tracing or Perfetto.
+int uart_wbp_trace_export(const char *filename);
+// Free all records and disable tracing. Threads write into their buffers without a lock, so call it 
+// only when no other thread accesses a device or calls uart_wbp_trace_export (e.g. after joining them). 
+// Tracing can be enabled again afterwards.
+void uart_wbp_trace_free(void);
+
 int uart_wbp_wait_single(uart_wbp_device_t *device, int timeout);
 int uart_wbp_wait(uart_wbp_device_t *device, int timeout);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
\ No newline at end of file
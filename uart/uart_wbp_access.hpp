@@ -0,0 +1,262 @@
+#ifndef UART_WBP_ACCESS_HPP_
+#define UART_WBP_ACCESS_HPP_
+
+// Header-only C++17 layer on top of uart_wbp_access.h.
+//
+// Registers and fields are types, so that addresses, sel bits, masks, and shifts
+// are compile-time constants:
+//
+//   using ctrl    = uart_wbp::reg<0x100>;
+//   using enable  = uart_wbp::field<ctrl, 0, 1>;
+//   using clk_div = uart_wbp::field<ctrl, 8, 8>;
+//
+//   uart_wbp::device dev("/dev/ttyUSB0");
+//   dev.write<ctrl>(0x12345678);
+//   dev.write_field<enable>(1);            // atomic read-modify-write
+//   uint32_t d; dev.read_field<clk_div>(d); // reads only the byte lanes of the field
+//
+// The command bytes of register writes/reads are built at compile time (see commands), 
+// only the data bytes are filled in at run time. Nothing in here allocates memory.
+
+#include "uart_wbp_access.h"
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+#if __cplusplus >= 202002L
+#include <span>
+#endif
+
+namespace uart_wbp {
+
+// the sel bits of all byte lanes that are touched by mask
+constexpr uint8_t sel_of_mask(uint32_t mask) {
+	return ((mask & 0x000000ff) ? 0x1 : 0)
+	     | ((mask & 0x0000ff00) ? 0x2 : 0)
+	     | ((mask & 0x00ff0000) ? 0x4 : 0)
+	     | ((mask & 0xff000000) ? 0x8 : 0);
+}
+
+constexpr uint32_t mask_of_width(unsigned width) {
+	return width >= 32 ? 0xffffffff : ((uint32_t(1) << width) - 1);
+}
+
+constexpr unsigned lanes_of_sel(uint8_t sel) {
+	return (sel & 0x1) + ((sel >> 1) & 0x1) + ((sel >> 2) & 0x1) + ((sel >> 3) & 0x1);
+}
+
+// command codes of the bridge (see the protocol specification in README.md)
+namespace command {
+	constexpr uint8_t set_sel   = 1;
+	constexpr uint8_t set_dat   = 2;
+	constexpr uint8_t set_adr   = 3;
+	constexpr uint8_t write_stb = 4;
+	constexpr uint8_t read_stb  = 5;
+	constexpr uint8_t keep_cyc  = 0x80;
+}
+
+// Command bytes of a single access to a register or field (anything with adr and sel).
+// select sets the sel register and all address bytes of the bridge, it is sent only if the 
+// bridge has other values in these registers. set_dat is followed by the bytes of the selected lanes.
+template <typename Reg>
+struct commands {
+	static constexpr std::array<uint8_t, 6> select = {
+		uint8_t(command::set_sel | (Reg::sel << 4)),
+		uint8_t(command::set_adr | 0xf0),
+		uint8_t(Reg::adr), uint8_t(Reg::adr >> 8), uint8_t(Reg::adr >> 16), uint8_t(Reg::adr >> 24),
+	};
+	static constexpr uint8_t     set_dat  = uint8_t(command::set_dat | (Reg::sel << 4));
+	static constexpr std::size_t max_size = select.size() + 1 + lanes_of_sel(Reg::sel) + 1;
+};
+
+template <uint32_t Adr>
+struct reg {
+	static_assert((Adr & 0x3) == 0, "register address must be 32-bit aligned");
+	static constexpr uint32_t adr  = Adr;
+	static constexpr uint32_t mask = 0xffffffff;
+	static constexpr uint8_t  sel  = 0xf;
+};
+
+template <typename Reg, unsigned Lsb, unsigned Width>
+struct field {
+	static_assert(Width > 0 && Lsb + Width <= 32, "field does not fit into a 32-bit register");
+	using reg_type = Reg;
+	static constexpr uint32_t adr   = Reg::adr;
+	static constexpr unsigned shift = Lsb;
+	static constexpr unsigned width = Width;
+	static constexpr uint32_t mask  = mask_of_width(Width) << Lsb;
+	static constexpr uint8_t  sel   = sel_of_mask(mask);
+
+	static constexpr uint32_t insert(uint32_t value) { return (value << Lsb) & mask; }
+	static constexpr uint32_t extract(uint32_t dat)  { return (dat & mask) >> Lsb; }
+};
+
+// owns a uart_wbp_device_t
+class device {
+public:
+	explicit device(const char *name, speed_t speed = B2000000, int verbose = 0)
+		: dev_(uart_wbp_open(name, speed, verbose)) {
+		if (dev_ == nullptr) {
+			throw std::runtime_error("uart_wbp: cannot open device");
+		}
+	}
+	~device() {
+		if (dev_) {
+			uart_wbp_close(dev_);
+		}
+	}
+	device(const device&) = delete;
+	device& operator=(const device&) = delete;
+	device(device &&other) noexcept : dev_(other.dev_) { other.dev_ = nullptr; }
+	device& operator=(device &&other) noexcept {
+		if (this != &other) {
+			if (dev_) {
+				uart_wbp_close(dev_);
+			}
+			dev_ = other.dev_;
+			other.dev_ = nullptr;
+		}
+		return *this;
+	}
+
+	uart_wbp_device_t *get() const { return dev_; }
+
+	template <typename Reg>
+	uart_wbp_response_t write(uint32_t dat, bool keep_cyc = false) {
+		if (dev_->resync) {
+			// the C layer resyncs first
+			return uart_wbp_write(dev_, Reg::sel, Reg::adr, dat, 0, keep_cyc);
+		}
+		uint8_t msg[commands<Reg>::max_size];
+		std::size_t len = select<Reg>(msg);
+		msg[len++] = commands<Reg>::set_dat;
+		for (unsigned i = 0; i < 4; ++i) {
+			if (Reg::sel & (1u << i)) {
+				msg[len++] = uint8_t(dat >> (8 * i));
+			}
+		}
+		msg[len++] = command::write_stb | (keep_cyc ? command::keep_cyc : 0);
+		return uart_wbp_write_prepared(dev_, msg, static_cast<int>(len), Reg::sel, Reg::adr, dat);
+	}
+	template <typename Reg>
+	uart_wbp_response_t read(uint32_t &dat, bool keep_cyc = false) {
+		if (dev_->resync) {
+			return uart_wbp_read(dev_, Reg::sel, Reg::adr, &dat, 0, keep_cyc);
+		}
+		uint8_t msg[commands<Reg>::max_size];
+		std::size_t len = select<Reg>(msg);
+		msg[len++] = command::read_stb | (keep_cyc ? command::keep_cyc : 0);
+		return uart_wbp_read_prepared(dev_, msg, static_cast<int>(len), Reg::sel, Reg::adr, &dat);
+	}
+
+	// Write a field with an atomic read-modify-write of its register. A field that
+	// covers whole byte lanes is written directly with the sel bits of these lanes.
+	template <typename Field>
+	uart_wbp_response_t write_field(uint32_t value) {
+		if constexpr (Field::mask == mask_of_sel(Field::sel)) {
+			return write<Field>(Field::insert(value));
+		} else {
+			return uart_wbp_modify(dev_, Field::adr, Field::mask, Field::insert(value), nullptr);
+		}
+	}
+	// Only the byte lanes of the field are read
+	template <typename Field>
+	uart_wbp_response_t read_field(uint32_t &value) {
+		uint32_t dat = 0;
+		uart_wbp_response_t response = read<Field>(dat);
+		value = Field::extract(dat);
+		return response;
+	}
+	template <typename Reg>
+	uart_wbp_response_t set_bits(uint32_t bits) {
+		return uart_wbp_set_bits(dev_, Reg::adr, bits);
+	}
+	template <typename Reg>
+	uart_wbp_response_t clear_bits(uint32_t bits) {
+		return uart_wbp_clear_bits(dev_, Reg::adr, bits);
+	}
+	template <typename Field>
+	uart_wbp_response_t poll_until(uint32_t value, int timeout_ms) {
+		return uart_wbp_poll_until(dev_, Field::sel, Field::adr, Field::mask, Field::insert(value), timeout_ms, nullptr);
+	}
+
+	// block transfers to/from consecutive addresses with burst commands
+	uart_wbp_response_t write_block(uint32_t adr, const uint32_t *dat, std::size_t n) {
+		return uart_wbp_write_burst(dev_, 0xf, adr, dat, static_cast<int>(n), 0);
+	}
+	uart_wbp_response_t read_block(uint32_t adr, uint32_t *dat, std::size_t n) {
+		return uart_wbp_read_burst(dev_, 0xf, adr, dat, static_cast<int>(n), 0);
+	}
+#if __cplusplus >= 202002L
+	uart_wbp_response_t write_block(uint32_t adr, std::span<const uint32_t> dat) {
+		return write_block(adr, dat.data(), dat.size());
+	}
+	uart_wbp_response_t read_block(uint32_t adr, std::span<uint32_t> dat) {
+		return read_block(adr, dat.data(), dat.size());
+	}
+#endif
+
+private:
+	// the select commands, if the sel and adr registers of the bridge don't have the values of Reg already
+	template <typename Reg>
+	std::size_t select(uint8_t *msg) const {
+		std::size_t len = 0;
+		if (dev_->wb_sel != Reg::sel || dev_->wb_adr != Reg::adr) {
+			for (uint8_t byte : commands<Reg>::select) {
+				msg[len++] = byte;
+			}
+		}
+		return len;
+	}
+
+	static constexpr uint32_t mask_of_sel(uint8_t sel) {
+		return ((sel & 0x1) ? 0x000000ff : 0)
+		     | ((sel & 0x2) ? 0x0000ff00 : 0)
+		     | ((sel & 0x4) ? 0x00ff0000 : 0)
+		     | ((sel & 0x8) ? 0xff000000 : 0);
+	}
+
+	uart_wbp_device_t *dev_;
+};
+
+// All accesses in this scope share one deadline (see uart_wbp_set_deadline).
+// The deadline that was set before is restored at the end of the scope.
+class deadline_scope {
+public:
+	deadline_scope(device &dev, int timeout_ms) : dev_(dev.get()), previous_ns_(dev_->batch_deadline_ns) {
+		uart_wbp_set_deadline(dev_, timeout_ms);
+	}
+	~deadline_scope() { dev_->batch_deadline_ns = previous_ns_; }
+	deadline_scope(const deadline_scope&) = delete;
+	deadline_scope& operator=(const deadline_scope&) = delete;
+private:
+	uart_wbp_device_t *dev_;
+	int64_t            previous_ns_;
+};
+
+// Writes in this scope are posted: the bridge does not send write responses, so the writes
+// don't wait for each other. When the scope ends, the previous configuration is restored
+// and one read of sync_adr makes sure that all writes were done.
+class posted_writes {
+public:
+	posted_writes(device &dev, uint32_t sync_adr)
+		: dev_(dev.get()), config_(dev_->hw_config), sync_adr_(sync_adr) {
+		uart_wbp_configure(dev_, static_cast<uart_wbp_config_t>(config_ & ~fpga_sends_write_response));
+	}
+	~posted_writes() {
+		uart_wbp_configure(dev_, config_);
+		uint32_t dat;
+		uart_wbp_read(dev_, 0xf, sync_adr_, &dat, 0, 0);
+	}
+	posted_writes(const posted_writes&) = delete;
+	posted_writes& operator=(const posted_writes&) = delete;
+private:
+	uart_wbp_device_t *dev_;
+	uart_wbp_config_t  config_;
+	uint32_t           sync_adr_;
+};
+
+} // namespace uart_wbp
+
+#endif
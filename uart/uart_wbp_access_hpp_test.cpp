@@ -0,0 +1,90 @@
+// Compiles uart_wbp_access.hpp and checks the command bytes that it builds at compile time. 
+// With a device name (e.g. of the loopback testbench) the register accessors are checked 
+// against the slave interface of the bridge.
+#include "uart_wbp_access.hpp"
+
+#include <cassert>
+#include <cstdio>
+#include <type_traits>
+#include <utility>
+
+using ctrl    = uart_wbp::reg<0x12345678>;
+using enable  = uart_wbp::field<ctrl, 0, 1>;
+using clk_div = uart_wbp::field<ctrl, 8, 8>;
+using status  = uart_wbp::reg<0x100>;
+
+// command bytes of ctrl: set sel 0xf, set all 4 address bytes, set dat with 4 data bytes, strobe
+static_assert(uart_wbp::commands<ctrl>::select[0] == 0xf1);
+static_assert(uart_wbp::commands<ctrl>::select[1] == 0xf3);
+static_assert(uart_wbp::commands<ctrl>::select[2] == 0x78 && uart_wbp::commands<ctrl>::select[5] == 0x12);
+static_assert(uart_wbp::commands<ctrl>::set_dat == 0xf2);
+static_assert(uart_wbp::commands<ctrl>::max_size == 12);
+// clk_div covers byte lane 1 only
+static_assert(clk_div::sel == 0x2 && clk_div::mask == 0x0000ff00);
+static_assert(uart_wbp::commands<clk_div>::select[0] == 0x21);
+static_assert(uart_wbp::commands<clk_div>::set_dat == 0x22);
+static_assert(uart_wbp::commands<clk_div>::max_size == 9);
+static_assert(enable::sel == 0x1 && enable::insert(3) == 1 && clk_div::extract(0x00abcd00) == 0xcd);
+
+static_assert(!std::is_copy_constructible_v<uart_wbp::device> && !std::is_copy_assignable_v<uart_wbp::device>);
+static_assert(std::is_nothrow_move_constructible_v<uart_wbp::device> && std::is_nothrow_move_assignable_v<uart_wbp::device>);
+
+uint8_t  handler_sel;
+uint32_t handler_adr;
+uint32_t handler_dat;
+
+uart_wbp_response_t write_handler(uint8_t sel, uint32_t adr, uint32_t dat) {
+	handler_sel = sel;
+	handler_adr = adr;
+	handler_dat = dat;
+	return ack;
+}
+uart_wbp_response_t read_handler(uint8_t sel, uint32_t adr, uint32_t *dat) {
+	handler_sel = sel;
+	handler_adr = adr;
+	*dat = handler_dat;
+	return ack;
+}
+
+int main(int argc, char **argv) {
+	if (argc != 2) {
+		printf("compile-time checks passed, give a device name to check the accessors\n");
+		return 0;
+	}
+	uart_wbp::device first(argv[1]);
+	uart_wbp::device dev(std::move(first));
+	assert(first.get() == nullptr);
+	uart_wbp_configure(dev.get(), static_cast<uart_wbp_config_t>(host_sends_write_response | fpga_sends_write_response));
+	dev.get()->write_handler = &write_handler;
+	dev.get()->read_handler  = &read_handler;
+
+	// the first write sends the select bytes, the second one only dat and strobe
+	for (uint32_t dat : {0xdeadbeefu, 0x01020304u}) {
+		assert(dev.write<ctrl>(dat) == ack);
+		assert(handler_sel == 0xf && handler_adr == ctrl::adr && handler_dat == dat);
+	}
+	uint32_t dat = 0;
+	handler_dat = 0xcafe1234;
+	assert(dev.read<status>(dat) == ack);
+	assert(handler_sel == 0xf && handler_adr == status::adr && dat == 0xcafe1234);
+
+	// fields
+	handler_dat = 0x00005a00;
+	assert(dev.read_field<clk_div>(dat) == ack);
+	assert(handler_sel == 0x2 && handler_adr == clk_div::adr && dat == 0x5a);
+	assert(dev.write_field<clk_div>(0x33) == ack);
+	assert(handler_sel == 0x2 && (handler_dat & clk_div::mask) == 0x3300);
+	handler_dat = 0xffffff00;
+	assert(dev.write_field<enable>(1) == ack); // read-modify-write
+	assert(handler_sel == 0xf && handler_dat == 0xffffff01);
+
+	// move assignment closes the device that was there
+	dev = uart_wbp::device(argv[1]);
+	uart_wbp_configure(dev.get(), static_cast<uart_wbp_config_t>(host_sends_write_response | fpga_sends_write_response));
+	dev.get()->write_handler = &write_handler;
+	dev.get()->read_handler  = &read_handler;
+	assert(dev.write<ctrl>(0x55aa55aa) == ack && handler_dat == 0x55aa55aa);
+
+	printf("uart_wbp_access.hpp: all checks passed\n");
+	return 0;
+}
@@ -1,8 +1,11 @@
 #include "uart_wbp_access.h"
+#include "uart_wbp_cache.h"
+#include "uart_wbp_readout.h"
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 void print_help(const char* argv0){
 	fprintf(stderr, "usage: %s [options] <devciename> <adr> [ <dat> ]\n", argv0);
@@ -21,6 +24,29 @@ uint8_t handler_sel;
 uint32_t handler_adr;
 uint32_t handler_dat;
 uart_wbp_response_t handler_response;
+uint32_t *handler_burst_dat;
+int handler_burst_len;
+uint32_t handler_modify_mask;
+uint32_t handler_modify_value;
+int handler_write_count;
+int handler_read_count;
+// the read handler sleeps this long before it answers
+int handler_delay_us;
+// if handler_log is set, the write handler records the writes there instead of checking them
+uint32_t (*handler_log)[2];
+int handler_log_n;
+// the read handler returns ~handler_dat for this many reads before it returns handler_dat
+int handler_poll_misses;
+// if handler_regs is set, the handlers read and write a small register file at handler_regs_adr 
+uint32_t *handler_regs;
+uint32_t handler_regs_adr;
+int handler_regs_n;
+// if handler_fifo is set, the handlers act as the registers of tdc_wbp_readout.vhd at handler_fifo_adr
+uint32_t *handler_fifo;
+uint32_t handler_fifo_adr;
+int handler_fifo_n;
+int handler_fifo_popped;
+uint16_t handler_fifo_lost;
 
 uint32_t get_sel_mask(uint8_t sel) {
 	uint32_t sel_mask = 0;
@@ -42,6 +68,23 @@ void test_write(uart_wbp_device_t *device, uint8_t sel, uint32_t adr, uint32_t d
 	assert(resp == response);
 }
 
+void test_write_burst(uart_wbp_device_t *device, uint8_t sel, uint32_t adr, int n, uart_wbp_response_t response) {
+	uint32_t dat[n];
+	for (int i = 0; i < n; ++i) {
+		dat[i] = rand();
+	}
+	handler_sel = sel;
+	handler_adr = adr;
+	handler_dat = dat[0];
+	handler_burst_dat = dat;
+	handler_burst_len = n;
+	handler_response = response;
+	uart_wbp_response_t resp = uart_wbp_write_burst(device, sel, adr, dat, n, 0);
+	printf("resp: %s\n", uart_wbp_response_str(resp));
+	assert(resp == response);
+	assert(handler_burst_len == 1);
+}
+
 void test_read(uart_wbp_device_t *device, uint8_t sel, uint32_t adr, uint32_t dat, uart_wbp_response_t response) {
 	handler_sel = sel;
 	handler_adr = adr;
@@ -56,21 +99,516 @@ void test_read(uart_wbp_device_t *device, uint8_t sel, uint32_t adr, uint32_t da
 	assert( ((handler_dat&sel_mask) == (data&sel_mask)));
 }
 
+void test_read_burst(uart_wbp_device_t *device, uint8_t sel, uint32_t adr, int n, uart_wbp_response_t response) {
+	uint32_t dat[n], data[n];
+	for (int i = 0; i < n; ++i) {
+		dat[i] = rand();
+	}
+	handler_sel = sel;
+	handler_adr = adr;
+	handler_dat = dat[0];
+	handler_burst_dat = dat;
+	handler_burst_len = n;
+	handler_response = response;
+	uart_wbp_response_t resp = uart_wbp_read_burst(device, sel, adr, data, n, 0);
+	printf("resp: %s\n", uart_wbp_response_str(resp));
+	assert(resp == response);
+	assert(handler_burst_len == 1);
+	uint32_t sel_mask = get_sel_mask(sel);
+	for (int i = 0; i < n; ++i) {
+		assert( ((dat[i]&sel_mask) == (data[i]&sel_mask)));
+	}
+}
+
+void test_modify(uart_wbp_device_t *device, uint32_t adr, uint32_t dat, uint32_t mask, uint32_t value, uart_wbp_response_t response) {
+	handler_sel = 0xf;
+	handler_adr = adr;
+	handler_dat = dat;
+	handler_response = response;
+	handler_modify_mask  = mask;
+	handler_modify_value = value;
+	uint32_t old;
+	uart_wbp_response_t resp = uart_wbp_modify(device, adr, mask, value, &old);
+	handler_modify_mask  = 0;
+	printf("resp: %s\n", uart_wbp_response_str(resp));
+	assert(resp == response);
+	if (resp == ack) {
+		assert(old == dat);
+	}
+}
+
+void test_compare_and_swap(uart_wbp_device_t *device, uint32_t adr, uint32_t dat, uint32_t mask, uint32_t desired, int match, uart_wbp_response_t response) {
+	mask |= 1; // a mismatch needs at least one bit in the mask
+	uint32_t expected = match ? dat : dat^mask;
+	handler_sel = 0xf;
+	handler_adr = adr;
+	handler_dat = dat;
+	handler_response = response;
+	handler_modify_mask  = mask;
+	handler_modify_value = desired;
+	int write_count = handler_write_count;
+	uint32_t old = ~dat;
+	uart_wbp_response_t resp = uart_wbp_compare_and_swap(device, adr, mask, expected, desired, &old);
+	handler_modify_mask  = 0;
+	printf("resp: %s\n", uart_wbp_response_str(resp));
+	assert(resp == response);
+	if (resp == ack) {
+		assert(old == dat);
+	} else {
+		// old is only written if the read was acked
+		assert(old == ~dat);
+	}
+	// the write is done only if the read was acked and the compare matched
+	assert(handler_write_count == write_count + (resp == ack && match));
+}
+
+void test_modify_batch(uart_wbp_device_t *device, uint32_t adr, int n, uint32_t mask, uint32_t value, uart_wbp_response_t response) {
+	uint32_t regs[8], before[8], adrs[16];
+	adr &= 0xffffffe0;
+	for (int i = 0; i < 8; ++i) {
+		regs[i] = before[i] = rand();
+	}
+	// random registers of the register file, some of them more than once
+	for (int i = 0; i < n; ++i) {
+		adrs[i] = adr + 4*(rand()%8);
+	}
+	handler_regs = regs;
+	handler_regs_adr = adr;
+	handler_regs_n = 8;
+	handler_response = response;
+	uart_wbp_response_t resp = uart_wbp_modify_batch(device, adrs, n, mask, value);
+	handler_regs = NULL;
+	printf("resp: %s\n", uart_wbp_response_str(resp));
+	assert(resp == response);
+	for (int i = 0; i < 8; ++i) {
+		int modified = 0;
+		for (int j = 0; j < n; ++j) {
+			if (adrs[j] == adr+4*i) modified = 1;
+		}
+		// if resp is not ack, the first read failed and nothing is written
+		if (modified && resp == ack) {
+			assert(regs[i] == ((before[i] & ~mask) | (value & mask)));
+		} else {
+			assert(regs[i] == before[i]);
+		}
+	}
+}
+
+void test_poll_until(uart_wbp_device_t *device, uint8_t sel, uint32_t adr, uint32_t dat, int misses, uart_wbp_response_t response) {
+	uint32_t mask = get_sel_mask(sel) & (rand()|1); // ~dat does not match in at least one bit
+	if (mask == 0) {
+		sel |= 1;
+		mask = 1;
+	}
+	handler_sel = sel;
+	handler_adr = adr;
+	handler_dat = dat;
+	handler_response = response;
+	handler_poll_misses = misses;
+	uint32_t data;
+	uart_wbp_response_t resp = uart_wbp_poll_until(device, sel, adr, mask, dat, 1000, &data);
+	printf("resp: %s\n", uart_wbp_response_str(resp));
+	assert(resp == response);
+	if (resp == ack) {
+		// the condition was met after all the misses
+		assert(handler_poll_misses == 0);
+		assert((data&mask) == (dat&mask));
+	}
+	handler_poll_misses = 0;
+}
+
+void test_poll_until_timeout(uart_wbp_device_t *device, uint8_t sel, uint32_t adr, uint32_t dat) {
+	sel |= 1;
+	handler_sel = sel;
+	handler_adr = adr;
+	handler_dat = dat;
+	handler_response = ack;
+	handler_poll_misses = 1000000;
+	uart_wbp_response_t resp = uart_wbp_poll_until(device, sel, adr, 0xff, dat, 20, NULL);
+	printf("resp: %s\n", uart_wbp_response_str(resp));
+	assert(resp == timeout);
+	assert(handler_poll_misses > 0);
+	handler_poll_misses = 0;
+}
+
+void test_register_cache(uart_wbp_device_t *device, uint32_t adr) {
+	uint32_t regs[8], dat;
+	adr &= 0xffffffe0;
+	for (int i = 0; i < 8; ++i) {
+		regs[i] = rand();
+	}
+	handler_regs = regs;
+	handler_regs_adr = adr;
+	handler_regs_n = 8;
+	handler_response = ack;
+	// 3 entries
+	uart_wbp_cache_t *cache = uart_wbp_cache_create(device, 3);
+	uart_wbp_cache_add_range(cache, adr, adr+4*7, uart_wbp_cache_cacheable);
+
+	// miss, then hit
+	int reads = handler_read_count;
+	assert(uart_wbp_cache_read(cache, adr, &dat) == ack && dat == regs[0]);
+	assert(uart_wbp_cache_read(cache, adr, &dat) == ack && dat == regs[0]);
+	assert(handler_read_count == reads+1);
+	assert(cache->misses == 1 && cache->hits == 1);
+
+	// write-back: two writes become one hardware write at the flush
+	int writes = handler_write_count;
+	uint32_t reg1 = regs[1];
+	assert(uart_wbp_cache_write(cache, adr+4, 0x11111111) == ack);
+	assert(uart_wbp_cache_write(cache, adr+4, 0x22222222) == ack);
+	assert(uart_wbp_cache_read(cache, adr+4, &dat) == ack && dat == 0x22222222);
+	assert(handler_write_count == writes && regs[1] == reg1);
+	assert(uart_wbp_cache_flush(cache) == ack);
+	assert(handler_write_count == writes+1 && regs[1] == 0x22222222);
+	assert(cache->coalesced_writes == 1);
+
+	// a full cache evicts clean entries first, then writes the oldest dirty entry back
+	writes = handler_write_count;
+	assert(uart_wbp_cache_write(cache, adr+8,  0x33333333) == ack);
+	assert(uart_wbp_cache_write(cache, adr+12, 0x44444444) == ack);
+	assert(uart_wbp_cache_write(cache, adr+16, 0x55555555) == ack);
+	assert(handler_write_count == writes);
+	assert(uart_wbp_cache_write(cache, adr+20, 0x66666666) == ack);
+	assert(handler_write_count == writes+1 && regs[2] == 0x33333333);
+	assert(uart_wbp_cache_read(cache, adr+12, &dat) == ack && dat == 0x44444444);
+	assert(uart_wbp_cache_flush(cache) == ack);
+	assert(regs[3] == 0x44444444 && regs[4] == 0x55555555 && regs[5] == 0x66666666);
+
+	// a failed read does not leave an entry behind
+	handler_response = err;
+	int used = cache->n_used;
+	assert(uart_wbp_cache_read(cache, adr+24, &dat) == err);
+	assert(cache->n_used == used);
+	handler_response = ack;
+	reads = handler_read_count;
+	assert(uart_wbp_cache_read(cache, adr+24, &dat) == ack && dat == regs[6]);
+	assert(handler_read_count == reads+1);
+	uart_wbp_cache_destroy(cache);
+
+	// one entry is used, without entries the writes go through
+	for (int size = 1; size >= 0; --size) {
+		cache = uart_wbp_cache_create(device, size);
+		uart_wbp_cache_add_range(cache, adr, adr+4*7, uart_wbp_cache_cacheable);
+		writes = handler_write_count;
+		assert(uart_wbp_cache_write(cache, adr,   0x77777777+size) == ack);
+		assert(handler_write_count == writes+1-size && cache->n_used == size);
+		assert(uart_wbp_cache_write(cache, adr+4, 0x88888888+size) == ack);
+		assert(handler_write_count == writes+2-size && regs[0] == 0x77777777+size);
+		assert(uart_wbp_cache_flush(cache) == ack);
+		assert(handler_write_count == writes+2 && regs[1] == 0x88888888+size);
+		uart_wbp_cache_destroy(cache);
+	}
+	handler_regs = NULL;
+}
+
+void test_trace(uart_wbp_device_t *device, uint32_t adr, uint32_t dat) {
+	const char *filename = "/tmp/uart_wbp_automatic_test_trace.json";
+	handler_sel = 0xf;
+	handler_adr = adr;
+	handler_dat = dat;
+	handler_response = ack;
+	uart_wbp_trace_enable(16);
+	assert(uart_wbp_write(device, 0xf, adr, dat, 0, 0) == ack);
+	uint32_t data;
+	assert(uart_wbp_read(device, 0xf, adr, &data, 0, 0) == ack);
+	assert(uart_wbp_trace_export(filename) == 0);
+	uart_wbp_trace_free();
+
+	// each event is on its own line, the phases of a transaction follow the transaction
+	FILE *f = fopen(filename, "r");
+	assert(f != NULL);
+	char line[256], name[64], transaction[64] = "";
+	int tid;
+	double ts, dur;
+	double write_begin = -1, write_end = -1, write_written = -1, handler_begin = -1, handler_end = -1;
+	int n_events = 0, n_read = 0, n_read_handler = 0;
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "{\"name\":\"%63[^\"]\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%lf,\"dur\":%lf", name, &tid, &ts, &dur) != 4) {
+			continue;
+		}
+		printf("trace: %-20s ts=%.3f dur=%.3f\n", name, ts, dur);
+		++n_events;
+		assert(dur >= 0);
+		if (!strcmp(name, "write") || !strcmp(name, "read")) {
+			strcpy(transaction, name);
+		}
+		if (!strcmp(name, "write")) {
+			write_begin = ts;
+			write_end   = ts+dur;
+		} else if (!strcmp(name, "encode and write") && !strcmp(transaction, "write")) {
+			write_written = ts+dur;
+		} else if (!strcmp(name, "slave write handler")) {
+			handler_begin = ts;
+			handler_end   = ts+dur;
+		} else if (!strcmp(name, "read")) {
+			++n_read;
+		} else if (!strcmp(name, "slave read handler")) {
+			++n_read_handler;
+		}
+	}
+	fclose(f);
+	assert(n_read == 1 && n_read_handler == 1);
+	assert(write_begin >= 0 && write_written >= 0 && handler_begin >= 0);
+	// the handler runs inside the write transaction, after the request was written 
+	// (the response of the handler does not count as the request)
+	assert(handler_begin >= write_begin && handler_end <= write_end+0.001);
+	assert(write_written <= handler_begin+0.001);
+	assert(n_events >= 4);
+}
+
+void test_slave_cache(uart_wbp_device_t *device, uint8_t sel, uint32_t adr, uint32_t dat) {
+	// the read is answered by the cache of the slave interface, the read handler must not be called
+	handler_sel = 0xff;
+	uart_wbp_slave_cache_fill(device, adr, &dat, 1);
+	uint32_t data;
+	uart_wbp_response_t resp = uart_wbp_read(device, sel, adr, &data, 0, 0);
+	printf("resp: %s\n", uart_wbp_response_str(resp));
+	assert(resp == ack);
+	uint32_t sel_mask = get_sel_mask(sel);
+	assert((dat&sel_mask) == (data&sel_mask));
+	uart_wbp_slave_cache_invalidate(device, adr);
+}
+
+void test_readout_poll(uart_wbp_device_t *device, uint32_t adr) {
+	uint32_t fifo[64];
+	for (int i = 0; i < 64; ++i) {
+		fifo[i] = rand()&0xffff;
+	}
+	handler_fifo = fifo;
+	handler_fifo_adr = adr;
+	handler_fifo_n = 40;
+	handler_fifo_popped = 0;
+	handler_fifo_lost = 5;
+	handler_response = ack;
+	uart_wbp_readout_t *readout = uart_wbp_readout_create(device, adr, 16, UART_WBP_READOUT_MAX_DEPTH+2);
+	assert(readout != NULL);
+	assert(handler_fifo_lost == 0);
+	uart_wbp_readout_set_depth(readout, 4, 16);
+	// all words arrive in order, the depth follows the fill level
+	int n_read = 0;
+	for (int poll = 0; poll < 20 && n_read < 40; ++poll) {
+		if (poll == 2) {
+			handler_fifo_lost = 3;
+		}
+		uart_wbp_response_t resp = uart_wbp_readout_poll(readout);
+		printf("resp: %s\n", uart_wbp_response_str(resp));
+		assert(resp == ack);
+		size_t n_words;
+		const uint32_t *words = uart_wbp_readout_peek(readout, &n_words);
+		for (size_t i = 0; i < n_words; ++i) {
+			assert(words[i] == fifo[n_read++]);
+		}
+		uart_wbp_readout_consume(readout, n_words);
+	}
+	assert(n_read == 40 && handler_fifo_popped == 40);
+	assert(readout->words == 40 && readout->lost_records == 3 && readout->lost_words == 0);
+	// a failed poll leaves the buffer unchanged, the words that it popped are lost
+	handler_fifo_n = 50;
+	handler_response = err;
+	uart_wbp_response_t resp = uart_wbp_readout_poll(readout);
+	printf("resp: %s\n", uart_wbp_response_str(resp));
+	assert(resp == err);
+	size_t n_words;
+	uart_wbp_readout_peek(readout, &n_words);
+	assert(n_words == 0);
+	assert(handler_fifo_popped > 40 && readout->lost_words == (uint64_t)(handler_fifo_popped-40));
+	handler_response = ack;
+	handler_fifo = NULL;
+	uart_wbp_readout_destroy(readout);
+}
+
+void test_delta_writes(uart_wbp_device_t *device, uint32_t adr) {
+	// Writes with sel=0xf that need no host response come as delta write frames, relative
+	// to the address after the previous slave write. Runs of consecutive words (up to 8 per
+	// frame), positive and negative strides, a long jump, and a write with another sel that
+	// is sent as a normal write request in between.
+	uint32_t expect[64][2], log[64][2];
+	int n = 0;
+	adr = (adr & 0x0ffff000) + 0x10000;
+	handler_log = log;
+	handler_log_n = 0;
+	uart_wbp_configure(device, fpga_sends_write_response | delta_slave_writes);
+	uint32_t dat[12];
+	for (int i = 0; i < 12; ++i) {
+		dat[i] = rand();
+		expect[n][0] = adr+4*i;
+		expect[n++][1] = dat[i];
+	}
+	assert(uart_wbp_write_burst(device, 0xf, adr, dat, 12, 0) == ack);
+	int strides[] = {-4, -4, -12, 8, 8, 4, 0x2000, -0x8000, 4};
+	uint32_t a = adr+4*11;
+	for (unsigned s = 0; s < sizeof(strides)/sizeof(strides[0]); ++s) {
+		a += strides[s];
+		expect[n][0] = a;
+		expect[n][1] = rand();
+		uint8_t sel = (s == 5) ? 0x3 : 0xf;
+		if (sel != 0xf) {
+			expect[n][1] &= get_sel_mask(sel);
+		}
+		assert(uart_wbp_write(device, sel, a, expect[n][1], 0, 0) == ack);
+		++n;
+	}
+	// the bridge may hold back the last frame for a few clock cycles, a read
+	// request comes after it
+	handler_sel = 0xf;
+	handler_adr = adr;
+	handler_dat = 0x12345678;
+	handler_response = ack;
+	uint32_t data;
+	assert(uart_wbp_read(device, 0xf, adr, &data, 0, 0) == ack && data == handler_dat);
+	uart_wbp_configure(device, host_sends_write_response | fpga_sends_write_response);
+	handler_log = NULL;
+	printf("delta writes: %d of %d\n", handler_log_n, n);
+	assert(handler_log_n == n);
+	for (int i = 0; i < n; ++i) {
+		assert(log[i][0] == expect[i][0] && log[i][1] == expect[i][1]);
+	}
+}
+
+void test_modify_batch_pipelined(uart_wbp_device_t *device, uint32_t adr) {
+	// Without host write responses the reads of uart_wbp_modify_batch are pipelined. They target 
+	// registers in the slave cache of the bridge, so the read handler must not be called, and 
+	// their requests do not fit into the receive FIFO all at once. The writes are posted and logged.
+	uint32_t regs[4], adrs[24], log[24][2];
+	int n = 24;
+	adr = (adr & 0x0ffff000) + 0x20000;
+	for (int i = 0; i < 4; ++i) {
+		regs[i] = rand();
+	}
+	assert(uart_wbp_slave_cache_fill(device, adr, regs, 4) == 0);
+	for (int i = 0; i < n; ++i) {
+		adrs[i] = adr + 4*(rand()%4);
+	}
+	uint32_t mask = rand(), value = rand();
+	handler_sel = 0xff;
+	handler_log = log;
+	handler_log_n = 0;
+	assert(uart_wbp_configure(device, fpga_sends_write_response) == 0);
+	assert(uart_wbp_modify_batch(device, adrs, n, mask, value) == ack);
+	// the posted writes are in the bridge before the response to the read request
+	handler_sel = 0xf;
+	handler_adr = adr+16;
+	handler_dat = 0x12345678;
+	handler_response = ack;
+	uint32_t data;
+	assert(uart_wbp_read(device, 0xf, adr+16, &data, 0, 0) == ack && data == handler_dat);
+	assert(uart_wbp_configure(device, host_sends_write_response | fpga_sends_write_response) == 0);
+	handler_log = NULL;
+	assert(uart_wbp_slave_cache_invalidate_all(device) == 0);
+	printf("pipelined modify: %d of %d writes\n", handler_log_n, n);
+	assert(handler_log_n == n);
+	for (int i = 0; i < n; ++i) {
+		uint32_t v = regs[(adrs[i]-adr)/4];
+		assert(log[i][0] == adrs[i] && log[i][1] == ((v & ~mask) | (value & mask)));
+	}
+}
+
+void test_stall_timeout(uart_wbp_device_t *device, uint32_t adr, int pipelined) {
+	// The slave stalls while the host answers a read. The single-strobe master sends the next strobe
+	// after the response, the pipelined master sends it right away and it stalls until the stall
+	// timeout takes it back.
+	uint32_t regs[4], dat[4];
+	adr &= 0xfffffff0;
+	for (int i = 0; i < 4; ++i) {
+		regs[i] = rand();
+	}
+	handler_regs = regs;
+	handler_regs_adr = adr;
+	handler_regs_n = 4;
+	handler_response = ack;
+	handler_delay_us = 5000;
+	int reads = handler_read_count;
+	uart_wbp_set_stall_timeout(device, 100);
+	uart_wbp_response_t resp = uart_wbp_read_burst(device, 0xf, adr, dat, 4, 0);
+	uart_wbp_set_stall_timeout(device, 50000000);
+	handler_delay_us = 0;
+	handler_regs = NULL;
+	printf("resp: %s\n", uart_wbp_response_str(resp));
+	if (pipelined) {
+		assert(resp == stall_timeout);
+		assert(handler_read_count > reads && handler_read_count < reads+4);
+		assert(dat[0] == regs[0]);
+	} else {
+		assert(resp == ack);
+		assert(handler_read_count == reads+4);
+		assert(memcmp(dat, regs, sizeof(dat)) == 0);
+	}
+}
+
 uart_wbp_response_t my_uart_wbp_slave_read_handler(uint8_t sel, uint32_t adr, uint32_t *dat)
 {
 	fprintf(stderr,"read_handler:   sel=%01x adr=%08x\n", sel, adr);
+	++handler_read_count;
+	if (handler_delay_us) {
+		usleep(handler_delay_us);
+	}
+	if (handler_fifo) {
+		// status, lost counter, and the data window that pops a word per read
+		int fill = handler_fifo_n - handler_fifo_popped;
+		if (adr == handler_fifo_adr) {
+			*dat = fill | (fill ? 0 : 0x80000000);
+		} else if (adr == handler_fifo_adr+4) {
+			*dat = handler_fifo_lost;
+		} else {
+			assert(adr >= handler_fifo_adr+8 && adr < handler_fifo_adr+0x1000);
+			*dat = fill ? (0x80000000 | handler_fifo[handler_fifo_popped++]) : 0;
+		}
+		return handler_response;
+	}
+	if (handler_regs) {
+		assert(adr >= handler_regs_adr && adr < handler_regs_adr+4*handler_regs_n);
+		*dat = handler_regs[(adr-handler_regs_adr)/4];
+		return handler_response;
+	}
 	assert(handler_sel == sel);
 	assert(handler_adr == adr);
 	*dat = handler_dat; 
+	if (handler_poll_misses > 0) {
+		--handler_poll_misses;
+		*dat = ~handler_dat;
+	}
+	// the following write of a read-modify-write has the modified value
+	handler_dat = (handler_dat & ~handler_modify_mask) | (handler_modify_value & handler_modify_mask);
+	// during a burst the next strobe goes to the next address
+	if (handler_burst_len > 1) {
+		--handler_burst_len;
+		handler_adr += 4;
+		handler_dat = *++handler_burst_dat;
+	}
 	return handler_response;
 }
 uart_wbp_response_t my_uart_wbp_slave_write_handler(uint8_t sel, uint32_t adr, uint32_t dat)
 {
 	uint32_t sel_mask = get_sel_mask(sel);
 	fprintf(stderr,"write_handler:  sel=%01x adr=%08x dat=%08x sel_mask=%08x\n", sel, adr, dat, sel_mask);
+	++handler_write_count;
+	if (handler_log) {
+		handler_log[handler_log_n][0] = adr;
+		handler_log[handler_log_n][1] = dat & sel_mask;
+		++handler_log_n;
+		return ack;
+	}
+	if (handler_fifo) {
+		assert(adr == handler_fifo_adr+4);
+		handler_fifo_lost = 0;
+		return handler_response;
+	}
+	if (handler_regs) {
+		assert(adr >= handler_regs_adr && adr < handler_regs_adr+4*handler_regs_n);
+		uint32_t *reg = &handler_regs[(adr-handler_regs_adr)/4];
+		*reg = (*reg & ~sel_mask) | (dat & sel_mask);
+		return handler_response;
+	}
 	assert(handler_sel == sel);
 	assert(handler_adr == adr);
 	assert((sel_mask&handler_dat) == (sel_mask&dat));
+	// during a burst the next strobe goes to the next address
+	if (handler_burst_len > 1) {
+		--handler_burst_len;
+		handler_adr += 4;
+		handler_dat = *++handler_burst_dat;
+	}
 	return handler_response;
 }
 
@@ -78,6 +616,8 @@ uart_wbp_response_t my_uart_wbp_slave_write_handler(uint8_t sel, uint32_t adr, u
 int main(int argc, char **argv) {
 	char device_name[256];
 	uint32_t device_name_set = 1;
+	// -p: the bridge has the pipelined wishbone master (g_master_depth > 0)
+	int pipelined = 0;
 	// uint32_t adr, adr_set = 0;
 	// uint32_t dat, dat_set = 0;
 	// uint8_t  sel = 0xf;
@@ -85,6 +625,11 @@ int main(int argc, char **argv) {
 	// int wait_ms = -1;
 	int verbose = 0;
 
+	if (argc > 1 && strcmp(argv[1], "-p") == 0) {
+		pipelined = 1;
+		--argc;
+		++argv;
+	}
 	if (argc == 2) {
 		strncpy(device_name, argv[1], sizeof(device_name));
 	} else {
@@ -110,14 +655,20 @@ int main(int argc, char **argv) {
 		return 2;
 	}
 	uart_wbp_config_t bridge_config = host_sends_write_response | fpga_sends_write_response;
-	uart_wbp_configure(device, bridge_config);
-	uart_wbp_set_stall_timeout(device, 50000000);
+	assert(uart_wbp_configure(device, bridge_config) == 0);
+	assert(uart_wbp_set_stall_timeout(device, 50000000) == 0);
 
 	device->write_handler = &my_uart_wbp_slave_write_handler;
 	device->read_handler  = &my_uart_wbp_slave_read_handler;
 
 
 
+	test_trace(device, 0x100, 0x12345678);
+	test_readout_poll(device, 0x40000);
+	test_stall_timeout(device, 0x300, pipelined);
+	test_delta_writes(device, 0x400);
+	test_modify_batch_pipelined(device, 0x500);
+
 	for (int i = 0; i < 2000; ++i) {
 		uint8_t sel=rand()&0xf;
 		uint32_t adr=rand()&0xfffffffc;
@@ -127,7 +678,26 @@ int main(int argc, char **argv) {
 		uart_wbp_response_t resp=ack+rand()%3;
 		printf("\ndevice_setting: sel=%01x adr=%08x dat=%08x\n", device->wb_sel, device->wb_adr, device->wb_dat);
 		printf("test %9d: sel=%01x adr=%08x dat=%08x, resp=%s\n", i, sel, adr, dat, uart_wbp_response_str(resp));
-		if (i%2) {
+		if (i%10 == 9) {
+			test_write_burst(device,sel,adr,1+rand()%16,resp);
+		} else if (i%10 == 8) {
+			// sometimes more than UART_WBP_BURST_READ_MAX_WORDS words, i.e. several bursts
+			int n = (i%100 == 98) ? UART_WBP_BURST_READ_MAX_WORDS+1+rand()%200 : 1+rand()%16;
+			test_read_burst(device,sel,adr,n,resp);
+		} else if (i%10 == 7) {
+			test_modify(device,adr,dat,rand(),rand(),resp);
+			test_compare_and_swap(device,adr,dat,rand(),rand(),1,resp);
+			test_compare_and_swap(device,adr,dat,rand(),rand(),0,resp);
+			test_modify_batch(device,adr,1+rand()%16,rand(),rand(),resp);
+		} else if (i%10 == 6) {
+			test_slave_cache(device,sel,adr,dat);
+			test_read(device,sel,adr,dat,resp);
+			test_poll_until(device,sel,adr,dat,rand()%8,resp);
+			if (i%100 == 6) {
+				test_poll_until_timeout(device,sel,adr,dat);
+				test_register_cache(device,adr);
+			}
+		} else if (i%2) {
 			test_write(device,sel,adr,dat,resp);
 		} else {
 			test_read(device,sel,adr,dat,resp);
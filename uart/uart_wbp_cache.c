@@ -0,0 +1,249 @@
+#include "uart_wbp_cache.h"
+
+// C header
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+uart_wbp_cache_t* uart_wbp_cache_create(uart_wbp_device_t *device, int size)
+{
+	uart_wbp_cache_t *cache = (uart_wbp_cache_t*)malloc(sizeof(uart_wbp_cache_t));
+	if (cache == NULL) {
+		return NULL;
+	}
+	memset(cache, 0, sizeof(uart_wbp_cache_t));
+	cache->device = device;
+	cache->capacity = size > 0 ? size : 0;
+	cache->size = 1;
+	while (cache->size < cache->capacity+1) {
+		cache->size *= 2;
+	}
+	cache->entries = (uart_wbp_cache_entry_t*)calloc(cache->size, sizeof(uart_wbp_cache_entry_t));
+	cache->dirty   = (int*)calloc(cache->size, sizeof(int));
+	if (cache->entries == NULL || cache->dirty == NULL) {
+		uart_wbp_cache_destroy(cache);
+		return NULL;
+	}
+	return cache;
+}
+
+void uart_wbp_cache_destroy(uart_wbp_cache_t *cache)
+{
+	free(cache->entries);
+	free(cache->dirty);
+	free(cache);
+}
+
+int uart_wbp_cache_add_range(uart_wbp_cache_t *cache, uint32_t first_adr, uint32_t last_adr, uart_wbp_cache_policy_t policy)
+{
+	if (cache->n_ranges == UART_WBP_CACHE_MAX_RANGES) {
+		fprintf(stderr, "uart_wbp_cache_add_range: too many ranges\n");
+		return -1;
+	}
+	cache->ranges[cache->n_ranges].first_adr = first_adr;
+	cache->ranges[cache->n_ranges].last_adr  = last_adr;
+	cache->ranges[cache->n_ranges].policy    = policy;
+	++cache->n_ranges;
+	return 0;
+}
+
+uart_wbp_cache_policy_t uart_wbp_cache_policy(uart_wbp_cache_t *cache, uint32_t adr)
+{
+	// later ranges take precedence
+	for (int i = cache->n_ranges-1; i >= 0; --i) {
+		if (adr >= cache->ranges[i].first_adr && adr <= cache->ranges[i].last_adr) {
+			return cache->ranges[i].policy;
+		}
+	}
+	return uart_wbp_cache_volatile;
+}
+
+// first index of the probe sequence for adr
+uint32_t uart_wbp_cache_home(uart_wbp_cache_t *cache, uint32_t adr)
+{
+	return ((adr>>2) * 2654435761u) & (cache->size-1);
+}
+
+// index of the entry for adr, a new entry is created if insert is nonzero.
+// returns -1 if there is no entry (or no space for a new one)
+int uart_wbp_cache_find(uart_wbp_cache_t *cache, uint32_t adr, int insert)
+{
+	uint32_t mask = cache->size-1;
+	uint32_t idx = uart_wbp_cache_home(cache, adr);
+	for (int n = 0; n < cache->size; ++n, idx = (idx+1)&mask) {
+		uart_wbp_cache_entry_t *entry = &cache->entries[idx];
+		if (entry->used && entry->adr == adr) {
+			return idx;
+		}
+		if (!entry->used) {
+			if (!insert || cache->n_used >= cache->capacity) {
+				return -1;
+			}
+			memset(entry, 0, sizeof(uart_wbp_cache_entry_t));
+			entry->used = 1;
+			entry->adr  = adr;
+			++cache->n_used;
+			return idx;
+		}
+	}
+	return -1;
+}
+
+// Remove the entry at idx (it must not be dirty). Entries behind it in the same probe 
+// sequence move up into the hole, so that the search for them still finds them.
+void uart_wbp_cache_remove(uart_wbp_cache_t *cache, int idx)
+{
+	uint32_t mask = cache->size-1;
+	uint32_t hole = idx;
+	for (uint32_t next = (hole+1)&mask; cache->entries[next].used; next = (next+1)&mask) {
+		uint32_t home = uart_wbp_cache_home(cache, cache->entries[next].adr);
+		// the entry can move if the hole is between its home and its current position
+		if (((next-home)&mask) >= ((next-hole)&mask)) {
+			cache->entries[hole] = cache->entries[next];
+			for (int i = 0; i < cache->n_dirty; ++i) {
+				if (cache->dirty[i] == (int)next) {
+					cache->dirty[i] = hole;
+				}
+			}
+			hole = next;
+		}
+	}
+	memset(&cache->entries[hole], 0, sizeof(uart_wbp_cache_entry_t));
+	--cache->n_used;
+}
+
+// Make space for one more entry: evict a clean entry, or if all entries are dirty, 
+// write the oldest dirty entry to the hardware and evict it.
+uart_wbp_response_t uart_wbp_cache_evict(uart_wbp_cache_t *cache)
+{
+	for (int n = 0; n < cache->size; ++n) {
+		int idx = cache->next_victim;
+		cache->next_victim = (idx+1)&(cache->size-1);
+		if (cache->entries[idx].used && !cache->entries[idx].dirty) {
+			uart_wbp_cache_remove(cache, idx);
+			return ack;
+		}
+	}
+	if (cache->n_dirty == 0) {
+		return -1;
+	}
+	uart_wbp_cache_entry_t *entry = &cache->entries[cache->dirty[0]];
+	uart_wbp_response_t response = uart_wbp_write(cache->device, 0xf, entry->adr, entry->dat, 0, 0);
+	if (response != ack && response != unknown) {
+		return response;
+	}
+	entry->dirty = 0;
+	int idx = cache->dirty[0];
+	--cache->n_dirty;
+	memmove(cache->dirty, cache->dirty+1, cache->n_dirty*sizeof(int));
+	uart_wbp_cache_remove(cache, idx);
+	return ack;
+}
+
+uart_wbp_response_t uart_wbp_cache_read(uart_wbp_cache_t *cache, uint32_t adr, uint32_t *dat)
+{
+	uart_wbp_cache_policy_t policy = uart_wbp_cache_policy(cache, adr);
+	int idx = -1;
+	if (policy != uart_wbp_cache_volatile) {
+		idx = uart_wbp_cache_find(cache, adr, 1);
+		if (idx >= 0 && (cache->entries[idx].hw_valid || cache->entries[idx].dirty)) {
+			++cache->hits;
+			*dat = cache->entries[idx].dat;
+			return ack;
+		}
+	}
+	++cache->misses;
+	uart_wbp_response_t response = uart_wbp_read(cache->device, 0xf, adr, dat, 0, 0);
+	if (idx >= 0 && response == ack) {
+		cache->entries[idx].dat      = *dat;
+		cache->entries[idx].hw_dat   = *dat;
+		cache->entries[idx].hw_valid = 1;
+	} else if (idx >= 0) {
+		// the entry has no valid value, do not keep it
+		uart_wbp_cache_remove(cache, idx);
+	}
+	return response;
+}
+
+uart_wbp_response_t uart_wbp_cache_write(uart_wbp_cache_t *cache, uint32_t adr, uint32_t dat)
+{
+	uart_wbp_cache_policy_t policy = uart_wbp_cache_policy(cache, adr);
+	if (policy == uart_wbp_cache_volatile) {
+		return uart_wbp_write(cache->device, 0xf, adr, dat, 0, 0);
+	}
+
+	int idx = uart_wbp_cache_find(cache, adr, 1);
+	if (idx < 0 && policy == uart_wbp_cache_cacheable && cache->n_used > 0) {
+		// the cache is full, make space
+		uart_wbp_response_t response = uart_wbp_cache_evict(cache);
+		if (response != ack) {
+			return response;
+		}
+		idx = uart_wbp_cache_find(cache, adr, 1);
+	}
+
+	if (policy == uart_wbp_cache_write_through || idx < 0) {
+		uart_wbp_response_t response = uart_wbp_write(cache->device, 0xf, adr, dat, 0, 0);
+		if (idx >= 0) {
+			uart_wbp_cache_entry_t *entry = &cache->entries[idx];
+			// if the write was not acked, the hardware value is not known
+			entry->dat      = dat;
+			entry->hw_dat   = dat;
+			entry->hw_valid = (response == ack || response == unknown);
+		}
+		return response;
+	}
+
+	uart_wbp_cache_entry_t *entry = &cache->entries[idx];
+	if (entry->dirty) {
+		++cache->coalesced_writes;
+	} else {
+		entry->dirty = 1;
+		cache->dirty[cache->n_dirty++] = idx;
+	}
+	entry->dat = dat;
+	return ack;
+}
+
+uart_wbp_response_t uart_wbp_cache_flush(uart_wbp_cache_t *cache)
+{
+	uart_wbp_response_t result = (cache->device->hw_config & fpga_sends_write_response) ? ack : unknown;
+	int n_kept = 0;
+	for (int i = 0; i < cache->n_dirty; ++i) {
+		uart_wbp_cache_entry_t *entry = &cache->entries[cache->dirty[i]];
+		if (entry->hw_valid && entry->hw_dat == entry->dat) {
+			// the hardware has this value already
+			entry->dirty = 0;
+			++cache->coalesced_writes;
+			continue;
+		}
+		uart_wbp_response_t response = uart_wbp_write(cache->device, 0xf, entry->adr, entry->dat, 0, 0);
+		if (response == ack || response == unknown) {
+			entry->dirty    = 0;
+			entry->hw_dat   = entry->dat;
+			entry->hw_valid = 1;
+		} else {
+			// keep it dirty for the next flush
+			cache->dirty[n_kept++] = cache->dirty[i];
+			entry->hw_valid = 0;
+			if (result == ack || result == unknown) {
+				result = response;
+			}
+			if (response == timeout) {
+				// the bridge does not respond, keep the rest for later
+				while (++i < cache->n_dirty) {
+					cache->dirty[n_kept++] = cache->dirty[i];
+				}
+			}
+		}
+	}
+	cache->n_dirty = n_kept;
+	return result;
+}
+
+void uart_wbp_cache_invalidate(uart_wbp_cache_t *cache)
+{
+	memset(cache->entries, 0, cache->size*sizeof(uart_wbp_cache_entry_t));
+	cache->n_used  = 0;
+	cache->n_dirty = 0;
+}
@@ -0,0 +1,90 @@
+#ifndef UART_WBP_CACHE_H_
+#define UART_WBP_CACHE_H_
+
+#include "uart_wbp_access.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A register cache on top of uart_wbp_read/uart_wbp_write for full 32-bit registers.
+// Each address range is given a policy:
+//   volatile      : every access goes to the hardware (default for addresses without a range)
+//   write_through : writes go to the hardware right away, reads are served from the cache once the value is known
+//   cacheable     : reads are served from the cache, writes only update the cache and are sent
+//                   to the hardware by uart_wbp_cache_flush. Several writes to the same register
+//                   before a flush result in a single write of the last value.
+typedef enum uart_wbp_cache_policy {
+	uart_wbp_cache_volatile      = 0,
+	uart_wbp_cache_write_through = 1,
+	uart_wbp_cache_cacheable     = 2,
+} uart_wbp_cache_policy_t;
+
+typedef struct uart_wbp_cache_range {
+	uint32_t first_adr;
+	uint32_t last_adr;
+	uart_wbp_cache_policy_t policy;
+} uart_wbp_cache_range_t;
+
+typedef struct uart_wbp_cache_entry {
+	uint32_t adr;
+	uint32_t dat;      // value seen by the host
+	uint32_t hw_dat;   // value the hardware has (if hw_valid)
+	uint8_t  used;
+	uint8_t  hw_valid;
+	uint8_t  dirty;
+} uart_wbp_cache_entry_t;
+
+#define UART_WBP_CACHE_MAX_RANGES 16
+typedef struct uart_wbp_cache
+{
+	uart_wbp_device_t *device;
+
+	uart_wbp_cache_range_t ranges[UART_WBP_CACHE_MAX_RANGES];
+	int n_ranges;
+
+	// hash table with linear probing, size is a power of 2 larger than capacity, 
+	// so that at least one entry stays free and the search for a missing address terminates
+	uart_wbp_cache_entry_t *entries;
+	int size;
+	int capacity;
+	int n_used;
+	int next_victim; // where the search for a clean entry to evict starts
+
+	// dirty entries in the order they were first written, this order is kept by uart_wbp_cache_flush
+	int *dirty;
+	int n_dirty;
+
+	// statistics
+	uint32_t hits;
+	uint32_t misses;
+	uint32_t coalesced_writes;
+} uart_wbp_cache_t;
+
+// size is the maximum number of cached registers. With size 0 nothing is cached and all accesses go to the hardware.
+uart_wbp_cache_t* uart_wbp_cache_create(uart_wbp_device_t *device, int size);
+void              uart_wbp_cache_destroy(uart_wbp_cache_t *cache);
+
+// Declare the policy for all addresses in [first_adr,last_adr]. Ranges that are added later take precedence.
+int uart_wbp_cache_add_range(uart_wbp_cache_t *cache, uint32_t first_adr, uint32_t last_adr, uart_wbp_cache_policy_t policy);
+
+uart_wbp_response_t uart_wbp_cache_read(uart_wbp_cache_t *cache, uint32_t adr, uint32_t *dat);
+uart_wbp_response_t uart_wbp_cache_write(uart_wbp_cache_t *cache, uint32_t adr, uint32_t dat);
+
+// Write all dirty registers to the hardware. Returns ack if all writes were acked
+// (or unknown if the bridge does not send write responses), otherwise the first other response.
+uart_wbp_response_t uart_wbp_cache_flush(uart_wbp_cache_t *cache);
+
+// If the cache is full, a write of a new cacheable register evicts a clean entry. If all entries are dirty,
+// the oldest dirty register is written to the hardware and evicted. If there is nothing to evict (size 0), 
+// the write goes to the hardware right away.
+
+// Forget all cached values, so that the next reads go to the hardware.
+// Dirty registers that were not flushed are lost.
+void uart_wbp_cache_invalidate(uart_wbp_cache_t *cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -74,6 +74,7 @@ begin
 	wbta_dat_o.cyc <= '0'; -- this is the bit that controls cyc after stb response (ack,err,rty, or timeout)
 	wbta_dat_o.we  <= wbta_we_out;
 	wbta_dat_o.stall_timeout <= (others => '0');
+	wbta_dat_o.burst <= c_wbp_burst_none;
 	wbta_stb_o <= wbta_stb_out;
 
 	we <= rx_dat_i(7);
@@ -268,6 +269,11 @@ use work.wbta_pkg.all;
 -- Internal state: registers for adr,dat,sel and
 --   the state of the state-machine
 entity uart_wbta is 
+generic (
+	-- clock cycles that the bridge waits for the next byte of an incomplete command (the payload 
+	-- bytes of set dat/adr/timeout/gpo, the count and data bytes of a burst), 0 waits forever
+	g_command_timeout : integer := 0
+);
 port (
 	clk_i    :  in std_logic;
 	rst_i    :  in std_logic;
@@ -282,6 +288,8 @@ port (
 	-- response interface from host to wishbone slave interface (wb_uart)
 	config_o    : out t_configuration;
 	stb_resp_o  : out t_wbp_response;
+	-- host commands for the cache of the slave interface (wb_uart)
+	slave_cache_o : out t_slave_cache_update;
 	-- general purpose output bits
 	gpo_bits_o  : out std_logic_vector(31 downto 0);
 	-- this reset can be initiated by the host
@@ -295,7 +303,7 @@ architecture rtl of uart_wbta is
 	signal wb_sel : std_logic_vector( 3 downto 0) := (others => '0');
 	signal stall_timeout : std_logic_vector(31 downto 0) := (others => '0');
 	signal gpo_bits : std_logic_vector(31 downto 0) := (others => '0');
-	type t_state is (s_idle, s_receive, s_stb);
+	type t_state is (s_idle, s_receive, s_stb, s_burst_count, s_burst_data, s_burst_stb);
 	signal state : t_state := s_idle;
 
 
@@ -311,6 +319,9 @@ architecture rtl of uart_wbta is
 									 command_slave_rty,   -- command code 9
 									 command_set_gpo,     -- command code 10
 									 command_reset,       -- command code 11
+									 command_burst_write, -- command code 12
+									 command_burst_read,  -- command code 13
+									 command_slave_cache, -- command code 14
 									 command_invalid);   
 
 	-- type conversion function to t_command
@@ -339,6 +350,16 @@ architecture rtl of uart_wbta is
 
 	signal wbta_we_out  : std_logic := '0';
 	signal wbta_stb_out : std_logic := '0';
+	signal wbta_cyc_out : std_logic := '0';
+
+	-- burst write/read: number of remaining words (minus one) and the keep-cyc bit for the last strobe
+	signal burst_count    : unsigned(7 downto 0) := (others => '0');
+	signal burst_keep_cyc : std_logic := '0';
+	signal burst_out      : t_wbp_burst := c_wbp_burst_none;
+
+	-- during a burst read only the commands that serve the bridge's own slave interface are accepted 
+	signal burst_read_pending : std_logic := '0';
+	signal rx_serves_slave    : std_logic := '0';
 
 	type t_receive_type is (receive_adr, receive_dat, receive_timeout, receive_gpo_bits);
 	signal receive_type : t_receive_type;
@@ -347,29 +368,41 @@ architecture rtl of uart_wbta is
 
 	signal config_out : t_configuration := c_configuration_init;
 	signal stb_resp_out : t_wbp_response := c_wbp_response_init;
+	signal slave_cache_out : t_slave_cache_update := c_slave_cache_update_none;
 
 	signal gpo_bits_out : std_logic_vector(31 downto 0) := (others => '0');
 
 	signal bridge_reset_out : std_logic := '0';
 	signal reset_just_happened : std_logic := '0';
 
+	-- clock cycles without a byte while a command is incomplete
+	signal command_wait : integer range 0 to g_command_timeout := 0;
+
 begin
 
-	-- we can only take rx_data in s_idle or s_receive state
-	rx_stall_o <= '0' when state = s_idle or state = s_receive 
+	-- we can only take rx_data in s_idle, s_receive, or while receiving a burst
+	rx_stall_o <= '0' when (state = s_idle and (burst_read_pending = '0' or rx_serves_slave = '1'))
+	                    or state = s_receive or state = s_burst_count or state = s_burst_data
 					 else '1';
 
+	burst_read_pending <= burst_out.active and not wbta_we_out;
+	with to_t_command(rx_dat_i(3 downto 0)) select rx_serves_slave <= 
+		'1' when command_set_dat | command_slave_ack | command_slave_err | command_slave_rty | command_reset,
+		'0' when others;
+
 	-- wishbone transaction output signals
 	wbta_dat_o.adr <= wb_adr;
 	wbta_dat_o.sel <= wb_sel;
 	wbta_dat_o.dat <= wb_dat;
-	wbta_dat_o.cyc <= mask(3); -- this is the bit that controls cyc after stb response (ack,err,rty, or timeout)
+	wbta_dat_o.cyc <= wbta_cyc_out; -- this is the bit that controls cyc after stb response (ack,err,rty, or timeout)
 	wbta_dat_o.we  <= wbta_we_out;
 	wbta_dat_o.stall_timeout <= unsigned(stall_timeout);
+	wbta_dat_o.burst <= burst_out;
 	wbta_stb_o <= wbta_stb_out;
 
 	config_o <= config_out;  
 	stb_resp_o <= stb_resp_out;
+	slave_cache_o <= slave_cache_out;
 
 	gpo_bits_o <= gpo_bits_out;
 
@@ -391,19 +424,39 @@ begin
 		end if;
 
 		stb_resp_out <= c_wbp_response_init;
+		slave_cache_out <= c_slave_cache_update_none;
 		bridge_reset_out <= '0';
 
+		-- The strobes of a burst read are issued while the bridge waits for host commands in s_idle, 
+		-- because the addressed slave can be the bridge's own slave interface which needs responses from the host.
+		if burst_read_pending = '1' and wbta_stb_out = '1' and wbta_stall_i = '0' then
+			wbta_stb_out <= '0';
+			wb_adr <= std_logic_vector(unsigned(wb_adr) + 4);
+			burst_out.first <= '0';
+			if burst_count = 0 then
+				burst_out <= c_wbp_burst_none;
+			else
+				burst_count <= burst_count - 1;
+				if burst_count = 1 then
+					burst_out.last <= '1';
+					wbta_cyc_out   <= burst_keep_cyc;
+				end if;
+				wbta_stb_out <= '1';
+			end if;
+		end if;
+
 		case state is
 
 			when s_idle =>
 				gpo_bits_out <= gpo_bits;
 
-				if rx_stb_i = '1' then
+				if rx_stb_i = '1' and (burst_read_pending = '0' or rx_serves_slave = '1') then
 					case command is
 						when command_config =>
 							reset_just_happened <= '0';
 							config_out.host_sends_write_response <= mask(0);
 							config_out.fpga_sends_write_response <= mask(1);
+							config_out.delta_slave_writes        <= mask(2);
 						when command_set_sel => 
 							reset_just_happened <= '0';
 							wb_sel <= mask;
@@ -423,14 +476,26 @@ begin
 							reset_just_happened <= '0';
 								wbta_stb_out <= '1';
 								wbta_we_out  <= '1';
+								wbta_cyc_out <= mask(3);
 								delta_adr <= signed(mask(2 downto 0));
 							state <= s_stb;
 						when command_read_stb => 
 							reset_just_happened <= '0';
 								wbta_stb_out <= '1';
 								wbta_we_out  <= '0';
+								wbta_cyc_out <= mask(3);
 								delta_adr <= signed(mask(2 downto 0));
 							state <= s_stb;
+						when command_burst_write =>
+							reset_just_happened <= '0';
+								wbta_we_out    <= '1';
+								burst_keep_cyc <= mask(3);
+							state <= s_burst_count;
+						when command_burst_read =>
+							reset_just_happened <= '0';
+								wbta_we_out    <= '0';
+								burst_keep_cyc <= mask(3);
+							state <= s_burst_count;
 						when command_slave_ack => 
 							reset_just_happened <= '0';
 							stb_resp_out.ack <= '1';
@@ -447,6 +512,13 @@ begin
 							reset_just_happened <= '0';
 							receive_type <= receive_gpo_bits;
 								start_receive(mask, byte_select, state);
+						when command_slave_cache =>
+							reset_just_happened <= '0';
+							slave_cache_out.fill           <= mask(0);
+							slave_cache_out.invalidate     <= mask(1);
+							slave_cache_out.invalidate_all <= mask(2);
+							slave_cache_out.adr            <= wb_adr;
+							slave_cache_out.dat            <= wb_dat;
 						when command_reset =>
 							reset_just_happened <= '1';
 							if reset_just_happened = '0' then
@@ -456,6 +528,8 @@ begin
 								wb_sel           <= (others => '0');
 								stall_timeout    <= (others => '0');
 								gpo_bits         <= (others => '0');
+								wbta_stb_out     <= '0';
+								burst_out        <= c_wbp_burst_none;
 								state            <= s_idle;
 							end if;
 
@@ -489,8 +563,86 @@ begin
 					state <= s_idle;
 				end if;
 
+			-- burst write/read: a count byte (number of words minus one) follows the command.
+			-- For a burst write it is followed by the data bytes of each word. 
+			-- Every word is strobed as soon as it is complete (a burst read strobes right away 
+			-- and continues in s_idle), the address is incremented by 4 after each strobe and 
+			-- cyc is kept high until the last strobe of the burst.
+			when s_burst_count =>
+				if rx_stb_i = '1' then
+					burst_count <= unsigned(rx_dat_i);
+					burst_out.active <= '1';
+					burst_out.first  <= '1';
+					burst_out.count  <= unsigned(rx_dat_i);
+					if unsigned(rx_dat_i) = 0 then
+						burst_out.last <= '1';
+						wbta_cyc_out   <= burst_keep_cyc;
+					else 
+						burst_out.last <= '0';
+						wbta_cyc_out   <= '1';
+					end if;
+					if wbta_we_out = '0' then 
+						wbta_stb_out <= '1';
+						state <= s_idle;
+					elsif wb_sel = "0000" then 
+						wbta_stb_out <= '1';
+						state <= s_burst_stb;
+					else
+						byte_select <= init_byte_select(wb_sel);
+						state <= s_burst_data;
+					end if;
+				end if;
+
+			when s_burst_data =>
+				if rx_stb_i = '1' then
+					wb_dat((byte_select.idx+1)*8-1 downto byte_select.idx*8) <= rx_dat_i;
+					byte_select <= next_byte_select(byte_select);
+					if byte_select.mask(3 downto 1) = "000" then
+						wbta_stb_out <= '1';
+						state <= s_burst_stb;
+					end if;
+				end if;
+
+			when s_burst_stb =>
+				if wbta_stall_i = '0' then
+					wbta_stb_out <= '0';
+					wb_adr <= std_logic_vector(unsigned(wb_adr) + 4);
+					burst_out.first <= '0';
+					if burst_count = 0 then
+						burst_out <= c_wbp_burst_none;
+						state <= s_idle;
+					else
+						burst_count <= burst_count - 1;
+						if burst_count = 1 then
+							burst_out.last <= '1';
+							wbta_cyc_out   <= burst_keep_cyc;
+						end if;
+						if wb_sel = "0000" then 
+							wbta_stb_out <= '1';
+						else
+							byte_select <= init_byte_select(wb_sel);
+							state <= s_burst_data;
+						end if;
+					end if;
+				end if;
+
 		end case;
 
+		-- If the host stops sending in the middle of a command (e.g. it timed out during a burst write), 
+		-- the command is abandoned after g_command_timeout clock cycles. The following bytes are taken as 
+		-- commands again, so the host needs only a few reset commands to bring the bridge into a known state.
+		if g_command_timeout > 0 then
+			command_wait <= 0;
+			if (state = s_receive or state = s_burst_count or state = s_burst_data) and rx_stb_i = '0' then
+				if command_wait = g_command_timeout then
+					burst_out <= c_wbp_burst_none;
+					state     <= s_idle;
+				else
+					command_wait <= command_wait + 1;
+				end if;
+			end if;
+		end if;
+
 	end process;
 end architecture;
 
@@ -531,7 +683,40 @@ architecture rtl of wbta_uart is
 		end if;
 	end function;
 
-	type t_state is (s_idle, s_write_header, s_read_header, s_read_data);
+	-- the aggregated response of a burst is the first response that is not ack
+	function combine_response(aggregated, response : std_logic_vector(2 downto 0)) return std_logic_vector is
+	begin
+		if aggregated = "000" or aggregated = "001" then return response;
+		else                                            return aggregated;
+		end if;
+	end function;
+
+	-- the bytes of dat that are selected by sel, moved towards the least significant bit
+	function selected_bytes(dat : t_wbp_dat; sel : t_wbp_sel) return std_logic_vector is
+		variable result : std_logic_vector(31 downto 0) := (others => '0');
+		variable n      : integer range 0 to 4 := 0;
+	begin
+		for i in 0 to 3 loop
+			if sel(i) = '1' then
+				result(n*8+7 downto n*8) := dat(i*8+7 downto i*8);
+				n := n + 1;
+			end if;
+		end loop;
+		return result;
+	end function;
+	function number_of_selected_bits(sel : t_wbp_sel) return integer is
+		variable n : integer range 0 to 32 := 0;
+	begin
+		for i in 0 to 3 loop
+			if sel(i) = '1' then
+				n := n + 8;
+			end if;
+		end loop;
+		return n;
+	end function;
+
+	type t_state is (s_idle, s_write_header, s_read_header, s_read_data, 
+	                 s_burst_header, s_burst_count, s_burst_payload, s_burst_status);
 	signal state : t_state := s_idle;
 
 	--signal wbta_stall_out : std_logic := '0';
@@ -544,6 +729,16 @@ architecture rtl of wbta_uart is
 
 
 	signal byte_select : t_byte_select := c_byte_select_zero;
+
+	-- aggregated response of the burst that is in progress
+	signal burst_response : std_logic_vector(2 downto 0) := (others => '0');
+
+	-- burst read response: bits of the selected data bytes that were not sent yet
+	-- (always less than 7 bits in s_idle) and the number of these bits
+	signal burst_count : unsigned(7 downto 0) := (others => '0');
+	signal burst_last  : std_logic := '0';
+	signal pack_buf    : std_logic_vector(38 downto 0) := (others => '0');
+	signal pack_cnt    : integer range 0 to 38 := 0;
 begin
 
 	wbta_stall_o <= '0' when state = s_idle else '1';
@@ -552,6 +747,38 @@ begin
 
 	process
 		variable byte_select_next : t_byte_select;
+		variable burst_response_next : std_logic_vector(2 downto 0);
+		variable pack_buf_next       : std_logic_vector(38 downto 0);
+		variable pack_cnt_next       : integer range 0 to 38;
+
+		-- send the next byte of a burst read response: 7 payload bits as long as there are enough, 
+		-- the remaining (zero padded) bits after the last word, and then the status byte
+		procedure burst_read_next_byte(buf : std_logic_vector(38 downto 0); cnt : integer; last : std_logic; response : std_logic_vector(2 downto 0)) is
+		begin
+			if cnt >= 7 or (last = '1' and cnt > 0) then
+				tx_stb_out <= '1';
+				tx_dat_out <= '0' & buf(6 downto 0);
+				pack_buf   <= "0000000" & buf(38 downto 7);
+				if cnt >= 7 then 
+					pack_cnt <= cnt - 7;
+				else 
+					pack_cnt <= 0;
+				end if;
+				state      <= s_burst_payload;
+			elsif last = '1' then
+				tx_stb_out <= '1';
+				tx_dat_out <= "00000" & response;
+				pack_buf   <= buf;
+				pack_cnt   <= cnt;
+				state      <= s_burst_status;
+			else 
+				-- wait for the next word, slave requests may be sent in between
+				tx_stb_out <= '0';
+				pack_buf   <= buf;
+				pack_cnt   <= cnt;
+				state      <= s_idle;
+			end if;
+		end procedure;
 	begin
 		wait until rising_edge(clk_i);
 
@@ -562,6 +789,11 @@ begin
 			wb_dat      <= (others => '0');
 			wb_sel      <= (others => '0');
 			byte_select <= c_byte_select_zero;
+			burst_response <= (others => '0');
+			burst_count    <= (others => '0');
+			burst_last     <= '0';
+			pack_buf       <= (others => '0');
+			pack_cnt       <= 0;
 
 		else
 
@@ -570,7 +802,36 @@ begin
 					if wbta_stb_i = '1' then 
 						wb_dat      <= wbta_dat_i.dat;
 						tx_stb_out  <= '1';
-						if wbta_dat_i.we = '1' then 
+						burst_response_next := combine_response(burst_response, response_type(wbta_dat_i.ack, wbta_dat_i.err, wbta_dat_i.rty, wbta_dat_i.stall_timeout));
+						if wbta_dat_i.we = '1' and wbta_dat_i.burst.active = '1' and wbta_dat_i.burst.last = '0' then
+							-- collect the responses of a burst write, only the last strobe is answered
+							tx_stb_out <= '0';
+							burst_response <= burst_response_next;
+						elsif wbta_dat_i.we = '1' and wbta_dat_i.burst.active = '1' then
+							tx_dat_out <= '1' & "000" & '0' & burst_response_next;
+							burst_response <= (others => '0');
+							state      <= s_write_header;
+						elsif wbta_dat_i.burst.active = '1' then
+							-- burst read: the selected data bytes of all words are sent as one stream of 7-bit payload bytes
+							burst_response <= burst_response_next;
+							burst_last     <= wbta_dat_i.burst.last;
+							if wbta_dat_i.burst.first = '1' then
+								pack_buf_next := std_logic_vector(resize(unsigned(selected_bytes(wbta_dat_i.dat, wbta_dat_i.sel)), 39));
+								pack_cnt_next := number_of_selected_bits(wbta_dat_i.sel);
+							else
+								pack_buf_next := pack_buf or std_logic_vector(shift_left(resize(unsigned(selected_bytes(wbta_dat_i.dat, wbta_dat_i.sel)), 39), pack_cnt));
+								pack_cnt_next := pack_cnt + number_of_selected_bits(wbta_dat_i.sel);
+							end if;
+							if wbta_dat_i.burst.first = '1' then
+								burst_count <= wbta_dat_i.burst.count;
+								pack_buf    <= pack_buf_next;
+								pack_cnt    <= pack_cnt_next;
+								tx_dat_out  <= '1' & "000" & "0101"; -- burst read response header
+								state       <= s_burst_header;
+							else 
+								burst_read_next_byte(pack_buf_next, pack_cnt_next, wbta_dat_i.burst.last, burst_response_next);
+							end if;
+						elsif wbta_dat_i.we = '1' then 
 							tx_dat_out <= '1' & "000" & '0' & response_type(wbta_dat_i.ack, wbta_dat_i.err, wbta_dat_i.rty, wbta_dat_i.stall_timeout);
 							state      <= s_write_header;
 						else 
@@ -609,6 +870,24 @@ begin
 						tx_dat_out <= '0' & wb_dat((byte_select_next.idx+1)*8-2 downto byte_select_next.idx*8);
 					end if;				
 
+				when s_burst_header =>
+					if tx_stall_i = '0' then
+						tx_dat_out <= '0' & std_logic_vector(burst_count(6 downto 0));
+						state      <= s_burst_count;
+					end if;
+
+				when s_burst_count | s_burst_payload =>
+					if tx_stall_i = '0' then
+						burst_read_next_byte(pack_buf, pack_cnt, burst_last, burst_response);
+					end if;
+
+				when s_burst_status =>
+					if tx_stall_i = '0' then
+						tx_stb_out     <= '0';
+						burst_response <= (others => '0');
+						state          <= s_idle;
+					end if;
+
 			end case;
 
 		end if;
@@ -624,8 +903,20 @@ use ieee.numeric_std.all;
 
 use work.wbta_pkg.all;
 
--- A wishbone slave interface with read and write capability
+-- A wishbone slave interface with read and write capability.
+-- Reads of addresses that the host has put into the cache (see slave cache command)
+-- are answered right away without sending a read request to the host.
+-- If delta writes are enabled (see config command), writes with sel="1111" that 
+-- need no response from the host are collected and sent as delta write frames.
 entity wb_uart is 
+generic (
+	-- number of words in the cache, 0 disables it
+	g_cache_entries : natural := 4;
+	-- maximum number of words in a delta write frame
+	g_delta_words   : positive range 1 to 8 := 8;
+	-- a delta write frame is sent if no write to the next address came for this many clock cycles
+	g_delta_wait    : natural := 16
+);
 port (
 	clk_i    :  in std_logic;
 	rst_i    :  in std_logic;
@@ -633,7 +924,10 @@ port (
 	bridge_reset_i          :  in std_logic;
 	-- host response
 	config_write_response_i :  in std_logic;
+	config_delta_writes_i   :  in std_logic := '0';
 	stb_resp_i              :  in t_wbp_response;
+	-- cache commands from host
+	cache_i                 :  in t_slave_cache_update := c_slave_cache_update_none;
 	-- uart transmitter interface
 	tx_dat_o   : out std_logic_vector(7 downto 0);
 	tx_stb_o   : out std_logic;
@@ -670,7 +964,8 @@ architecture rtl of wb_uart is
 	type t_state is  (s_idle, 
 										s_write_header, s_adr, s_finish_read_adr, 
 										s_prepare_write_data, s_write_data, 
-										s_wait_for_host_response
+										s_wait_for_host_response,
+										s_delta_collect, s_delta_data
 										);
 	signal state : t_state := s_idle;
 
@@ -678,6 +973,40 @@ architecture rtl of wb_uart is
 
 	signal lowest_adr_bit_read : integer := 0;
 
+	-- the words of a delta write frame
+	type t_delta_words is array (0 to g_delta_words-1) of t_wbp_dat;
+	signal delta_words : t_delta_words := (others => (others => '0'));
+	signal delta_count : integer range 0 to g_delta_words := 0;
+	signal delta_word  : integer range 0 to g_delta_words := 0;
+	signal delta_byte  : integer range 0 to 4 := 0;
+	signal delta_wait  : integer range 0 to g_delta_wait := 0;
+	signal delta_frame : std_logic := '0';
+	-- the address after the last slave write, delta write frames are relative to it
+	signal expected_adr : std_logic_vector(31 downto 2) := (others => '0');
+	signal delta_append : std_logic;
+
+	-- fully associative, entries are replaced round robin
+	type t_cache_entry is record
+		valid : std_logic;
+		adr   : std_logic_vector(31 downto 2);
+		dat   : t_wbp_dat;
+	end record;
+	constant c_cache_entry_invalid : t_cache_entry := (valid=>'0', adr=>(others => '0'), dat=>(others => '0'));
+	type t_cache is array (natural range <>) of t_cache_entry;
+	signal cache : t_cache(0 to g_cache_entries-1) := (others => c_cache_entry_invalid);
+	signal cache_replace : integer range 0 to g_cache_entries := 0;
+
+	-- index of the valid entry for adr, or -1
+	function cache_lookup(cache : t_cache; adr : std_logic_vector(31 downto 0)) return integer is
+	begin
+		for i in cache'range loop
+			if cache(i).valid = '1' and cache(i).adr = adr(31 downto 2) then
+				return i;
+			end if;
+		end loop;
+		return -1;
+	end function;
+
 
 	-- The slave produces two types of headers (type field 5 or 7)
 	-- Type 5 is a slave write access, causing the wb-write callback function on the host to be called
@@ -691,7 +1020,14 @@ architecture rtl of wb_uart is
 	--                             /   adr bit 2    \ adr bit 4                    adr bit 31      adr bit 26
 		--                       adr bit 3              adr bit 5
 		--
-	-- not yet implmeneted fast write (writes with sel = "1111" and without address) response type 6 header "1 110 dddd" "0ddddddd" "0ddddddd" "0ddddddd" "0ddddddd"
+	-- Type 6 is a slave write access like type 5, but the host sends no response
+	-- header type 6 "1 110 ssss" ... same as type 5 
+
+	-- delta writes (write response type with payload "1nnn"), n+1 words with sel="1111" at consecutive addresses.
+	-- The first address is sent as zigzag encoded word distance to the address after the previous slave write.
+	-- Each word is sent as "0000dddd" (dat(31),dat(23),dat(15),dat(7)) and four data bytes.
+	-- header type 0 "1 000 1nnn" "00zzzzzz" "0000dddd" "0ddddddd" "0ddddddd" "0ddddddd" "0ddddddd" ...
+	-- header type 0 "1 000 1nnn" "01zzzzzz" "00zzzzzz" "0000dddd" "0ddddddd" "0ddddddd" "0ddddddd" "0ddddddd" ...
 
 	-- slave reads
 	-- header type 7 "1 111 ssss" "00aaaaaa" 
@@ -702,7 +1038,12 @@ begin
 	tx_dat_o <= tx_dat_out;
 	tx_stb_o <= tx_stb_out;
 
-	stall_o  <= '0' when state = s_idle else '1';
+	-- another word for the delta write frame that is being collected
+	delta_append <= '1' when state = s_delta_collect and delta_count < g_delta_words and 
+	                         cyc_i = '1' and stb_i = '1' and we_i = '1' and sel_i = "1111" and 
+	                         adr_i(31 downto 2) = expected_adr else '0';
+
+	stall_o  <= '0' when state = s_idle or delta_append = '1' else '1';
 	ack_o    <= wbp_resp_out.ack;
 	rty_o    <= wbp_resp_out.rty;
 	err_o    <= wbp_resp_out.err;
@@ -711,6 +1052,8 @@ begin
 
 	process
 		variable byte_select_next : t_byte_select;
+		variable cache_idx : integer;
+		variable word : t_wbp_dat;
 	begin
 		wait until rising_edge(clk_i);
 
@@ -726,6 +1069,11 @@ begin
 			state          <= s_idle;
 			byte_select    <= c_byte_select_zero;
 			lowest_adr_bit_read <= 0;
+			delta_count    <= 0;
+			delta_frame    <= '0';
+			expected_adr   <= (others => '0');
+			cache          <= (others => c_cache_entry_invalid);
+			cache_replace  <= 0;
 
 		else
 
@@ -734,20 +1082,42 @@ begin
 			case state is 
 				when s_idle =>
 					if cyc_i = '1' and stb_i = '1' then 
+						cache_idx := cache_lookup(cache, adr_i);
 						if we_i = '1' then
+							-- the host decides what happens with the written value
+							if cache_idx >= 0 then
+								cache(cache_idx).valid <= '0';
+							end if;
 							wb_dat <= dat_i;
 							wb_adr <= adr_i;
 							wb_sel <= sel_i;
 							wb_we  <= '1';
 							wbp_resp_out.ack <= not config_write_response_i; -- don't ack if a write response from the host is expected
-							tx_stb_out <= '1';
-							if config_write_response_i = '1' then
-								tx_dat_out <= "1101" & sel_i;
-							else 
-								tx_dat_out <= "1110" & sel_i;
+							delta_frame <= '0';
+							expected_adr <= std_logic_vector(unsigned(adr_i(31 downto 2)) + 1);
+							if config_delta_writes_i = '1' and config_write_response_i = '0' and sel_i = "1111" then
+								-- wait for more words before anything is sent
+								delta_words(0) <= dat_i;
+								delta_count    <= 1;
+								delta_wait     <= 0;
+								delta_frame    <= '1';
+								adr_packing    <= init_adr_packing_delta(adr_i, expected_adr);
+								tx_stb_out     <= '0';
+								state          <= s_delta_collect;
+							else
+								tx_stb_out <= '1';
+								if config_write_response_i = '1' then
+									tx_dat_out <= "1101" & sel_i;
+								else 
+									tx_dat_out <= "1110" & sel_i;
+								end if;
+								adr_packing <= init_adr_packing_write(adr_i);
+								state <= s_write_header;
 							end if;
-							adr_packing <= init_adr_packing_write(adr_i);
-							state <= s_write_header;
+						elsif cache_idx >= 0 then
+							wbp_resp_out.ack <= '1';
+							wbp_resp_out.dat <= cache(cache_idx).dat;
+							tx_stb_out <= '0';
 						else 
 							wb_adr <= adr_i;
 							wb_sel <= sel_i;
@@ -780,7 +1150,11 @@ begin
 							tx_dat_out <= '0' & '1' & adr_packing.blocks(adr_packing.idx);
 						else
 							tx_dat_out <= '0' & '0' & adr_packing.blocks(adr_packing.idx);
-							if wb_we = '1' then
+							if delta_frame = '1' then
+								delta_word <= 0;
+								delta_byte <= 0;
+								state <= s_delta_data;
+							elsif wb_we = '1' then
 								state <= s_prepare_write_data;
 							else 
 								state <= s_finish_read_adr;
@@ -839,8 +1213,75 @@ begin
 						end if;
 					end if;
 
+				when s_delta_collect =>
+					if delta_append = '1' then
+						cache_idx := cache_lookup(cache, adr_i);
+						if cache_idx >= 0 then
+							cache(cache_idx).valid <= '0';
+						end if;
+						delta_words(delta_count) <= dat_i;
+						delta_count  <= delta_count + 1;
+						delta_wait   <= 0;
+						expected_adr <= std_logic_vector(unsigned(expected_adr) + 1);
+						wbp_resp_out.ack <= '1';
+					elsif (cyc_i = '1' and stb_i = '1') or delta_count = g_delta_words or delta_wait = g_delta_wait then
+						-- another access is waiting, the frame is full, or no more words came
+						tx_stb_out <= '1';
+						tx_dat_out <= "10001" & std_logic_vector(to_unsigned(delta_count-1, 3));
+						state <= s_adr;
+					else
+						delta_wait <= delta_wait + 1;
+					end if;
+
+				when s_delta_data =>
+					if tx_stall_i = '0' then 
+						if delta_word = delta_count then
+							tx_stb_out <= '0';
+							state <= s_idle;
+						else
+							word := delta_words(delta_word);
+							if delta_byte = 0 then
+								tx_dat_out <= "0000" & word(31) & word(23) & word(15) & word(7);
+							else
+								tx_dat_out <= '0' & word(delta_byte*8-2 downto delta_byte*8-8);
+							end if;
+							if delta_byte = 4 then
+								delta_byte <= 0;
+								delta_word <= delta_word + 1;
+							else
+								delta_byte <= delta_byte + 1;
+							end if;
+						end if;
+					end if;
+
 			end case;
 
+			-- the host starts from zero whenever delta writes are enabled
+			if config_delta_writes_i = '0' then
+				expected_adr <= (others => '0');
+			end if;
+
+			-- commands from the host take precedence over the invalidation by slave writes
+			if bridge_reset_i = '1' or cache_i.invalidate_all = '1' then
+				cache <= (others => c_cache_entry_invalid);
+			elsif g_cache_entries > 0 then
+				cache_idx := cache_lookup(cache, cache_i.adr);
+				if cache_i.invalidate = '1' and cache_idx >= 0 then
+					cache(cache_idx).valid <= '0';
+				end if;
+				if cache_i.fill = '1' then
+					if cache_idx < 0 then
+						cache_idx := cache_replace;
+						if cache_replace = g_cache_entries-1 then
+							cache_replace <= 0;
+						else
+							cache_replace <= cache_replace + 1;
+						end if;
+					end if;
+					cache(cache_idx) <= (valid=>'1', adr=>cache_i.adr(31 downto 2), dat=>cache_i.dat);
+				end if;
+			end if;
+
 		end if;
 
 	end process;
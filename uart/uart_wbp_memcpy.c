@@ -0,0 +1,323 @@
+#include "uart_wbp_access.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+void print_help(const char* argv0){
+	fprintf(stderr, "usage: %s [options] <devicename> upload   <file> <adr>\n", argv0);
+	fprintf(stderr, "       %s [options] <devicename> download <file> <adr> <bytes>\n", argv0);
+	fprintf(stderr, " upload copies the file to the wishbone address range starting at <adr>,\n");
+	fprintf(stderr, " download copies <bytes> bytes from the address range to the file.\n");
+	fprintf(stderr, " Byte 4*i+j of the file is byte lane j of the word at <adr>+4*i.\n");
+	fprintf(stderr, " options are\n");
+	fprintf(stderr, " -c <words>        : number of words per chunk (default is 4096), without -r the burst reads\n");
+	fprintf(stderr, "                     of a chunk are paced so that they do not overrun the bridge\n");
+	fprintf(stderr, " -o <offset>       : start at byte offset (multiple of 4), e.g. to resume a transfer\n");
+	fprintf(stderr, " -V                : verify each uploaded chunk by reading it back\n");
+	fprintf(stderr, " -R <retries>      : retry a failing chunk this many times (default is 3)\n");
+	fprintf(stderr, " -T <milliseconds> : give up on a chunk if the device does not respond in time (default is 2000)\n");
+	fprintf(stderr, " -d                : disable device response message to writes\n");
+	fprintf(stderr, " -r                : enable RTS/CTS hardware flow control\n");
+	fprintf(stderr, " -q                : don't show progress\n");
+	fprintf(stderr, " -v                : verbose output\n");
+}
+
+double now_s()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + 1e-9*t.tv_nsec;
+}
+
+// 32-bit FNV-1a hash of the transferred bytes, to compare two transfers
+uint32_t fnv1a(uint32_t hash, const uint8_t *data, size_t len)
+{
+	for (size_t i = 0; i < len; ++i) {
+		hash = (hash ^ data[i]) * 16777619u;
+	}
+	return hash;
+}
+
+void show_progress(size_t done, size_t total, double t_start, int final)
+{
+	double dt = now_s() - t_start;
+	fprintf(stderr, "\r%10zu / %zu bytes (%3d%%) %8.3f MB/s", done, total,
+		total ? (int)(100.0*done/total) : 100, dt > 0 ? 1e-6*done/dt : 0.0);
+	if (final) {
+		fprintf(stderr, "\n");
+	}
+}
+
+// The words of a chunk are accessed with burst commands, except for the last word if the file 
+// ends inside of it (tail_sel != 0). That word is accessed with the sel bits of the bytes in the 
+// file, so that the bytes beyond the end of the file are not overwritten.
+uart_wbp_response_t write_chunk(uart_wbp_device_t *device, uint32_t adr, const uint32_t *words, int n_full, uint8_t tail_sel)
+{
+	uart_wbp_response_t response = ack;
+	if (n_full > 0) {
+		response = uart_wbp_write_burst(device, 0xf, adr, words, n_full, 0);
+	}
+	if (tail_sel && (response == ack || response == unknown)) {
+		response = uart_wbp_write(device, tail_sel, adr+4*n_full, words[n_full], 0, 0);
+	}
+	return response;
+}
+
+uart_wbp_response_t read_chunk(uart_wbp_device_t *device, uint32_t adr, uint32_t *words, int n_full, uint8_t tail_sel)
+{
+	uart_wbp_response_t response = ack;
+	if (n_full > 0) {
+		response = uart_wbp_read_burst(device, 0xf, adr, words, n_full, 0);
+	}
+	if (tail_sel && response == ack) {
+		response = uart_wbp_read(device, tail_sel, adr+4*n_full, &words[n_full], 0, 0);
+	}
+	return response;
+}
+
+int main(int argc, char **argv) {
+
+	const char* device_name = NULL;
+	const char* direction = NULL;
+	const char* file_name = NULL;
+	uint32_t adr = 0, adr_set = 0;
+	size_t   size = 0, size_set = 0;
+	size_t   offset = 0;
+	int chunk_words = 4096;
+	int verify = 0;
+	int retries = 3;
+	int timeout_ms = 2000;
+	int rtscts = 0;
+	int quiet = 0;
+	int verbose = 0;
+	uart_wbp_config_t bridge_config = fpga_sends_write_response;
+
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i],"--help") == 0) {
+			print_help(argv[0]);
+			return 0;
+		} else if (strcmp(argv[i],"-c") == 0) {
+			if (++i >= argc || sscanf(argv[i], "%d", &chunk_words) != 1 || chunk_words <= 0) {
+				fprintf(stderr, "expect positive integer value after option -c\n");
+				return -1;
+			}
+		} else if (strcmp(argv[i],"-o") == 0) {
+			if (++i >= argc || sscanf(argv[i], "%zi", &offset) != 1 || offset%4 != 0) {
+				fprintf(stderr, "expect multiple of 4 after option -o\n");
+				return -1;
+			}
+		} else if (strcmp(argv[i],"-R") == 0) {
+			if (++i >= argc || sscanf(argv[i], "%d", &retries) != 1) {
+				fprintf(stderr, "expect integer value after option -R\n");
+				return -1;
+			}
+		} else if (strcmp(argv[i],"-T") == 0) {
+			if (++i >= argc || sscanf(argv[i], "%d", &timeout_ms) != 1) {
+				fprintf(stderr, "expect integer value after option -T\n");
+				return -1;
+			}
+		} else if (strcmp(argv[i],"-V") == 0) {
+			verify = 1;
+		} else if (strcmp(argv[i],"-d") == 0) {
+			bridge_config &= ~(fpga_sends_write_response);
+		} else if (strcmp(argv[i],"-r") == 0) {
+			rtscts = 1;
+		} else if (strcmp(argv[i],"-q") == 0) {
+			quiet = 1;
+		} else if (strcmp(argv[i],"-v") == 0) {
+			verbose = 1;
+		} else if (argv[i][0] != '-') {
+			if (device_name == NULL) {
+				device_name = argv[i];
+			} else if (direction == NULL) {
+				direction = argv[i];
+			} else if (file_name == NULL) {
+				file_name = argv[i];
+			} else if (adr_set == 0) {
+				sscanf(argv[i], "%x", &adr);
+				adr_set = 1;
+			} else if (size_set == 0) {
+				sscanf(argv[i], "%zi", &size);
+				size_set = 1;
+			} else {
+				fprintf(stderr, "unkown command line option: %s\n", argv[i]);
+				return -1;
+			}
+		} else {
+			fprintf(stderr, "unkown command line option: %s\n", argv[i]);
+			return -1;
+		}
+	}
+
+	if (direction == NULL || file_name == NULL || !adr_set) {
+		print_help(argv[0]);
+		return -1;
+	}
+	int upload = (strcmp(direction, "upload") == 0);
+	if (!upload && strcmp(direction, "download") != 0) {
+		fprintf(stderr, "expect upload or download, not \"%s\"\n", direction);
+		return -1;
+	}
+	if (!upload && !size_set) {
+		fprintf(stderr, "missing number of bytes to download\n");
+		return -1;
+	}
+	if (adr%4 != 0) {
+		fprintf(stderr, "address must be a multiple of 4\n");
+		return -1;
+	}
+
+	// map the file
+	int fd = open(file_name, upload ? O_RDONLY : (O_RDWR | O_CREAT), 0644);
+	if (fd < 0) {
+		perror(file_name);
+		return 2;
+	}
+	if (upload) {
+		struct stat st;
+		if (fstat(fd, &st) < 0) {
+			perror(file_name);
+			return 2;
+		}
+		size = st.st_size;
+	} else if (ftruncate(fd, size) < 0) {
+		perror(file_name);
+		return 2;
+	}
+	if (offset > size) {
+		fprintf(stderr, "offset %zu is beyond the end of the transfer (%zu bytes)\n", offset, size);
+		return -1;
+	}
+	uint8_t *data = NULL;
+	if (size > 0) {
+		data = (uint8_t*)mmap(NULL, size, upload ? PROT_READ : (PROT_READ | PROT_WRITE), MAP_SHARED, fd, 0);
+		if (data == MAP_FAILED) {
+			perror(file_name);
+			return 2;
+		}
+		madvise(data, size, MADV_SEQUENTIAL);
+	}
+
+	uart_wbp_device_t *device = uart_wbp_open(device_name, B2000000, verbose);
+	if (!device) {
+		fprintf(stderr,"cannot open device \"%s\"\n", device_name);
+		return 2;
+	}
+	if (rtscts && uart_wbp_set_flow_control(device, 1) < 0) {
+		fprintf(stderr,"cannot enable flow control on device \"%s\"\n", device_name);
+		return 2;
+	}
+	if (uart_wbp_configure(device, bridge_config) < 0) {
+		fprintf(stderr,"cannot configure the bridge\n");
+		return 2;
+	}
+
+	uint32_t *words     = (uint32_t*)malloc(chunk_words*sizeof(uint32_t));
+	uint32_t *readback  = (uint32_t*)malloc(chunk_words*sizeof(uint32_t));
+	if (words == NULL || readback == NULL) {
+		fprintf(stderr, "cannot allocate buffers\n");
+		return 2;
+	}
+
+	// The data is transferred in chunks, each chunk is one call of uart_wbp_write_burst or
+	// uart_wbp_read_burst. The burst writes are sent all at once, the bridge takes their data as fast 
+	// as it arrives. Without flow control the burst reads are requested one burst ahead, because the 
+	// bridge takes the next request only when it can send its response, so the chunk size is not 
+	// limited by the receive FIFO of the bridge.
+	// A chunk that fails is repeated (the library resyncs the bridge after a timeout).
+	int result = 0;
+	uint32_t hash = 2166136261u;
+	double t_start = now_s(), t_progress = 0;
+	size_t start_offset = offset;
+	while (offset < size) {
+		size_t bytes = size - offset;
+		if (bytes > 4*(size_t)chunk_words) {
+			bytes = 4*(size_t)chunk_words;
+		}
+		int n = (bytes+3)/4;
+		int n_full = bytes/4;
+		uint8_t tail_sel = (1<<(bytes%4))-1; // byte lanes of the last word that are in the file
+		uint32_t tail_mask = (bytes%4) ? (1u<<(8*(bytes%4)))-1 : 0xffffffff;
+		uint32_t chunk_adr = adr + offset;
+
+		if (upload) {
+			// the last word is padded with zeros
+			memset(words, 0, n*sizeof(uint32_t));
+			for (size_t i = 0; i < bytes; ++i) {
+				words[i/4] |= (uint32_t)data[offset+i] << (8*(i%4));
+			}
+		}
+
+		uart_wbp_response_t response = unknown;
+		for (int attempt = 0; attempt <= retries; ++attempt) {
+			if (attempt > 0) {
+				fprintf(stderr, "\nchunk at offset %zu: %s, retry %d of %d\n", offset, uart_wbp_response_str(response), attempt, retries);
+			}
+			uart_wbp_set_deadline(device, timeout_ms);
+			if (upload) {
+				response = write_chunk(device, chunk_adr, words, n_full, tail_sel);
+				if ((response == ack || response == unknown) && verify) {
+					response = read_chunk(device, chunk_adr, readback, n_full, tail_sel);
+					for (int w = 0; w < n && response == ack; ++w) {
+						// only the bytes of the last word that are in the file are compared
+						uint32_t mask = (w == n-1) ? tail_mask : 0xffffffff;
+						if ((words[w] & mask) != (readback[w] & mask)) {
+							fprintf(stderr, "\nverify failed at adr 0x%08x: wrote 0x%08x, read 0x%08x (mask 0x%08x)\n", chunk_adr+4*w, words[w], readback[w], mask);
+							response = err;
+						}
+					}
+				}
+			} else {
+				response = read_chunk(device, chunk_adr, words, n_full, tail_sel);
+			}
+			uart_wbp_set_deadline(device, -1);
+			if (response == ack || response == unknown) {
+				break;
+			}
+		}
+		if (response != ack && response != unknown) {
+			fprintf(stderr, "\ntransfer failed at offset %zu (adr 0x%08x): %s\n", offset, chunk_adr, uart_wbp_response_str(response));
+			fprintf(stderr, "resume with option -o %zu\n", offset);
+			result = 1;
+			break;
+		}
+
+		if (!upload) {
+			for (size_t i = 0; i < bytes; ++i) {
+				data[offset+i] = words[i/4] >> (8*(i%4));
+			}
+		}
+		hash = fnv1a(hash, &data[offset], bytes);
+		offset += bytes;
+
+		if (!quiet && now_s() - t_progress > 0.2) {
+			t_progress = now_s();
+			show_progress(offset-start_offset, size-start_offset, t_start, 0);
+		}
+	}
+	if (!quiet) {
+		show_progress(offset-start_offset, size-start_offset, t_start, 1);
+	}
+	if (result == 0) {
+		// the hash covers the whole file only if the transfer was not resumed
+		fprintf(stdout, "%zu bytes %s, fnv1a%s=0x%08x\n", size-start_offset, upload ? "uploaded" : "downloaded",
+			start_offset ? "(from offset)" : "", hash);
+	}
+
+	free(words);
+	free(readback);
+	if (data) {
+		if (!upload) {
+			msync(data, size, MS_SYNC);
+		}
+		munmap(data, size);
+	}
+	close(fd);
+	uart_wbp_close(device);
+	return result;
+}
@@ -0,0 +1,314 @@
+#ifndef UART_WBP_QUEUE_H_
+#define UART_WBP_QUEUE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Bounded lock-free queues to pass items between threads, with the index scheme of the fifo cores
+// (see fifo/*/fifo.vhd): the storage has 2**depth slots, and the read and write indices have one bit
+// more than needed to address a slot. The low depth bits select the slot, the extra MSB toggles on
+// every lap. Equal indices mean empty, indices that differ only in the MSB mean full, so all slots
+// can be used.
+//
+// uart_wbp_queue_t has one producer thread and one consumer thread. Each side writes only its own
+// index and keeps a copy of the other index, which is reloaded when the copy says that there is not
+// enough space (or data). The index of each side is on its own cache line.
+//
+// uart_wbp_mpsc_queue_t allows any number of producer threads and one consumer thread. Producers
+// reserve slots with a compare-and-swap on a write ticket, copy the items, and mark each slot as
+// written in a sequence array. The consumer takes the written slots in order and marks them free
+// for the next lap. The tickets are free running 32 bit counters, their low depth+1 bits are the
+// fifo index (a producer that is suspended between reading the ticket and the compare-and-swap
+// would otherwise see the same index again after two laps).
+//
+// Items are item_size bytes and are copied. The storage (and the sequence array) is provided by
+// the caller, the queues never allocate. All functions are inline and only available in C.
+
+#ifdef __cplusplus
+#include <atomic>
+#define UART_WBP_QUEUE_ATOMIC(T) std::atomic<T>
+#define UART_WBP_QUEUE_ALIGNED   alignas(UART_WBP_QUEUE_CACHE_LINE)
+#else
+#include <stdatomic.h>
+#define UART_WBP_QUEUE_ATOMIC(T) _Atomic T
+#define UART_WBP_QUEUE_ALIGNED   _Alignas(UART_WBP_QUEUE_CACHE_LINE)
+#endif
+
+#define UART_WBP_QUEUE_CACHE_LINE 64
+#define UART_WBP_QUEUE_MAX_DEPTH  30
+
+typedef struct uart_wbp_queue
+{
+	// producer side
+	UART_WBP_QUEUE_ALIGNED UART_WBP_QUEUE_ATOMIC(uint32_t) write_idx;
+	uint32_t read_idx_cache;
+
+	// consumer side
+	UART_WBP_QUEUE_ALIGNED UART_WBP_QUEUE_ATOMIC(uint32_t) read_idx;
+	uint32_t write_idx_cache;
+
+	// constant after init
+	UART_WBP_QUEUE_ALIGNED uint8_t *storage;
+	size_t   item_size;
+	uint32_t size;   // 2**depth
+	uint32_t mask;   // selects the slot
+	uint32_t wrap;   // selects slot and lap bit
+} uart_wbp_queue_t;
+
+typedef struct uart_wbp_mpsc_queue
+{
+	// producer side, shared by all producers
+	UART_WBP_QUEUE_ALIGNED UART_WBP_QUEUE_ATOMIC(uint32_t) write_ticket;
+
+	// consumer side
+	UART_WBP_QUEUE_ALIGNED UART_WBP_QUEUE_ATOMIC(uint32_t) read_ticket;
+
+	// constant after init
+	UART_WBP_QUEUE_ALIGNED uint8_t *storage;
+	// seq[slot] is the ticket that may write the slot next, that ticket+1 once it is written,
+	// and the ticket of the next lap once the consumer took it
+	UART_WBP_QUEUE_ATOMIC(uint32_t) *seq;
+	size_t   item_size;
+	uint32_t size;
+	uint32_t mask;
+} uart_wbp_mpsc_queue_t;
+
+#ifndef __cplusplus
+
+// Copy n items between the slots starting at index idx and a linear array, in two parts at the end of the storage.
+static inline void uart_wbp_queue_copy_in(uint8_t *storage, uint32_t size, uint32_t mask, size_t item_size, uint32_t idx, const void *items, size_t n)
+{
+	uint32_t slot = idx & mask;
+	size_t first = (n < size-slot) ? n : size-slot;
+	memcpy(storage + slot*item_size, items, first*item_size);
+	memcpy(storage, (const uint8_t*)items + first*item_size, (n-first)*item_size);
+}
+
+static inline void uart_wbp_queue_copy_out(const uint8_t *storage, uint32_t size, uint32_t mask, size_t item_size, uint32_t idx, void *items, size_t n)
+{
+	uint32_t slot = idx & mask;
+	size_t first = (n < size-slot) ? n : size-slot;
+	memcpy(items, storage + slot*item_size, first*item_size);
+	memcpy((uint8_t*)items + first*item_size, storage, (n-first)*item_size);
+}
+
+/////////////////////////////////////////////////
+// single producer, single consumer
+/////////////////////////////////////////////////
+
+// storage must hold 2**depth items of item_size bytes. Returns -1 if depth is not in [1,UART_WBP_QUEUE_MAX_DEPTH].
+// Not thread safe, the queue must not be in use.
+static inline int uart_wbp_queue_init(uart_wbp_queue_t *queue, void *storage, int depth, size_t item_size)
+{
+	if (depth < 1 || depth > UART_WBP_QUEUE_MAX_DEPTH) {
+		return -1;
+	}
+	queue->storage   = (uint8_t*)storage;
+	queue->item_size = item_size;
+	queue->size      = 1u << depth;
+	queue->mask      = queue->size - 1;
+	queue->wrap      = 2*queue->size - 1;
+	atomic_init(&queue->write_idx, 0);
+	atomic_init(&queue->read_idx, 0);
+	queue->read_idx_cache  = 0;
+	queue->write_idx_cache = 0;
+	return 0;
+}
+
+// Number of items in the queue. Exact in the producer and consumer threads, a snapshot in others.
+static inline size_t uart_wbp_queue_fill(uart_wbp_queue_t *queue)
+{
+	uint32_t r = atomic_load_explicit(&queue->read_idx, memory_order_acquire);
+	uint32_t w = atomic_load_explicit(&queue->write_idx, memory_order_acquire);
+	return (w - r) & queue->wrap;
+}
+
+// Producer: free slots, the copy of the read index is reloaded if it shows less than n.
+static inline size_t uart_wbp_queue_space(uart_wbp_queue_t *queue, uint32_t w, size_t n)
+{
+	size_t space = queue->size - ((w - queue->read_idx_cache) & queue->wrap);
+	if (space < n) {
+		queue->read_idx_cache = atomic_load_explicit(&queue->read_idx, memory_order_acquire);
+		space = queue->size - ((w - queue->read_idx_cache) & queue->wrap);
+	}
+	return space;
+}
+
+// Consumer: written slots, the copy of the write index is reloaded if it shows less than n.
+static inline size_t uart_wbp_queue_avail(uart_wbp_queue_t *queue, uint32_t r, size_t n)
+{
+	size_t avail = (queue->write_idx_cache - r) & queue->wrap;
+	if (avail < n) {
+		queue->write_idx_cache = atomic_load_explicit(&queue->write_idx, memory_order_acquire);
+		avail = (queue->write_idx_cache - r) & queue->wrap;
+	}
+	return avail;
+}
+
+// Producer: push up to n items, returns the number of items that fit.
+static inline size_t uart_wbp_queue_push(uart_wbp_queue_t *queue, const void *items, size_t n)
+{
+	uint32_t w = atomic_load_explicit(&queue->write_idx, memory_order_relaxed);
+	size_t space = uart_wbp_queue_space(queue, w, n);
+	if (n > space) {
+		n = space;
+	}
+	if (n) {
+		uart_wbp_queue_copy_in(queue->storage, queue->size, queue->mask, queue->item_size, w, items, n);
+		atomic_store_explicit(&queue->write_idx, (w + n) & queue->wrap, memory_order_release);
+	}
+	return n;
+}
+
+// Consumer: pop up to n items into items (or drop them if items is NULL), returns the number of items.
+static inline size_t uart_wbp_queue_pop(uart_wbp_queue_t *queue, void *items, size_t n)
+{
+	uint32_t r = atomic_load_explicit(&queue->read_idx, memory_order_relaxed);
+	size_t avail = uart_wbp_queue_avail(queue, r, n);
+	if (n > avail) {
+		n = avail;
+	}
+	if (n) {
+		if (items != NULL) {
+			uart_wbp_queue_copy_out(queue->storage, queue->size, queue->mask, queue->item_size, r, items, n);
+		}
+		atomic_store_explicit(&queue->read_idx, (r + n) & queue->wrap, memory_order_release);
+	}
+	return n;
+}
+
+// Producer, without copying: pointer to the free slots up to the end of the storage, *n is set to their
+// number. Items that were written there are published with uart_wbp_queue_commit.
+static inline void* uart_wbp_queue_write_ptr(uart_wbp_queue_t *queue, size_t *n)
+{
+	uint32_t w = atomic_load_explicit(&queue->write_idx, memory_order_relaxed);
+	uint32_t slot = w & queue->mask;
+	size_t space = uart_wbp_queue_space(queue, w, queue->size);
+	*n = (space < queue->size-slot) ? space : queue->size-slot;
+	return queue->storage + slot*queue->item_size;
+}
+
+static inline void uart_wbp_queue_commit(uart_wbp_queue_t *queue, size_t n)
+{
+	uint32_t w = atomic_load_explicit(&queue->write_idx, memory_order_relaxed);
+	atomic_store_explicit(&queue->write_idx, (w + n) & queue->wrap, memory_order_release);
+}
+
+// Consumer, without copying: pointer to the written slots up to the end of the storage, *n is set to
+// their number. They stay valid until they are given back with uart_wbp_queue_release.
+static inline const void* uart_wbp_queue_read_ptr(uart_wbp_queue_t *queue, size_t *n)
+{
+	uint32_t r = atomic_load_explicit(&queue->read_idx, memory_order_relaxed);
+	uint32_t slot = r & queue->mask;
+	size_t avail = uart_wbp_queue_avail(queue, r, queue->size);
+	*n = (avail < queue->size-slot) ? avail : queue->size-slot;
+	return queue->storage + slot*queue->item_size;
+}
+
+static inline void uart_wbp_queue_release(uart_wbp_queue_t *queue, size_t n)
+{
+	uint32_t r = atomic_load_explicit(&queue->read_idx, memory_order_relaxed);
+	atomic_store_explicit(&queue->read_idx, (r + n) & queue->wrap, memory_order_release);
+}
+
+/////////////////////////////////////////////////
+// multiple producers, single consumer
+/////////////////////////////////////////////////
+
+// storage must hold 2**depth items of item_size bytes, seq must have 2**depth entries.
+// Returns -1 if depth is not in [1,UART_WBP_QUEUE_MAX_DEPTH]. Not thread safe, the queue must not be in use.
+static inline int uart_wbp_mpsc_queue_init(uart_wbp_mpsc_queue_t *queue, void *storage, _Atomic uint32_t *seq, int depth, size_t item_size)
+{
+	if (depth < 1 || depth > UART_WBP_QUEUE_MAX_DEPTH) {
+		return -1;
+	}
+	queue->storage   = (uint8_t*)storage;
+	queue->seq       = seq;
+	queue->item_size = item_size;
+	queue->size      = 1u << depth;
+	queue->mask      = queue->size - 1;
+	for (uint32_t i = 0; i < queue->size; ++i) {
+		atomic_init(&seq[i], i);
+	}
+	atomic_init(&queue->write_ticket, 0);
+	atomic_init(&queue->read_ticket, 0);
+	return 0;
+}
+
+// Number of items that are reserved or written, a snapshot.
+static inline size_t uart_wbp_mpsc_queue_fill(uart_wbp_mpsc_queue_t *queue)
+{
+	uint32_t r = atomic_load_explicit(&queue->read_ticket, memory_order_acquire);
+	uint32_t w = atomic_load_explicit(&queue->write_ticket, memory_order_acquire);
+	return w - r;
+}
+
+// Any producer: push up to n items, returns the number of items that fit. The items of one call
+// are consecutive in the queue.
+static inline size_t uart_wbp_mpsc_queue_push(uart_wbp_mpsc_queue_t *queue, const void *items, size_t n)
+{
+	if (n > queue->size) {
+		n = queue->size;
+	}
+	uint32_t t = atomic_load_explicit(&queue->write_ticket, memory_order_relaxed);
+	while (n) {
+		// the consumer frees the slots in order, so if the last slot of the batch is free, all are
+		uint32_t last = t + (uint32_t)n - 1;
+		int32_t diff = (int32_t)(atomic_load_explicit(&queue->seq[last & queue->mask], memory_order_acquire) - last);
+		if (diff == 0) {
+			if (atomic_compare_exchange_weak_explicit(&queue->write_ticket, &t, t + (uint32_t)n,
+			                                          memory_order_relaxed, memory_order_relaxed)) {
+				break;
+			}
+		} else if (diff < 0) {
+			// not enough space for n items
+			uint32_t r = atomic_load_explicit(&queue->read_ticket, memory_order_acquire);
+			if ((int32_t)(t - r) < 0) {
+				// t is outdated
+				t = atomic_load_explicit(&queue->write_ticket, memory_order_relaxed);
+				continue;
+			}
+			// otherwise retry with what is free, the slot was freed after seq was loaded if n fits
+			size_t space = queue->size - (t - r);
+			if (n > space) {
+				n = space;
+			}
+		} else {
+			// another producer took the slots
+			t = atomic_load_explicit(&queue->write_ticket, memory_order_relaxed);
+		}
+	}
+	if (n) {
+		uart_wbp_queue_copy_in(queue->storage, queue->size, queue->mask, queue->item_size, t, items, n);
+		for (uint32_t i = 0; i < n; ++i) {
+			atomic_store_explicit(&queue->seq[(t + i) & queue->mask], t + i + 1, memory_order_release);
+		}
+	}
+	return n;
+}
+
+// Consumer: pop up to n items into items (or drop them if items is NULL), returns the number of items.
+// Stops at the first slot that is reserved but not yet written.
+static inline size_t uart_wbp_mpsc_queue_pop(uart_wbp_mpsc_queue_t *queue, void *items, size_t n)
+{
+	uint32_t r = atomic_load_explicit(&queue->read_ticket, memory_order_relaxed);
+	size_t avail = 0;
+	while (avail < n && atomic_load_explicit(&queue->seq[(r + avail) & queue->mask], memory_order_acquire) == r + avail + 1) {
+		++avail;
+	}
+	if (avail) {
+		if (items != NULL) {
+			uart_wbp_queue_copy_out(queue->storage, queue->size, queue->mask, queue->item_size, r, items, avail);
+		}
+		for (uint32_t i = 0; i < avail; ++i) {
+			atomic_store_explicit(&queue->seq[(r + i) & queue->mask], r + i + queue->size, memory_order_release);
+		}
+		atomic_store_explicit(&queue->read_ticket, r + (uint32_t)avail, memory_order_release);
+	}
+	return avail;
+}
+
+#endif // __cplusplus
+
+#endif
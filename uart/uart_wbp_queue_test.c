@@ -0,0 +1,175 @@
+#include "uart_wbp_queue.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+void print_help(const char* argv0){
+	fprintf(stderr, "usage: %s [options]\n", argv0);
+	fprintf(stderr, " Pass items between threads through the queues of uart_wbp_queue.h, check that every item\n");
+	fprintf(stderr, " arrives once and in the order of its producer, and show the throughput.\n");
+	fprintf(stderr, " options are\n");
+	fprintf(stderr, " -n <items>        : items per producer (default is 10000000)\n");
+	fprintf(stderr, " -p <producers>    : producer threads of the multi producer queue (default is 4)\n");
+	fprintf(stderr, " -b <items>        : items per push and pop call (default is 64)\n");
+	fprintf(stderr, " -d <depth>        : the queues have 2**depth slots (default is 12)\n");
+}
+
+double now_s()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + 1e-9*t.tv_nsec;
+}
+
+// items are producer<<48 | sequence number
+#define ITEM(producer, n) (((uint64_t)(producer) << 48) | (n))
+
+typedef struct test {
+	int producers;
+	uint64_t items;
+	int batch;
+	uart_wbp_queue_t      *spsc;
+	uart_wbp_mpsc_queue_t *mpsc;
+} test_t;
+
+typedef struct producer {
+	test_t *test;
+	int id;
+} producer_t;
+
+void* producer_thread(void *arg)
+{
+	producer_t *producer = (producer_t*)arg;
+	test_t *test = producer->test;
+	uint64_t *items = (uint64_t*)malloc(test->batch*sizeof(uint64_t));
+	for (uint64_t n = 0; n < test->items; ) {
+		size_t batch = (test->items-n < (uint64_t)test->batch) ? test->items-n : (uint64_t)test->batch;
+		for (size_t i = 0; i < batch; ++i) {
+			items[i] = ITEM(producer->id, n+i);
+		}
+		size_t pushed = 0;
+		while (pushed < batch) {
+			size_t k = test->spsc ? uart_wbp_queue_push(test->spsc, &items[pushed], batch-pushed)
+			                      : uart_wbp_mpsc_queue_push(test->mpsc, &items[pushed], batch-pushed);
+			if (k == 0) {
+				sched_yield();
+			}
+			pushed += k;
+		}
+		n += batch;
+	}
+	free(items);
+	return NULL;
+}
+
+// returns the number of errors
+int run(test_t *test, const char *name)
+{
+	pthread_t *threads = (pthread_t*)calloc(test->producers, sizeof(pthread_t));
+	producer_t *producers = (producer_t*)calloc(test->producers, sizeof(producer_t));
+	uint64_t *expect = (uint64_t*)calloc(test->producers, sizeof(uint64_t));
+	uint64_t *items = (uint64_t*)malloc(test->batch*sizeof(uint64_t));
+	double t0 = now_s();
+	for (int p = 0; p < test->producers; ++p) {
+		producers[p].test = test;
+		producers[p].id   = p;
+		pthread_create(&threads[p], NULL, producer_thread, &producers[p]);
+	}
+	uint64_t total = test->items*test->producers, received = 0;
+	int errors = 0;
+	while (received < total) {
+		size_t n = test->spsc ? uart_wbp_queue_pop(test->spsc, items, test->batch)
+		                      : uart_wbp_mpsc_queue_pop(test->mpsc, items, test->batch);
+		if (n == 0) {
+			sched_yield();
+			continue;
+		}
+		for (size_t i = 0; i < n; ++i) {
+			int p = items[i] >> 48;
+			if (p >= test->producers || items[i] != ITEM(p, expect[p])) {
+				if (errors++ < 10) {
+					fprintf(stderr, "%s: unexpected item %016llx\n", name, (unsigned long long)items[i]);
+				}
+				continue;
+			}
+			++expect[p];
+		}
+		received += n;
+	}
+	for (int p = 0; p < test->producers; ++p) {
+		pthread_join(threads[p], NULL);
+	}
+	double dt = now_s() - t0;
+	printf("%s: %d producer(s), %llu items in %.3f s, %.1f Mitems/s, %d errors\n", name, test->producers,
+		(unsigned long long)total, dt, 1e-6*total/dt, errors);
+	free(items);
+	free(expect);
+	free(producers);
+	free(threads);
+	return errors;
+}
+
+int main(int argc, char **argv) {
+	int producers = 4;
+	int batch = 64;
+	int depth = 12;
+	long long items = 10000000;
+
+	for (int i = 1; i < argc; ++i) {
+		int *value = NULL;
+		if      (strcmp(argv[i],"-p") == 0) value = &producers;
+		else if (strcmp(argv[i],"-b") == 0) value = &batch;
+		else if (strcmp(argv[i],"-d") == 0) value = &depth;
+		else if (strcmp(argv[i],"-n") == 0) {
+			if (++i >= argc || sscanf(argv[i], "%lld", &items) != 1 || items < 0) {
+				fprintf(stderr, "expect integer value after option -n\n");
+				return -1;
+			}
+			continue;
+		} else if (strcmp(argv[i],"--help") == 0) {
+			print_help(argv[0]);
+			return 0;
+		} else {
+			fprintf(stderr, "unkown command line option: %s\n", argv[i]);
+			return -1;
+		}
+		if (++i >= argc || sscanf(argv[i], "%d", value) != 1 || *value <= 0) {
+			fprintf(stderr, "expect positive integer value after option %s\n", argv[i-1]);
+			return -1;
+		}
+	}
+	if (producers > 0xffff || depth > UART_WBP_QUEUE_MAX_DEPTH) {
+		fprintf(stderr, "at most 65535 producers and depth %d\n", UART_WBP_QUEUE_MAX_DEPTH);
+		return -1;
+	}
+
+	// the queues have cache line aligned members
+	uart_wbp_queue_t      *spsc = (uart_wbp_queue_t*)aligned_alloc(_Alignof(uart_wbp_queue_t), sizeof(uart_wbp_queue_t));
+	uart_wbp_mpsc_queue_t *mpsc = (uart_wbp_mpsc_queue_t*)aligned_alloc(_Alignof(uart_wbp_mpsc_queue_t), sizeof(uart_wbp_mpsc_queue_t));
+	uint64_t *storage = (uint64_t*)malloc(sizeof(uint64_t) << depth);
+	_Atomic uint32_t *seq = (_Atomic uint32_t*)malloc(sizeof(uint32_t) << depth);
+	if (spsc == NULL || mpsc == NULL || storage == NULL || seq == NULL) {
+		return 2;
+	}
+	int errors = 0;
+
+	test_t test = { 1, items, batch, spsc, NULL };
+	uart_wbp_queue_init(spsc, storage, depth, sizeof(uint64_t));
+	errors += run(&test, "spsc");
+
+	test.producers = producers;
+	test.spsc      = NULL;
+	test.mpsc      = mpsc;
+	uart_wbp_mpsc_queue_init(mpsc, storage, seq, depth, sizeof(uint64_t));
+	errors += run(&test, "mpsc");
+
+	free(seq);
+	free(storage);
+	free(mpsc);
+	free(spsc);
+	return errors ? 1 : 0;
+}
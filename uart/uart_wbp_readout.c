@@ -0,0 +1,153 @@
+#include "uart_wbp_readout.h"
+
+// C header
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define UART_WBP_READOUT_VALID 0x80000000
+
+static int64_t uart_wbp_readout_now_ns()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec*1000000000 + now.tv_nsec;
+}
+
+uart_wbp_readout_t* uart_wbp_readout_create(uart_wbp_device_t *device, uint32_t base_adr, int word_width, size_t buffer_words)
+{
+	if (word_width < 1 || word_width > 31 || buffer_words < UART_WBP_READOUT_MAX_DEPTH+2) {
+		fprintf(stderr, "uart_wbp_readout_create: word_width must be in [1,31] and buffer_words at least %d\n", UART_WBP_READOUT_MAX_DEPTH+2);
+		return NULL;
+	}
+	uart_wbp_readout_t *readout = (uart_wbp_readout_t*)malloc(sizeof(uart_wbp_readout_t));
+	if (readout == NULL) {
+		return NULL;
+	}
+	memset(readout, 0, sizeof(uart_wbp_readout_t));
+	readout->device     = device;
+	readout->base_adr   = base_adr;
+	readout->word_width = word_width;
+	// byte 3 has the valid bit, bytes 0 and 1 have fill level and lost counter
+	readout->sel        = (word_width <= 16) ? 0xb : 0xf;
+	readout->capacity   = buffer_words;
+	readout->buffer     = (uint32_t*)malloc(buffer_words*sizeof(uint32_t));
+	if (readout->buffer == NULL) {
+		free(readout);
+		return NULL;
+	}
+	uart_wbp_readout_set_depth(readout, 8, UART_WBP_READOUT_MAX_DEPTH);
+	readout->depth = readout->min_depth;
+	uart_wbp_response_t response = uart_wbp_write(device, 0xf, base_adr+4, 0, 0, 0);
+	if (response != ack && response != write_response && response != unknown) {
+		fprintf(stderr, "uart_wbp_readout_create: cannot clear the lost counter at %08x\n", base_adr+4);
+	}
+	readout->start_ns = uart_wbp_readout_now_ns();
+	return readout;
+}
+
+void uart_wbp_readout_destroy(uart_wbp_readout_t *readout)
+{
+	free(readout->buffer);
+	free(readout);
+}
+
+void uart_wbp_readout_set_depth(uart_wbp_readout_t *readout, int min_depth, int max_depth)
+{
+	if (max_depth > UART_WBP_READOUT_MAX_DEPTH) max_depth = UART_WBP_READOUT_MAX_DEPTH;
+	if (min_depth < 1)                          min_depth = 1;
+	if (min_depth > max_depth)                  min_depth = max_depth;
+	readout->min_depth = min_depth;
+	readout->max_depth = max_depth;
+}
+
+uart_wbp_response_t uart_wbp_readout_poll(uart_wbp_readout_t *readout)
+{
+	// move the unread words to the front if there is not enough space behind them
+	if (readout->capacity - readout->write_idx < (size_t)readout->depth+2) {
+		size_t n = readout->write_idx - readout->read_idx;
+		memmove(readout->buffer, &readout->buffer[readout->read_idx], n*sizeof(uint32_t));
+		readout->read_idx  = 0;
+		readout->write_idx = n;
+	}
+	int depth = readout->depth;
+	if (readout->capacity - readout->write_idx < (size_t)depth+2) {
+		depth = readout->capacity - readout->write_idx - 2;
+		if (depth < 0) {
+			depth = 0;
+		}
+	}
+	// status and lost counter are read into the buffer and overwritten by the data words
+	uint32_t *words = &readout->buffer[readout->write_idx];
+	memset(words, 0, (depth+2)*sizeof(uint32_t));
+	uart_wbp_response_t response = uart_wbp_read_burst(readout->device, readout->sel, readout->base_adr, words, depth+2, 0);
+	if (response != ack) {
+		// the FIFO has popped the words that were read, they are gone
+		for (int i = 0; i < depth; ++i) {
+			if (words[i+2] & UART_WBP_READOUT_VALID) {
+				++readout->lost_words;
+			}
+		}
+		return response;
+	}
+	uint32_t status = words[0];
+	uint16_t lost   = words[1] & 0xffff;
+	int fill = status & 0xffff;
+	uint32_t word_mask = (1u << readout->word_width) - 1;
+	int n_valid = 0;
+	for (int i = 0; i < depth; ++i) {
+		uint32_t word = words[i+2];
+		if (word & UART_WBP_READOUT_VALID) {
+			words[n_valid++] = word & word_mask;
+		}
+	}
+	readout->write_idx += n_valid;
+
+	++readout->polls;
+	readout->words         += n_valid;
+	readout->invalid_words += depth - n_valid;
+	readout->lost_records  += (uint16_t)(lost - readout->last_lost);
+	readout->last_lost      = lost;
+	if (status & 0x40000000) {
+		++readout->full_polls;
+	}
+	if (fill > readout->max_fill) {
+		readout->max_fill = fill;
+	}
+
+	// Next depth: what was left in the FIFO, plus what is expected to arrive until the next poll.
+	// Words that arrived during the burst were read as well, so n_valid can be more than fill.
+	int arrived = fill - readout->remaining;
+	if (arrived < 0) arrived = 0;
+	readout->arrivals += 0.25*(arrived - readout->arrivals);
+	readout->remaining = (fill > n_valid) ? fill - n_valid : 0;
+	int next = readout->remaining + (int)(1.25*readout->arrivals) + 1;
+	if (next < readout->min_depth) next = readout->min_depth;
+	if (next > readout->max_depth) next = readout->max_depth;
+	readout->depth = next;
+	return ack;
+}
+
+const uint32_t* uart_wbp_readout_peek(const uart_wbp_readout_t *readout, size_t *n_words)
+{
+	*n_words = readout->write_idx - readout->read_idx;
+	return &readout->buffer[readout->read_idx];
+}
+
+void uart_wbp_readout_consume(uart_wbp_readout_t *readout, size_t n_words)
+{
+	if (n_words > readout->write_idx - readout->read_idx) {
+		n_words = readout->write_idx - readout->read_idx;
+	}
+	readout->read_idx += n_words;
+	if (readout->read_idx == readout->write_idx) {
+		readout->read_idx = readout->write_idx = 0;
+	}
+}
+
+double uart_wbp_readout_rate(const uart_wbp_readout_t *readout)
+{
+	int64_t dt = uart_wbp_readout_now_ns() - readout->start_ns;
+	return (dt > 0) ? 1e9*readout->words/dt : 0;
+}
@@ -0,0 +1,84 @@
+#ifndef UART_WBP_READOUT_H_
+#define UART_WBP_READOUT_H_
+
+#include "uart_wbp_access.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Continuous readout of a FIFO behind the bridge, with the register layout of tdc/tdc_wbp_readout.vhd:
+//   base+0x000 : status, bits 15..0 fill level in words, bit 30 full, bit 31 empty
+//   base+0x004 : bits 15..0 number of lost records (wrapping)
+//   base+0x008 : data window up to base+0xffc, each read pops a word, bit 31 marks valid words
+//
+// Each poll is a single burst read from base: the status, the lost counter, and depth data words,
+// so one round trip returns the data and the state of the FIFO. Reading more data words than the FIFO
+// has only costs the transfer of the invalid words, reading less leaves data in the FIFO. The depth
+// of the next poll is adapted to the fill level that the status showed and to the number of words that
+// arrived between the polls. Bursts longer than UART_WBP_BURST_READ_MAX_WORDS are sent back to back
+// (see uart_wbp_read_burst), so the link stays busy during a poll.
+//
+// The valid words are kept in a buffer of the readout, uart_wbp_readout_peek gives direct access to
+// them (without the valid bit) and uart_wbp_readout_consume releases them.
+
+#define UART_WBP_READOUT_MAX_DEPTH 1022
+
+typedef struct uart_wbp_readout
+{
+	uart_wbp_device_t *device;
+	uint32_t base_adr;
+	int      word_width;
+	uint8_t  sel;         // byte lanes that are transferred
+
+	// unread words are in buffer[read_idx, write_idx)
+	uint32_t *buffer;
+	size_t    capacity;
+	size_t    read_idx;
+	size_t    write_idx;
+
+	int      min_depth, max_depth;
+	int      depth;        // data words of the next poll
+	int      remaining;    // words that were left in the FIFO after the last poll
+	double   arrivals;     // moving average of the words that arrive between two polls
+	uint16_t last_lost;
+
+	// statistics
+	uint64_t polls;
+	uint64_t words;         // valid words
+	uint64_t invalid_words; // reads beyond the end of the data
+	uint64_t lost_records;  // records that did not fit into the FIFO
+	uint64_t lost_words;    // valid words that a failed poll has taken from the FIFO
+	uint64_t full_polls;    // polls that found the FIFO full
+	int      max_fill;
+	int64_t  start_ns;
+} uart_wbp_readout_t;
+
+// word_width is the serializer output width (at most 31), buffer_words the size of the host buffer
+// (at least UART_WBP_READOUT_MAX_DEPTH+2). The lost counter of the FIFO is cleared.
+uart_wbp_readout_t* uart_wbp_readout_create(uart_wbp_device_t *device, uint32_t base_adr, int word_width, size_t buffer_words);
+void                uart_wbp_readout_destroy(uart_wbp_readout_t *readout);
+
+// Limit the number of data words per poll (defaults are 8 and UART_WBP_READOUT_MAX_DEPTH)
+void uart_wbp_readout_set_depth(uart_wbp_readout_t *readout, int min_depth, int max_depth);
+
+// One burst read. Returns ack, or the first response of the burst that was not ack (the buffer
+// is not changed in that case). If the buffer has no space for depth words, fewer are read.
+// The valid words of a failed poll are counted in lost_words, words of bursts whose response
+// did not arrive at all are unknown and not counted.
+uart_wbp_response_t uart_wbp_readout_poll(uart_wbp_readout_t *readout);
+
+// Pointer to the unread words, *n_words is set to their number. The pointer is valid until the next poll.
+const uint32_t* uart_wbp_readout_peek(const uart_wbp_readout_t *readout, size_t *n_words);
+void            uart_wbp_readout_consume(uart_wbp_readout_t *readout, size_t n_words);
+
+// Valid words per second since create
+double uart_wbp_readout_rate(const uart_wbp_readout_t *readout);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,328 @@
+// Predict the throughput of a wishbone interconnect: drive one of the interconnect topologies of
+// wbp_mux.vhd with masters that replay access traces or generate random accesses, and show for each
+// master the achieved bandwidth, the time its strobes waited for arbitration, and starvation.
+
+#include "wbp_model.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+void print_help(const char* argv0){
+	fprintf(stderr, "usage: %s [options]\n", argv0);
+	fprintf(stderr, " Simulate an interconnect of wbp_mux.vhd cycle by cycle and show per master the strobes\n");
+	fprintf(stderr, " per cycle, the wait (from the cycle an access is due until its strobe is accepted), and\n");
+	fprintf(stderr, " the latency (until the response), and per slave the utilization.\n");
+	fprintf(stderr, " options are\n");
+	fprintf(stderr, " -t <topology>   : 2s1m (wbp_2s1m, two masters share one slave), 1s2m (wbp_1s2m),\n");
+	fprintf(stderr, "                   1s2m_protected (wbp_1s2m_protected), crossbar (wbp_2s2m_crossbar),\n");
+	fprintf(stderr, "                   interconnect (wbp_interconnect, as many masters and slaves as -m and -s\n");
+	fprintf(stderr, "                   options, at least 4 each, slave m at address m<<<bit>), default is 2s1m\n");
+	fprintf(stderr, " -m <spec>       : a master, given once per master (2 for 2s1m and crossbar, 1 otherwise)\n");
+	fprintf(stderr, "                   <spec> is a comma separated list of key=value:\n");
+	fprintf(stderr, "                    type=<type>          pipelined master, wbta (wbta_wbp_master), or\n");
+	fprintf(stderr, "                                         wbta_pipelined (wbta_wbp_master_pipelined), default pipelined\n");
+	fprintf(stderr, "                    trace=<file>         replay the accesses in <file>, lines are\n");
+	fprintf(stderr, "                                         '<cycle> r|w <hex address> [<words>]', # starts a comment\n");
+	fprintf(stderr, "                    rate=<r>             otherwise random accesses, <r> strobes per cycle (default 0.5)\n");
+	fprintf(stderr, "                    burst=<b>            mean number of consecutive words (default 1)\n");
+	fprintf(stderr, "                    read=<f>             fraction of reads (default 0.5)\n");
+	fprintf(stderr, "                    base=<hex>,size=<hex> address range (default is both slaves)\n");
+	fprintf(stderr, "                    seed=<n>             seed of the random accesses (default is the master index+1)\n");
+	fprintf(stderr, "                    outstanding=<n>      open strobes of a pipelined master (default 8)\n");
+	fprintf(stderr, "                    depth=<n>            2**<n> open strobes of wbta_pipelined (default 2)\n");
+	fprintf(stderr, "                    timeout=<n>          stall timeout of wbta (default 0, disabled)\n");
+	fprintf(stderr, " -s <spec>       : a slave, given once per slave (2 for 1s2m, 1s2m_protected, crossbar)\n");
+	fprintf(stderr, "                    latency=<n>          cycles from strobe to ack (default 1)\n");
+	fprintf(stderr, "                    outstanding=<n>      open strobes before the slave stalls (default 1)\n");
+	fprintf(stderr, "                    stall=<p>            probability of an additional stall cycle (default 0)\n");
+	fprintf(stderr, "                    seed=<n>\n");
+	fprintf(stderr, " -a <bit>        : address bit that selects the slave (default 16)\n");
+	fprintf(stderr, " -w <weight>     : strobes before an interconnect port goes to another master (default 8)\n");
+	fprintf(stderr, " -d              : interconnect without register stages\n");
+	fprintf(stderr, " -n <cycles>     : number of cycles (default 1000000)\n");
+	fprintf(stderr, " -W <cycles>     : an access starves if it waits at least <cycles> (default 1000)\n");
+}
+
+// key=value pairs of a -m or -s option
+struct spec {
+	std::vector<std::pair<std::string,std::string>> values;
+
+	bool parse(const char *arg) {
+		std::string s = arg;
+		size_t pos = 0;
+		while (pos <= s.size()) {
+			size_t end = s.find(',', pos);
+			if (end == std::string::npos) end = s.size();
+			std::string item = s.substr(pos, end-pos);
+			size_t eq = item.find('=');
+			if (eq == std::string::npos) {
+				fprintf(stderr, "expect key=value instead of '%s'\n", item.c_str());
+				return false;
+			}
+			values.emplace_back(item.substr(0, eq), item.substr(eq+1));
+			pos = end+1;
+		}
+		return true;
+	}
+	const char *get(const char *key) const {
+		for (auto &v: values) if (v.first == key) return v.second.c_str();
+		return nullptr;
+	}
+	double number(const char *key, double fallback) const {
+		const char *v = get(key);
+		return v ? strtod(v, nullptr) : fallback;
+	}
+	uint64_t hex(const char *key, uint64_t fallback) const {
+		const char *v = get(key);
+		return v ? strtoull(v, nullptr, 16) : fallback;
+	}
+	bool check(const std::vector<std::string> &keys) const {
+		for (auto &v: values) {
+			bool known = false;
+			for (auto &k: keys) known |= (k == v.first);
+			if (!known) {
+				fprintf(stderr, "unknown key %s\n", v.first.c_str());
+				return false;
+			}
+		}
+		return true;
+	}
+};
+
+bool read_trace(const char *filename, std::vector<wbp_model::access> &accesses)
+{
+	FILE *f = fopen(filename, "r");
+	if (f == NULL) {
+		perror(filename);
+		return false;
+	}
+	char line[256];
+	int line_number = 0;
+	while (fgets(line, sizeof(line), f)) {
+		++line_number;
+		char *comment = strchr(line, '#');
+		if (comment) *comment = '\0';
+		unsigned long long time;
+		char dir;
+		unsigned adr, words = 1;
+		int n = sscanf(line, "%llu %c %x %u", &time, &dir, &adr, &words);
+		if (n <= 0) continue;
+		if (n < 3 || (dir != 'r' && dir != 'w')) {
+			fprintf(stderr, "%s:%d: expect '<cycle> r|w <hex address> [<words>]'\n", filename, line_number);
+			fclose(f);
+			return false;
+		}
+		for (unsigned i = 0; i < words; ++i) {
+			accesses.push_back(wbp_model::access{time, adr + 4*i, dir == 'w'});
+		}
+	}
+	fclose(f);
+	// the master issues the accesses in order, a later line must not be due earlier
+	for (size_t i = 1; i < accesses.size(); ++i) {
+		accesses[i].time = std::max(accesses[i].time, accesses[i-1].time);
+	}
+	return true;
+}
+
+struct master {
+	std::unique_ptr<wbp_model::access_source> source;
+	std::unique_ptr<wbp_model::block>         block;
+	const wbp_model::master_stats            *stats;
+	std::string                               description;
+};
+
+bool make_master(const spec &sp, int index, wbp_model::bus &port, uint32_t default_size, uint64_t starvation, master &m)
+{
+	if (!sp.check({"type","trace","rate","burst","read","base","size","seed","outstanding","depth","timeout"})) return false;
+	std::string type = sp.get("type") ? sp.get("type") : "pipelined";
+	if (type != "pipelined" && type != "wbta" && type != "wbta_pipelined") {
+		fprintf(stderr, "unknown master type %s\n", type.c_str());
+		return false;
+	}
+	if (sp.get("trace")) {
+		std::vector<wbp_model::access> accesses;
+		if (!read_trace(sp.get("trace"), accesses)) return false;
+		m.source.reset(new wbp_model::trace_source(std::move(accesses)));
+		m.description = type + " " + sp.get("trace");
+	} else {
+		double   rate  = sp.number("rate", 0.5);
+		double   burst = sp.number("burst", 1);
+		uint32_t base  = sp.hex("base", 0);
+		uint32_t size  = sp.hex("size", default_size);
+		m.source.reset(new wbp_model::random_source(rate, burst, sp.number("read", 0.5), base, size, sp.number("seed", index+1)));
+		char buf[128];
+		snprintf(buf, sizeof(buf), "%s rate=%g burst=%g", type.c_str(), rate, burst);
+		m.description = buf;
+	}
+	if (type == "pipelined") {
+		auto *p = new wbp_model::pipelined_master(port, *m.source, sp.number("outstanding", 8), starvation);
+		m.block.reset(p);
+		m.stats = &p->stats;
+	} else if (type == "wbta") {
+		auto *p = new wbp_model::wbta_master(port, *m.source, sp.number("timeout", 0), true, false, starvation);
+		m.block.reset(p);
+		m.stats = &p->stats;
+	} else {
+		auto *p = new wbp_model::wbta_pipelined_master(port, *m.source, sp.number("depth", 2), sp.number("timeout", 0), false, starvation);
+		m.block.reset(p);
+		m.stats = &p->stats;
+	}
+	return true;
+}
+
+bool make_slave(const spec &sp, int index, wbp_model::bus &port, std::unique_ptr<wbp_model::pipelined_slave> &s)
+{
+	if (!sp.check({"latency","outstanding","stall","seed"})) return false;
+	s.reset(new wbp_model::pipelined_slave(port, sp.number("latency", 1), sp.number("outstanding", 1),
+	                                       sp.number("stall", 0), sp.number("seed", 100+index)));
+	return true;
+}
+
+int main(int argc, char **argv) {
+	std::string topology = "2s1m";
+	std::vector<spec> master_specs, slave_specs;
+	unsigned adr_bit = 16, weight = 8;
+	bool registered = true;
+	unsigned long long cycles = 1000000, starvation = 1000;
+
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i],"--help") == 0) {
+			print_help(argv[0]);
+			return 0;
+		} else if (strcmp(argv[i],"-d") == 0) {
+			registered = false;
+		} else if (i+1 >= argc) {
+			fprintf(stderr, "unkown command line option or missing value: %s\n", argv[i]);
+			return -1;
+		} else if (strcmp(argv[i],"-t") == 0) {
+			topology = argv[++i];
+		} else if (strcmp(argv[i],"-m") == 0) {
+			master_specs.emplace_back();
+			if (!master_specs.back().parse(argv[++i])) return -1;
+		} else if (strcmp(argv[i],"-s") == 0) {
+			slave_specs.emplace_back();
+			if (!slave_specs.back().parse(argv[++i])) return -1;
+		} else if (strcmp(argv[i],"-a") == 0) {
+			if (sscanf(argv[++i], "%u", &adr_bit) != 1 || adr_bit > 31) {
+				fprintf(stderr, "expect address bit in [0,31] after option -a\n");
+				return -1;
+			}
+		} else if (strcmp(argv[i],"-w") == 0) {
+			if (sscanf(argv[++i], "%u", &weight) != 1) {
+				fprintf(stderr, "expect integer value after option -w\n");
+				return -1;
+			}
+		} else if (strcmp(argv[i],"-n") == 0) {
+			if (sscanf(argv[++i], "%llu", &cycles) != 1) {
+				fprintf(stderr, "expect integer value after option -n\n");
+				return -1;
+			}
+		} else if (strcmp(argv[i],"-W") == 0) {
+			if (sscanf(argv[++i], "%llu", &starvation) != 1 || starvation == 0) {
+				fprintf(stderr, "expect positive integer value after option -W\n");
+				return -1;
+			}
+		} else {
+			fprintf(stderr, "unkown command line option: %s\n", argv[i]);
+			return -1;
+		}
+	}
+
+	size_t n_masters, n_slaves;
+	if      (topology == "2s1m")                                 { n_masters = 2; n_slaves = 1; }
+	else if (topology == "1s2m" || topology == "1s2m_protected") { n_masters = 1; n_slaves = 2; }
+	else if (topology == "crossbar")                             { n_masters = 2; n_slaves = 2; }
+	else if (topology == "interconnect") {
+		n_masters = std::max<size_t>(4, master_specs.size());
+		n_slaves  = std::max<size_t>(4, slave_specs.size());
+	}
+	else {
+		fprintf(stderr, "unknown topology %s\n", topology.c_str());
+		return -1;
+	}
+	if (master_specs.size() > n_masters || slave_specs.size() > n_slaves) {
+		fprintf(stderr, "topology %s has %zu masters and %zu slaves\n", topology.c_str(), n_masters, n_slaves);
+		return -1;
+	}
+	master_specs.resize(n_masters);
+	slave_specs.resize(n_slaves);
+
+	// the names are the ones of the VHDL ports: the masters drive the slave ports of the interconnect
+	std::vector<wbp_model::bus> master_bus(n_masters), slave_bus(n_slaves);
+	std::vector<master> masters(n_masters);
+	std::vector<std::unique_ptr<wbp_model::pipelined_slave>> slaves(n_slaves);
+	for (size_t i = 0; i < n_masters; ++i) {
+		uint64_t size = uint64_t(std::max<size_t>(n_slaves, 2)) << adr_bit;
+		if (!make_master(master_specs[i], i, master_bus[i], std::min<uint64_t>(size, 0xffffffffu), starvation, masters[i])) return -1;
+	}
+	for (size_t i = 0; i < n_slaves; ++i) {
+		if (!make_slave(slave_specs[i], i, slave_bus[i], slaves[i])) return -1;
+	}
+	std::unique_ptr<wbp_model::block> interconnect;
+	wbp_model::wbp_1s2m_protected *protected_split = nullptr;
+	wbp_model::wbp_interconnect   *generic_interconnect = nullptr;
+	if (topology == "2s1m") {
+		interconnect.reset(new wbp_model::wbp_2s1m(master_bus[0], master_bus[1], slave_bus[0]));
+	} else if (topology == "1s2m") {
+		interconnect.reset(new wbp_model::wbp_1s2m(master_bus[0], slave_bus[0], slave_bus[1], adr_bit));
+	} else if (topology == "1s2m_protected") {
+		protected_split = new wbp_model::wbp_1s2m_protected(master_bus[0], slave_bus[0], slave_bus[1], adr_bit);
+		interconnect.reset(protected_split);
+	} else if (topology == "interconnect") {
+		std::vector<wbp_model::bus*> s, m;
+		std::vector<uint32_t> adr, mask;
+		for (auto &b: master_bus) s.push_back(&b);
+		for (size_t i = 0; i < n_slaves; ++i) {
+			m.push_back(&slave_bus[i]);
+			adr.push_back(i << adr_bit);
+			mask.push_back(~((1u << adr_bit) - 1));
+		}
+		generic_interconnect = new wbp_model::wbp_interconnect(s, m, adr, mask, {weight}, registered);
+		interconnect.reset(generic_interconnect);
+	} else {
+		interconnect.reset(new wbp_model::wbp_2s2m_crossbar(master_bus[0], master_bus[1], slave_bus[0], slave_bus[1], adr_bit));
+	}
+
+	wbp_model::fabric fabric;
+	for (auto &m: masters) fabric.add(*m.block);
+	fabric.add(*interconnect);
+	for (auto &s: slaves) fabric.add(*s);
+
+	auto start = std::chrono::steady_clock::now();
+	fabric.run(cycles);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	printf("%s, %llu cycles in %.3f s (%.1f Mcycles/s)\n", topology.c_str(), cycles, seconds, cycles/seconds/1e6);
+	printf("\n master                          strobes  per cycle  wait mean    max  latency mean    max  stalled  longest  starved  timeouts  unanswered\n");
+	for (size_t i = 0; i < n_masters; ++i) {
+		const wbp_model::master_stats &s = *masters[i].stats;
+		double n = s.strobes ? s.strobes : 1;
+		double responses = (s.acks + s.errs + s.rtys + s.timeouts) ? (s.acks + s.errs + s.rtys + s.timeouts) : 1;
+		printf(" %d %-28s %10llu %10.4f %10.2f %6llu %13.2f %6llu %8.4f %8llu %8llu %9llu %11lld\n", (int)i, masters[i].description.c_str(),
+			(unsigned long long)s.strobes, s.strobes/(double)cycles,
+			s.wait_sum/n, (unsigned long long)s.wait_max,
+			s.latency_sum/responses, (unsigned long long)s.latency_max,
+			s.stall_cycles/(double)cycles, (unsigned long long)s.longest_stall,
+			(unsigned long long)s.starved, (unsigned long long)s.timeouts,
+			(long long)(s.strobes - s.acks - s.errs - s.rtys));
+	}
+	printf("\n slave    strobes  per cycle  cyc\n");
+	for (size_t i = 0; i < n_slaves; ++i) {
+		printf(" %d     %10llu %10.4f %6.3f\n", (int)i, (unsigned long long)slaves[i]->strobes,
+			slaves[i]->strobes/(double)cycles, slaves[i]->busy_cycles/(double)cycles);
+	}
+	if (protected_split) {
+		printf("\n open strobes at the end %lld (max %lld), strobes passed to both slaves %llu\n",
+			(long long)protected_split->count(), (long long)protected_split->max_count,
+			(unsigned long long)protected_split->double_strobes);
+	}
+	if (generic_interconnect) {
+		printf("\n %llu grant changes\n", (unsigned long long)generic_interconnect->grant_changes);
+	}
+	return 0;
+}
@@ -0,0 +1,860 @@
+#ifndef WBP_MODEL_HPP_
+#define WBP_MODEL_HPP_
+
+// Header-only C++17 cycle model of the pipelined wishbone blocks in the parent directory, to predict the
+// throughput of an interconnect before it is changed in the RTL.
+//
+// Blocks are connected by wbp_model::bus (like t_wbp in wbp_pkg.vhd) and the signals have the
+// meaning of the VHDL ports. Each cycle is evaluated in three passes: forward() computes the
+// signals towards the slaves (cyc, stb, we, adr), backward() the signals towards the masters
+// (ack, err, rty, stall), and clock() updates the registers at the rising edge. The interconnect
+// blocks follow the VHDL: wbp_2s1m gives the bus to slave port 0 unless port 1 already holds it,
+// wbp_1s2m selects by one address bit, wbp_1s2m_protected stalls a switch to the other slave while
+// strobes are open (with the counter as it is in the RTL), and wbp_2s2m_crossbar is built from
+// these like in wbp_mux.vhd. wbp_interconnect models the arbiters and register stages of
+// wbp_interconnect.vhd. Data and sel lines are not modelled.
+//
+//   wbp_model::fabric f;
+//   wbp_model::bus m0, m1, s;
+//   wbp_model::pipelined_master a(m0, source_a), b(m1, source_b);
+//   wbp_model::wbp_2s1m mux(m0, m1, s);
+//   wbp_model::pipelined_slave mem(s, 2, 4, 0.0);
+//   f.add(a); f.add(b); f.add(mux); f.add(mem);   // from the masters to the slaves
+//   f.run(1000000);
+//
+// The masters collect the statistics of their strobes (see master_stats).
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+namespace wbp_model {
+
+struct master_out {
+	bool     cyc = false;
+	bool     stb = false;
+	bool     we  = false;
+	uint32_t adr = 0;
+};
+struct master_in {
+	bool ack   = false;
+	bool err   = false;
+	bool rty   = false;
+	bool stall = false;
+};
+// a connection between a master and a slave port, like t_wbp
+struct bus {
+	master_out mosi;
+	master_in  miso;
+};
+
+const master_out idle_out{};
+// what a port of a mux sees when it doesn't have the bus
+const master_in stalled_in{false, false, false, true};
+
+class block {
+public:
+	virtual ~block() {}
+	virtual void forward()  {}
+	virtual void backward() {}
+	virtual void clock()    {}
+};
+
+// evaluates the blocks in the order in which they were added (masters first) and backwards
+class fabric {
+public:
+	void add(block &b) { blocks_.push_back(&b); }
+
+	void step() {
+		for (block *b : blocks_) b->forward();
+		for (auto b = blocks_.rbegin(); b != blocks_.rend(); ++b) (*b)->backward();
+		for (block *b : blocks_) b->clock();
+		++cycle_;
+	}
+	void run(uint64_t cycles) {
+		for (uint64_t c = 0; c < cycles; ++c) step();
+	}
+	uint64_t cycle() const { return cycle_; }
+
+private:
+	std::vector<block*> blocks_;
+	uint64_t cycle_ = 0;
+};
+
+/////////////////////////////////////////////////
+// interconnect (wbp_mux.vhd)
+/////////////////////////////////////////////////
+
+//  S S
+//  |/
+//  M
+class wbp_2s1m : public block {
+public:
+	wbp_2s1m(bus &slave0, bus &slave1, bus &master) : s0_(slave0), s1_(slave1), m_(master) {}
+
+	void forward() override {
+		if (slave0_prio() && s0_.mosi.cyc) m_.mosi = s0_.mosi;
+		else if (s1_.mosi.cyc)             m_.mosi = s1_.mosi;
+		else                               m_.mosi = idle_out;
+	}
+	void backward() override {
+		s0_.miso = (slave0_prio() && s0_.mosi.cyc) ? m_.miso : stalled_in;
+		s1_.miso = (cyc1_ || (s1_.mosi.cyc && !s0_.mosi.cyc)) ? m_.miso : stalled_in;
+	}
+	void clock() override {
+		if (!cyc1_) {
+			cyc1_ = s1_.mosi.cyc && !s0_.mosi.cyc;
+		} else {
+			cyc1_ = s1_.mosi.cyc;
+		}
+	}
+
+private:
+	bool slave0_prio() const { return !cyc1_ || !s1_.mosi.cyc; }
+
+	bus &s0_, &s1_, &m_;
+	bool cyc1_ = false; // state s_cyc1
+};
+
+//   S
+//  /|
+// M M
+class wbp_1s2m : public block {
+public:
+	wbp_1s2m(bus &slave, bus &master0, bus &master1, unsigned adr_bit)
+		: s_(slave), m0_(master0), m1_(master1), adr_bit_(adr_bit) {}
+
+	void forward() override {
+		master_out out = s_.mosi;
+		out.adr &= low_mask();
+		bool upper = (s_.mosi.adr & ~low_mask()) != 0;
+		m0_.mosi = upper ? idle_out : out;
+		m1_.mosi = upper ? out : idle_out;
+	}
+	void backward() override {
+		s_.miso = ((s_.mosi.adr & ~low_mask()) != 0) ? m1_.miso : m0_.miso;
+	}
+
+private:
+	uint32_t low_mask() const { return adr_bit_ >= 32 ? ~0u : (1u << adr_bit_) - 1; }
+
+	bus &s_, &m0_, &m1_;
+	unsigned adr_bit_;
+};
+
+// stalls a change of the addressed slave while strobes are open on the other one.
+// The counter of open strobes counts like the RTL: +1 for each cycle with stb and without ack
+// (also when the strobe is stalled), -1 for an ack in a cycle without stb or while the switch stalls.
+class wbp_1s2m_protected : public block {
+public:
+	wbp_1s2m_protected(bus &slave, bus &master0, bus &master1, unsigned adr_bit)
+		: s_(slave), m0_(master0), m1_(master1), adr_bit_(adr_bit) {}
+
+	void forward() override {
+		select();
+		master_out hold;
+		hold.cyc = true;
+		m0_.mosi = (sel0_ && !stall_) ? s_.mosi : sel0_ ? hold : idle_out;
+		m1_.mosi = (sel1_ && !stall_) ? s_.mosi : sel1_ ? hold : idle_out;
+		if (sel0_ && sel1_ && s_.mosi.stb && !stall_) {
+			++double_strobes;
+		}
+	}
+	void backward() override {
+		if      (sel0_) { s_.miso = m0_.miso; if (stall_) s_.miso.stall = s_.mosi.cyc; }
+		else if (sel1_) { s_.miso = m1_.miso; if (stall_) s_.miso.stall = s_.mosi.cyc; }
+		else            { s_.miso = master_in{}; }
+	}
+	void clock() override {
+		const bool a   = bit();
+		const bool end0 = m0_.miso.ack || m0_.miso.err || m0_.miso.rty;
+		const bool end1 = m1_.miso.ack || m1_.miso.err || m1_.miso.rty;
+		const bool inc = (sel0_ && !end0 && s_.mosi.stb) || (sel1_ && !end1 && s_.mosi.stb);
+		const bool dec = (sel0_ && end0 && (!s_.mosi.stb || stall_)) || (sel1_ && end1 && (!s_.mosi.stb || stall_));
+		switch (state_) {
+			case s_idle:
+				if (s_.mosi.cyc) state_ = a ? s_cyc1 : s_cyc0;
+				break;
+			case s_cyc0:
+				if (!s_.mosi.cyc) state_ = s_idle;
+				else if (a && (cnt_ == 0 || (cnt_ == 1 && dec))) state_ = s_cyc1;
+				break;
+			case s_cyc1:
+				if (!s_.mosi.cyc) state_ = s_idle;
+				else if (!a && (cnt_ == 0 || (cnt_ == 1 && dec))) state_ = s_cyc0;
+				break;
+		}
+		// the later assignment wins in the process
+		if (dec)      --cnt_;
+		else if (inc) ++cnt_;
+		max_count = std::max(max_count, cnt_);
+	}
+
+	int64_t  count() const { return cnt_; }
+	int64_t  max_count = 0;
+	// strobes that were passed to both slaves (sel_0 and sel_1 at the same time)
+	uint64_t double_strobes = 0;
+
+private:
+	enum state { s_idle, s_cyc0, s_cyc1 };
+
+	bool bit() const { return adr_bit_ < 32 && ((s_.mosi.adr >> adr_bit_) & 1); }
+	void select() {
+		const bool a = bit();
+		const bool cyc = s_.mosi.cyc;
+		sel0_  = (state_ == s_cyc0 && cyc) || (state_ == s_idle && !a) || (state_ == s_cyc1 && !a && cnt_ == 0);
+		sel1_  = (state_ == s_cyc1 && cyc) || (state_ == s_idle &&  a) || (state_ == s_cyc0 &&  a && cnt_ == 0);
+		stall_ = (state_ == s_cyc0 && a && cnt_ != 0) || (state_ == s_cyc1 && !a && cnt_ != 0);
+	}
+
+	bus &s_, &m0_, &m1_;
+	unsigned adr_bit_;
+	state   state_ = s_idle;
+	int64_t cnt_ = 0;
+	bool sel0_ = false, sel1_ = false, stall_ = false;
+};
+
+//  S S
+//  |X|
+//  M M
+class wbp_2s2m_crossbar : public block {
+public:
+	wbp_2s2m_crossbar(bus &slave0, bus &slave1, bus &master0, bus &master1, unsigned adr_bit)
+		: spread0_(slave0, i_[0], i_[1], adr_bit), spread1_(slave1, i_[2], i_[3], adr_bit),
+		  combine0_(i_[0], i_[2], master0), combine1_(i_[1], i_[3], master1) {}
+
+	void forward() override {
+		spread0_.forward(); spread1_.forward();
+		combine0_.forward(); combine1_.forward();
+	}
+	void backward() override {
+		combine1_.backward(); combine0_.backward();
+		spread1_.backward(); spread0_.backward();
+	}
+	void clock() override {
+		combine0_.clock(); combine1_.clock();
+	}
+
+private:
+	bus i_[4];
+	wbp_1s2m spread0_, spread1_;
+	wbp_2s1m combine0_, combine1_;
+};
+
+// wbp_register (wbp_interconnect.vhd): output register with skid buffer, responses delayed by one cycle
+class wbp_register : public block {
+public:
+	wbp_register(bus &slave, bus &master) : s_(slave), m_(master) {}
+
+	void forward() override { m_.mosi = out_; }
+	void backward() override {
+		s_.miso = response_;
+		s_.miso.stall = skid_valid_;
+	}
+	void clock() override {
+		const master_in in = m_.miso;
+		if (!out_.stb || !in.stall) {
+			if (skid_valid_) {
+				out_ = skid_;
+				skid_valid_ = false;
+			} else {
+				out_ = s_.mosi;
+				out_.stb = s_.mosi.cyc && s_.mosi.stb;
+			}
+		} else if (!skid_valid_ && s_.mosi.cyc && s_.mosi.stb) {
+			skid_ = s_.mosi;
+			skid_valid_ = true;
+		}
+		response_ = in;
+		response_.stall = false;
+	}
+
+private:
+	bus &s_, &m_;
+	master_out out_, skid_;
+	bool       skid_valid_ = false;
+	master_in  response_;
+};
+
+// wbp_interconnect (wbp_interconnect.vhd): masters on slaves.size() slave ports, slaves on
+// masters.size() master ports, one arbiter per master port. A strobe goes to the first master port
+// with (adr & mask[m]) == adr_map[m], others are answered with err. With registered, a wbp_register
+// is placed in front of each master port (add the interconnect to the fabric before the slaves).
+class wbp_interconnect : public block {
+public:
+	wbp_interconnect(std::vector<bus*> slaves, std::vector<bus*> masters,
+	                 std::vector<uint32_t> adr_map, std::vector<uint32_t> mask,
+	                 std::vector<unsigned> weights = {8}, bool registered = true)
+		: s_(slaves), adr_(adr_map), mask_(mask), weights_(weights),
+		  none_(masters.size()), to_(masters.size()),
+		  slave_(slaves.size()), port_(masters.size()) {
+		for (size_t m = 0; m < masters.size(); ++m) {
+			if (registered) {
+				registers_.emplace_back(new wbp_register(to_[m], *masters[m]));
+				m_.push_back(&to_[m]);
+			} else {
+				m_.push_back(masters[m]);
+			}
+		}
+	}
+
+	void forward() override {
+		for (size_t s = 0; s < s_.size(); ++s) {
+			slave_state &st = slave_[s];
+			st.request = s_[s]->mosi.cyc && s_[s]->mosi.stb;
+			st.target  = decode(s_[s]->mosi.adr);
+		}
+		for (size_t m = 0; m < port_.size(); ++m) {
+			port_state &p = port_[m];
+			p.others_wait = false;
+			for (size_t s = 0; s < s_.size(); ++s) {
+				p.others_wait |= s != p.owner && slave_[s].request && slave_[s].target == m;
+			}
+		}
+		for (size_t s = 0; s < s_.size(); ++s) {
+			slave_state &st = slave_[s];
+			size_t t = st.target;
+			bool p = st.request && (st.open == 0 || st.current == t) && st.open < max_open;
+			if (t != none_) {
+				p = p && port_[t].granted && port_[t].owner == s && !exhausted(s, t);
+			}
+			st.pass = p;
+		}
+		for (size_t m = 0; m < port_.size(); ++m) {
+			master_out out;
+			if (port_[m].granted) {
+				const slave_state &o = slave_[port_[m].owner];
+				out = s_[port_[m].owner]->mosi;
+				out.cyc = out.cyc && (o.target == m || (o.open && o.current == m));
+				out.stb = o.pass && o.target == m;
+			}
+			to(m).mosi = out;
+		}
+		for (auto &r: registers_) r->forward();
+	}
+
+	void backward() override {
+		for (auto r = registers_.rbegin(); r != registers_.rend(); ++r) (*r)->backward();
+		for (size_t s = 0; s < s_.size(); ++s) {
+			slave_state &st = slave_[s];
+			master_in rsp;
+			if (st.open) {
+				if (st.current == none_) rsp.err = st.err_resp;
+				else                     rsp = to(st.current).miso;
+			}
+			rsp.stall = true;
+			if (st.pass) {
+				rsp.stall = (st.target == none_) ? false : to(st.target).miso.stall;
+			}
+			st.accepted = st.pass && !rsp.stall;
+			st.answered = st.open && (rsp.ack || rsp.err || rsp.rty);
+			s_[s]->miso = rsp;
+		}
+	}
+
+	void clock() override {
+		for (size_t m = 0; m < port_.size(); ++m) {
+			port_state &p = port_[m];
+			const size_t s = p.owner;
+			const slave_state &o = slave_[s];
+			bool keep = p.granted && ((o.open && o.current == m) || o.accepted ||
+			                          (o.request && o.target == m && !exhausted(s, m)));
+			if (p.granted && o.accepted && p.used != 255) ++p.used;
+			if (!keep) {
+				for (size_t i = 1; i <= s_.size(); ++i) {
+					size_t n = (p.owner + i) % s_.size();
+					const slave_state &c = slave_[n];
+					if (c.request && c.target == m && (c.open == 0 || c.current == m)) {
+						if (p.granted && n != p.owner) ++grant_changes;
+						p.granted = true;
+						p.owner   = n;
+						p.used    = 0;
+						break;
+					}
+				}
+			}
+		}
+		for (size_t s = 0; s < s_.size(); ++s) {
+			slave_state &st = slave_[s];
+			if (st.accepted && !st.answered) ++st.open;
+			else if (st.answered && !st.accepted) --st.open;
+			if (st.accepted) st.current = st.target;
+			st.err_resp = st.accepted && st.target == none_;
+		}
+		for (auto &r: registers_) r->clock();
+	}
+
+	// times that an arbiter gave its port to another slave port
+	uint64_t grant_changes = 0;
+
+private:
+	static const unsigned max_open = 255;
+
+	struct slave_state {
+		bool     request = false, pass = false, accepted = false, answered = false, err_resp = false;
+		size_t   target = 0, current = 0;
+		unsigned open = 0;
+	};
+	struct port_state {
+		bool     granted = false, others_wait = false;
+		size_t   owner = 0;
+		unsigned used = 0;
+	};
+
+	size_t decode(uint32_t adr) const {
+		for (size_t m = 0; m < none_; ++m) {
+			if ((adr & mask_[m]) == adr_[m]) return m;
+		}
+		return none_;
+	}
+	unsigned weight(size_t s) const { return weights_[std::min(s, weights_.size()-1)]; }
+	bool exhausted(size_t s, size_t m) const {
+		return weight(s) != 0 && port_[m].used >= weight(s) && port_[m].others_wait;
+	}
+	bus &to(size_t m) { return *m_[m]; }
+
+	std::vector<bus*>     s_, m_;
+	std::vector<uint32_t> adr_, mask_;
+	std::vector<unsigned> weights_;
+	size_t none_;
+	std::vector<bus>      to_;   // between the arbiters and the registers
+	std::vector<std::unique_ptr<wbp_register>> registers_;
+	std::vector<slave_state> slave_;
+	std::vector<port_state>  port_;
+};
+
+/////////////////////////////////////////////////
+// masters
+/////////////////////////////////////////////////
+
+// one strobe: the cycle from which on the master wants to issue it, its address, and the direction
+struct access {
+	uint64_t time;
+	uint32_t adr;
+	bool     we;
+};
+
+class access_source {
+public:
+	virtual ~access_source() {}
+	// the next access (not removed), false if there are no more
+	virtual bool peek(access &a) = 0;
+	virtual void pop() = 0;
+};
+
+// a recorded list of accesses
+class trace_source : public access_source {
+public:
+	explicit trace_source(std::vector<access> accesses) : accesses_(std::move(accesses)) {}
+	bool peek(access &a) override {
+		if (pos_ == accesses_.size()) return false;
+		a = accesses_[pos_];
+		return true;
+	}
+	void pop() override { ++pos_; }
+
+private:
+	std::vector<access> accesses_;
+	size_t pos_ = 0;
+};
+
+// Random accesses: bursts of consecutive words with geometric length of mean burst, separated by
+// gaps that give rate strobes per cycle on average. Addresses are word aligned in [base, base+size),
+// a fraction of read_fraction are reads.
+class random_source : public access_source {
+public:
+	random_source(double rate, double burst, double read_fraction, uint32_t base, uint32_t size, uint64_t seed)
+		: rate_(rate), burst_(std::max(1.0, burst)), read_fraction_(read_fraction), base_(base),
+		  words_(std::max(1u, size/4)), rng_(seed ? seed : 1) { generate(0); }
+
+	bool peek(access &a) override {
+		if (rate_ <= 0) return false;
+		a = next_;
+		return true;
+	}
+	void pop() override { generate(next_.time + 1); }
+
+private:
+	uint64_t xorshift() {
+		rng_ ^= rng_ >> 12;
+		rng_ ^= rng_ << 25;
+		rng_ ^= rng_ >> 27;
+		return rng_ * 2685821657736338717ull;
+	}
+	double uniform() { return (xorshift() >> 11) * (1.0/9007199254740992.0); }
+	// cycles until the next event with probability p per cycle
+	uint64_t geometric(double p) {
+		if (p >= 1) return 0;
+		double u = uniform();
+		return (uint64_t)(std::log1p(-u)/std::log1p(-p));
+	}
+
+	void generate(uint64_t earliest) {
+		if (in_burst_ && uniform() >= 1/burst_) {
+			// next word of the burst
+			word_ = (word_ + 1) % words_;
+			next_ = access{earliest, base_ + 4*word_, next_.we};
+			return;
+		}
+		// a new burst after a gap with a mean of burst*(1-rate)/rate cycles
+		double gap = (rate_ >= 1) ? 0 : burst_*(1-rate_)/rate_;
+		uint64_t wait = (gap > 0) ? geometric(1/(1+gap)) : 0;
+		in_burst_ = true;
+		word_ = xorshift() % words_;
+		next_ = access{earliest + wait, base_ + 4*word_, uniform() >= read_fraction_};
+	}
+
+	double   rate_, burst_, read_fraction_;
+	uint32_t base_, words_;
+	uint64_t rng_;
+	bool     in_burst_ = false;
+	uint32_t word_ = 0;
+	access   next_{0, 0, false};
+};
+
+struct master_stats {
+	uint64_t strobes = 0;        // accepted by the slave side (stb and not stall)
+	uint64_t acks = 0, errs = 0, rtys = 0;
+	uint64_t timeouts = 0;       // wbta_master: the stall timeout ended the strobe
+	uint64_t stall_cycles = 0;   // stb and stall
+	uint64_t wait_sum = 0;       // cycles from the time of an access until its strobe was accepted
+	uint64_t wait_max = 0;
+	uint64_t latency_sum = 0;    // cycles from the time of an access until it was acked
+	uint64_t latency_max = 0;
+	uint64_t starved = 0;        // accesses that waited at least starvation_cycles
+	uint64_t longest_stall = 0;  // consecutive stalled cycles
+	uint64_t busy_cycles = 0;    // cycles with cyc
+	uint64_t last_cycle = 0;     // cycle of the last response
+};
+
+// A master that keeps up to max_outstanding strobes open, issues one strobe per cycle if there is
+// one due, and keeps cyc while strobes are open or due. Outputs are registered.
+class pipelined_master : public block {
+public:
+	pipelined_master(bus &port, access_source &source, int max_outstanding = 8, uint64_t starvation_cycles = 1000)
+		: port_(port), source_(source), max_outstanding_(std::max(1, max_outstanding)), starvation_(starvation_cycles) {}
+
+	void forward() override { port_.mosi = out_; }
+
+	void clock() override {
+		const master_in &in = port_.miso;
+		stats.busy_cycles += out_.cyc;
+		if (out_.stb) {
+			if (in.stall) {
+				++stats.stall_cycles;
+				longest_ = std::max(longest_, ++stalled_);
+				stats.longest_stall = longest_;
+			} else {
+				// accepted
+				stalled_ = 0;
+				++stats.strobes;
+				access a;
+				source_.peek(a);
+				source_.pop();
+				account_wait(a.time);
+				open_.push_back(a.time);
+			}
+		}
+		if (out_.cyc && (in.ack || in.err || in.rty) && !open_.empty()) {
+			stats.acks += in.ack; stats.errs += in.err; stats.rtys += in.rty;
+			uint64_t latency = now_ + 1 - open_.front();
+			stats.latency_sum += latency;
+			stats.latency_max = std::max(stats.latency_max, latency);
+			stats.last_cycle = now_;
+			open_.pop_front();
+		}
+		++now_;
+		// next outputs
+		access next;
+		bool due = source_.peek(next) && next.time <= now_;
+		out_.stb = due && (int)open_.size() < max_outstanding_;
+		if (out_.stb) {
+			out_.adr = next.adr;
+			out_.we  = next.we;
+		}
+		out_.cyc = out_.stb || !open_.empty();
+		done_ = open_.empty() && !source_.peek(next);
+	}
+
+	bool done() const { return done_; }
+	master_stats stats;
+
+private:
+	void account_wait(uint64_t time) {
+		uint64_t wait = now_ + 1 - time;
+		stats.wait_sum += wait;
+		stats.wait_max = std::max(stats.wait_max, wait);
+		stats.starved += wait >= starvation_;
+	}
+
+	bus &port_;
+	access_source &source_;
+	int max_outstanding_;
+	uint64_t starvation_;
+	master_out out_;
+	std::deque<uint64_t> open_; // times of the open strobes
+	uint64_t now_ = 0;
+	uint64_t stalled_ = 0, longest_ = 0;
+	bool done_ = false;
+};
+
+// wbta_wbp_master.vhd: takes one strobe request when idle, waits for ack, err, rty, or the stall
+// timeout, and delivers the response (for reads, and for writes if write_response is set) in an
+// extra state before it takes the next request. A stall_timeout of 0 disables the timeout.
+// The response is taken at once (stall_i = '0'). keep_cyc keeps cyc between strobes like tract_i.cyc.
+// Like in the RTL, a strobe that ends by the timeout is not taken back: stb stays high until the next strobe.
+class wbta_master : public block {
+public:
+	wbta_master(bus &port, access_source &source, uint32_t stall_timeout = 0, bool write_response = true,
+	            bool keep_cyc = false, uint64_t starvation_cycles = 1000)
+		: port_(port), source_(source), stall_timeout_(stall_timeout), write_response_(write_response),
+		  keep_cyc_(keep_cyc), starvation_(starvation_cycles) {}
+
+	void forward() override { port_.mosi = out_; }
+
+	void clock() override {
+		const master_in &in = port_.miso;
+		stats.busy_cycles += out_.cyc;
+		access a;
+		switch (state_) {
+			case s_idle:
+				if (source_.peek(a) && a.time <= now_) {
+					source_.pop();
+					time_ = a.time;
+					timeout_active_ = stall_timeout_ != 0;
+					timeout_count_  = stall_timeout_;
+					out_.cyc = out_.stb = true;
+					out_.adr = a.adr;
+					out_.we  = a.we;
+					state_ = s_wait_for_ack;
+				}
+				break;
+			case s_wait_for_ack: {
+				if (out_.stb) {
+					if (!in.stall) {
+						++stats.strobes;
+						account_wait();
+						stalled_ = 0;
+					} else {
+						++stats.stall_cycles;
+						stats.longest_stall = std::max(stats.longest_stall, ++stalled_);
+					}
+				}
+				// the timeout is bit 31 of the counter before it is decremented
+				const bool timed_out = timeout_active_ && (timeout_count_ >> 31);
+				if (!in.stall) {
+					out_.stb = false;
+				} else if (timeout_active_) {
+					--timeout_count_;
+				}
+				if (in.ack || in.err || in.rty || timed_out) {
+					stats.acks += in.ack; stats.errs += in.err; stats.rtys += in.rty;
+					stats.timeouts += timed_out && !(in.ack || in.err || in.rty);
+					uint64_t latency = now_ + 1 - time_;
+					stats.latency_sum += latency;
+					stats.latency_max = std::max(stats.latency_max, latency);
+					stats.last_cycle = now_;
+					if (!keep_cyc_) {
+						out_.cyc = false;
+					}
+					state_ = (write_response_ || !out_.we) ? s_send_response : s_idle;
+				}
+				break;
+			}
+			case s_send_response:
+				state_ = s_idle;
+				break;
+		}
+		++now_;
+	}
+
+	bool done() {
+		access a;
+		return state_ == s_idle && !source_.peek(a);
+	}
+	master_stats stats;
+
+private:
+	enum state { s_idle, s_wait_for_ack, s_send_response };
+
+	void account_wait() {
+		uint64_t wait = now_ + 1 - time_;
+		stats.wait_sum += wait;
+		stats.wait_max = std::max(stats.wait_max, wait);
+		stats.starved += wait >= starvation_;
+	}
+
+	bus &port_;
+	access_source &source_;
+	uint32_t stall_timeout_;
+	bool write_response_, keep_cyc_;
+	uint64_t starvation_;
+	master_out out_;
+	state    state_ = s_idle;
+	bool     timeout_active_ = false;
+	uint32_t timeout_count_ = 0;
+	uint64_t time_ = 0, now_ = 0, stalled_ = 0;
+};
+
+// wbta_wbp_master_pipelined (wbta_wbp_master.vhd): takes the next request in the cycle in which the
+// strobe on the bus is accepted, while less than 2**depth strobes wait for their response or its
+// delivery. A strobe that times out is taken back and answered after the strobes before it.
+// The responses are delivered one per cycle (stall_i = '0').
+class wbta_pipelined_master : public block {
+public:
+	wbta_pipelined_master(bus &port, access_source &source, unsigned depth = 2, uint32_t stall_timeout = 0,
+	                      bool keep_cyc = false, uint64_t starvation_cycles = 1000)
+		: port_(port), source_(source), size_(1u << depth), stall_timeout_(stall_timeout),
+		  keep_cyc_(keep_cyc), starvation_(starvation_cycles) {}
+
+	void forward() override { port_.mosi = out_; }
+
+	void clock() override {
+		const master_in &in = port_.miso;
+		stats.busy_cycles += out_.cyc;
+		const bool full  = w_ - r_ == size_;
+		const bool stall = full || timeout_pending_ || (out_.stb && in.stall);
+		access a;
+		const bool take  = !stall && source_.peek(a) && a.time <= now_;
+
+		if (out_.stb) {
+			if (!in.stall) {
+				++stats.strobes;
+				uint64_t wait = now_ + 1 - times_.back();
+				stats.wait_sum += wait;
+				stats.wait_max = std::max(stats.wait_max, wait);
+				stats.starved += wait >= starvation_;
+				stalled_ = 0;
+			} else {
+				++stats.stall_cycles;
+				stats.longest_stall = std::max(stats.longest_stall, ++stalled_);
+			}
+		}
+		// strobes
+		if (take) {
+			source_.pop();
+			times_.push_back(a.time);
+			timeout_active_ = stall_timeout_ != 0;
+			timeout_count_  = stall_timeout_;
+			out_.cyc = out_.stb = true;
+			out_.adr = a.adr;
+			out_.we  = a.we;
+			++w_;
+		} else if (out_.stb) {
+			if (!in.stall) {
+				out_.stb = false;
+			} else if (timeout_active_ && (timeout_count_ >> 31)) {
+				out_.stb = false;
+				timeout_pending_ = true;
+			} else if (timeout_active_) {
+				--timeout_count_;
+			}
+		}
+		// answers
+		bool answer = false;
+		if (a_ != w_ && (in.ack || in.err || in.rty)) {
+			stats.acks += in.ack; stats.errs += in.err; stats.rtys += in.rty;
+			answer = true;
+		} else if (timeout_pending_ && a_ + 1 == w_) {
+			++stats.timeouts;
+			timeout_pending_ = false;
+			answer = true;
+		}
+		if (answer) {
+			uint64_t latency = now_ + 1 - times_.front();
+			stats.latency_sum += latency;
+			stats.latency_max = std::max(stats.latency_max, latency);
+			stats.last_cycle = now_;
+			times_.pop_front();
+			if (a_ + 1 == w_ && !take && !keep_cyc_) {
+				out_.cyc = false;
+			}
+			++a_;
+		}
+		// responses
+		if (r_ != a_) {
+			++r_;
+		}
+		++now_;
+	}
+
+	bool done() {
+		access a;
+		return r_ == w_ && !source_.peek(a);
+	}
+	master_stats stats;
+
+private:
+	bus &port_;
+	access_source &source_;
+	uint64_t size_;
+	uint32_t stall_timeout_;
+	bool keep_cyc_;
+	uint64_t starvation_;
+	master_out out_;
+	uint64_t w_ = 0, a_ = 0, r_ = 0;
+	std::deque<uint64_t> times_; // times of the strobes from a_ to w_
+	bool     timeout_active_ = false, timeout_pending_ = false;
+	uint32_t timeout_count_ = 0;
+	uint64_t now_ = 0, stalled_ = 0;
+};
+
+/////////////////////////////////////////////////
+// slaves
+/////////////////////////////////////////////////
+
+// A slave that acks each accepted strobe latency cycles later (at least 1, in order), stalls while
+// max_outstanding strobes are open, and additionally stalls a cycle with probability stall_probability.
+class pipelined_slave : public block {
+public:
+	pipelined_slave(bus &port, unsigned latency = 1, unsigned max_outstanding = 1, double stall_probability = 0, uint64_t seed = 1)
+		: port_(port), latency_(std::max(1u, latency)), max_outstanding_(std::max(1u, max_outstanding)),
+		  stall_probability_(stall_probability), rng_(seed ? seed : 1) {}
+
+	void backward() override {
+		master_in out;
+		out.ack   = !due_.empty() && due_.front() == now_;
+		out.stall = random_stall_ || due_.size() - out.ack >= max_outstanding_;
+		port_.miso = out;
+	}
+
+	void clock() override {
+		const master_out &in = port_.mosi;
+		if (port_.miso.ack) {
+			due_.pop_front();
+			++acks;
+		}
+		if (in.cyc && in.stb && !port_.miso.stall) {
+			due_.push_back(now_ + latency_);
+			++strobes;
+		}
+		busy_cycles += in.cyc;
+		++now_;
+		random_stall_ = stall_probability_ > 0 && uniform() < stall_probability_;
+	}
+
+	uint64_t strobes = 0, acks = 0, busy_cycles = 0;
+
+private:
+	double uniform() {
+		rng_ ^= rng_ >> 12;
+		rng_ ^= rng_ << 25;
+		rng_ ^= rng_ >> 27;
+		return ((rng_ * 2685821657736338717ull) >> 11) * (1.0/9007199254740992.0);
+	}
+
+	bus &port_;
+	unsigned latency_, max_outstanding_;
+	double   stall_probability_;
+	uint64_t rng_;
+	std::deque<uint64_t> due_; // cycles in which the open strobes are acked
+	uint64_t now_ = 0;
+	bool     random_stall_ = false;
+};
+
+} // namespace wbp_model
+
+#endif
@@ -0,0 +1,238 @@
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+use ieee.math_real.all;
+
+use work.wbp_pkg.all;
+
+-- Random traffic through a wbp_interconnect with 4 masters and 4 slaves.
+-- Each master starts a strobe with probability g_rate in each clock cycle (while it has
+-- less than 16 open strobes). It addresses the same slave for a random number of strobes
+-- (g_burst on average) before it picks another random slave, a few strobes go to
+-- addresses that are not mapped. Slave m answers after m+1 clock cycles with its index
+-- in the upper 4 bits and the lower 28 address bits, and stalls at random. The masters
+-- check that the responses arrive in order and come from the addressed slave.
+-- At the end the strobes per 1000 clock cycles of each master and in total are reported.
+entity testbench is
+	generic (
+		g_cycles     : integer := 100000;
+		g_rate       : real    := 0.5;
+		g_burst      : real    := 8.0;
+		g_registered : boolean := true;
+		g_weight     : natural := 8
+		);
+end entity;
+
+architecture simulation of testbench is
+	constant c_clk_period : time := 10 ns;
+	constant c_masters    : integer := 4; -- masters on the slave ports of the interconnect
+	constant c_slaves     : integer := 4; -- slaves on the master ports of the interconnect
+	constant c_max_open   : integer := 16;
+
+	signal clk  : std_logic := '1';
+	signal rst  : std_logic := '1';
+	signal done : boolean   := false;
+
+	signal masters : t_wbp_array(0 to c_masters-1) := (others => c_wbp_init);
+	signal slaves  : t_wbp_array(0 to c_slaves-1)  := (others => c_wbp_init);
+
+	signal to_interconnect   : t_wbp_slave_in_array(0 to c_masters-1);
+	signal from_interconnect : t_wbp_slave_out_array(0 to c_masters-1);
+	signal to_slaves         : t_wbp_master_out_array(0 to c_slaves-1);
+	signal from_slaves       : t_wbp_master_in_array(0 to c_slaves-1);
+
+	type t_count_array is array(natural range<>) of natural;
+	signal strobes     : t_count_array(0 to c_masters-1) := (others => 0);
+	signal stalls      : t_count_array(0 to c_masters-1) := (others => 0);
+	signal mismatches  : t_count_array(0 to c_masters-1) := (others => 0);
+	signal slave_stbs  : t_count_array(0 to c_slaves-1)  := (others => 0);
+
+	function slave_adr(m : natural) return t_wbp_adr is
+	begin
+		return std_logic_vector(to_unsigned(m, 4)) & x"0000000";
+	end function;
+
+	function adr_map return t_wbp_adr_array is
+		variable result : t_wbp_adr_array(0 to c_slaves-1);
+	begin
+		for m in 0 to c_slaves-1 loop
+			result(m) := slave_adr(m);
+		end loop;
+		return result;
+	end function;
+begin
+
+	clk <= not clk after c_clk_period/2 when not done;
+	rst <= '0' after c_clk_period*5;
+
+	dut: entity work.wbp_interconnect
+	generic map(
+		g_slaves     => c_masters,
+		g_masters    => c_slaves,
+		g_adr        => adr_map,
+		g_mask       => (0 to c_slaves-1 => x"f0000000"),
+		g_weights    => (0 => g_weight),
+		g_registered => g_registered
+	)
+	port map(
+		clk_i     => clk,
+		rst_i     => rst,
+		slaves_i  => to_interconnect,
+		slaves_o  => from_interconnect,
+		masters_o => to_slaves,
+		masters_i => from_slaves
+	);
+
+	connect_masters: for i in 0 to c_masters-1 generate
+		to_interconnect(i) <= masters(i).mosi;
+		masters(i).miso    <= from_interconnect(i);
+	end generate;
+	connect_slaves: for m in 0 to c_slaves-1 generate
+		slaves(m).mosi <= to_slaves(m);
+		from_slaves(m) <= slaves(m).miso;
+	end generate;
+
+	bus_masters: for i in 0 to c_masters-1 generate
+		process
+			type t_expect_array is array(0 to c_max_open-1) of t_wbp_dat;
+			variable expect   : t_expect_array;
+			variable expect_err : std_logic_vector(0 to c_max_open-1);
+			variable w, r, n  : natural := 0;
+			variable seed1    : positive := 1+i;
+			variable seed2    : positive := 1000+i;
+			variable x        : real;
+			variable adr      : t_wbp_adr;
+			variable target   : natural := i;
+			variable mosi     : t_wbp_master_out := c_wbp_master_out_init;
+		begin
+			wait until rising_edge(clk);
+			if rst = '0' then
+				-- responses
+				if masters(i).miso.ack = '1' or masters(i).miso.err = '1' or masters(i).miso.rty = '1' then
+					if n = 0 then
+						report "master " & integer'image(i) & ": response without strobe" severity error;
+						mismatches(i) <= mismatches(i) + 1;
+					else
+						if masters(i).miso.err /= expect_err(r) or
+						   (expect_err(r) = '0' and masters(i).miso.dat /= expect(r)) then
+							mismatches(i) <= mismatches(i) + 1;
+						end if;
+						r := (r+1) mod c_max_open;
+						n := n-1;
+					end if;
+				end if;
+				-- strobes
+				if mosi.stb = '1' then
+					if masters(i).miso.stall = '0' then
+						strobes(i) <= strobes(i) + 1;
+						mosi.stb := '0';
+					else
+						stalls(i) <= stalls(i) + 1;
+					end if;
+				end if;
+				if mosi.stb = '0' and n < c_max_open then
+					uniform(seed1, seed2, x);
+					if x < g_rate then
+						uniform(seed1, seed2, x);
+						if x*g_burst < 1.0 then
+							uniform(seed1, seed2, x);
+							target := integer(trunc(x*real(c_slaves)*1.02)); -- some to unmapped addresses
+						end if;
+						uniform(seed1, seed2, x);
+						adr := std_logic_vector(to_unsigned(target, 4)) &
+						       std_logic_vector(to_unsigned(integer(trunc(x*2.0**26)), 26)) & "00";
+						uniform(seed1, seed2, x);
+						mosi.stb := '1';
+						mosi.we  := '0';
+						if x < 0.5 then
+							mosi.we := '1';
+						end if;
+						mosi.adr := adr;
+						mosi.dat := adr;
+						mosi.sel := "1111";
+						expect(w) := adr;
+						expect_err(w) := '0';
+						if target >= c_slaves then
+							expect_err(w) := '1';
+						end if;
+						w := (w+1) mod c_max_open;
+						n := n+1;
+					end if;
+				end if;
+				mosi.cyc := '0';
+				if mosi.stb = '1' or n /= 0 then
+					mosi.cyc := '1';
+				end if;
+			end if;
+			masters(i).mosi <= mosi;
+		end process;
+	end generate;
+
+	bus_slaves: for m in 0 to c_slaves-1 generate
+		process
+			constant c_latency : natural := m+1;
+			constant c_depth   : natural := 8;
+			type t_due_array is array(0 to c_depth-1) of natural;
+			type t_dat_array is array(0 to c_depth-1) of t_wbp_dat;
+			variable due      : t_due_array;
+			variable dat      : t_dat_array;
+			variable w, r, n  : natural := 0;
+			variable now      : natural := 0;
+			variable seed1    : positive := 100+m;
+			variable seed2    : positive := 2000+m;
+			variable x        : real;
+			variable miso     : t_wbp_master_in := c_wbp_master_in_init;
+		begin
+			wait until rising_edge(clk);
+			if miso.ack = '1' then
+				r := (r+1) mod c_depth;
+				n := n-1;
+			end if;
+			if slaves(m).mosi.cyc = '1' and slaves(m).mosi.stb = '1' and miso.stall = '0' then
+				due(w) := now + c_latency;
+				dat(w) := std_logic_vector(to_unsigned(m, 4)) & slaves(m).mosi.adr(27 downto 0);
+				w := (w+1) mod c_depth;
+				n := n+1;
+				slave_stbs(m) <= slave_stbs(m) + 1;
+			end if;
+			now := now + 1;
+			miso.ack := '0';
+			miso.dat := (others => '-');
+			if n /= 0 and due(r) <= now then
+				miso.ack := '1';
+				miso.dat := dat(r);
+			end if;
+			uniform(seed1, seed2, x);
+			miso.stall := '0';
+			if x < 0.05*real(m) or n = c_depth then
+				miso.stall := '1';
+			end if;
+			slaves(m).miso <= miso;
+		end process;
+	end generate;
+
+	result: process
+		variable total, wrong : natural := 0;
+	begin
+		wait until falling_edge(rst);
+		for c in 1 to g_cycles loop
+			wait until rising_edge(clk);
+		end loop;
+		for i in 0 to c_masters-1 loop
+			report "master " & integer'image(i) & ": " & integer'image(strobes(i)) & " strobes, " &
+			       integer'image(stalls(i)) & " stalled cycles, " &
+			       integer'image(1000*strobes(i)/g_cycles) & " strobes per 1000 cycles";
+			total := total + strobes(i);
+			wrong := wrong + mismatches(i);
+		end loop;
+		for m in 0 to c_slaves-1 loop
+			report "slave " & integer'image(m) & ": " & integer'image(1000*slave_stbs(m)/g_cycles) & " strobes per 1000 cycles";
+		end loop;
+		report "total: " & integer'image(1000*total/g_cycles) & " strobes per 1000 cycles, offered " &
+		       integer'image(integer(1000.0*g_rate*real(c_masters))) & ", " & integer'image(wrong) & " wrong responses";
+		assert wrong = 0 report "responses did not match" severity error;
+		done <= true;
+		wait;
+	end process;
+
+end architecture;
@@ -0,0 +1,327 @@
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+use work.wbp_pkg.all;
+
+-- A register stage for a pipelined wishbone bus.
+-- The strobes go through an output register with a skid buffer, so that
+-- the stall line towards the master is also registered. The responses
+-- (ack, err, rty, dat) are delayed by one clock cycle.
+--   S
+--   |
+--  [ ]
+--   |
+--   M
+entity wbp_register is
+	port (
+		clk_i    : in  std_logic;
+		rst_i    : in  std_logic;
+		slave_i  : in  t_wbp_slave_in;
+		slave_o  : out t_wbp_slave_out;
+		master_o : out t_wbp_master_out;
+		master_i : in  t_wbp_master_in
+		);
+end entity;
+
+architecture rtl of wbp_register is
+	signal out_reg    : t_wbp_master_out := c_wbp_master_out_init;
+	signal skid       : t_wbp_master_out := c_wbp_master_out_init;
+	signal skid_valid : std_logic := '0';
+	signal response   : t_wbp_slave_out := c_wbp_slave_out_init;
+begin
+	master_o <= out_reg;
+	slave_o  <= (ack=>response.ack, err=>response.err, rty=>response.rty, stall=>skid_valid, dat=>response.dat);
+
+	process
+	begin
+		wait until rising_edge(clk_i);
+		response.ack <= master_i.ack;
+		response.err <= master_i.err;
+		response.rty <= master_i.rty;
+		response.dat <= master_i.dat;
+		if out_reg.stb = '0' or master_i.stall = '0' then
+			-- the output register is free after this edge
+			if skid_valid = '1' then
+				out_reg    <= skid;
+				skid_valid <= '0';
+			else
+				out_reg     <= slave_i;
+				out_reg.stb <= slave_i.cyc and slave_i.stb;
+			end if;
+		elsif skid_valid = '0' and slave_i.cyc = '1' and slave_i.stb = '1' then
+			-- the output is stalled, keep the strobe that comes in
+			skid       <= slave_i;
+			skid_valid <= '1';
+		end if;
+		if rst_i = '1' then
+			out_reg    <= c_wbp_master_out_init;
+			skid_valid <= '0';
+			response   <= c_wbp_slave_out_init;
+		end if;
+	end process;
+end architecture;
+
+
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+use work.wbp_pkg.all;
+
+-- Connects g_slaves masters (on the slave ports) with g_masters slaves (on the master ports).
+-- A strobe goes to the first master port m with (adr and g_mask(m)) = g_adr(m),
+-- the address is passed unchanged. Strobes to addresses that are not mapped are
+-- answered with err in the next clock cycle.
+--
+-- Each master port has its own arbiter, so that strobes of different masters to
+-- different slaves go through at the same time. An arbiter gives the port to one
+-- slave port at a time, the grant is registered (one clock cycle after a request).
+-- The owner keeps the port as long as it strobes to it, or until it has made
+-- g_weights(s) strobes while another slave port waits (weight 0: no limit);
+-- the next owner is chosen round robin. Without requests the port stays with its owner.
+-- Ownership changes only after all strobes of the owner are answered, and a slave port
+-- can only address a different master port after all its strobes are answered, so that
+-- the responses arrive in order.
+-- The cost of this is that every change of the target drains the pipeline of the master.
+-- Masters that change the target with almost every strobe get little more than one strobe
+-- per round trip. wishbone/model/wbp_fabric (-t interconnect, 4 masters at rate=1, slave
+-- latencies 1 to 4) gives per master 0.12 strobes per cycle for a random slave per strobe
+-- (0.17 with -d), 0.31 for runs of 8 words (burst=8) per slave, and 1.00 if each master
+-- stays with its own slave. Keeping the accesses of a master to one slave together
+-- matters more than the number of open strobes.
+-- For random targets the interconnect does not beat wbp_2s2m_crossbar: with the same
+-- traffic (2 masters at rate=1, 2 slaves with latency 1 and 2) the crossbar gives 0.29
+-- strobes per cycle per master, the interconnect 0.24 (0.32 with -d). The crossbar
+-- keeps strobes to both slaves open at the same time, the interconnect would need
+-- response FIFOs per slave port, tagged with the target, for that.
+-- If g_weights has fewer entries than slave ports, the last entry is used for the others.
+--
+-- With g_registered, a wbp_register is placed in front of each master port.
+-- Responses are expected earliest in the clock cycle after the strobe was accepted.
+--  S S ... S
+--  |   X   |
+--  M M ... M
+entity wbp_interconnect is
+	generic (
+		g_slaves     : positive := 2;
+		g_masters    : positive := 2;
+		g_adr        : t_wbp_adr_array;
+		g_mask       : t_wbp_adr_array;
+		g_weights    : t_wbp_weight_array := (0 => 8);
+		g_registered : boolean := true
+		);
+	port (
+		clk_i     : in  std_logic;
+		rst_i     : in  std_logic;
+		slaves_i  : in  t_wbp_slave_in_array(0 to g_slaves-1);
+		slaves_o  : out t_wbp_slave_out_array(0 to g_slaves-1);
+		masters_o : out t_wbp_master_out_array(0 to g_masters-1);
+		masters_i : in  t_wbp_master_in_array(0 to g_masters-1)
+		);
+end entity;
+
+architecture rtl of wbp_interconnect is
+	-- the target of strobes to addresses that are not mapped
+	constant c_none     : natural := g_masters;
+	-- open strobes per slave port
+	constant c_max_open : natural := 255;
+
+	subtype t_target is natural range 0 to g_masters;
+	type t_target_array is array(0 to g_slaves-1) of t_target;
+	type t_open_array   is array(0 to g_slaves-1) of natural range 0 to c_max_open;
+	type t_slave_flags  is array(0 to g_slaves-1) of boolean;
+	type t_owner_array  is array(0 to g_masters-1) of natural range 0 to g_slaves-1;
+	type t_used_array   is array(0 to g_masters-1) of natural range 0 to 255;
+	type t_master_flags is array(0 to g_masters-1) of boolean;
+
+	function decode(adr : t_wbp_adr) return t_target is
+	begin
+		for m in 0 to g_masters-1 loop
+			if (adr and g_mask(g_mask'low+m)) = g_adr(g_adr'low+m) then
+				return m;
+			end if;
+		end loop;
+		return c_none;
+	end function;
+
+	function weight(s : natural) return natural is
+	begin
+		if g_weights'low+s <= g_weights'high then
+			return g_weights(g_weights'low+s);
+		end if;
+		return g_weights(g_weights'high);
+	end function;
+
+	-- slave ports
+	signal target    : t_target_array;                   -- where the strobe goes
+	signal current   : t_target_array := (others => 0);  -- where the open strobes went
+	signal open_cnt  : t_open_array   := (others => 0);
+	signal err_resp  : t_slave_flags  := (others => false);
+	signal pass      : t_slave_flags;                    -- the strobe is passed to the target
+	signal accepted  : t_slave_flags;                    -- ... and not stalled
+	signal answered  : t_slave_flags;
+	signal requests  : t_slave_flags;
+
+	-- master ports
+	signal owner     : t_owner_array  := (others => 0);
+	signal granted   : t_master_flags := (others => false);
+	signal used      : t_used_array   := (others => 0);
+	signal others_wait : t_master_flags;
+
+	signal to_masters   : t_wbp_master_out_array(0 to g_masters-1);
+	signal from_masters : t_wbp_master_in_array(0 to g_masters-1);
+begin
+
+	decoders: for s in 0 to g_slaves-1 generate
+		target(s)   <= decode(slaves_i(s).adr);
+		requests(s) <= slaves_i(s).cyc = '1' and slaves_i(s).stb = '1';
+	end generate;
+
+	waiting: process(requests, target, owner)
+		variable w : boolean;
+	begin
+		for m in 0 to g_masters-1 loop
+			w := false;
+			for s in 0 to g_slaves-1 loop
+				if s /= owner(m) and requests(s) and target(s) = m then
+					w := true;
+				end if;
+			end loop;
+			others_wait(m) <= w;
+		end loop;
+	end process;
+
+	routing: process(slaves_i, from_masters, requests, target, current, open_cnt, err_resp, owner, granted, used, others_wait)
+		variable t   : t_target;
+		variable p   : boolean;
+		variable ps  : t_slave_flags;
+		variable rsp : t_wbp_slave_out;
+	begin
+		for s in 0 to g_slaves-1 loop
+			t := target(s);
+			p := requests(s) and (open_cnt(s) = 0 or current(s) = t) and open_cnt(s) < c_max_open;
+			if t /= c_none then
+				p := p and granted(t) and owner(t) = s and
+				     not (weight(s) /= 0 and used(t) >= weight(s) and others_wait(t));
+			end if;
+			ps(s)   := p;
+			pass(s) <= p;
+			accepted(s) <= p and (t = c_none or from_masters(t).stall = '0');
+
+			rsp := c_wbp_slave_out_init;
+			if open_cnt(s) /= 0 then
+				if current(s) = c_none then
+					if err_resp(s) then
+						rsp.err := '1';
+					end if;
+				else
+					rsp := from_masters(current(s));
+				end if;
+			end if;
+			rsp.stall := '1';
+			if p then
+				if t = c_none then
+					rsp.stall := '0';
+				else
+					rsp.stall := from_masters(t).stall;
+				end if;
+			end if;
+			slaves_o(s) <= rsp;
+			answered(s) <= open_cnt(s) /= 0 and (rsp.ack = '1' or rsp.err = '1' or rsp.rty = '1');
+		end loop;
+
+		for m in 0 to g_masters-1 loop
+			to_masters(m) <= c_wbp_master_out_init;
+			if granted(m) then
+				-- the owner can address another port while it keeps this one
+				to_masters(m)     <= slaves_i(owner(m));
+				to_masters(m).cyc <= '0';
+				to_masters(m).stb <= '0';
+				if slaves_i(owner(m)).cyc = '1' and
+				   (target(owner(m)) = m or (open_cnt(owner(m)) /= 0 and current(owner(m)) = m)) then
+					to_masters(m).cyc <= '1';
+				end if;
+				if ps(owner(m)) and target(owner(m)) = m then
+					to_masters(m).stb <= '1';
+				end if;
+			end if;
+		end loop;
+	end process;
+
+	process
+		variable keep  : boolean;
+		variable next_owner : natural range 0 to g_slaves-1;
+		variable found : boolean;
+		variable s     : natural range 0 to g_slaves-1;
+	begin
+		wait until rising_edge(clk_i);
+
+		for i in 0 to g_slaves-1 loop
+			if accepted(i) and not answered(i) then
+				open_cnt(i) <= open_cnt(i) + 1;
+			elsif answered(i) and not accepted(i) then
+				open_cnt(i) <= open_cnt(i) - 1;
+			end if;
+			if accepted(i) then
+				current(i) <= target(i);
+			end if;
+			err_resp(i) <= accepted(i) and target(i) = c_none;
+		end loop;
+
+		for m in 0 to g_masters-1 loop
+			s := owner(m);
+			if granted(m) and accepted(s) and used(m) /= 255 then
+				used(m) <= used(m) + 1;
+			end if;
+			-- the owner keeps the port while it has open strobes, or strobes that may still pass
+			keep := granted(m) and (
+			           (open_cnt(s) /= 0 and current(s) = m) or
+			           accepted(s) or
+			           (requests(s) and target(s) = m and
+			            not (weight(s) /= 0 and used(m) >= weight(s) and others_wait(m))));
+			if not keep then
+				found := false;
+				next_owner := owner(m);
+				for i in 1 to g_slaves loop
+					if not found then
+						next_owner := (owner(m) + i) mod g_slaves;
+						if requests(next_owner) and target(next_owner) = m and
+						   (open_cnt(next_owner) = 0 or current(next_owner) = m) then
+							found := true;
+						end if;
+					end if;
+				end loop;
+				-- without requests the port stays with the last owner
+				if found then
+					granted(m) <= true;
+					owner(m)   <= next_owner;
+					used(m)    <= 0;
+				end if;
+			end if;
+		end loop;
+
+		if rst_i = '1' then
+			open_cnt <= (others => 0);
+			err_resp <= (others => false);
+			granted  <= (others => false);
+			used     <= (others => 0);
+		end if;
+	end process;
+
+	ports: for m in 0 to g_masters-1 generate
+		registered: if g_registered generate
+			stage: entity work.wbp_register
+			port map(clk_i    => clk_i,
+			         rst_i    => rst_i,
+			         slave_i  => to_masters(m),
+			         slave_o  => from_masters(m),
+			         master_o => masters_o(m),
+			         master_i => masters_i(m));
+		end generate;
+		direct: if not g_registered generate
+			masters_o(m)    <= to_masters(m);
+			from_masters(m) <= masters_i(m);
+		end generate;
+	end generate;
+
+end architecture;
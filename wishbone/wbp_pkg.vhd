@@ -52,6 +52,10 @@ package wbp_pkg is
 
   constant c_wbp_init : t_wbp := (c_wbp_master_out_init, c_wbp_master_in_init);
 
+  -- address map and arbitration weights of wbp_interconnect
+  type t_wbp_adr_array is array(natural range<>) of t_wbp_adr;
+  type t_wbp_weight_array is array(natural range<>) of natural;
+
 
 end package;
 
@@ -14,6 +14,15 @@ package wbta_pkg is
 	subtype t_wbp_sel is
 		std_logic_vector((c_wbp_adr_width/8)-1 downto 0);
 
+	-- strobes that belong to a burst are answered with one aggregated response
+	type t_wbp_burst is record
+		active : std_logic; -- the strobe is part of a burst
+		first  : std_logic; -- the strobe is the first one of the burst
+		last   : std_logic; -- the strobe is the last one of the burst
+		count  : unsigned(7 downto 0); -- number of strobes in the burst minus one
+	end record;
+	constant c_wbp_burst_none : t_wbp_burst := (active=>'0', first=>'0', last=>'0', count=>(others => '0'));
+
 	type t_wbp_transaction_request is record
 		stall_timeout : unsigned(31 downto 0); -- wait at most so long for stall to go down before ending the strobe
 		cyc : std_logic;
@@ -21,8 +30,9 @@ package wbta_pkg is
 		sel : t_wbp_sel;
 		we  : std_logic;
 		dat : t_wbp_dat;
+		burst : t_wbp_burst;
 	end record;
-	constant c_wbp_transaction_init   : t_wbp_transaction_request   := (stall_timeout=>(others => '0'), cyc=>'0',we=>'0',adr=>(others=>'-'),dat=>(others=>'-'),sel=>(others=>'-'));
+	constant c_wbp_transaction_init   : t_wbp_transaction_request   := (stall_timeout=>(others => '0'), cyc=>'0',we=>'0',adr=>(others=>'-'),dat=>(others=>'-'),sel=>(others=>'-'),burst=>c_wbp_burst_none);
 	type t_wbta_request is record
 		dat   : t_wbp_transaction_request;
 		stb   : std_logic;
@@ -37,8 +47,9 @@ package wbta_pkg is
 		err : std_logic;
 		rty : std_logic;
 		stall_timeout : std_logic; -- this is '1' when the strobe was stalled for too long
+		burst : t_wbp_burst;       -- copied from the request
 	end record;
-	constant c_wbp_transaction_response_init  : t_wbp_transaction_response := (sel=>(others=>'0'),dat=>(others=>'0'),we=>'0',ack=>'0',err=>'0',rty=>'0',stall_timeout=>'0');
+	constant c_wbp_transaction_response_init  : t_wbp_transaction_response := (sel=>(others=>'0'),dat=>(others=>'0'),we=>'0',ack=>'0',err=>'0',rty=>'0',stall_timeout=>'0',burst=>c_wbp_burst_none);
 	type t_wbta_response is record
 		dat   : t_wbp_transaction_response;
 		stb   : std_logic;
@@ -56,8 +67,19 @@ package wbta_pkg is
 	type t_configuration is record
 		host_sends_write_response : std_logic;
 		fpga_sends_write_response : std_logic;
+		delta_slave_writes        : std_logic;
+	end record;
+	constant c_configuration_init : t_configuration := (host_sends_write_response=>'0', fpga_sends_write_response=>'1', delta_slave_writes=>'0');
+
+	-- host commands for the cache of the slave interface (wb_uart)
+	type t_slave_cache_update is record
+		fill           : std_logic; -- store dat as value for adr
+		invalidate     : std_logic; -- forget the value for adr
+		invalidate_all : std_logic; -- forget all values
+		adr : t_wbp_adr;
+		dat : t_wbp_dat;
 	end record;
-	constant c_configuration_init : t_configuration := (host_sends_write_response=>'0', fpga_sends_write_response=>'1');
+	constant c_slave_cache_update_none : t_slave_cache_update := (adr=>(others => '0'), dat=>(others => '0'), others => '0');
 
 
 	subtype t_byte_idx is integer range 0 to 3;
@@ -81,6 +103,7 @@ package wbta_pkg is
 
 	function init_adr_packing_write(adr : std_logic_vector(31 downto 0)) return t_adr_packing;
 	function init_adr_packing_read(adr : std_logic_vector(31 downto 0)) return t_adr_packing;
+	function init_adr_packing_delta(adr : std_logic_vector(31 downto 0); expected : std_logic_vector(31 downto 2)) return t_adr_packing;
 	function adr_packing_more_adr_blocks(adr_packing : t_adr_packing) return boolean;
 end package;
 
@@ -137,6 +160,28 @@ package body wbta_pkg is
 		result.idx := 0;
 		return result;
 	end function;
+	-- the word distance between adr and the expected address, zigzag encoded 
+	-- (0, -1, 1, -2, ... become 0, 1, 2, 3, ...) so that small steps in both directions need only one block
+	function init_adr_packing_delta(adr : std_logic_vector(31 downto 0); expected : std_logic_vector(31 downto 2)) return t_adr_packing is 
+		variable result : t_adr_packing := c_adr_packing_init;
+		variable delta  : std_logic_vector(29 downto 0);
+		variable zigzag : std_logic_vector(29 downto 0);
+	begin
+		delta  := std_logic_vector(unsigned(adr(31 downto 2)) - unsigned(expected));
+		zigzag := (delta(28 downto 0) & '0') xor (29 downto 0 => delta(29));
+		for i in 0 to 4 loop 
+			result.blocks(i) := zigzag(5+6*i downto 6*i);
+		end loop;
+		for i in 0 to 4 loop 
+			if result.blocks(i) = "000000" then 
+				result.mask(i) := '0';
+			else 
+				result.mask(i) := '1';
+			end if; 
+		end loop;
+		result.idx := 0;
+		return result;
+	end function;
 	function adr_packing_more_adr_blocks(adr_packing : t_adr_packing) return boolean is 
 	begin
 		if adr_packing.idx = 4 then 
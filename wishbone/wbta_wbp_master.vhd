@@ -105,6 +105,7 @@ begin
 						tract_out.sel  <= tract_i.sel;
 						wb_we_out  <= tract_i.we;
 						tract_out.we   <= tract_i.we;
+						tract_out.burst<= tract_i.burst;
 						keep_cycle     <= tract_i.cyc; 
 						state <= s_wait_for_ack;
 					end if; 
@@ -143,3 +144,189 @@ begin
 	end process;
 
 end architecture;
+
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+use work.wbta_pkg.all;
+
+-- like wbta_wbp_master, but it takes a new strobe request as soon as the previous 
+-- strobe was accepted by the slave (wb_stall_i = '0'), so that up to 2**g_depth strobes
+-- can be open at the same time. The responses are delivered in the order of the requests.
+-- A strobe that is stalled for longer than its stall_timeout is taken back (wb_stb_o goes low)
+-- and answered with stall_timeout = '1' after the responses of all strobes before it. 
+-- No new request is taken until then.
+entity wbta_wbp_master_pipelined is
+generic (
+	g_depth : positive := 2
+);
+port (
+	clk_i   :  in std_logic;
+	rst_i   :  in std_logic;
+
+	-- this interface takes a strobe request
+	tract_i :  in t_wbp_transaction_request;
+	stb_i   :  in std_logic;
+	stall_o : out std_logic;
+
+	-- this interface delivers the strobe response
+	tract_o : out t_wbp_transaction_response;
+	stb_o   : out std_logic;
+	stall_i :  in std_logic;
+
+	-- configuration if a response to write strobes is expected
+	config_write_response_i :  in std_logic;
+
+	-- a normal wishbone master
+	wb_cyc_o    : out std_logic;
+	wb_stb_o    : out std_logic;
+	wb_we_o     : out std_logic;
+	wb_adr_o    : out std_logic_vector(31 downto 0);
+	wb_dat_o    : out std_logic_vector(31 downto 0);
+	wb_sel_o    : out std_logic_vector( 3 downto 0);
+	wb_stall_i  :  in std_logic;
+	wb_ack_i    :  in std_logic;
+	wb_err_i    :  in std_logic;
+	wb_rty_i    :  in std_logic;
+	wb_dat_i    :  in std_logic_vector(31 downto 0));
+end entity;
+
+architecture rtl of wbta_wbp_master_pipelined is
+	-- the responses in the order of the strobes
+	type t_response_array is array(0 to 2**g_depth-1) of t_wbp_transaction_response;
+	signal responses : t_response_array := (others => c_wbp_transaction_response_init);
+	-- indices with one extra bit (like in fifo.vhd): 
+	--  strobes are written at w_idx, answered at a_idx, and delivered at r_idx
+	signal w_idx, a_idx, r_idx : unsigned(g_depth downto 0) := (others => '0');
+	signal full : boolean := false;
+
+	signal stall_out  : std_logic := '0';
+	signal take       : boolean := false;
+	signal tract_out  : t_wbp_transaction_response := c_wbp_transaction_response_init;
+	signal stb_out    : std_logic := '0';
+	signal stall_timeout_count : unsigned(31 downto 0) := (others => '0');
+	signal stall_timeout_active: boolean := false;
+	-- the strobe on the bus was taken back, its response is still to be written 
+	signal timeout_pending     : boolean := false;
+	
+	signal wb_cyc_out    : std_logic := '0';
+	signal wb_stb_out    : std_logic := '0';
+	signal wb_we_out     : std_logic := '0';
+	signal wb_adr_out    : std_logic_vector(31 downto 0) := (others => '0');
+	signal wb_dat_out    : std_logic_vector(31 downto 0) := (others => '0');
+	signal wb_sel_out    : std_logic_vector( 3 downto 0) := (others => '0');
+
+	signal keep_cycle : std_logic := '0';
+begin
+	stall_o  <= stall_out;
+	tract_o <= tract_out;
+	stb_o    <= stb_out;
+	
+	wb_cyc_o   <= wb_cyc_out;
+	wb_stb_o   <= wb_stb_out;
+	wb_we_o    <= wb_we_out;
+	wb_adr_o   <= wb_adr_out;
+	wb_dat_o   <= wb_dat_out;
+	wb_sel_o   <= wb_sel_out;
+
+	full <= w_idx(g_depth) /= r_idx(g_depth) and w_idx(g_depth-1 downto 0) = r_idx(g_depth-1 downto 0);
+
+	-- the next request can be taken when the strobe on the bus is accepted in this cycle
+	stall_out <= '1' when full or timeout_pending or (wb_stb_out = '1' and wb_stall_i = '1') else '0';
+	take      <= stb_i = '1' and stall_out = '0';
+
+	process 
+		variable answer : boolean;
+	begin 
+		wait until rising_edge(clk_i);
+
+		if rst_i = '1' then
+			w_idx                <= (others => '0');
+			a_idx                <= (others => '0');
+			r_idx                <= (others => '0');
+			tract_out            <= c_wbp_transaction_response_init;
+			stb_out              <= '0';
+			stall_timeout_count  <= (others => '0');
+			stall_timeout_active <= false;
+			timeout_pending      <= false;
+			wb_cyc_out           <= '0';
+			wb_stb_out           <= '0';
+			wb_we_out            <= '0';
+			wb_adr_out           <= (others => '0');
+			wb_dat_out           <= (others => '0');
+			wb_sel_out           <= (others => '0');
+			keep_cycle <= '0';
+
+		else
+
+			-- strobes
+			if take then
+				stall_timeout_active <= tract_i.stall_timeout /= 0;	
+				stall_timeout_count  <= tract_i.stall_timeout;
+				wb_cyc_out <= '1';
+				wb_stb_out <= '1';
+				wb_adr_out <= tract_i.adr;
+				wb_dat_out <= tract_i.dat;
+				wb_sel_out <= tract_i.sel;
+				wb_we_out  <= tract_i.we;
+				responses(to_integer(w_idx(g_depth-1 downto 0))).sel   <= tract_i.sel;
+				responses(to_integer(w_idx(g_depth-1 downto 0))).we    <= tract_i.we;
+				responses(to_integer(w_idx(g_depth-1 downto 0))).burst <= tract_i.burst;
+				keep_cycle <= tract_i.cyc; 
+				w_idx <= w_idx + 1;
+			elsif wb_stb_out = '1' then
+				if wb_stall_i = '0' then
+					wb_stb_out <= '0'; 
+				elsif stall_timeout_active and stall_timeout_count(31) = '1' then
+					wb_stb_out      <= '0';
+					timeout_pending <= true;
+				elsif stall_timeout_active then 
+					stall_timeout_count <= stall_timeout_count - 1;
+				end if;
+			end if;
+
+			-- answers, in the order of the strobes
+			answer := false;
+			if a_idx /= w_idx and (wb_ack_i = '1' or wb_err_i = '1' or wb_rty_i = '1') then
+				responses(to_integer(a_idx(g_depth-1 downto 0))).dat           <= wb_dat_i;
+				responses(to_integer(a_idx(g_depth-1 downto 0))).ack           <= wb_ack_i;
+				responses(to_integer(a_idx(g_depth-1 downto 0))).err           <= wb_err_i;
+				responses(to_integer(a_idx(g_depth-1 downto 0))).rty           <= wb_rty_i;
+				responses(to_integer(a_idx(g_depth-1 downto 0))).stall_timeout <= '0';
+				answer := true;
+			elsif timeout_pending and a_idx + 1 = w_idx then
+				-- all strobes before the one that was taken back are answered
+				responses(to_integer(a_idx(g_depth-1 downto 0))).dat           <= (others => '0');
+				responses(to_integer(a_idx(g_depth-1 downto 0))).ack           <= '0';
+				responses(to_integer(a_idx(g_depth-1 downto 0))).err           <= '0';
+				responses(to_integer(a_idx(g_depth-1 downto 0))).rty           <= '0';
+				responses(to_integer(a_idx(g_depth-1 downto 0))).stall_timeout <= '1';
+				timeout_pending <= false;
+				answer := true;
+			end if;
+			if answer then
+				a_idx <= a_idx + 1;
+				if a_idx + 1 = w_idx and not take and keep_cycle = '0' then
+					wb_cyc_out <= '0'; 
+				end if;
+			end if;
+
+			-- responses
+			if stb_out = '0' or stall_i = '0' then
+				stb_out <= '0';
+				if r_idx /= a_idx then
+					if config_write_response_i = '1' or responses(to_integer(r_idx(g_depth-1 downto 0))).we = '0' then
+						tract_out <= responses(to_integer(r_idx(g_depth-1 downto 0)));
+						stb_out   <= '1';
+					end if;
+					r_idx <= r_idx + 1;
+				end if;
+			end if;
+
+		end if;
+
+	end process;
+
+end architecture;